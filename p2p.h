@@ -4,6 +4,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <climits>
+#include <cstring>
 #include <type_traits>
 #ifdef P2P_SIMD
 #include <typeinfo>
@@ -85,10 +86,16 @@ struct uint48 {
 	constexpr operator uint64_t() const;
 };
 
+/** POD type holding an IEEE 754 half-precision planar sample. */
+struct half {
+	uint16_t bits;
+};
+
 static_assert(std::is_standard_layout<uint24>::value, "uint24 must be POD");
 static_assert(std::is_standard_layout<uint48>::value, "uint48 must be POD");
 static_assert(sizeof(uint24) == 3, "uint24 must not have padding");
 static_assert(sizeof(uint48) == 6, "uint48 must not have padding");
+static_assert(sizeof(half) == 2, "half must not have padding");
 
 /**
  * Native integer type corresponding to packed type.
@@ -129,6 +136,19 @@ constexpr uint32_t mask(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
 /** Initialize channel mask (i.e. u8[4]) by broadcasting. */
 constexpr uint32_t mask(uint8_t x) { return mask(x, x, x, x); }
 
+/**
+ * Range conversion between packed and planar samples.
+ *
+ * Limited (studio) range places black at 16 and white at 235, and chroma in
+ * [16, 240] centered at 128, all scaled by 2^(depth - 8). Full range spans
+ * every code, with chroma centered at half scale.
+ */
+enum range_mode {
+	range_none,         /**< Samples keep their range. */
+	range_limited_full, /**< Packed samples are limited range, planar samples full range. */
+	range_full_limited, /**< Packed samples are full range, planar samples limited range. */
+};
+
 /**
  * Packing format descriptor.
  *
@@ -189,6 +209,11 @@ struct pack_traits {
 	static const uint32_t component_mask = ComponentMask;
 	static const uint32_t shift_mask = ShiftMask;
 	static const uint32_t depth_mask = DepthMask;
+
+	static const unsigned planar_depth = 0; /**< Planar bit depth, or 0 if equal to the component depth. */
+	static const bool bit_replicate = false;
+	static const range_mode range = range_none;
+	static const bool yuv = false; /**< Components 1 and 2 are chroma. Only relevant to range conversion. */
 };
 
 namespace detail {
@@ -196,6 +221,108 @@ template <class T>
 static constexpr size_t bit_size = sizeof(T) * CHAR_BIT;
 }
 
+/**
+ * Packing format with rescaled planar samples.
+ *
+ * Components are converted between their packed depth and a common planar
+ * depth during the pack and unpack passes. By default, widening shifts the
+ * sample left and narrowing shifts right with rounding. If BitReplicate is
+ * set, full scale maps to full scale instead: widening fills the LSB with
+ * copies of the MSB, and narrowing rounds the sample scaled by the ratio of
+ * the maximum values, so that narrowing inverts widening.
+ *
+ * Floating point planar samples ({@ref half} or float) are normalized, with
+ * the maximum of each component at 1.0. Packing clamps them to [0, 1], with
+ * NaN mapped to 0, and rounds to nearest.
+ *
+ * @tparam Traits packing format definition
+ * @tparam Planar native integer type, float, or {@ref half}
+ * @tparam PlanarDepth bit depth of integer planar data, at most 16. Must be 0
+ *         for floating point
+ * @tparam BitReplicate scale by bit replication
+ */
+template <class Traits, class Planar, unsigned PlanarDepth = std::is_integral<Planar>::value ? detail::bit_size<Planar> : 0, bool BitReplicate = false>
+struct rescale_traits : Traits {
+	static_assert(std::is_trivial<Planar>::value, "must be POD");
+	static_assert(std::is_integral<Planar>::value || std::is_same<Planar, float>::value || std::is_same<Planar, half>::value, "unsupported planar type");
+	static_assert(std::is_integral<Planar>::value ? PlanarDepth > 0 && PlanarDepth <= 16 && PlanarDepth <= detail::bit_size<Planar> : PlanarDepth == 0,
+		"unsupported planar depth");
+
+	typedef Planar planar_type;
+
+	static const unsigned planar_depth = PlanarDepth;
+	static const bool bit_replicate = BitReplicate;
+};
+
+namespace detail {
+// Padding bits between component c and the next lower component.
+constexpr unsigned lsb_padding(uint32_t component_mask, uint32_t shift_mask, uint32_t depth_mask, unsigned c)
+{
+	unsigned shift = (shift_mask >> (c * 8)) & 0xFF;
+	unsigned floor = 0;
+
+	if (((component_mask >> (c * 8)) & 0xFF) == C__)
+		return 0;
+
+	for (unsigned i = 0; i < 4; ++i) {
+		unsigned end = ((shift_mask >> (i * 8)) & 0xFF) + ((depth_mask >> (i * 8)) & 0xFF);
+		if (i != c && ((component_mask >> (i * 8)) & 0xFF) != C__ && end <= shift && end > floor)
+			floor = end;
+	}
+	return shift - floor;
+}
+
+template <class Traits>
+constexpr uint32_t lsb_padding_mask()
+{
+	return mask(
+		lsb_padding(Traits::component_mask, Traits::shift_mask, Traits::depth_mask, 0),
+		lsb_padding(Traits::component_mask, Traits::shift_mask, Traits::depth_mask, 1),
+		lsb_padding(Traits::component_mask, Traits::shift_mask, Traits::depth_mask, 2),
+		lsb_padding(Traits::component_mask, Traits::shift_mask, Traits::depth_mask, 3));
+}
+} // namespace detail
+
+/**
+ * Packing format with MSB-aligned planar samples.
+ *
+ * Components padded in their LSB, as in P010 or Y210, are converted without
+ * shifting the padding away, so that planar samples keep the alignment they
+ * have in the packed word. Padding bits pass through unchanged in both
+ * directions; they are zero in conforming data. For the predefined padded
+ * formats, the result has the layout of the 16-bit format, e.g. P016 for
+ * P010, whose kernels may be used instead.
+ *
+ * @tparam Traits packing format definition
+ */
+template <class Traits>
+struct msb_traits : Traits {
+	static const uint32_t shift_mask = Traits::shift_mask - detail::lsb_padding_mask<Traits>();
+	static const uint32_t depth_mask = Traits::depth_mask + detail::lsb_padding_mask<Traits>();
+};
+
+/**
+ * Packing format with range conversion.
+ *
+ * Luma and color components of at least 8 bits are remapped between limited
+ * and full range in the pack and unpack passes, together with any rescaling
+ * to the planar type, and rounded once. Integer results are clamped to their
+ * range. Floating point planar samples have black at 0.0, white at 1.0, and
+ * chroma centered at 0.5; unpacking does not clamp them, so that out-of-range
+ * codes survive, and packing clamps as usual. Alpha is not remapped.
+ *
+ * @tparam Traits packing format definition
+ * @tparam Range direction of the conversion
+ * @tparam Yuv components 1 and 2 are chroma (Cb, Cr) rather than green and blue
+ */
+template <class Traits, range_mode Range, bool Yuv = true>
+struct range_traits : Traits {
+	static_assert(Range != range_full_limited || std::is_integral<typename Traits::planar_type>::value, "limited range planar samples must be integers");
+
+	static const range_mode range = Range;
+	static const bool yuv = Yuv;
+};
+
 /**
  * Helper template for defining 4:4:4 packing formats.
  *
@@ -405,9 +532,21 @@ using packed_p016_be = packed_p216_be; /**< p016be */
 using packed_p016_le = packed_p216_le; /**< p016le, a.k.a. P016 */
 using packed_p016 = packed_p216;
 
-// Special formats.
-struct packed_v210_be {}; /**< v210be */;
-struct packed_v210_le {}; /**< v210le, a.k.a. v210 */;
+// Special formats. Their layout is given by specializations; only the planar
+// sample fields of pack_traits apply, so that they can be wrapped like others.
+namespace detail {
+struct v210_traits {
+	typedef uint16_t planar_type;
+
+	static const unsigned planar_depth = 0;
+	static const bool bit_replicate = false;
+	static const range_mode range = range_none;
+	static const bool yuv = true;
+};
+} // namespace detail
+
+struct packed_v210_be : detail::v210_traits {}; /**< v210be */;
+struct packed_v210_le : detail::v210_traits {}; /**< v210le, a.k.a. v210 */;
 using packed_v210 = endian_select<packed_v210_be, packed_v210_le>;
 
 // ^^^ End of predefined formats. ^^^
@@ -417,6 +556,27 @@ using packed_v210 = endian_select<packed_v210_be, packed_v210_le>;
 namespace detail {
 typedef void (*unpack_func)(const void *, void * const *, unsigned, unsigned);
 typedef void (*pack_func)(const void * const *, void *, unsigned, unsigned);
+typedef void (*unpack_2d_func)(const void *, ptrdiff_t, void * const *, const ptrdiff_t *, unsigned, unsigned, unsigned);
+typedef void (*pack_2d_func)(const void * const *, const ptrdiff_t *, void *, ptrdiff_t, unsigned, unsigned, unsigned);
+struct byte_transform;
+typedef void (*transform_func)(const void *, void *, size_t, const byte_transform &);
+enum row_filter : unsigned;
+typedef void (*row_filter_func)(const void * const *, void *, unsigned);
+enum chroma_resample : unsigned;
+typedef void (*chroma_resample_func)(const void *, void *, unsigned, unsigned);
+enum alpha_op : unsigned;
+struct alpha_scale;
+typedef void (*alpha_func)(const void *, const void *, void *, unsigned, const alpha_scale &);
+struct color_matrix;
+typedef void (*matrix_func)(const void * const *, void * const *, unsigned, const color_matrix &);
+struct lut_table;
+typedef void (*lut_func)(const void *, void *, unsigned, const lut_table &);
+enum dither_mode : unsigned;
+typedef void (*dither_func)(const void *, void *, unsigned, unsigned, unsigned);
+typedef void (*box_filter_func)(const void * const *, void *, unsigned);
+struct sample_stats;
+typedef void (*stats_func)(const void *, unsigned, sample_stats &);
+typedef uint32_t (*crc32c_func)(uint32_t, const void *, size_t);
 }
 #endif // P2P_SIMD
 
@@ -425,7 +585,7 @@ typedef void (*pack_func)(const void * const *, void *, unsigned, unsigned);
  *
  * @tparam Traits packing format definition
  */
-template <class Traits>
+template <class Traits, class Enable = void>
 class packed_to_planar {
 	typedef typename Traits::planar_type planar_type;
 	typedef typename Traits::packed_type packed_type;
@@ -435,11 +595,13 @@ class packed_to_planar {
 
 #ifdef P2P_SIMD
 	static detail::unpack_func s_delegate;
+	static detail::unpack_2d_func s_delegate_2d;
 #endif
 
 	static planar_type extract_component(numeric_type x, unsigned c);
 
 	static void unpack_impl(const void *src, void * const dst[4], unsigned left, unsigned right);
+	static void unpack_2d_impl(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height);
 public:
 	/**
 	 * Unpack one scanline.
@@ -455,6 +617,27 @@ public:
 		s_delegate(src, dst, left, right);
 #else
 		unpack_impl(src, dst, left, right);
+#endif
+	}
+
+	/**
+	 * Unpack a rectangle of scanlines, as {@ref unpack} on each in turn. SIMD
+	 * kernels also prefetch the start of the next scanline.
+	 *
+	 * @param src pointer to first packed scanline
+	 * @param src_stride distance between packed scanlines in bytes
+	 * @param dst pointer to first planar scanlines, in R-G-B-A or Y-U-V-A order
+	 * @param dst_stride distance between planar scanlines in bytes
+	 * @param left first pixel to process
+	 * @param right last pixel to process
+	 * @param height number of scanlines
+	 */
+	static void unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+	{
+#ifdef P2P_SIMD
+		s_delegate_2d(src, src_stride, dst, dst_stride, left, right, height);
+#else
+		unpack_2d_impl(src, src_stride, dst, dst_stride, left, right, height);
 #endif
 	}
 };
@@ -465,7 +648,7 @@ public:
  * @tparam Traits packing format definition
  * @tparam AlphaOneFill initialize alpha channel to all-ones if not provided
  */
-template <class Traits, bool AlphaOneFill = true>
+template <class Traits, bool AlphaOneFill = true, class Enable = void>
 class planar_to_packed {
 	typedef typename Traits::planar_type planar_type;
 	typedef typename Traits::packed_type packed_type;
@@ -475,11 +658,14 @@ class planar_to_packed {
 
 #ifdef P2P_SIMD
 	static detail::pack_func s_delegate;
+	static detail::pack_2d_func s_delegate_2d;
 #endif
 
 	static numeric_type align_component(planar_type x, unsigned c);
+	static numeric_type ones_component(unsigned c);
 
 	static void pack_impl(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d_impl(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
 public:
 	/**
 	 * Pack one scanline.
@@ -495,6 +681,27 @@ public:
 		s_delegate(src, dst, left, right);
 #else
 		pack_impl(src, dst, left, right);
+#endif
+	}
+
+	/**
+	 * Pack a rectangle of scanlines, as {@ref pack} on each in turn. SIMD
+	 * kernels also prefetch the start of the next scanline.
+	 *
+	 * @param src pointer to first planar scanlines, in R-G-B-A or Y-U-V-A order
+	 * @param src_stride distance between planar scanlines in bytes
+	 * @param dst pointer to first packed scanline
+	 * @param dst_stride distance between packed scanlines in bytes
+	 * @param left first pixel to process
+	 * @param right last pixel to process
+	 * @param height number of scanlines
+	 */
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+	{
+#ifdef P2P_SIMD
+		s_delegate_2d(src, src_stride, dst, dst_stride, left, right, height);
+#else
+		pack_2d_impl(src, src_stride, dst, dst_stride, left, right, height);
 #endif
 	}
 };
@@ -504,31 +711,121 @@ template <>
 class packed_to_planar<packed_v210_be> {
 public:
 	static void unpack(const void *src, void * const dst[4], unsigned left, unsigned right);
+	static void unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height);
 };
 template <>
 class packed_to_planar<packed_v210_le> {
 public:
 	static void unpack(const void *src, void * const dst[4], unsigned left, unsigned right);
+	static void unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height);
 };
 template <>
 class planar_to_packed<packed_v210_be, false> {
 public:
 	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
 };
 template <>
 class planar_to_packed<packed_v210_be, true> {
 public:
 	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
 };
 template <>
 class planar_to_packed<packed_v210_le, false> {
 public:
 	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
 };
 template <>
 class planar_to_packed<packed_v210_le, true> {
 public:
 	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
+};
+
+namespace detail {
+// Wrapped v210, e.g. rescale_traits or range_traits of packed_v210_le.
+template <class Traits>
+struct is_wrapped_v210 : std::integral_constant<bool,
+	(std::is_base_of<packed_v210_be, Traits>::value || std::is_base_of<packed_v210_le, Traits>::value) &&
+	!std::is_same<Traits, packed_v210_be>::value && !std::is_same<Traits, packed_v210_le>::value> {};
+
+// Wrapped v210, converted through a 10-bit line buffer.
+template <class Traits>
+struct wrapped_v210 {
+	typedef std::conditional_t<std::is_base_of<packed_v210_be, Traits>::value, packed_v210_be, packed_v210_le> v210;
+	typedef typename Traits::planar_type planar_type;
+
+	static const unsigned line_pels = 384;
+
+	static void unpack(const void *src, void * const dst[4], unsigned left, unsigned right);
+	static void unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height);
+	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right);
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
+};
+} // namespace detail
+
+template <class Traits>
+class packed_to_planar<Traits, std::enable_if_t<detail::is_wrapped_v210<Traits>::value>> {
+	typedef detail::wrapped_v210<Traits> impl;
+public:
+	static void unpack(const void *src, void * const dst[4], unsigned left, unsigned right) { impl::unpack(src, dst, left, right); }
+	static void unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+	{
+		impl::unpack_2d(src, src_stride, dst, dst_stride, left, right, height);
+	}
+};
+template <class Traits, bool AlphaOneFill>
+class planar_to_packed<Traits, AlphaOneFill, std::enable_if_t<detail::is_wrapped_v210<Traits>::value>> {
+	typedef detail::wrapped_v210<Traits> impl;
+public:
+	static void pack(const void * const src[4], void *dst, unsigned left, unsigned right) { impl::pack(src, dst, left, right); }
+	static void pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+	{
+		impl::pack_2d(src, src_stride, dst, dst_stride, left, right, height);
+	}
+};
+
+/**
+ * Convert between packed formats.
+ *
+ * Pixels are unpacked into a small line buffer and repacked immediately, so
+ * that no intermediate planar frame is needed. The formats must have the same
+ * planar type and subsampling. If they also have the same pack size, source
+ * and destination may be the same buffer.
+ *
+ * @tparam SrcTraits source packing format definition
+ * @tparam DstTraits destination packing format definition
+ * @tparam AlphaOneFill initialize alpha channel to all-ones if the source has none
+ */
+template <class SrcTraits, class DstTraits, bool AlphaOneFill = true>
+class packed_to_packed {
+	// Pixels per line buffer. Multiple of every pack size.
+	static const unsigned line_pels = 384;
+public:
+	/**
+	 * Convert one scanline.
+	 *
+	 * @param src pointer to source scanline
+	 * @param dst pointer to destination scanline
+	 * @param left first pixel to process
+	 * @param right last pixel to process
+	 */
+	static void convert(const void *src, void *dst, unsigned left, unsigned right);
+
+	/**
+	 * Convert a rectangle of scanlines.
+	 *
+	 * @param src pointer to first source scanline
+	 * @param src_stride distance between source scanlines in bytes
+	 * @param dst pointer to first destination scanline
+	 * @param dst_stride distance between destination scanlines in bytes
+	 * @param left first pixel to process
+	 * @param right last pixel to process
+	 * @param height number of scanlines
+	 */
+	static void convert_2d(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height);
 };
 
 } // namespace p2p
@@ -603,6 +900,13 @@ T convert_endian(T x) { return x; }
 template <class Endian, class T, std::enable_if_t<!std::is_same<Endian, native_endian_t>::value> * = nullptr>
 T convert_endian(T x) { return endian_swap(x); }
 
+// Advance a byte-addressed pointer, keeping null pointers null.
+template <class T>
+T *increment_ptr(T *ptr, ptrdiff_t n)
+{
+	return ptr ? (T *)((const unsigned char *)ptr + n) : nullptr;
+}
+
 } // namespace detail
 
 
@@ -644,6 +948,49 @@ namespace detail {
 
 unpack_func search_unpack_func(const std::type_info &ti);
 pack_func search_pack_func(const std::type_info &ti, bool alpha_one_fill);
+unpack_2d_func search_unpack_2d_func(const std::type_info &ti);
+pack_2d_func search_pack_2d_func(const std::type_info &ti, bool alpha_one_fill);
+
+/** Variants with non-temporal stores, or null if none. The caller issues the store fence. */
+unpack_2d_func search_unpack_2d_nt_func(const std::type_info &ti);
+pack_2d_func search_pack_2d_nt_func(const std::type_info &ti, bool alpha_one_fill);
+
+/** Kernel for {@ref byte_transform}, or null if none. Source and destination may alias. */
+transform_func search_transform_func();
+
+/** Kernel for {@ref row_filter} on 8- or 16-bit samples, or null if none. */
+row_filter_func search_row_filter_func(row_filter filter, unsigned bytes_per_sample);
+
+/** Kernel for {@ref chroma_resample} on 8- or 16-bit samples, or null if none. */
+chroma_resample_func search_chroma_resample_func(chroma_resample resample, unsigned bytes_per_sample);
+
+/** Kernel for {@ref alpha_op} on 8- or 16-bit samples with full-scale alpha, or null if none. */
+alpha_func search_alpha_func(alpha_op op, unsigned bytes_per_sample);
+
+/** Kernel for {@ref color_matrix} on 8- or 16-bit samples, or null if none. Source and destination may alias. */
+matrix_func search_matrix_func(unsigned bytes_per_sample);
+
+/** Kernel for {@ref lut_table} on 8- or 16-bit samples, or null if none. Source and destination may alias. */
+lut_func search_lut_func(unsigned bytes_per_sample);
+
+/** Kernel for {@ref dither_mode} on 16-bit samples scaled by shifts, or null if none. Source and destination may alias. */
+dither_func search_dither_func(dither_mode mode);
+
+/**
+ * Kernel averaging scale x scale boxes of 8- or 16-bit samples, rounded to
+ * nearest, from scale rows of width samples, or null if none. A partial box at
+ * the end of the rows averages the samples it covers.
+ */
+box_filter_func search_box_filter_func(unsigned scale, unsigned bytes_per_sample);
+
+/** Kernel for {@ref sample_stats} on 8- or 16-bit samples, or null if none. */
+stats_func search_stats_func(unsigned bytes_per_sample);
+
+/**
+ * Kernel continuing a CRC-32C over n bytes, or null if none. The CRC is passed
+ * and returned finally inverted, as for zlib crc32, and is zero for no bytes.
+ */
+crc32c_func search_crc32c_func();
 
 template <class Traits>
 unpack_func search_unpack_func(unpack_func default_func)
@@ -659,12 +1006,30 @@ pack_func search_pack_func(pack_func default_func)
 	return func ? func : default_func;
 }
 
-} // namespace detail
-
 template <class Traits>
-detail::unpack_func packed_to_planar<Traits>::s_delegate = detail::search_unpack_func<Traits>(packed_to_planar::unpack_impl);
+unpack_2d_func search_unpack_2d_func(unpack_2d_func default_func)
+{
+	unpack_2d_func func = search_unpack_2d_func(typeid(Traits));
+	return func ? func : default_func;
+}
+
 template <class Traits, bool AlphaOneFill>
-detail::pack_func planar_to_packed<Traits, AlphaOneFill>::s_delegate = detail::search_pack_func<Traits, AlphaOneFill>(planar_to_packed::pack_impl);
+pack_2d_func search_pack_2d_func(pack_2d_func default_func)
+{
+	pack_2d_func func = search_pack_2d_func(typeid(Traits), AlphaOneFill);
+	return func ? func : default_func;
+}
+
+} // namespace detail
+
+template <class Traits, class Enable>
+detail::unpack_func packed_to_planar<Traits, Enable>::s_delegate = detail::search_unpack_func<Traits>(packed_to_planar::unpack_impl);
+template <class Traits, bool AlphaOneFill, class Enable>
+detail::pack_func planar_to_packed<Traits, AlphaOneFill, Enable>::s_delegate = detail::search_pack_func<Traits, AlphaOneFill>(planar_to_packed::pack_impl);
+template <class Traits, class Enable>
+detail::unpack_2d_func packed_to_planar<Traits, Enable>::s_delegate_2d = detail::search_unpack_2d_func<Traits>(packed_to_planar::unpack_2d_impl);
+template <class Traits, bool AlphaOneFill, class Enable>
+detail::pack_2d_func planar_to_packed<Traits, AlphaOneFill, Enable>::s_delegate_2d = detail::search_pack_2d_func<Traits, AlphaOneFill>(planar_to_packed::pack_2d_impl);
 #endif // P2P_SIMD
 
 namespace detail {
@@ -674,17 +1039,411 @@ constexpr bool mask_contains(uint32_t mask, unsigned val)
 {
 	return mask_get(mask, 0) == val || mask_get(mask, 1) == val || mask_get(mask, 2) == val || mask_get(mask, 3) == val;
 }
-} // namespace detail
 
+// Bit depth of the first packed field holding a component, or 0 if none.
+constexpr unsigned component_depth(uint32_t component_mask, uint32_t depth_mask, unsigned component)
+{
+	for (unsigned c = 0; c < 4; ++c) {
+		if (mask_get(component_mask, c) == component)
+			return mask_get(depth_mask, c);
+	}
+	return 0;
+}
+
+// Layout of a packing, including the special formats.
 template <class Traits>
-typename packed_to_planar<Traits>::planar_type packed_to_planar<Traits>::extract_component(numeric_type x, unsigned c)
+struct packing_info {
+	typedef typename Traits::planar_type planar_type;
+	static const unsigned pel_per_pack = Traits::pel_per_pack;
+	static const unsigned bytes_per_pack = sizeof(typename Traits::packed_type);
+	static const unsigned subsampling = Traits::subsampling;
+	static const bool has_alpha = mask_contains(Traits::component_mask, C_A);
+	static const unsigned depth = mask_contains(Traits::component_mask, C_Y) ?
+		component_depth(Traits::component_mask, Traits::depth_mask, C_Y) : component_depth(Traits::component_mask, Traits::depth_mask, C_U);
+	static const unsigned alpha_depth = component_depth(Traits::component_mask, Traits::depth_mask, C_A);
+};
+
+template <>
+struct packing_info<packed_v210_be> {
+	typedef uint16_t planar_type;
+	static const unsigned pel_per_pack = 6;
+	static const unsigned bytes_per_pack = 16;
+	static const unsigned subsampling = 1;
+	static const bool has_alpha = false;
+	static const unsigned depth = 10;
+	static const unsigned alpha_depth = 0;
+};
+
+template <>
+struct packing_info<packed_v210_le> : packing_info<packed_v210_be> {};
+
+// Conversion of 16-byte groups in one pass: gather bytes, shift each 16-bit
+// little-endian lane, mask, then reorder the bytes within each lane.
+struct byte_transform {
+	uint8_t shuffle[16];
+	uint8_t mask[16];
+	uint8_t shuffle_out[16];
+	uint8_t shift_right;
+	uint8_t shift_left;
+};
+
+// Vertical filters of planar rows, rounded to nearest. Weights apply to the
+// source rows in the order given.
+enum row_filter : unsigned {
+	row_average,     // [1 1] / 2
+	row_interpolate, // [3 1] / 4
+	row_smooth,      // [1 3 3 1] / 8
+};
+
+// Horizontal resampling of chroma rows by a factor of two, rounded to
+// nearest. Decimated sample k is sited at source sample 2k (cosited), or
+// halfway between 2k and 2k + 1 (centered), and upsampling assumes the same
+// siting. Samples beyond the source row repeat the edge sample.
+enum chroma_resample : unsigned {
+	chroma_drop,            // x[2k]
+	chroma_average,         // [1 1] / 2, centered
+	chroma_triangle,        // [1 2 1] / 4, cosited
+	chroma_smooth,          // [1 3 3 1] / 8, centered
+	chroma_repeat,          // x[k / 2]
+	chroma_linear_cosited,  // x[k / 2], or [1 1] / 2 between samples
+	chroma_linear_centered, // [3 1] / 4 from the nearest two samples
+};
+
+// Conversion of color rows between straight and premultiplied alpha, rounded
+// to nearest. Color scales towards zero, or towards half scale if centered,
+// as chroma does. Unpremultiplying clamps to full scale and maps zero alpha to
+// zero color. Floating point samples are neither clamped nor rounded.
+enum alpha_op : unsigned {
+	alpha_premultiply,   // x * a / max
+	alpha_unpremultiply, // x * max / a
+};
+
+// Integer depths of the color and alpha samples of an alpha_op.
+struct alpha_scale {
+	unsigned char depth;
+	unsigned char alpha_depth;
+	bool centered;
+};
+
+// Conversion of three planar color rows by y[i] = M[i] * (x - in) + out[i].
+// Integer coefficients have 13 fractional bits, and integer results are
+// rounded to nearest and clamped to [0, max]. Floating point samples use the
+// float coefficients, normalized like the samples, and are not clamped.
+struct color_matrix {
+	int32_t c[3][3];
+	int32_t in[3];
+	int32_t out[3];
+	int32_t max;
+	float cf[3][3];
+	float in_f[3];
+	float out_f[3];
+};
+
+// Lookup of planar samples in a table of mask + 1 entries of the same type.
+// Indices are masked, so that samples above the depth stay in the table.
+struct lut_table {
+	const void *entries;
+	uint32_t mask;
+};
+
+// Quantization of a row of planar samples to the codes of a lower packed
+// depth, written back as samples that the pack kernel then rounds exactly.
+// Ordered dithering adds a threshold from an 8x8 Bayer matrix, indexed by
+// column and row, before rounding down. Error diffusion rounds to nearest and
+// carries the error of each sample to the next one in the row, so that rows
+// stay independent.
+enum dither_mode : unsigned {
+	dither_ordered,
+	dither_error_diffusion,
+};
+
+// Entry of the 8x8 Bayer matrix, from 0 to 63.
+inline unsigned bayer_threshold(unsigned x, unsigned y)
+{
+	unsigned t = 0;
+	for (unsigned bit = 0; bit < 3; ++bit) {
+		t |= (((x ^ y) >> bit) & 1) << (5 - 2 * bit);
+		t |= ((y >> bit) & 1) << (4 - 2 * bit);
+	}
+	return t;
+}
+
+// Running minimum, maximum and sum of a row of integer samples, starting from
+// UINT32_MAX, zero, and zero.
+struct sample_stats {
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+};
+} // namespace detail
+
+namespace detail {
+// Convert a sample of at most 16 bits between bit depths. See rescale_traits.
+template <bool BitReplicate>
+inline uint32_t rescale_depth(uint32_t x, unsigned from, unsigned to)
+{
+	if (from < to) {
+		uint32_t y = x << (to - from);
+		for (unsigned filled = from; BitReplicate && filled < to; filled *= 2) {
+			y |= y >> filled;
+		}
+		return y;
+	} else if (from > to) {
+		uint32_t max_from = (UINT32_C(1) << from) - 1;
+		uint32_t max_to = (UINT32_C(1) << to) - 1;
+
+		if (BitReplicate)
+			return (x * max_to + max_from / 2) / max_from;
+
+		uint32_t y = (x + (UINT32_C(1) << (from - to - 1))) >> (from - to);
+		return y < max_to ? y : max_to;
+	} else {
+		return x;
+	}
+}
+
+// Conversion between single and half precision, rounding to nearest even.
+inline float half_to_float(uint16_t h)
+{
+	uint32_t sign = static_cast<uint32_t>(h & 0x8000U) << 16;
+	uint32_t exp = (h >> 10) & 0x1FU;
+	uint32_t mant = h & 0x3FFU;
+	uint32_t bits;
+
+	if (exp == 0x1F) {
+		bits = sign | 0x7F800000U | (mant << 13);
+	} else if (exp) {
+		bits = sign | ((exp + 112) << 23) | (mant << 13);
+	} else {
+		// Zero or subnormal, exact in single precision.
+		float f = static_cast<float>(mant) * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+inline uint16_t float_to_half(float f)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000U;
+	uint32_t abs = bits & 0x7FFFFFFFU;
+
+	if (abs > 0x7F800000U)
+		return static_cast<uint16_t>(sign | 0x7E00U); // NaN
+	if (abs >= 0x47800000U)
+		return static_cast<uint16_t>(sign | 0x7C00U); // Overflow to infinity.
+
+	if (abs < 0x38800000U) {
+		// Subnormal. Round in units of the smallest subnormal, 2^-24.
+		float a;
+		std::memcpy(&a, &abs, sizeof(a));
+		a *= 16777216.0f;
+
+		uint32_t q = static_cast<uint32_t>(a);
+		float rem = a - static_cast<float>(q);
+		q += rem > 0.5f || (rem == 0.5f && (q & 1));
+		return static_cast<uint16_t>(sign | q);
+	}
+
+	// Rebias the exponent and round the mantissa. A carry propagates into the
+	// exponent, up to infinity.
+	abs += 0xFFFU + ((abs >> 13) & 1);
+	return static_cast<uint16_t>(sign | ((abs - 0x38000000U) >> 13));
+}
+
+// Conversion of a component sample to and from its planar representation.
+// Integers are rescaled if PlanarDepth is set. See rescale_traits.
+template <class Planar, unsigned PlanarDepth, bool BitReplicate>
+struct planar_codec {
+	static Planar decode(uint32_t x, unsigned depth)
+	{
+		return static_cast<Planar>(PlanarDepth ? rescale_depth<BitReplicate>(x, depth, PlanarDepth) : x);
+	}
+
+	static uint32_t encode(Planar x, unsigned depth)
+	{
+		return PlanarDepth ? rescale_depth<BitReplicate>(x, PlanarDepth, depth) : static_cast<uint32_t>(x);
+	}
+};
+
+template <bool BitReplicate>
+struct planar_codec<float, 0, BitReplicate> {
+	static float decode(uint32_t x, unsigned depth)
+	{
+		return static_cast<float>(x) * (1.0f / static_cast<float>((UINT32_C(1) << depth) - 1));
+	}
+
+	static uint32_t encode(float x, unsigned depth)
+	{
+		// Comparisons are ordered so that NaN clamps to zero.
+		x = x > 0.0f ? x : 0.0f;
+		x = x < 1.0f ? x : 1.0f;
+		return static_cast<uint32_t>(x * static_cast<float>((UINT32_C(1) << depth) - 1) + 0.5f);
+	}
+};
+
+template <bool BitReplicate>
+struct planar_codec<half, 0, BitReplicate> {
+	static half decode(uint32_t x, unsigned depth)
+	{
+		return half{ float_to_half(planar_codec<float, 0, BitReplicate>::decode(x, depth)) };
+	}
+
+	static uint32_t encode(half x, unsigned depth)
+	{
+		return planar_codec<float, 0, BitReplicate>::encode(half_to_float(x.bits), depth);
+	}
+};
+
+// Division rounding half away from zero. The divisor is positive.
+inline int64_t div_round(int64_t num, int64_t den)
+{
+	return num < 0 ? -((den / 2 - num) / den) : (num + den / 2) / den;
+}
+
+inline uint32_t clamp_code(int64_t x, unsigned depth)
+{
+	int64_t max = (INT64_C(1) << depth) - 1;
+	return static_cast<uint32_t>(x < 0 ? 0 : x > max ? max : x);
+}
+
+// Remap a sample from limited range at depth `from` to full range at depth
+// `to`, or the reverse. Depths are 8 to 16 bits. See range_traits.
+inline uint32_t limited_to_full(uint32_t x, unsigned from, unsigned to, bool chroma)
 {
-	numeric_type lsb_mask = ~static_cast<numeric_type>(0) >> (detail::bit_size<numeric_type> -detail::mask_get(Traits::depth_mask, c));
-	return static_cast<planar_type>((x >> detail::mask_get(Traits::shift_mask, c)) & lsb_mask);
+	int64_t k = INT64_C(1) << (from - 8);
+	int64_t max_to = (INT64_C(1) << to) - 1;
+
+	if (chroma)
+		return clamp_code((INT64_C(1) << (to - 1)) + div_round((x - 128 * k) * max_to, 224 * k), to);
+	else
+		return clamp_code(div_round((x - 16 * k) * max_to, 219 * k), to);
+}
+
+inline uint32_t full_to_limited(uint32_t x, unsigned from, unsigned to, bool chroma)
+{
+	int64_t k = INT64_C(1) << (to - 8);
+	int64_t max_from = (INT64_C(1) << from) - 1;
+
+	if (chroma)
+		return clamp_code(128 * k + div_round((x - (INT64_C(1) << (from - 1))) * 224 * k, max_from), to);
+	else
+		return clamp_code(16 * k + div_round(x * 219 * k, max_from), to);
 }
 
+// Codec with range conversion of luma, chroma and color samples.
+template <class Planar, unsigned PlanarDepth, bool BitReplicate, range_mode Range>
+struct range_codec {
+	typedef planar_codec<Planar, PlanarDepth, BitReplicate> codec;
+
+	static Planar decode(uint32_t x, unsigned depth, bool chroma)
+	{
+		unsigned planar_depth = PlanarDepth ? PlanarDepth : depth;
+
+		if (Range == range_limited_full)
+			return static_cast<Planar>(limited_to_full(x, depth, planar_depth, chroma));
+		else if (Range == range_full_limited)
+			return static_cast<Planar>(full_to_limited(x, depth, planar_depth, chroma));
+		else
+			return codec::decode(x, depth);
+	}
+
+	static uint32_t encode(Planar x, unsigned depth, bool chroma)
+	{
+		unsigned planar_depth = PlanarDepth ? PlanarDepth : depth;
+
+		if (Range == range_limited_full)
+			return full_to_limited(x, planar_depth, depth, chroma);
+		else if (Range == range_full_limited)
+			return limited_to_full(x, planar_depth, depth, chroma);
+		else
+			return codec::encode(x, depth);
+	}
+};
+
+template <bool BitReplicate, range_mode Range>
+struct range_codec<float, 0, BitReplicate, Range> {
+	typedef planar_codec<float, 0, BitReplicate> codec;
+
+	static float decode(uint32_t x, unsigned depth, bool chroma)
+	{
+		if (Range == range_none)
+			return codec::decode(x, depth);
+
+		float k = static_cast<float>(UINT32_C(1) << (depth - 8));
+
+		if (chroma)
+			return 0.5f + (static_cast<float>(x) - 128.0f * k) * (1.0f / (224.0f * k));
+		else
+			return (static_cast<float>(x) - 16.0f * k) * (1.0f / (219.0f * k));
+	}
+
+	static uint32_t encode(float x, unsigned depth, bool chroma)
+	{
+		if (Range == range_none)
+			return codec::encode(x, depth);
+
+		float k = static_cast<float>(UINT32_C(1) << (depth - 8));
+		float max = static_cast<float>((UINT32_C(1) << depth) - 1);
+
+		x = chroma ? (x - 0.5f) * (224.0f * k) + 128.0f * k : x * (219.0f * k) + 16.0f * k;
+		x = x > 0.0f ? x : 0.0f;
+		x = x < max ? x : max;
+		return static_cast<uint32_t>(x + 0.5f);
+	}
+};
+
+template <bool BitReplicate, range_mode Range>
+struct range_codec<half, 0, BitReplicate, Range> {
+	typedef range_codec<float, 0, BitReplicate, Range> codec;
+
+	static half decode(uint32_t x, unsigned depth, bool chroma)
+	{
+		return half{ float_to_half(codec::decode(x, depth, chroma)) };
+	}
+
+	static uint32_t encode(half x, unsigned depth, bool chroma)
+	{
+		return codec::encode(half_to_float(x.bits), depth, chroma);
+	}
+};
+
+// Codec of a component of a packing. Alpha keeps its range.
 template <class Traits>
-void packed_to_planar<Traits>::unpack_impl(const void *src, void * const dst[4], unsigned left, unsigned right)
+struct component_codec {
+	typedef typename Traits::planar_type planar_type;
+	typedef planar_codec<planar_type, Traits::planar_depth, Traits::bit_replicate> alpha_codec;
+	typedef range_codec<planar_type, Traits::planar_depth, Traits::bit_replicate, Traits::range> codec;
+
+	static planar_type decode(uint32_t x, unsigned depth, unsigned component)
+	{
+		return component == C_A ? alpha_codec::decode(x, depth) : codec::decode(x, depth, Traits::yuv && component != C_Y);
+	}
+
+	static uint32_t encode(planar_type x, unsigned depth, unsigned component)
+	{
+		return component == C_A ? alpha_codec::encode(x, depth) : codec::encode(x, depth, Traits::yuv && component != C_Y);
+	}
+};
+} // namespace detail
+
+template <class Traits, class Enable>
+typename packed_to_planar<Traits, Enable>::planar_type packed_to_planar<Traits, Enable>::extract_component(numeric_type x, unsigned c)
+{
+	unsigned depth = detail::mask_get(Traits::depth_mask, c);
+	numeric_type lsb_mask = static_cast<numeric_type>(~static_cast<numeric_type>(0)) >> (detail::bit_size<numeric_type> - depth);
+	numeric_type val = (x >> detail::mask_get(Traits::shift_mask, c)) & lsb_mask;
+
+	return detail::component_codec<Traits>::decode(static_cast<uint32_t>(val), depth, detail::mask_get(Traits::component_mask, c));
+}
+
+template <class Traits, class Enable>
+void packed_to_planar<Traits, Enable>::unpack_impl(const void *src, void * const dst[4], unsigned left, unsigned right)
 {
 	const packed_type *src_p = static_cast<const packed_type *>(src);
 	planar_type *dst_p[4] = {
@@ -715,15 +1474,39 @@ void packed_to_planar<Traits>::unpack_impl(const void *src, void * const dst[4],
 #undef P2P_COMPONENT_ENABLED
 }
 
-template <class Traits, bool AlphaOneFill>
-typename planar_to_packed<Traits, AlphaOneFill>::numeric_type planar_to_packed<Traits, AlphaOneFill>::align_component(planar_type x, unsigned c)
+template <class Traits, class Enable>
+void packed_to_planar<Traits, Enable>::unpack_2d_impl(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
 {
-	numeric_type lsb_mask = ~static_cast<numeric_type>(0) >> (detail::bit_size<numeric_type> -detail::mask_get(Traits::depth_mask, c));
-	return (static_cast<numeric_type>(x) & lsb_mask) << detail::mask_get(Traits::shift_mask, c);
+	void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		unpack_impl(src, dst_p, left, right);
+
+		src = detail::increment_ptr(src, src_stride);
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = detail::increment_ptr(dst_p[p], dst_stride[p]);
+		}
+	}
 }
 
-template <class Traits, bool AlphaOneFill>
-void planar_to_packed<Traits, AlphaOneFill>::pack_impl(const void * const src[4], void *dst, unsigned left, unsigned right)
+template <class Traits, bool AlphaOneFill, class Enable>
+typename planar_to_packed<Traits, AlphaOneFill, Enable>::numeric_type planar_to_packed<Traits, AlphaOneFill, Enable>::align_component(planar_type x, unsigned c)
+{
+	unsigned depth = detail::mask_get(Traits::depth_mask, c);
+	numeric_type lsb_mask = static_cast<numeric_type>(~static_cast<numeric_type>(0)) >> (detail::bit_size<numeric_type> - depth);
+	numeric_type val = static_cast<numeric_type>(detail::component_codec<Traits>::encode(x, depth, detail::mask_get(Traits::component_mask, c)));
+	return (val & lsb_mask) << detail::mask_get(Traits::shift_mask, c);
+}
+
+template <class Traits, bool AlphaOneFill, class Enable>
+typename planar_to_packed<Traits, AlphaOneFill, Enable>::numeric_type planar_to_packed<Traits, AlphaOneFill, Enable>::ones_component(unsigned c)
+{
+	numeric_type lsb_mask = static_cast<numeric_type>(~static_cast<numeric_type>(0)) >> (detail::bit_size<numeric_type> - detail::mask_get(Traits::depth_mask, c));
+	return lsb_mask << detail::mask_get(Traits::shift_mask, c);
+}
+
+template <class Traits, bool AlphaOneFill, class Enable>
+void planar_to_packed<Traits, AlphaOneFill, Enable>::pack_impl(const void * const src[4], void *dst, unsigned left, unsigned right)
 {
 	const planar_type *src_p[4] = {
 		static_cast<const planar_type *>(src[0]), static_cast<const planar_type *>(src[1]), static_cast<const planar_type *>(src[2]), static_cast<const planar_type *>(src[3])
@@ -744,13 +1527,13 @@ void planar_to_packed<Traits, AlphaOneFill>::pack_impl(const void * const src[4]
 
 		if (AlphaOneFill && !have_alpha) {
 			if (detail::mask_get(Traits::component_mask, 0) == C_A)
-				x |= align_component(~static_cast<planar_type>(0), 0);
+				x |= ones_component(0);
 			if (detail::mask_get(Traits::component_mask, 1) == C_A)
-				x |= align_component(~static_cast<planar_type>(0), 1);
+				x |= ones_component(1);
 			if (detail::mask_get(Traits::component_mask, 2) == C_A)
-				x |= align_component(~static_cast<planar_type>(0), 2);
+				x |= ones_component(2);
 			if (detail::mask_get(Traits::component_mask, 3) == C_A)
-				x |= align_component(~static_cast<planar_type>(0), 3);
+				x |= ones_component(3);
 		}
 
 		if (P2P_COMPONENT_ENABLED(0))
@@ -766,6 +1549,138 @@ void planar_to_packed<Traits, AlphaOneFill>::pack_impl(const void * const src[4]
 	}
 }
 #undef P2P_COMPONENT_ENABLED
+
+template <class Traits, bool AlphaOneFill, class Enable>
+void planar_to_packed<Traits, AlphaOneFill, Enable>::pack_2d_impl(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		pack_impl(src_p, dst, left, right);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = detail::increment_ptr(src_p[p], src_stride[p]);
+		}
+		dst = detail::increment_ptr(dst, dst_stride);
+	}
+}
+
+namespace detail {
+template <class Traits>
+void wrapped_v210<Traits>::unpack(const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	uint16_t buf[3][line_pels];
+	void *buf_ptrs[4] = { buf[0], buf[1], buf[2], nullptr };
+
+	for (unsigned x = left - left % line_pels; x < right; x += line_pels) {
+		unsigned line_left = left > x ? left - x : 0;
+		unsigned line_right = right < x + line_pels ? right - x : line_pels;
+
+		packed_to_planar<v210>::unpack(increment_ptr(src, static_cast<ptrdiff_t>(x / 6) * 16), buf_ptrs, line_left, line_right);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			unsigned ss = p ? 1 : 0;
+			planar_type *dst_p = static_cast<planar_type *>(dst[p]) + (x >> ss);
+
+			for (unsigned i = line_left >> ss; i < (line_right + ss) >> ss; ++i) {
+				dst_p[i] = component_codec<Traits>::decode(buf[p][i], 10, p);
+			}
+		}
+	}
+}
+
+template <class Traits>
+void wrapped_v210<Traits>::unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+{
+	void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		unpack(src, dst_p, left, right);
+
+		src = increment_ptr(src, src_stride);
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = increment_ptr(dst_p[p], dst_stride[p]);
+		}
+	}
+}
+
+template <class Traits>
+void wrapped_v210<Traits>::pack(const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	uint16_t buf[3][line_pels];
+	const void *buf_ptrs[4] = { buf[0], buf[1], buf[2], nullptr };
+
+	for (unsigned x = left - left % line_pels; x < right; x += line_pels) {
+		unsigned line_left = left > x ? left - x : 0;
+		unsigned line_right = right < x + line_pels ? right - x : line_pels;
+
+		// The v210 kernel reads from the start of the pack to the next even pixel.
+		for (unsigned p = 0; p < 3; ++p) {
+			unsigned ss = p ? 1 : 0;
+			const planar_type *src_p = static_cast<const planar_type *>(src[p]) + (x >> ss);
+
+			for (unsigned i = (line_left - line_left % 6) >> ss; i < ((line_right + 1) & ~1U) >> ss; ++i) {
+				buf[p][i] = static_cast<uint16_t>(component_codec<Traits>::encode(src_p[i], 10, p));
+			}
+		}
+
+		planar_to_packed<v210, false>::pack(buf_ptrs, increment_ptr(dst, static_cast<ptrdiff_t>(x / 6) * 16), line_left, line_right);
+	}
+}
+
+template <class Traits>
+void wrapped_v210<Traits>::pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		pack(src_p, dst, left, right);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = increment_ptr(src_p[p], src_stride[p]);
+		}
+		dst = increment_ptr(dst, dst_stride);
+	}
+}
+} // namespace detail
+
+template <class SrcTraits, class DstTraits, bool AlphaOneFill>
+void packed_to_packed<SrcTraits, DstTraits, AlphaOneFill>::convert(const void *src, void *dst, unsigned left, unsigned right)
+{
+	typedef detail::packing_info<SrcTraits> src_info;
+	typedef detail::packing_info<DstTraits> dst_info;
+	typedef typename src_info::planar_type planar_type;
+
+	static_assert(std::is_same<planar_type, typename dst_info::planar_type>::value, "planar types must match");
+	static_assert(src_info::subsampling == dst_info::subsampling, "subsampling must match");
+	static_assert(line_pels % src_info::pel_per_pack == 0 && line_pels % dst_info::pel_per_pack == 0, "line buffer must hold whole packs");
+
+	planar_type buf[4][line_pels];
+	void *unpack_ptrs[4] = { buf[0], buf[1], buf[2], buf[3] };
+	const void *pack_ptrs[4] = { buf[0], buf[1], buf[2], src_info::has_alpha ? buf[3] : nullptr };
+
+	for (unsigned x = left - left % line_pels; x < right; x += line_pels) {
+		unsigned line_left = left > x ? left - x : 0;
+		unsigned line_right = right < x + line_pels ? right - x : line_pels;
+
+		const void *src_p = detail::increment_ptr(src, static_cast<ptrdiff_t>(x / src_info::pel_per_pack) * src_info::bytes_per_pack);
+		void *dst_p = detail::increment_ptr(dst, static_cast<ptrdiff_t>(x / dst_info::pel_per_pack) * dst_info::bytes_per_pack);
+
+		packed_to_planar<SrcTraits>::unpack(src_p, unpack_ptrs, line_left, line_right);
+		planar_to_packed<DstTraits, AlphaOneFill>::pack(pack_ptrs, dst_p, line_left, line_right);
+	}
+}
+
+template <class SrcTraits, class DstTraits, bool AlphaOneFill>
+void packed_to_packed<SrcTraits, DstTraits, AlphaOneFill>::convert_2d(const void *src, ptrdiff_t src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	for (unsigned i = 0; i < height; ++i) {
+		convert(src, dst, left, right);
+
+		src = detail::increment_ptr(src, src_stride);
+		dst = detail::increment_ptr(dst, dst_stride);
+	}
+}
 } // namespace p2p
 
 #endif // P2P_H_
@@ -1,8 +1,24 @@
 #include <algorithm>
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <typeinfo>
+#include <vector>
 #include "p2p.h"
 #include "p2p_api.h"
+#include "p2p_thread.h"
+
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+  #include <xmmintrin.h>
+  #include "simd/cpuinfo_x86.h"
+#endif
 
 #ifdef P2P_USER_NAMESPACE
   #error API build must not use custom namespace
@@ -15,53 +31,95 @@ struct packing_traits {
 	p2p_unpack_func unpack;
 	p2p_pack_func pack;
 	p2p_pack_func pack_one_fill;
+	p2p_unpack_2d_func unpack_2d;
+	p2p_pack_2d_func pack_2d;
+	p2p_pack_2d_func pack_2d_one_fill;
+	// Packing with 16-bit planar samples, indexed by bit replication, and with
+	// float then half planar samples, for looking up fused SIMD kernels.
+	const std::type_info *type_16[2];
+	const std::type_info *type_fp[2];
+	const std::type_info *type;
+	unsigned char pel_per_pack;
+	unsigned char bytes_per_pack;
+	unsigned char bytes_per_sample;
+	unsigned char depth;       // Of luma or red, or of chroma for NV formats.
+	unsigned char alpha_depth; // Or 0 without alpha.
+	bool has_alpha;
+	bool is_yuv;
 	bool native_endian;
 	unsigned char subsample_w;
 	unsigned char subsample_h;
 	bool is_nv;
-	unsigned char bytes_per_sample; // Only used to copy luma plane for NV12.
 	unsigned char nv_shift; // Extra LSB to shift away for MS P010/P210, etc.
 };
 
-#define CASE(x, ...) \
-	{ p2p_##x, &p2p::packed_to_planar<p2p::packed_##x>::unpack, &p2p::planar_to_packed<p2p::packed_##x, false>::pack, &p2p::planar_to_packed<p2p::packed_##x, true>::pack, ##__VA_ARGS__ }
-#define CASE2(x, ...) \
-	CASE(x##_be, std::is_same<p2p::native_endian_t, p2p::big_endian_t>::value, ##__VA_ARGS__), \
-	CASE(x##_le, std::is_same<p2p::native_endian_t, p2p::little_endian_t>::value, ##__VA_ARGS__), \
-	CASE(x, true, ##__VA_ARGS__)
+// Packing with every component scaled to 16 bits. Packings that are already
+// 16-bit keep their own kernels.
+template <class Traits, bool BitReplicate>
+struct planar16 {
+	typedef std::conditional_t<std::is_same<typename Traits::planar_type, uint16_t>::value && Traits::depth_mask == p2p::mask(16),
+		Traits, p2p::rescale_traits<Traits, uint16_t, 16, BitReplicate>> type;
+};
+
+template <bool BitReplicate>
+struct planar16<p2p::packed_v210_be, BitReplicate> {
+	typedef p2p::rescale_traits<p2p::packed_v210_be, uint16_t, 16, BitReplicate> type;
+};
+
+template <bool BitReplicate>
+struct planar16<p2p::packed_v210_le, BitReplicate> {
+	typedef p2p::rescale_traits<p2p::packed_v210_le, uint16_t, 16, BitReplicate> type;
+};
+
+#define WIDE(x, r) typename planar16<p2p::packed_##x, r>::type
+#define FP(x, h) p2p::rescale_traits<p2p::packed_##x, std::conditional_t<h, p2p::half, float>>
+#define CASE(x, yuv, ...) \
+	{ p2p_##x, &p2p::packed_to_planar<p2p::packed_##x>::unpack, &p2p::planar_to_packed<p2p::packed_##x, false>::pack, &p2p::planar_to_packed<p2p::packed_##x, true>::pack, \
+	  &p2p::packed_to_planar<p2p::packed_##x>::unpack_2d, &p2p::planar_to_packed<p2p::packed_##x, false>::pack_2d, &p2p::planar_to_packed<p2p::packed_##x, true>::pack_2d, \
+	  { &typeid(WIDE(x, false)), &typeid(WIDE(x, true)) }, { &typeid(FP(x, false)), &typeid(FP(x, true)) }, \
+	  &typeid(p2p::packed_##x), p2p::detail::packing_info<p2p::packed_##x>::pel_per_pack, p2p::detail::packing_info<p2p::packed_##x>::bytes_per_pack, \
+	  sizeof(p2p::detail::packing_info<p2p::packed_##x>::planar_type), \
+	  p2p::detail::packing_info<p2p::packed_##x>::depth, p2p::detail::packing_info<p2p::packed_##x>::alpha_depth, \
+	  p2p::detail::packing_info<p2p::packed_##x>::has_alpha, yuv, ##__VA_ARGS__ }
+#define CASE2(x, yuv, ...) \
+	CASE(x##_be, yuv, std::is_same<p2p::native_endian_t, p2p::big_endian_t>::value, ##__VA_ARGS__), \
+	CASE(x##_le, yuv, std::is_same<p2p::native_endian_t, p2p::little_endian_t>::value, ##__VA_ARGS__), \
+	CASE(x, yuv, true, ##__VA_ARGS__)
 const packing_traits traits_table[] = {
-	CASE2(rgb24, 0, 0),
-	CASE2(argb32, 0, 0),
-	CASE2(ayuv, 0, 0),
-	CASE2(rgb48, 0, 0),
-	CASE2(argb64, 0, 0),
-	CASE2(rgb30, 0, 0),
-	CASE2(y410, 0, 0),
-	CASE2(y412, 0, 0),
-	CASE2(y416, 0, 0),
-	CASE(yuy2, true, 1, 0),
-	CASE(uyvy, true, 1, 0),
-	CASE2(y210, 1, 0),
-	CASE2(y212, 1, 0),
-	CASE2(y216, 1, 0),
-	CASE2(v210, 1, 0),
-	CASE2(v216, 1, 0),
-	CASE2(nv12, 1, 1, true, 1),
-	CASE2(nv16, 1, 0, true, 1),
-	CASE2(p010, 1, 1, true, 2, 6),
-	CASE2(p012, 1, 1, true, 2, 4),
-	CASE2(p016, 1, 1, true, 2),
-	CASE2(p210, 1, 0, true, 2, 6),
-	CASE2(p212, 1, 0, true, 2, 4),
-	CASE2(p216, 1, 0, true, 2),
-	CASE2(rgba32, 0, 0),
-	CASE2(rgba64, 0, 0),
-	CASE2(abgr64, 0, 0),
-	CASE2(bgr48, 0, 0),
-	CASE2(bgra64, 0, 0),
+	CASE2(rgb24, false, 0, 0),
+	CASE2(argb32, false, 0, 0),
+	CASE2(ayuv, true, 0, 0),
+	CASE2(rgb48, false, 0, 0),
+	CASE2(argb64, false, 0, 0),
+	CASE2(rgb30, false, 0, 0),
+	CASE2(y410, true, 0, 0),
+	CASE2(y412, true, 0, 0),
+	CASE2(y416, true, 0, 0),
+	CASE(yuy2, true, true, 1, 0),
+	CASE(uyvy, true, true, 1, 0),
+	CASE2(y210, true, 1, 0),
+	CASE2(y212, true, 1, 0),
+	CASE2(y216, true, 1, 0),
+	CASE2(v210, true, 1, 0),
+	CASE2(v216, true, 1, 0),
+	CASE2(nv12, true, 1, 1, true),
+	CASE2(nv16, true, 1, 0, true),
+	CASE2(p010, true, 1, 1, true, 6),
+	CASE2(p012, true, 1, 1, true, 4),
+	CASE2(p016, true, 1, 1, true),
+	CASE2(p210, true, 1, 0, true, 6),
+	CASE2(p212, true, 1, 0, true, 4),
+	CASE2(p216, true, 1, 0, true),
+	CASE2(rgba32, false, 0, 0),
+	CASE2(rgba64, false, 0, 0),
+	CASE2(abgr64, false, 0, 0),
+	CASE2(bgr48, false, 0, 0),
+	CASE2(bgra64, false, 0, 0),
 };
 #undef CASE2
 #undef CASE
+#undef FP
+#undef WIDE
 
 const packing_traits &lookup_traits(enum p2p_packing packing)
 {
@@ -74,12 +132,82 @@ const packing_traits &lookup_traits(enum p2p_packing packing)
 	return traits;
 }
 
+// Packing with the LSB padding of each component kept as sample bits.
+enum p2p_packing msb_aligned_packing(enum p2p_packing packing)
+{
+	switch (packing) {
+	case p2p_y412_be: return p2p_y416_be;
+	case p2p_y412_le: return p2p_y416_le;
+	case p2p_y412: return p2p_y416;
+	case p2p_y210_be: case p2p_y212_be: return p2p_y216_be;
+	case p2p_y210_le: case p2p_y212_le: return p2p_y216_le;
+	case p2p_y210: case p2p_y212: return p2p_y216;
+	case p2p_p010_be: case p2p_p012_be: return p2p_p016_be;
+	case p2p_p010_le: case p2p_p012_le: return p2p_p016_le;
+	case p2p_p010: case p2p_p012: return p2p_p016;
+	case p2p_p210_be: case p2p_p212_be: return p2p_p216_be;
+	case p2p_p210_le: case p2p_p212_le: return p2p_p216_le;
+	case p2p_p210: case p2p_p212: return p2p_p216;
+	default: return packing;
+	}
+}
+
+const packing_traits &lookup_traits(enum p2p_packing packing, unsigned long flags)
+{
+	return lookup_traits(flags & P2P_MSB_ALIGNED ? msb_aligned_packing(packing) : packing);
+}
+
 template <class T>
 T *increment_ptr(T *ptr, ptrdiff_t n)
 {
 	return (T *)((const unsigned char *)ptr + n);
 }
 
+// Bytes past the end of a row that kernels may touch with P2P_PADDED_BUFFERS.
+const unsigned max_overrun_bytes = 64;
+
+// Minimum amount of packed data worth dispatching as a separate band.
+const size_t min_band_bytes = 1UL << 16;
+
+// Cache capacities used to size the working set.
+struct cache_budget {
+	size_t l2;  // Per thread.
+	size_t llc; // Whole last-level cache.
+};
+
+cache_budget query_cache_budget()
+{
+	cache_budget budget = { 256UL << 10, 8UL << 20 };
+
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+	p2p::simd::X86CacheHierarchy cache = p2p::simd::query_x86_cache_hierarchy();
+
+	if (cache.valid) {
+		if (cache.l2)
+			budget.l2 = cache.l2 / cache.l2_threads;
+		budget.llc = std::max(static_cast<size_t>(cache.l3 ? cache.l3 : cache.l2), budget.l2);
+	}
+#endif
+	return budget;
+}
+
+const cache_budget &cache_sizes()
+{
+	static const cache_budget budget = query_cache_budget();
+	return budget;
+}
+
+// Order non-temporal stores before the frame is handed on.
+void store_fence()
+{
+#if defined(P2P_SIMD) && (defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64))
+	_mm_sfence();
+#endif
+}
+
+typedef void (*plane_func)(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                           const packing_traits &traits, unsigned width, unsigned height);
+
 void copy_plane_fast(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
                      unsigned linesize, unsigned height)
 {
@@ -91,6 +219,12 @@ void copy_plane_fast(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t
 	}
 }
 
+void copy_nv_plane(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                   const packing_traits &traits, unsigned width, unsigned height)
+{
+	copy_plane_fast(src, dst, src_stride, dst_stride, traits.bytes_per_sample * width, height);
+}
+
 void unpack_nv16_plane(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
                        const packing_traits &traits, unsigned width, unsigned height)
 {
@@ -125,88 +259,3250 @@ void pack_nv16_plane(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t
 	}
 }
 
-} // namespace
+// Luma of NV formats with rescaled or range converted planar samples.
+template <class Planar, unsigned PlanarDepth, bool BitReplicate, p2p::range_mode Range>
+void unpack_nv_plane_rescaled(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                              const packing_traits &traits, unsigned width, unsigned height)
+{
+	typedef p2p::detail::range_codec<Planar, PlanarDepth, BitReplicate, Range> codec;
+	unsigned depth = traits.bytes_per_sample * 8 - traits.nv_shift;
+
+	for (unsigned i = 0; i < height; ++i) {
+		Planar *dst_p = static_cast<Planar *>(dst);
 
+		if (traits.bytes_per_sample == 1) {
+			const uint8_t *src_p = static_cast<const uint8_t *>(src);
+			for (unsigned j = 0; j < width; ++j) {
+				dst_p[j] = codec::decode(src_p[j], 8, false);
+			}
+		} else {
+			const uint16_t *src_p = static_cast<const uint16_t *>(src);
+			for (unsigned j = 0; j < width; ++j) {
+				uint16_t x = traits.native_endian ? src_p[j] : (src_p[j] >> 8) | (src_p[j] << 8);
+				dst_p[j] = codec::decode(x >> traits.nv_shift, depth, false);
+			}
+		}
 
-p2p_unpack_func p2p_select_unpack_func(enum p2p_packing packing)
+		src = increment_ptr(src, src_stride);
+		dst = increment_ptr(dst, dst_stride);
+	}
+}
+
+template <class Planar, unsigned PlanarDepth, bool BitReplicate, p2p::range_mode Range>
+void pack_nv_plane_rescaled(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                            const packing_traits &traits, unsigned width, unsigned height)
 {
-	return lookup_traits(packing).unpack;
+	typedef p2p::detail::range_codec<Planar, PlanarDepth, BitReplicate, Range> codec;
+	unsigned depth = traits.bytes_per_sample * 8 - traits.nv_shift;
+
+	for (unsigned i = 0; i < height; ++i) {
+		const Planar *src_p = static_cast<const Planar *>(src);
+
+		if (traits.bytes_per_sample == 1) {
+			uint8_t *dst_p = static_cast<uint8_t *>(dst);
+			for (unsigned j = 0; j < width; ++j) {
+				dst_p[j] = static_cast<uint8_t>(codec::encode(src_p[j], 8, false));
+			}
+		} else {
+			uint16_t *dst_p = static_cast<uint16_t *>(dst);
+			for (unsigned j = 0; j < width; ++j) {
+				uint16_t x = static_cast<uint16_t>(codec::encode(src_p[j], depth, false) << traits.nv_shift);
+				dst_p[j] = traits.native_endian ? x : (x >> 8) | (x << 8);
+			}
+		}
+
+		src = increment_ptr(src, src_stride);
+		dst = increment_ptr(dst, dst_stride);
+	}
 }
 
-p2p_pack_func p2p_select_pack_func(enum p2p_packing packing)
+template <class Planar, unsigned PlanarDepth = 0, bool BitReplicate = false, p2p::range_mode Range = p2p::range_none>
+plane_func select_nv_plane_rescaled(bool is_pack)
 {
-	return p2p_select_pack_func_ex(packing, 0);
+	return is_pack ? pack_nv_plane_rescaled<Planar, PlanarDepth, BitReplicate, Range> : unpack_nv_plane_rescaled<Planar, PlanarDepth, BitReplicate, Range>;
 }
 
-p2p_pack_func p2p_select_pack_func_ex(enum p2p_packing packing, int alpha_one_fill)
+// Luma of NV formats with range conversion of native planar samples.
+template <p2p::range_mode Range>
+plane_func select_nv_plane_range(const packing_traits &traits, bool is_pack)
 {
-	const packing_traits &traits = lookup_traits(packing);
-	return alpha_one_fill ? traits.pack_one_fill : traits.pack;
+	return traits.bytes_per_sample == 1 ? select_nv_plane_rescaled<uint8_t, 0, false, Range>(is_pack) : select_nv_plane_rescaled<uint16_t, 0, false, Range>(is_pack);
 }
 
-void p2p_unpack_frame(const struct p2p_buffer_param *param, unsigned long flags)
+// Interleaved samples converted between the native planar type of a packing
+// and the planar type of the frame, a row stage around the native kernels.
+// Alpha is rescaled but keeps its range.
+typedef void (*sample_func)(const void *src, void *dst, unsigned n, unsigned depth, bool chroma, bool alpha);
+
+template <class Native, class Planar, unsigned PlanarDepth, bool BitReplicate, p2p::range_mode Range>
+void decode_samples(const void *src, void *dst, unsigned n, unsigned depth, bool chroma, bool alpha)
 {
-	const packing_traits &traits = lookup_traits(param->packing);
+	typedef p2p::detail::planar_codec<Planar, PlanarDepth, BitReplicate> alpha_codec;
+	typedef p2p::detail::range_codec<Planar, PlanarDepth, BitReplicate, Range> codec;
+	const Native *src_p = static_cast<const Native *>(src);
+	Planar *dst_p = static_cast<Planar *>(dst);
 
-	// Process interleaved plane.
-	const void *src_p = traits.is_nv ? param->src[1] : param->src[0];
-	ptrdiff_t src_stride = traits.is_nv ? param->src_stride[1] : param->src_stride[0];
+	for (unsigned i = 0; i < n; ++i) {
+		dst_p[i] = alpha ? alpha_codec::decode(src_p[i], depth) : codec::decode(src_p[i], depth, chroma);
+	}
+}
+
+template <class Native, class Planar, unsigned PlanarDepth, bool BitReplicate, p2p::range_mode Range>
+void encode_samples(const void *src, void *dst, unsigned n, unsigned depth, bool chroma, bool alpha)
+{
+	typedef p2p::detail::planar_codec<Planar, PlanarDepth, BitReplicate> alpha_codec;
+	typedef p2p::detail::range_codec<Planar, PlanarDepth, BitReplicate, Range> codec;
+	const Planar *src_p = static_cast<const Planar *>(src);
+	Native *dst_p = static_cast<Native *>(dst);
+
+	for (unsigned i = 0; i < n; ++i) {
+		dst_p[i] = static_cast<Native>(alpha ? alpha_codec::encode(src_p[i], depth) : codec::encode(src_p[i], depth, chroma));
+	}
+}
+
+template <class Native, class Planar, unsigned PlanarDepth = 0, bool BitReplicate = false, p2p::range_mode Range = p2p::range_none>
+sample_func select_samples(bool is_pack)
+{
+	return is_pack ? encode_samples<Native, Planar, PlanarDepth, BitReplicate, Range> : decode_samples<Native, Planar, PlanarDepth, BitReplicate, Range>;
+}
+
+template <class Native>
+sample_func select_samples(unsigned long flags, bool is_pack)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return select_samples<Native, float>(is_pack);
+	else if (flags & P2P_PLANAR_HALF)
+		return select_samples<Native, p2p::half>(is_pack);
+	else if (flags & P2P_PLANAR_16BIT)
+		return flags & P2P_BIT_REPLICATE ? select_samples<Native, uint16_t, 16, true>(is_pack) : select_samples<Native, uint16_t, 16, false>(is_pack);
+	else if (flags & P2P_PLANAR_FULL_RANGE)
+		return select_samples<Native, Native, 0, false, p2p::range_limited_full>(is_pack);
+	else
+		return select_samples<Native, Native, 0, false, p2p::range_full_limited>(is_pack);
+}
+
+size_t packed_linesize(const packing_traits &traits, unsigned width)
+{
+	return static_cast<size_t>((width + traits.pel_per_pack - 1) / traits.pel_per_pack) * traits.bytes_per_pack;
+}
+
+size_t planar_linesize(const packing_traits &traits, unsigned width, unsigned plane, unsigned bytes_per_sample)
+{
+	unsigned subsample = plane == 1 || plane == 2 ? traits.subsample_w : 0;
+	return static_cast<size_t>(width >> subsample) * bytes_per_sample;
+}
+
+size_t planar_linesize(const packing_traits &traits, unsigned width, unsigned plane)
+{
+	return planar_linesize(traits, width, plane, traits.bytes_per_sample);
+}
+
+// Flags selecting a planar sample type other than the packed component type.
+const unsigned long planar_type_flags = P2P_PLANAR_16BIT | P2P_PLANAR_FLOAT | P2P_PLANAR_HALF;
+
+// Flags selecting range conversion. Only apply to native planar samples.
+const unsigned long range_flags = P2P_PLANAR_FULL_RANGE | P2P_PLANAR_LIMITED_RANGE;
+
+// Flags selecting vertical chroma resampling. Only apply to unpack and pack.
+const unsigned long chroma_flags = P2P_CHROMA_420 | P2P_CHROMA_LINEAR | P2P_CHROMA_INTERLACED | P2P_CHROMA_444 | P2P_CHROMA_CENTERED;
+
+// Flags selecting a color matrix.
+const unsigned long matrix_flags = P2P_MATRIX_MASK | P2P_MATRIX_FULL_RANGE;
+
+unsigned planar_sample_bytes(const packing_traits &traits, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return 4;
+	else if (flags & (P2P_PLANAR_HALF | P2P_PLANAR_16BIT))
+		return 2;
+	else
+		return traits.bytes_per_sample;
+}
 
-	void *dst_p[4] = { param->dst[0], param->dst[1], param->dst[2], param->dst[3] };
+using p2p::detail::row_filter;
 
-	for (unsigned i = 0; i < (param->height >> traits.subsample_h); ++i) {
-		traits.unpack(src_p, dst_p, 0, param->width);
+typedef void (*row_filter_func)(const void * const *src, void *dst, unsigned n);
 
-		src_p = increment_ptr(src_p, src_stride);
+// Arithmetic of the row filters. Integers are summed exactly and rounded once.
+template <class T>
+struct filter_arith {
+	typedef uint32_t type;
+	static type load(T x) { return x; }
+	static T store(type x, unsigned shift) { return static_cast<T>((x + (1U << shift >> 1)) >> shift); }
+	static T average(type x, unsigned count) { return static_cast<T>((x + count / 2) / count); }
+};
+
+template <>
+struct filter_arith<float> {
+	typedef float type;
+	static type load(float x) { return x; }
+	static float store(type x, unsigned shift) { return x * (1.0f / (1U << shift)); }
+	static float average(type x, unsigned count) { return x / static_cast<float>(count); }
+};
+
+template <>
+struct filter_arith<p2p::half> {
+	typedef float type;
+	static type load(p2p::half x) { return p2p::detail::half_to_float(x.bits); }
+	static p2p::half store(type x, unsigned shift) { return p2p::half{ p2p::detail::float_to_half(x * (1.0f / (1U << shift))) }; }
+	static p2p::half average(type x, unsigned count) { return p2p::half{ p2p::detail::float_to_half(x / static_cast<float>(count)) }; }
+};
+
+template <class T, row_filter Filter>
+void filter_rows_c(const void * const *src, void *dst, unsigned n)
+{
+	typedef filter_arith<T> arith;
+	auto load = [=](unsigned k, unsigned i) { return arith::load(static_cast<const T *>(src[k])[i]); };
+	T *dst_p = static_cast<T *>(dst);
 
-		if (!traits.is_nv) {
-			dst_p[0] = increment_ptr(dst_p[0], param->dst_stride[0]);
-			dst_p[3] = increment_ptr(dst_p[3], param->dst_stride[3]);
+	for (unsigned i = 0; i < n; ++i) {
+		switch (Filter) {
+		case p2p::detail::row_average:
+			dst_p[i] = arith::store(load(0, i) + load(1, i), 1);
+			break;
+		case p2p::detail::row_interpolate:
+			dst_p[i] = arith::store(3 * load(0, i) + load(1, i), 2);
+			break;
+		default:
+			dst_p[i] = arith::store(load(0, i) + 3 * (load(1, i) + load(2, i)) + load(3, i), 3);
+			break;
 		}
-		dst_p[1] = increment_ptr(dst_p[1], param->dst_stride[1]);
-		dst_p[2] = increment_ptr(dst_p[2], param->dst_stride[2]);
 	}
+}
 
-	if (traits.is_nv && !(flags & P2P_SKIP_UNPACKED_PLANES) && param->src[0] && param->dst[0]) {
-		if ((traits.bytes_per_sample == 1 || traits.native_endian) && !traits.nv_shift) {
-			copy_plane_fast(param->src[0], param->dst[0], param->src_stride[0], param->dst_stride[0],
-			                traits.bytes_per_sample * param->width, param->height);
-		} else {
-			unpack_nv16_plane(param->src[0], param->dst[0], param->src_stride[0], param->dst_stride[0], traits, param->width, param->height);
+template <row_filter Filter>
+row_filter_func select_row_filter_c(const packing_traits &traits, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return filter_rows_c<float, Filter>;
+	else if (flags & P2P_PLANAR_HALF)
+		return filter_rows_c<p2p::half, Filter>;
+	else if (planar_sample_bytes(traits, flags) == 1)
+		return filter_rows_c<uint8_t, Filter>;
+	else
+		return filter_rows_c<uint16_t, Filter>;
+}
+
+row_filter_func select_row_filter(row_filter filter, const packing_traits &traits, unsigned long flags)
+{
+#ifdef P2P_SIMD
+	if (!(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF))) {
+		row_filter_func simd_func = p2p::detail::search_row_filter_func(filter, planar_sample_bytes(traits, flags));
+		if (simd_func)
+			return simd_func;
+	}
+#endif
+	switch (filter) {
+	case p2p::detail::row_average:
+		return select_row_filter_c<p2p::detail::row_average>(traits, flags);
+	case p2p::detail::row_interpolate:
+		return select_row_filter_c<p2p::detail::row_interpolate>(traits, flags);
+	default:
+		return select_row_filter_c<p2p::detail::row_smooth>(traits, flags);
+	}
+}
+
+using p2p::detail::chroma_resample;
+
+typedef void (*chroma_resample_func)(const void *src, void *dst, unsigned src_width, unsigned dst_width);
+
+template <class T, chroma_resample Resample>
+void resample_chroma_c(const void *src, void *dst, unsigned src_width, unsigned dst_width)
+{
+	typedef filter_arith<T> arith;
+	const T *src_p = static_cast<const T *>(src);
+	T *dst_p = static_cast<T *>(dst);
+	auto x = [=](int i) { return arith::load(src_p[std::min(std::max(i, 0), static_cast<int>(src_width) - 1)]); };
+
+	for (unsigned k = 0; k < dst_width; ++k) {
+		int i = 2 * k;
+		int h = k / 2;
+
+		switch (Resample) {
+		case p2p::detail::chroma_drop:
+			dst_p[k] = arith::store(x(i), 0);
+			break;
+		case p2p::detail::chroma_average:
+			dst_p[k] = arith::store(x(i) + x(i + 1), 1);
+			break;
+		case p2p::detail::chroma_triangle:
+			dst_p[k] = arith::store(x(i - 1) + 2 * x(i) + x(i + 1), 2);
+			break;
+		case p2p::detail::chroma_smooth:
+			dst_p[k] = arith::store(x(i - 1) + 3 * (x(i) + x(i + 1)) + x(i + 2), 3);
+			break;
+		case p2p::detail::chroma_repeat:
+			dst_p[k] = arith::store(x(h), 0);
+			break;
+		case p2p::detail::chroma_linear_cosited:
+			dst_p[k] = k % 2 ? arith::store(x(h) + x(h + 1), 1) : arith::store(x(h), 0);
+			break;
+		default:
+			dst_p[k] = arith::store(3 * x(h) + x(k % 2 ? h + 1 : h - 1), 2);
+			break;
 		}
 	}
 }
 
-void p2p_pack_frame(const struct p2p_buffer_param *param, unsigned long flags)
+template <chroma_resample Resample>
+chroma_resample_func select_chroma_resample_c(const packing_traits &traits, unsigned long flags)
 {
-	const packing_traits &traits = lookup_traits(param->packing);
-	p2p_pack_func pack_func = flags & P2P_ALPHA_SET_ONE ? traits.pack_one_fill : traits.pack;
+	if (flags & P2P_PLANAR_FLOAT)
+		return resample_chroma_c<float, Resample>;
+	else if (flags & P2P_PLANAR_HALF)
+		return resample_chroma_c<p2p::half, Resample>;
+	else if (planar_sample_bytes(traits, flags) == 1)
+		return resample_chroma_c<uint8_t, Resample>;
+	else
+		return resample_chroma_c<uint16_t, Resample>;
+}
 
-	// Process interleaved plane.
-	const void *src_p[4] = { param->src[0], param->src[1], param->src[2], param->src[3] };
+chroma_resample_func select_chroma_resample(chroma_resample resample, const packing_traits &traits, unsigned long flags)
+{
+#ifdef P2P_SIMD
+	if (!(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF))) {
+		chroma_resample_func simd_func = p2p::detail::search_chroma_resample_func(resample, planar_sample_bytes(traits, flags));
+		if (simd_func)
+			return simd_func;
+	}
+#endif
+	switch (resample) {
+	case p2p::detail::chroma_drop:
+		return select_chroma_resample_c<p2p::detail::chroma_drop>(traits, flags);
+	case p2p::detail::chroma_average:
+		return select_chroma_resample_c<p2p::detail::chroma_average>(traits, flags);
+	case p2p::detail::chroma_triangle:
+		return select_chroma_resample_c<p2p::detail::chroma_triangle>(traits, flags);
+	case p2p::detail::chroma_smooth:
+		return select_chroma_resample_c<p2p::detail::chroma_smooth>(traits, flags);
+	case p2p::detail::chroma_repeat:
+		return select_chroma_resample_c<p2p::detail::chroma_repeat>(traits, flags);
+	case p2p::detail::chroma_linear_cosited:
+		return select_chroma_resample_c<p2p::detail::chroma_linear_cosited>(traits, flags);
+	default:
+		return select_chroma_resample_c<p2p::detail::chroma_linear_centered>(traits, flags);
+	}
+}
 
-	void *dst_p = traits.is_nv ? param->dst[1] : param->dst[0];
-	ptrdiff_t dst_stride = traits.is_nv ? param->dst_stride[1] : param->dst_stride[0];
+using p2p::detail::alpha_op;
+using p2p::detail::alpha_scale;
 
-	for (unsigned i = 0; i < (param->height >> traits.subsample_h); ++i) {
-		pack_func(src_p, dst_p, 0, param->width);
+typedef void (*alpha_func)(const void *src, const void *alpha, void *dst, unsigned n, const alpha_scale &scale);
 
-		if (!traits.is_nv) {
-			src_p[0] = increment_ptr(src_p[0], param->src_stride[0]);
-			src_p[3] = increment_ptr(src_p[3], param->src_stride[3]);
+template <class T, alpha_op Op>
+void alpha_rows_c(const void *src, const void *alpha, void *dst, unsigned n, const alpha_scale &scale)
+{
+	const T *src_p = static_cast<const T *>(src);
+	const T *alpha_p = static_cast<const T *>(alpha);
+	T *dst_p = static_cast<T *>(dst);
+
+	uint64_t max = (UINT64_C(1) << scale.depth) - 1;
+	uint64_t alpha_max = (UINT64_C(1) << scale.alpha_depth) - 1;
+	uint64_t mid = scale.centered ? UINT64_C(1) << (scale.depth - 1) : 0;
+
+	for (unsigned i = 0; i < n; ++i) {
+		uint64_t x = src_p[i];
+		uint64_t a = alpha_p[i];
+		bool negative = x < mid;
+		uint64_t m = negative ? mid - x : x - mid;
+		uint64_t r = 0;
+
+		if (Op == p2p::detail::alpha_premultiply)
+			r = (2 * m * a + alpha_max) / (2 * alpha_max);
+		else if (a)
+			r = (2 * m * alpha_max + a) / (2 * a);
+		r = std::min(r, negative ? mid : max - mid);
+		dst_p[i] = static_cast<T>(negative ? mid - r : mid + r);
+	}
+}
+
+template <class T, alpha_op Op>
+void alpha_rows_fp(const void *src, const void *alpha, void *dst, unsigned n, const alpha_scale &scale)
+{
+	typedef filter_arith<T> arith;
+	const T *src_p = static_cast<const T *>(src);
+	const T *alpha_p = static_cast<const T *>(alpha);
+	T *dst_p = static_cast<T *>(dst);
+	float mid = scale.centered ? 0.5f : 0.0f;
+
+	for (unsigned i = 0; i < n; ++i) {
+		float x = arith::load(src_p[i]);
+		float a = arith::load(alpha_p[i]);
+
+		if (Op == p2p::detail::alpha_premultiply)
+			x = (x - mid) * a + mid;
+		else
+			x = a > 0.0f ? (x - mid) / a + mid : mid;
+		dst_p[i] = arith::store(x, 0);
+	}
+}
+
+template <alpha_op Op>
+alpha_func select_alpha_c(const packing_traits &traits, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return alpha_rows_fp<float, Op>;
+	else if (flags & P2P_PLANAR_HALF)
+		return alpha_rows_fp<p2p::half, Op>;
+	else if (planar_sample_bytes(traits, flags) == 1)
+		return alpha_rows_c<uint8_t, Op>;
+	else
+		return alpha_rows_c<uint16_t, Op>;
+}
+
+alpha_func select_alpha(alpha_op op, const packing_traits &traits, unsigned long flags, const alpha_scale &scale)
+{
+#ifdef P2P_SIMD
+	unsigned bytes = planar_sample_bytes(traits, flags);
+	bool full_scale = scale.depth == bytes * 8 && scale.alpha_depth == bytes * 8;
+
+	if (!(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF)) && full_scale) {
+		alpha_func simd_func = p2p::detail::search_alpha_func(op, bytes);
+		if (simd_func)
+			return simd_func;
+	}
+#else
+	(void)scale;
+#endif
+	if (op == p2p::detail::alpha_premultiply)
+		return select_alpha_c<p2p::detail::alpha_premultiply>(traits, flags);
+	else
+		return select_alpha_c<p2p::detail::alpha_unpremultiply>(traits, flags);
+}
+
+using p2p::detail::color_matrix;
+
+typedef void (*matrix_func)(const void * const *src, void * const *dst, unsigned n, const color_matrix &m);
+
+template <class T>
+void matrix_rows_c(const void * const *src, void * const *dst, unsigned n, const color_matrix &m)
+{
+	const T *src_p[3] = { static_cast<const T *>(src[0]), static_cast<const T *>(src[1]), static_cast<const T *>(src[2]) };
+	T *dst_p[3] = { static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2]) };
+
+	for (unsigned i = 0; i < n; ++i) {
+		int32_t d[3];
+		for (unsigned j = 0; j < 3; ++j) {
+			d[j] = src_p[j][i] - m.in[j];
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			int32_t y = ((m.c[k][0] * d[0] + m.c[k][1] * d[1] + m.c[k][2] * d[2] + (1 << 12)) >> 13) + m.out[k];
+			dst_p[k][i] = static_cast<T>(std::min(std::max(y, 0), m.max));
+		}
+	}
+}
+
+template <class T>
+void matrix_rows_fp(const void * const *src, void * const *dst, unsigned n, const color_matrix &m)
+{
+	typedef filter_arith<T> arith;
+	const T *src_p[3] = { static_cast<const T *>(src[0]), static_cast<const T *>(src[1]), static_cast<const T *>(src[2]) };
+	T *dst_p[3] = { static_cast<T *>(dst[0]), static_cast<T *>(dst[1]), static_cast<T *>(dst[2]) };
+
+	for (unsigned i = 0; i < n; ++i) {
+		float d[3];
+		for (unsigned j = 0; j < 3; ++j) {
+			d[j] = arith::load(src_p[j][i]) - m.in_f[j];
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			dst_p[k][i] = arith::store(m.cf[k][0] * d[0] + m.cf[k][1] * d[1] + m.cf[k][2] * d[2] + m.out_f[k], 0);
+		}
+	}
+}
+
+matrix_func select_matrix(const packing_traits &traits, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return matrix_rows_fp<float>;
+	else if (flags & P2P_PLANAR_HALF)
+		return matrix_rows_fp<p2p::half>;
+#ifdef P2P_SIMD
+	matrix_func simd_func = p2p::detail::search_matrix_func(planar_sample_bytes(traits, flags));
+	if (simd_func)
+		return simd_func;
+#endif
+	return planar_sample_bytes(traits, flags) == 1 ? matrix_rows_c<uint8_t> : matrix_rows_c<uint16_t>;
+}
+
+// Matrix between R'G'B' and Y'CbCr codes at the planar depth. RGB is full
+// range, and YUV limited range unless requested otherwise.
+void init_color_matrix(color_matrix &m, const packing_traits &traits, unsigned long flags, bool to_yuv)
+{
+	double kr, kb;
+	switch (flags & P2P_MATRIX_MASK) {
+	case P2P_MATRIX_BT601:
+		kr = 0.299;
+		kb = 0.114;
+		break;
+	case P2P_MATRIX_BT709:
+		kr = 0.2126;
+		kb = 0.0722;
+		break;
+	default:
+		kr = 0.2627;
+		kb = 0.0593;
+		break;
+	}
+	double kg = 1.0 - kr - kb;
+
+	// Y'PbPr from R'G'B', and back.
+	const double forward[3][3] = {
+		{ kr, kg, kb },
+		{ -kr / (2 * (1 - kb)), -kg / (2 * (1 - kb)), 0.5 },
+		{ 0.5, -kg / (2 * (1 - kr)), -kb / (2 * (1 - kr)) },
+	};
+	const double inverse[3][3] = {
+		{ 1, 0, 2 * (1 - kr) },
+		{ 1, -2 * kb * (1 - kb) / kg, -2 * kr * (1 - kr) / kg },
+		{ 1, 2 * (1 - kb), 0 },
+	};
+
+	// Floating point samples are normalized to the maximum packed code.
+	bool fp = !!(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF));
+	unsigned depth = (flags & P2P_PLANAR_16BIT) && !fp ? 16 : traits.depth;
+	double max = static_cast<double>((1U << depth) - 1);
+	double k = static_cast<double>(1U << (depth - 8));
+	double norm = fp ? max : 1.0;
+
+	// Codes per unit of Y'PbPr, and code of zero.
+	bool full = !!(flags & P2P_MATRIX_FULL_RANGE);
+	const double scale[3] = { full ? max : 219 * k, full ? max : 224 * k, full ? max : 224 * k };
+	const double offset[3] = { full ? 0 : 16 * k, 128 * k, 128 * k };
+
+	for (unsigned i = 0; i < 3; ++i) {
+		for (unsigned j = 0; j < 3; ++j) {
+			double c = to_yuv ? scale[i] * forward[i][j] / max : max * inverse[i][j] / scale[j];
+			m.c[i][j] = static_cast<int32_t>(std::lround(c * 8192));
+			m.cf[i][j] = static_cast<float>(c);
 		}
-		src_p[1] = increment_ptr(src_p[1], param->src_stride[1]);
-		src_p[2] = increment_ptr(src_p[2], param->src_stride[2]);
 
-		dst_p = increment_ptr(dst_p, dst_stride);
+		double in = to_yuv ? 0 : offset[i];
+		double out = to_yuv ? offset[i] : 0;
+		m.in[i] = static_cast<int32_t>(in);
+		m.out[i] = static_cast<int32_t>(out);
+		m.in_f[i] = static_cast<float>(in / norm);
+		m.out_f[i] = static_cast<float>(out / norm);
+	}
+	m.max = static_cast<int32_t>(max);
+}
+
+using p2p::detail::lut_table;
+
+typedef void (*lut_func)(const void *src, void *dst, unsigned n, const lut_table &t);
+
+template <class T>
+void lut_rows_c(const void *src, void *dst, unsigned n, const lut_table &t)
+{
+	const T *src_p = static_cast<const T *>(src);
+	T *dst_p = static_cast<T *>(dst);
+	const T *table = static_cast<const T *>(t.entries);
+
+	for (unsigned i = 0; i < n; ++i) {
+		dst_p[i] = table[src_p[i] & t.mask];
+	}
+}
+
+lut_func select_lut(const packing_traits &traits, unsigned long flags)
+{
+#ifdef P2P_SIMD
+	lut_func simd_func = p2p::detail::search_lut_func(planar_sample_bytes(traits, flags));
+	if (simd_func)
+		return simd_func;
+#endif
+	return planar_sample_bytes(traits, flags) == 1 ? lut_rows_c<uint8_t> : lut_rows_c<uint16_t>;
+}
+
+using p2p::detail::dither_mode;
+
+typedef void (*dither_func)(const void *src, void *dst, unsigned n, unsigned row, unsigned depth);
+
+// Conversion between planar samples and fractional codes of the packed depth.
+template <class T, bool BitReplicate>
+struct dither_codec {
+	static float units(T x, float max) { return filter_arith<T>::load(x) * max; }
+	static T sample(uint32_t q, unsigned, float max) { return filter_arith<T>::store(static_cast<float>(q) / max, 0); }
+};
+
+template <bool BitReplicate>
+struct dither_codec<uint16_t, BitReplicate> {
+	static float units(uint16_t x, float max)
+	{
+		return BitReplicate ? x * (max / 65535.0f) : x * ((max + 1.0f) / 65536.0f);
+	}
+
+	static uint16_t sample(uint32_t q, unsigned depth, float)
+	{
+		return static_cast<uint16_t>(p2p::detail::rescale_depth<BitReplicate>(q, depth, 16));
 	}
+};
 
-	if (traits.is_nv && !(flags & P2P_SKIP_UNPACKED_PLANES) && param->src[0] && param->dst[0]) {
-		if ((traits.bytes_per_sample == 1 || traits.native_endian) && !traits.nv_shift) {
-			copy_plane_fast(param->src[0], param->dst[0], param->src_stride[0], param->dst_stride[0],
-			                traits.bytes_per_sample * param->width, param->height);
+template <class T, bool BitReplicate, dither_mode Mode>
+void dither_rows_c(const void *src, void *dst, unsigned n, unsigned row, unsigned depth)
+{
+	typedef dither_codec<T, BitReplicate> codec;
+	const T *src_p = static_cast<const T *>(src);
+	T *dst_p = static_cast<T *>(dst);
+	float max = static_cast<float>((UINT32_C(1) << depth) - 1);
+	float error = 0.0f;
+
+	for (unsigned i = 0; i < n; ++i) {
+		float t = codec::units(src_p[i], max);
+		float q;
+
+		if (Mode == p2p::detail::dither_ordered) {
+			q = std::floor(t + (2 * p2p::detail::bayer_threshold(i, row) + 1) * (1.0f / 128));
 		} else {
-			pack_nv16_plane(param->src[0], param->dst[0], param->src_stride[0], param->dst_stride[0], traits, param->width, param->height);
+			t += error;
+			q = std::floor(t + 0.5f);
+		}
+		q = q > 0.0f ? q : 0.0f;
+		q = q < max ? q : max;
+
+		// NaN propagates no error.
+		float clamped = std::min(std::max(t, 0.0f), max);
+		error = clamped == clamped ? clamped - q : 0.0f;
+		dst_p[i] = codec::sample(static_cast<uint32_t>(q), depth, max);
+	}
+}
+
+template <class T, bool BitReplicate>
+dither_func select_dither_c(dither_mode mode)
+{
+	if (mode == p2p::detail::dither_ordered)
+		return dither_rows_c<T, BitReplicate, p2p::detail::dither_ordered>;
+	else
+		return dither_rows_c<T, BitReplicate, p2p::detail::dither_error_diffusion>;
+}
+
+dither_func select_dither(dither_mode mode, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return select_dither_c<float, false>(mode);
+	else if (flags & P2P_PLANAR_HALF)
+		return select_dither_c<p2p::half, false>(mode);
+	else if (flags & P2P_BIT_REPLICATE)
+		return select_dither_c<uint16_t, true>(mode);
+#ifdef P2P_SIMD
+	dither_func simd_func = p2p::detail::search_dither_func(mode);
+	if (simd_func)
+		return simd_func;
+#endif
+	return select_dither_c<uint16_t, false>(mode);
+}
+
+typedef void (*box_filter_func)(const void * const *src, void *dst, unsigned width);
+typedef void (*box_rows_func)(const void * const *src, unsigned rows, void *dst, unsigned width, unsigned scale);
+
+// Average of scale x scale boxes over the given number of rows, which is less
+// than scale for the last box row of the plane.
+template <class T>
+void box_rows_c(const void * const *src, unsigned rows, void *dst, unsigned width, unsigned scale)
+{
+	typedef filter_arith<T> arith;
+	T *dst_p = static_cast<T *>(dst);
+
+	for (unsigned i = 0; i < width; i += scale) {
+		unsigned end = std::min(i + scale, width);
+		typename arith::type sum = 0;
+
+		for (unsigned r = 0; r < rows; ++r) {
+			const T *row = static_cast<const T *>(src[r]);
+			for (unsigned j = i; j < end; ++j) {
+				sum += arith::load(row[j]);
+			}
 		}
+		dst_p[i / scale] = arith::average(sum, rows * (end - i));
+	}
+}
+
+box_rows_func select_box_rows(const packing_traits &traits, unsigned long flags)
+{
+	if (flags & P2P_PLANAR_FLOAT)
+		return box_rows_c<float>;
+	else if (flags & P2P_PLANAR_HALF)
+		return box_rows_c<p2p::half>;
+	else if (planar_sample_bytes(traits, flags) == 1)
+		return box_rows_c<uint8_t>;
+	else
+		return box_rows_c<uint16_t>;
+}
+
+box_filter_func select_box_filter(unsigned scale, const packing_traits &traits, unsigned long flags)
+{
+#ifdef P2P_SIMD
+	if (!(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF)))
+		return p2p::detail::search_box_filter_func(scale, planar_sample_bytes(traits, flags));
+#else
+	(void)scale;
+	(void)traits;
+	(void)flags;
+#endif
+	return nullptr;
+}
+
+using p2p::detail::sample_stats;
+
+typedef void (*stats_func)(const void *src, unsigned n, sample_stats &stats);
+
+template <class T>
+void stats_rows_c(const void *src, unsigned n, sample_stats &stats)
+{
+	const T *src_p = static_cast<const T *>(src);
+
+	for (unsigned i = 0; i < n; ++i) {
+		stats.min = std::min(stats.min, static_cast<uint32_t>(src_p[i]));
+		stats.max = std::max(stats.max, static_cast<uint32_t>(src_p[i]));
+		stats.sum += src_p[i];
+	}
+}
+
+// Running minimum, maximum and sum of floating point samples. NaN is skipped
+// by the minimum and maximum, but not by the sum.
+struct fp_stats {
+	double min;
+	double max;
+	double sum;
+};
+
+typedef void (*fp_stats_func)(const void *src, unsigned n, fp_stats &stats);
+
+template <class T>
+void fp_stats_rows_c(const void *src, unsigned n, fp_stats &stats)
+{
+	typedef filter_arith<T> arith;
+	const T *src_p = static_cast<const T *>(src);
+	float min = static_cast<float>(stats.min);
+	float max = static_cast<float>(stats.max);
+	double sum = 0.0;
+
+	for (unsigned i = 0; i < n; ++i) {
+		float x = arith::load(src_p[i]);
+		min = x < min ? x : min;
+		max = x > max ? x : max;
+		sum += x;
+	}
+	stats.min = min;
+	stats.max = max;
+	stats.sum += sum;
+}
+
+typedef void (*histogram_func)(const void *src, unsigned n, uint32_t mask, unsigned long long *histogram);
+
+template <class T>
+void histogram_rows_c(const void *src, unsigned n, uint32_t mask, unsigned long long *histogram)
+{
+	const T *src_p = static_cast<const T *>(src);
+
+	for (unsigned i = 0; i < n; ++i) {
+		++histogram[src_p[i] & mask];
+	}
+}
+
+// Bytes are counted into four interleaved histograms first, so that runs of
+// equal samples do not wait on the same counter.
+template <>
+void histogram_rows_c<uint8_t>(const void *src, unsigned n, uint32_t mask, unsigned long long *histogram)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint32_t counts[4][256] = {};
+	unsigned i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		++counts[0][src_p[i + 0] & mask];
+		++counts[1][src_p[i + 1] & mask];
+		++counts[2][src_p[i + 2] & mask];
+		++counts[3][src_p[i + 3] & mask];
 	}
+	for (; i < n; ++i) {
+		++counts[0][src_p[i] & mask];
+	}
+	for (unsigned k = 0; k <= mask; ++k) {
+		histogram[k] += counts[0][k] + counts[1][k] + counts[2][k] + counts[3][k];
+	}
+}
+
+// Kernels accumulating the statistics of planar rows.
+struct stats_kernels {
+	stats_func ints;         // Minimum, maximum and sum of integer samples.
+	histogram_func histogram;
+	fp_stats_func fp;        // Replaces the others for floating point samples.
+	uint32_t masks[4];       // Largest integer sample of each plane.
+};
+
+void init_stats_kernels(stats_kernels &kernels, const packing_traits &traits, unsigned long flags)
+{
+	unsigned bytes = planar_sample_bytes(traits, flags);
+
+	kernels.ints = bytes == 1 ? stats_rows_c<uint8_t> : stats_rows_c<uint16_t>;
+	kernels.histogram = bytes == 1 ? histogram_rows_c<uint8_t> : histogram_rows_c<uint16_t>;
+	kernels.fp = nullptr;
+	if (flags & P2P_PLANAR_FLOAT)
+		kernels.fp = fp_stats_rows_c<float>;
+	else if (flags & P2P_PLANAR_HALF)
+		kernels.fp = fp_stats_rows_c<p2p::half>;
+#ifdef P2P_SIMD
+	stats_func simd_func = p2p::detail::search_stats_func(bytes);
+	if (simd_func)
+		kernels.ints = simd_func;
+#endif
+
+	for (unsigned p = 0; p < 4; ++p) {
+		unsigned depth = flags & P2P_PLANAR_16BIT ? 16 : p < 3 ? traits.depth : traits.alpha_depth;
+		kernels.masks[p] = (UINT32_C(1) << depth) - 1;
+	}
+}
+
+// CRC-32C (Castagnoli), bit-reflected, passed and returned finally inverted.
+typedef uint32_t (*crc32c_func)(uint32_t crc, const void *src, size_t n);
+
+const uint32_t crc32c_poly = UINT32_C(0x82F63B78);
+
+// Tables for eight bytes at a time. Entry i of table k is the CRC of byte i
+// followed by k zero bytes.
+struct crc32c_tables {
+	uint32_t t[8][256];
+
+	crc32c_tables()
+	{
+		for (unsigned i = 0; i < 256; ++i) {
+			uint32_t c = i;
+			for (unsigned bit = 0; bit < 8; ++bit) {
+				c = c & 1 ? (c >> 1) ^ crc32c_poly : c >> 1;
+			}
+			t[0][i] = c;
+		}
+		for (unsigned k = 1; k < 8; ++k) {
+			for (unsigned i = 0; i < 256; ++i) {
+				t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+			}
+		}
+	}
+};
+
+uint32_t load_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t load_le64(const unsigned char *p)
+{
+	return load_le32(p) | (static_cast<uint64_t>(load_le32(p + 4)) << 32);
+}
+
+uint32_t crc32c_c(uint32_t crc, const void *src, size_t n)
+{
+	static const crc32c_tables tables;
+	const uint32_t (*t)[256] = tables.t;
+	const unsigned char *src_p = static_cast<const unsigned char *>(src);
+	uint32_t c = ~crc;
+
+	for (; n >= 8; n -= 8, src_p += 8) {
+		uint32_t lo = c ^ load_le32(src_p);
+		uint32_t hi = load_le32(src_p + 4);
+		c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+			t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+	}
+	for (; n; --n) {
+		c = t[0][(c ^ *src_p++) & 0xFF] ^ (c >> 8);
+	}
+	return ~c;
+}
+
+crc32c_func select_crc32c()
+{
+#ifdef P2P_SIMD
+	crc32c_func simd_func = p2p::detail::search_crc32c_func();
+	if (simd_func)
+		return simd_func;
+#endif
+	return crc32c_c;
+}
+
+// Product of bit-reflected polynomials modulo the CRC polynomial.
+uint32_t crc32c_multiply(uint32_t a, uint32_t b)
+{
+	uint32_t product = 0;
+
+	for (uint32_t m = UINT32_C(1) << 31; m; m >>= 1) {
+		if (a & m)
+			product ^= b;
+		b = b & 1 ? (b >> 1) ^ crc32c_poly : b >> 1;
+	}
+	return product;
+}
+
+// CRC of the concatenation of two runs, given the CRC of each and the length
+// of the second, i.e. the first CRC is advanced over len2 zero bytes by
+// multiplying it by x^(8 * len2).
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, unsigned long long len2)
+{
+	uint32_t power = UINT32_C(1) << 31;  // x^0
+	uint32_t square = UINT32_C(1) << 23; // x^8
+
+	for (; len2; len2 >>= 1) {
+		if (len2 & 1)
+			power = crc32c_multiply(square, power);
+		square = crc32c_multiply(square, square);
+	}
+	return crc32c_multiply(power, crc1) ^ crc2;
+}
+
+// Streaming XXH64 with seed 0.
+const uint64_t xxh64_prime1 = UINT64_C(0x9E3779B185EBCA87);
+const uint64_t xxh64_prime2 = UINT64_C(0xC2B2AE3D27D4EB4F);
+const uint64_t xxh64_prime3 = UINT64_C(0x165667B19E3779F9);
+const uint64_t xxh64_prime4 = UINT64_C(0x85EBCA77C2B2AE63);
+const uint64_t xxh64_prime5 = UINT64_C(0x27D4EB2F165667C5);
+
+struct xxh64_state {
+	uint64_t acc[4];
+	unsigned long long total;
+	unsigned char buffer[32]; // Bytes short of a whole stripe.
+	unsigned buffered;
+};
+
+uint64_t rotl64(uint64_t x, unsigned r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+uint64_t xxh64_round(uint64_t acc, uint64_t x)
+{
+	return rotl64(acc + x * xxh64_prime2, 31) * xxh64_prime1;
+}
+
+uint64_t xxh64_merge(uint64_t h, uint64_t acc)
+{
+	return (h ^ xxh64_round(0, acc)) * xxh64_prime1 + xxh64_prime4;
+}
+
+void xxh64_stripe(xxh64_state &state, const unsigned char *p)
+{
+	for (unsigned k = 0; k < 4; ++k) {
+		state.acc[k] = xxh64_round(state.acc[k], load_le64(p + 8 * k));
+	}
+}
+
+void xxh64_init(xxh64_state &state)
+{
+	state.acc[0] = xxh64_prime1 + xxh64_prime2;
+	state.acc[1] = xxh64_prime2;
+	state.acc[2] = 0;
+	state.acc[3] = 0 - xxh64_prime1;
+	state.total = 0;
+	state.buffered = 0;
+}
+
+void xxh64_update(xxh64_state &state, const void *src, size_t n)
+{
+	const unsigned char *src_p = static_cast<const unsigned char *>(src);
+	state.total += n;
+
+	if (state.buffered) {
+		size_t fill = std::min(n, static_cast<size_t>(32 - state.buffered));
+		std::memcpy(state.buffer + state.buffered, src_p, fill);
+		state.buffered += static_cast<unsigned>(fill);
+		src_p += fill;
+		n -= fill;
+
+		if (state.buffered < 32)
+			return;
+		xxh64_stripe(state, state.buffer);
+		state.buffered = 0;
+	}
+	for (; n >= 32; n -= 32, src_p += 32) {
+		xxh64_stripe(state, src_p);
+	}
+	std::memcpy(state.buffer, src_p, n);
+	state.buffered = static_cast<unsigned>(n);
+}
+
+uint64_t xxh64_digest(const xxh64_state &state)
+{
+	const uint64_t *acc = state.acc;
+	uint64_t h;
+
+	if (state.total >= 32) {
+		h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+		for (unsigned k = 0; k < 4; ++k) {
+			h = xxh64_merge(h, acc[k]);
+		}
+	} else {
+		h = xxh64_prime5;
+	}
+	h += state.total;
+
+	const unsigned char *p = state.buffer;
+	unsigned n = state.buffered;
+	for (; n >= 8; n -= 8, p += 8) {
+		h = rotl64(h ^ xxh64_round(0, load_le64(p)), 27) * xxh64_prime1 + xxh64_prime4;
+	}
+	if (n >= 4) {
+		h = rotl64(h ^ (load_le32(p) * xxh64_prime1), 23) * xxh64_prime2 + xxh64_prime3;
+		n -= 4;
+		p += 4;
+	}
+	for (; n; --n) {
+		h = rotl64(h ^ (*p++ * xxh64_prime5), 11) * xxh64_prime1;
+	}
+
+	h ^= h >> 33;
+	h *= xxh64_prime2;
+	h ^= h >> 29;
+	h *= xxh64_prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+} // namespace
+
+
+/**
+ * Precompiled frame conversion.
+ *
+ * Rows are counted in the interleaved plane, i.e. chroma rows for NV formats.
+ * With 4:2:0 chroma for a 4:2:2 packing, rows are planar chroma rows, each
+ * covering two packed rows.
+ */
+struct p2p_plan {
+	const packing_traits *traits;
+	bool is_pack;
+	p2p_unpack_func unpack;
+	p2p_pack_func pack;
+	p2p_unpack_2d_func unpack_2d; // Or null to unpack row by row.
+	p2p_pack_2d_func pack_2d;  // Or null to pack row by row.
+	sample_func samples; // Converts samples between the kernels and the frame, or null.
+	plane_func nv_plane; // Luma handling for NV formats, or null to skip.
+	unsigned width;
+	unsigned kernel_width; // Width of the interleaved pass, rounded up for padded buffers.
+	unsigned height;
+	unsigned rows;
+	unsigned subsample_h;  // Vertical chroma subsampling of the planar frame.
+	unsigned planar_bytes; // Bytes per planar sample.
+	ptrdiff_t src_stride[4];
+	ptrdiff_t dst_stride[4];
+	bool collapse;       // Interleaved plane is contiguous and processed as one span.
+	bool collapse_luma;  // Likewise for the NV luma plane.
+	unsigned strip_rows; // Interleaved rows per NV strip.
+	unsigned band_rows;
+	unsigned num_bands;
+	bool chroma_420;     // 4:2:2 packed chroma is resampled to or from 4:2:0 planar chroma.
+	bool chroma_444;     // Subsampled packed chroma is resampled to or from 4:4:4 planar chroma.
+	bool interlaced;     // Vertical resampling is within each field. Bands hold even numbers of rows.
+	unsigned chroma_taps; // Rows read per vertically resampled chroma row.
+	row_filter_func chroma_filter; // Vertical filter, or null to repeat rows when packing.
+	chroma_resample_func chroma_h; // Horizontal filter for 4:4:4 planar chroma.
+	alpha_func alpha;    // Premultiplies unpacked color, or unpremultiplies color to pack, or null.
+	alpha_scale alpha_scales[3];
+	matrix_func matrix;  // Converts planar color between RGB and YUV, or null.
+	color_matrix colors;
+	lut_func lut;        // Looks up planar samples in the tables, or null if there are none.
+	lut_table luts[4];   // Table of each plane, or with null entries to leave it as is.
+	dither_func dither;  // Quantizes planar color to the packed depth, or null.
+	unsigned dither_depth;
+	stats_kernels stats; // Statistics of unpacked planes.
+	bool stream;         // 2-D kernels use non-temporal stores.
+	bool threaded;       // Bands are spread across the library thread pool.
+	p2p::thread_pool::priority priority;
+};
+
+struct p2p_job {
+	p2p::thread_pool *pool;
+	p2p::thread_pool::task_ptr task;
+};
+
+namespace {
+
+bool is_contiguous(const p2p_plan &plan, const ptrdiff_t packed_stride, const ptrdiff_t planar_stride[4])
+{
+	const packing_traits &traits = *plan.traits;
+
+	if (plan.width % traits.pel_per_pack)
+		return false;
+	if (static_cast<unsigned long long>(plan.width) * plan.rows > UINT_MAX)
+		return false;
+	if (packed_stride != static_cast<ptrdiff_t>(packed_linesize(traits, plan.width)))
+		return false;
+
+	for (unsigned p = 0; p < 4; ++p) {
+		// Luma and alpha are not touched by the interleaved pass of NV formats.
+		if (traits.is_nv && (p == 0 || p == 3))
+			continue;
+		// Alpha plane is optional and its stride may be left unset.
+		if (p == 3 && !planar_stride[p])
+			continue;
+		if (planar_stride[p] != static_cast<ptrdiff_t>(planar_linesize(traits, plan.width, p, plan.planar_bytes)))
+			return false;
+	}
+	return true;
+}
+
+size_t plan_frame_bytes(const p2p_plan &plan)
+{
+	return packed_linesize(*plan.traits, plan.width) * (plan.chroma_420 ? plan.height : plan.rows);
+}
+
+void init_plan(p2p_plan &plan, const struct p2p_buffer_param *param, unsigned long flags, bool is_pack, const void * const *luts = nullptr)
+{
+	const packing_traits &traits = lookup_traits(param->packing, flags);
+
+	// A color matrix replaces range conversion, and needs 4:4:4 chroma.
+	if (flags & P2P_MATRIX_MASK) {
+		flags &= ~range_flags;
+		flags |= traits.subsample_w ? P2P_CHROMA_444 : 0;
+	}
+
+	unsigned replicate = flags & P2P_BIT_REPLICATE ? 1 : 0;
+	unsigned one_fill = flags & P2P_ALPHA_SET_ONE ? 1 : 0;
+	unsigned limited = flags & P2P_PLANAR_FULL_RANGE ? 0 : 1;
+	bool range = !(flags & planar_type_flags) && (flags & range_flags);
+
+	plan.traits = &traits;
+	plan.is_pack = is_pack;
+	plan.unpack = traits.unpack;
+	plan.pack = one_fill ? traits.pack_one_fill : traits.pack;
+	plan.unpack_2d = traits.unpack_2d;
+	plan.pack_2d = one_fill ? traits.pack_2d_one_fill : traits.pack_2d;
+	plan.nv_plane = nullptr;
+	plan.width = param->width;
+	plan.height = param->height;
+	plan.chroma_444 = (flags & P2P_CHROMA_444) && traits.subsample_w;
+	plan.chroma_420 = !plan.chroma_444 && (flags & P2P_CHROMA_420) && traits.subsample_w && !traits.is_nv;
+	plan.subsample_h = plan.chroma_420 ? 1 : traits.subsample_h;
+	plan.rows = param->height >> plan.subsample_h;
+	plan.planar_bytes = planar_sample_bytes(traits, flags);
+	std::copy_n(param->src_stride, 4, plan.src_stride);
+	std::copy_n(param->dst_stride, 4, plan.dst_stride);
+
+	// Rescaled and range converted samples go through a row stage around the
+	// native kernels, unless the packing has fused SIMD kernels for them.
+	plan.samples = nullptr;
+	if ((flags & planar_type_flags) || range) {
+		const std::type_info *type = flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF) ? traits.type_fp[flags & P2P_PLANAR_FLOAT ? 0 : 1] :
+			flags & P2P_PLANAR_16BIT ? traits.type_16[replicate] : nullptr;
+		bool fused = type == traits.type;
+
+#ifdef P2P_SIMD
+		if (type && !fused && is_pack) {
+			plan.pack = p2p::detail::search_pack_func(*type, !!one_fill);
+			plan.pack_2d = p2p::detail::search_pack_2d_func(*type, !!one_fill);
+			fused = !!plan.pack;
+		} else if (type && !fused) {
+			plan.unpack = p2p::detail::search_unpack_func(*type);
+			plan.unpack_2d = p2p::detail::search_unpack_2d_func(*type);
+			fused = !!plan.unpack;
+		}
+#endif
+		if (!fused) {
+			plan.unpack = traits.unpack;
+			plan.pack = one_fill ? traits.pack_one_fill : traits.pack;
+			plan.unpack_2d = nullptr;
+			plan.pack_2d = nullptr;
+			plan.samples = traits.bytes_per_sample == 1 ? select_samples<uint8_t>(flags, is_pack) : select_samples<uint16_t>(flags, is_pack);
+		}
+	}
+
+	if (traits.is_nv && !(flags & P2P_SKIP_UNPACKED_PLANES)) {
+		if (flags & P2P_PLANAR_FLOAT)
+			plan.nv_plane = select_nv_plane_rescaled<float>(is_pack);
+		else if (flags & P2P_PLANAR_HALF)
+			plan.nv_plane = select_nv_plane_rescaled<p2p::half>(is_pack);
+		else if (flags & P2P_PLANAR_16BIT && (traits.bytes_per_sample == 1 || traits.nv_shift))
+			plan.nv_plane = replicate ? select_nv_plane_rescaled<uint16_t, 16, true>(is_pack) : select_nv_plane_rescaled<uint16_t, 16, false>(is_pack);
+		else if (range)
+			plan.nv_plane = limited ? select_nv_plane_range<p2p::range_full_limited>(traits, is_pack) : select_nv_plane_range<p2p::range_limited_full>(traits, is_pack);
+		else if ((traits.bytes_per_sample == 1 || traits.native_endian) && !traits.nv_shift)
+			plan.nv_plane = copy_nv_plane;
+		else
+			plan.nv_plane = is_pack ? pack_nv16_plane : unpack_nv16_plane;
+	}
+
+	const ptrdiff_t *packed_stride = is_pack ? plan.dst_stride : plan.src_stride;
+	const ptrdiff_t *planar_stride = is_pack ? plan.src_stride : plan.dst_stride;
+	ptrdiff_t packed_luma_linesize = planar_linesize(traits, plan.width, 0);
+	ptrdiff_t planar_luma_linesize = planar_linesize(traits, plan.width, 0, plan.planar_bytes);
+
+	plan.collapse = is_contiguous(plan, packed_stride[traits.is_nv ? 1 : 0], planar_stride);
+
+	// Round the interleaved pass up to whole packs and vectors, so that the
+	// kernels never take their partial-group and scalar tail paths. Neither
+	// the packed nor the planar rows may be overrun by more than the padding.
+	plan.kernel_width = plan.width;
+	if (flags & P2P_PADDED_BUFFERS) {
+		unsigned pack_bytes = std::max<unsigned>(traits.bytes_per_pack, traits.pel_per_pack * plan.planar_bytes);
+		unsigned granularity = std::max(max_overrun_bytes / pack_bytes, 1U) * traits.pel_per_pack;
+		plan.kernel_width = plan.width + (granularity - plan.width % granularity) % granularity;
+		plan.collapse = plan.collapse && plan.kernel_width == plan.width;
+	}
+	plan.collapse_luma = packed_stride[0] == packed_luma_linesize && planar_stride[0] == planar_luma_linesize &&
+		static_cast<unsigned long long>(plan.width) * plan.height <= UINT_MAX;
+
+	plan.strip_rows = 1;
+	plan.band_rows = std::max(plan.rows, 1U);
+	plan.num_bands = 1;
+
+	bool linear = !!(flags & P2P_CHROMA_LINEAR);
+	bool vertical_444 = plan.chroma_444 && traits.subsample_h;
+
+	plan.interlaced = (plan.chroma_420 || vertical_444) && (flags & P2P_CHROMA_INTERLACED);
+	plan.chroma_taps = 0;
+	plan.chroma_filter = nullptr;
+	plan.chroma_h = nullptr;
+
+	if (plan.chroma_444 && !is_pack) {
+		if (linear)
+			plan.chroma_h = select_chroma_resample(flags & P2P_CHROMA_CENTERED ? p2p::detail::chroma_linear_centered : p2p::detail::chroma_linear_cosited, traits, flags);
+		else
+			plan.chroma_h = select_chroma_resample(p2p::detail::chroma_repeat, traits, flags);
+	} else if (plan.chroma_444) {
+		if (flags & P2P_CHROMA_CENTERED)
+			plan.chroma_h = select_chroma_resample(linear ? p2p::detail::chroma_smooth : p2p::detail::chroma_average, traits, flags);
+		else
+			plan.chroma_h = select_chroma_resample(linear ? p2p::detail::chroma_triangle : p2p::detail::chroma_drop, traits, flags);
+	}
+	if (vertical_444 && !is_pack) {
+		plan.chroma_taps = linear ? 2 : 1;
+		plan.chroma_filter = linear ? select_row_filter(p2p::detail::row_interpolate, traits, flags) : nullptr;
+	} else if (vertical_444) {
+		plan.chroma_taps = linear ? 4 : 2;
+		plan.chroma_filter = select_row_filter(linear ? p2p::detail::row_smooth : p2p::detail::row_average, traits, flags);
+	} else if (plan.chroma_420) {
+		if (is_pack) {
+			plan.chroma_taps = linear ? 2 : 1;
+			plan.chroma_filter = linear ? select_row_filter(p2p::detail::row_interpolate, traits, flags) : nullptr;
+		} else {
+			plan.chroma_taps = linear ? 4 : 2;
+			plan.chroma_filter = select_row_filter(linear ? p2p::detail::row_smooth : p2p::detail::row_average, traits, flags);
+		}
+	}
+
+	// Packing without an alpha plane stores constant alpha, which is opaque
+	// with one fill and leaves color as given otherwise.
+	plan.matrix = nullptr;
+	if (flags & P2P_MATRIX_MASK) {
+		init_color_matrix(plan.colors, traits, flags, traits.is_yuv == is_pack);
+		plan.matrix = select_matrix(traits, flags);
+	}
+
+	// Tables are indexed by integer samples at the planar depth.
+	plan.lut = nullptr;
+	for (unsigned p = 0; p < 4; ++p) {
+		unsigned depth = flags & P2P_PLANAR_16BIT ? 16 : p < 3 ? traits.depth : traits.alpha_depth;
+		bool has_table = luts && luts[p] && !(flags & (P2P_PLANAR_FLOAT | P2P_PLANAR_HALF)) && (p < 3 || traits.has_alpha);
+
+		plan.luts[p] = { has_table ? luts[p] : nullptr, (UINT32_C(1) << depth) - 1 };
+		if (has_table)
+			plan.lut = select_lut(traits, flags);
+	}
+
+	// Only samples more precise than the packing have anything to dither.
+	plan.dither = nullptr;
+	plan.dither_depth = 0;
+	if ((flags & P2P_DITHER_MASK) && is_pack) {
+		unsigned precision = flags & P2P_PLANAR_FLOAT ? 24 : flags & P2P_PLANAR_HALF ? 11 : flags & P2P_PLANAR_16BIT ? 16 : 0;
+
+		if (traits.depth < precision) {
+			plan.dither_depth = traits.depth;
+			plan.dither = select_dither((flags & P2P_DITHER_MASK) == P2P_DITHER_ERROR_DIFFUSION ? p2p::detail::dither_error_diffusion : p2p::detail::dither_ordered, flags);
+		}
+	}
+
+	init_stats_kernels(plan.stats, traits, flags);
+
+	plan.alpha = nullptr;
+	if ((flags & P2P_ALPHA_PREMULTIPLIED) && traits.has_alpha) {
+		unsigned char depth = flags & P2P_PLANAR_16BIT ? 16 : traits.depth;
+		unsigned char alpha_depth = flags & P2P_PLANAR_16BIT ? 16 : traits.alpha_depth;
+
+		for (unsigned p = 0; p < 3; ++p) {
+			plan.alpha_scales[p] = { depth, alpha_depth, traits.is_yuv != !!plan.matrix && p != 0 };
+		}
+		plan.alpha = select_alpha(is_pack ? p2p::detail::alpha_unpremultiply : p2p::detail::alpha_premultiply, traits, flags, plan.alpha_scales[0]);
+	}
+
+	// Size NV strips so that the chroma and luma rows of a strip, on both
+	// sides, fit in half of the L2 cache.
+	if (plan.nv_plane) {
+		size_t strip_bytes = packed_linesize(traits, plan.width) + 2 * planar_linesize(traits, plan.width, 1, plan.planar_bytes) +
+			((packed_luma_linesize + planar_luma_linesize) << traits.subsample_h);
+		size_t strip_rows = cache_sizes().l2 / 2 / std::max(strip_bytes, static_cast<size_t>(1));
+		plan.strip_rows = static_cast<unsigned>(std::min(std::max(strip_rows, static_cast<size_t>(1)), static_cast<size_t>(plan.band_rows)));
+	}
+
+	// Output that cannot stay in the last-level cache only evicts other data.
+	// Rescaling and range kernels have no streaming variants, and resampled
+	// chroma, premultiplied, matrixed and looked up samples go through line
+	// buffers.
+	plan.stream = false;
+	if (!(flags & (planar_type_flags | range_flags)) && !plan.chroma_420 && !plan.chroma_444 && !plan.alpha && !plan.matrix && !plan.lut && ((flags & P2P_STREAMING_STORES) || plan_frame_bytes(plan) > cache_sizes().llc / 2)) {
+#ifdef P2P_SIMD
+		if (is_pack) {
+			p2p_pack_2d_func pack_nt = p2p::detail::search_pack_2d_nt_func(*traits.type, !!(flags & P2P_ALPHA_SET_ONE));
+			plan.pack_2d = pack_nt ? pack_nt : plan.pack_2d;
+			plan.stream = !!pack_nt;
+		} else {
+			p2p_unpack_2d_func unpack_nt = p2p::detail::search_unpack_2d_nt_func(*traits.type);
+			plan.unpack_2d = unpack_nt ? unpack_nt : plan.unpack_2d;
+			plan.stream = !!unpack_nt;
+		}
+#endif
+	}
+
+	plan.threaded = !!(flags & P2P_USE_THREADS);
+	if (flags & P2P_PRIORITY_REALTIME)
+		plan.priority = p2p::thread_pool::realtime;
+	else if (flags & P2P_PRIORITY_BACKGROUND)
+		plan.priority = p2p::thread_pool::background;
+	else
+		plan.priority = p2p::thread_pool::normal;
+}
+
+// Partition into bands large enough to be worth a thread each.
+void partition_plan(p2p_plan &plan, unsigned threads)
+{
+	size_t max_bands = std::max(plan_frame_bytes(plan) / min_band_bytes, static_cast<size_t>(1));
+	unsigned num_bands = static_cast<unsigned>(std::min(std::min(static_cast<size_t>(threads), max_bands), static_cast<size_t>(std::max(plan.rows, 1U))));
+
+	plan.band_rows = std::max((plan.rows + num_bands - 1) / num_bands, 1U);
+
+	// Keep strips whole, unless that would idle a thread.
+	if (plan.band_rows > plan.strip_rows && plan.band_rows % plan.strip_rows) {
+		unsigned aligned = (plan.band_rows + plan.strip_rows - 1) / plan.strip_rows * plan.strip_rows;
+		if ((plan.rows + aligned - 1) / aligned == num_bands)
+			plan.band_rows = aligned;
+	}
+
+	// Keep the packed rows of both fields together.
+	if (plan.interlaced)
+		plan.band_rows += plan.band_rows & 1;
+	plan.num_bands = std::max((plan.rows + plan.band_rows - 1) / plan.band_rows, 1U);
+}
+
+// Luma rows corresponding to a range of interleaved rows.
+void nv_luma_range(const p2p_plan &plan, unsigned row_begin, unsigned row_end, unsigned *luma_begin, unsigned *luma_end)
+{
+	*luma_begin = row_begin << plan.subsample_h;
+	*luma_end = row_end == plan.rows ? plan.height : row_end << plan.subsample_h;
+}
+
+void convert_nv_luma(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void *src, void *dst)
+{
+	unsigned luma_begin, luma_end;
+	nv_luma_range(plan, row_begin, row_end, &luma_begin, &luma_end);
+
+	src = increment_ptr(src, plan.src_stride[0] * luma_begin);
+	dst = increment_ptr(dst, plan.dst_stride[0] * luma_begin);
+
+	if (plan.collapse_luma)
+		plan.nv_plane(src, dst, 0, 0, *plan.traits, plan.width * (luma_end - luma_begin), 1);
+	else
+		plan.nv_plane(src, dst, plan.src_stride[0], plan.dst_stride[0], *plan.traits, plan.width, luma_end - luma_begin);
+}
+
+const ptrdiff_t zero_stride[4] = {};
+
+// Pixels converted at a time by the row stage. A multiple of every pack.
+const unsigned span_pixels = 384;
+
+// Planes of the interleaved pass read or written by the kernels.
+bool kernel_plane(const packing_traits &traits, unsigned p, const void * const planes[4])
+{
+	return planes[p] && (traits.is_nv ? p == 1 || p == 2 : p < 3 || traits.has_alpha);
+}
+
+// Kernel calls on a span of pixels, through line buffers of native samples if
+// the plan converts them.
+void unpack_span(const p2p_plan &plan, const void *src, void * const dst[4], unsigned left, unsigned right)
+{
+	if (!plan.samples) {
+		plan.unpack(src, dst, left, right);
+		return;
+	}
+
+	const packing_traits &traits = *plan.traits;
+	alignas(16) unsigned char native[4][span_pixels * 2 + max_overrun_bytes];
+	void *native_p[4];
+	for (unsigned p = 0; p < 4; ++p) {
+		native_p[p] = dst[p] ? native[p] : nullptr;
+	}
+
+	for (unsigned i = left; i < right; i += span_pixels) {
+		unsigned n = std::min(span_pixels, right - i);
+		plan.unpack(increment_ptr(src, i / traits.pel_per_pack * traits.bytes_per_pack), native_p, 0, n);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			unsigned shift = p == 1 || p == 2 ? traits.subsample_w : 0;
+			if (kernel_plane(traits, p, dst)) {
+				plan.samples(native[p], increment_ptr(dst[p], static_cast<size_t>(i >> shift) * plan.planar_bytes), (n + (1U << shift) - 1) >> shift,
+					p == 3 ? traits.alpha_depth : traits.depth, traits.is_yuv && (p == 1 || p == 2), p == 3);
+			}
+		}
+	}
+}
+
+void pack_span(const p2p_plan &plan, const void * const src[4], void *dst, unsigned left, unsigned right)
+{
+	if (!plan.samples) {
+		plan.pack(src, dst, left, right);
+		return;
+	}
+
+	const packing_traits &traits = *plan.traits;
+	alignas(16) unsigned char native[4][span_pixels * 2 + max_overrun_bytes];
+	const void *native_p[4];
+	for (unsigned p = 0; p < 4; ++p) {
+		native_p[p] = src[p] ? native[p] : nullptr;
+	}
+
+	for (unsigned i = left; i < right; i += span_pixels) {
+		unsigned n = std::min(span_pixels, right - i);
+		unsigned packed_n = (n + traits.pel_per_pack - 1) / traits.pel_per_pack * traits.pel_per_pack;
+
+		// Samples past the end of the last partial pack are packed as zero.
+		for (unsigned p = 0; p < 4; ++p) {
+			unsigned shift = p == 1 || p == 2 ? traits.subsample_w : 0;
+			unsigned m = (n + (1U << shift) - 1) >> shift;
+			if (kernel_plane(traits, p, src)) {
+				plan.samples(increment_ptr(src[p], static_cast<size_t>(i >> shift) * plan.planar_bytes), native[p], m,
+					p == 3 ? traits.alpha_depth : traits.depth, traits.is_yuv && (p == 1 || p == 2), p == 3);
+				std::fill(native[p] + m * traits.bytes_per_sample, native[p] + (packed_n >> shift) * traits.bytes_per_sample, 0);
+			}
+		}
+		plan.pack(native_p, increment_ptr(dst, i / traits.pel_per_pack * traits.bytes_per_pack), 0, n);
+	}
+}
+
+void unpack_interleaved(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+
+	// Process interleaved plane.
+	const void *src_p = traits.is_nv ? src[1] : src[0];
+	ptrdiff_t src_stride = traits.is_nv ? plan.src_stride[1] : plan.src_stride[0];
+
+	if (plan.collapse && plan.stream) {
+		plan.unpack_2d(src_p, 0, dst, zero_stride, row_begin * plan.width, row_end * plan.width, 1);
+	} else if (plan.collapse) {
+		unpack_span(plan, src_p, dst, row_begin * plan.width, row_end * plan.width);
+	} else {
+		void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+		ptrdiff_t dst_stride[4] = { plan.dst_stride[0], plan.dst_stride[1], plan.dst_stride[2], plan.dst_stride[3] };
+
+		// Luma and alpha are not advanced by the interleaved pass of NV formats.
+		if (traits.is_nv)
+			dst_stride[0] = dst_stride[3] = 0;
+
+		src_p = increment_ptr(src_p, src_stride * row_begin);
+		for (unsigned p = 0; p < 4; ++p) {
+			if (dst_p[p])
+				dst_p[p] = increment_ptr(dst_p[p], dst_stride[p] * row_begin);
+		}
+
+		if (plan.unpack_2d) {
+			plan.unpack_2d(src_p, src_stride, dst_p, dst_stride, 0, plan.kernel_width, row_end - row_begin);
+		} else {
+			for (unsigned r = row_begin; r < row_end; ++r) {
+				unpack_span(plan, src_p, dst_p, 0, plan.kernel_width);
+
+				src_p = increment_ptr(src_p, src_stride);
+				for (unsigned p = 0; p < 4; ++p) {
+					if (dst_p[p])
+						dst_p[p] = increment_ptr(dst_p[p], dst_stride[p]);
+				}
+			}
+		}
+	}
+}
+
+void pack_interleaved(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+
+	// Process interleaved plane.
+	void *dst_p = traits.is_nv ? dst[1] : dst[0];
+	ptrdiff_t dst_stride = traits.is_nv ? plan.dst_stride[1] : plan.dst_stride[0];
+
+	if (plan.collapse && plan.stream) {
+		plan.pack_2d(src, zero_stride, dst_p, 0, row_begin * plan.width, row_end * plan.width, 1);
+	} else if (plan.collapse) {
+		pack_span(plan, src, dst_p, row_begin * plan.width, row_end * plan.width);
+	} else {
+		const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+		ptrdiff_t src_stride[4] = { plan.src_stride[0], plan.src_stride[1], plan.src_stride[2], plan.src_stride[3] };
+
+		// Luma and alpha are not advanced by the interleaved pass of NV formats.
+		if (traits.is_nv)
+			src_stride[0] = src_stride[3] = 0;
+
+		for (unsigned p = 0; p < 4; ++p) {
+			if (src_p[p])
+				src_p[p] = increment_ptr(src_p[p], src_stride[p] * row_begin);
+		}
+		dst_p = increment_ptr(dst_p, dst_stride * row_begin);
+
+		if (plan.pack_2d) {
+			plan.pack_2d(src_p, src_stride, dst_p, dst_stride, 0, plan.kernel_width, row_end - row_begin);
+		} else {
+			for (unsigned r = row_begin; r < row_end; ++r) {
+				pack_span(plan, src_p, dst_p, 0, plan.kernel_width);
+
+				for (unsigned p = 0; p < 4; ++p) {
+					if (src_p[p])
+						src_p[p] = increment_ptr(src_p[p], src_stride[p]);
+				}
+				dst_p = increment_ptr(dst_p, dst_stride);
+			}
+		}
+	}
+}
+
+// NV formats process each strip of chroma rows together with the luma rows it
+// covers, so that both planes pass through the cache once per strip.
+void unpack_rows(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	unsigned strip_rows = do_luma ? plan.strip_rows : row_end - row_begin;
+	unsigned i = row_begin;
+
+	do {
+		unsigned n = std::min(strip_rows, row_end - i);
+		unpack_interleaved(plan, i, i + n, src, dst);
+		if (do_luma)
+			convert_nv_luma(plan, i, i + n, src[0], dst[0]);
+		i += n;
+	} while (i < row_end);
+}
+
+void pack_rows(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	unsigned strip_rows = do_luma ? plan.strip_rows : row_end - row_begin;
+	unsigned i = row_begin;
+
+	do {
+		unsigned n = std::min(strip_rows, row_end - i);
+		pack_interleaved(plan, i, i + n, src, dst);
+		if (do_luma)
+			convert_nv_luma(plan, i, i + n, src[0], dst[0]);
+		i += n;
+	} while (i < row_end);
+}
+
+// Packed row read by tap k of 4:2:0 chroma row c, with k from -1 to 2 top to
+// bottom. Taps outside the frame, or the field of c, repeat the edge row.
+unsigned chroma_source_row(const p2p_plan &plan, unsigned c, int k)
+{
+	int step = plan.interlaced ? 2 : 1;
+	int base = plan.interlaced ? (c & ~1U) * 2 + (c & 1) : c * 2;
+	int row = base + k * step;
+
+	while (row < 0)
+		row += step;
+	while (row >= static_cast<int>(plan.height))
+		row -= step;
+	return row;
+}
+
+// 4:2:0 chroma row nearest to packed row r, and the nearest one on the other
+// side of r.
+void chroma_dest_rows(const p2p_plan &plan, unsigned r, unsigned *nearest, unsigned *next)
+{
+	int step = plan.interlaced ? 2 : 1;
+	int field_row = plan.interlaced ? r >> 1 : r;
+	int rows = plan.rows;
+	int c = plan.interlaced ? (r >> 2) * 2 + (r & 1) : r >> 1;
+
+	// Trailing rows of odd-sized frames and fields.
+	while (c >= rows)
+		c -= step;
+	c = std::max(c, 0);
+
+	int n = c + (field_row & 1 ? step : -step);
+	*nearest = c;
+	*next = n >= 0 && n < rows ? n : c;
+}
+
+// Line buffer of planar samples, with room for padded kernels.
+size_t line_buffer_bytes(const p2p_plan &plan, unsigned width)
+{
+	return (static_cast<size_t>(width) * plan.planar_bytes + max_overrun_bytes + 63) & ~static_cast<size_t>(63);
+}
+
+// Samples in a planar row of the interleaved pass.
+unsigned planar_width(const p2p_plan &plan, unsigned p)
+{
+	return (p == 1 || p == 2) && !plan.chroma_444 ? (plan.kernel_width + plan.traits->subsample_w) >> plan.traits->subsample_w : plan.kernel_width;
+}
+
+void lookup_row(const p2p_plan &plan, unsigned p, const void *src, void *dst, unsigned n)
+{
+	if (plan.luts[p].entries)
+		plan.lut(src, dst, n, plan.luts[p]);
+}
+
+void lookup_nv_luma(const p2p_plan &plan, unsigned row_begin, unsigned row_end, void *dst)
+{
+	unsigned luma_begin, luma_end;
+	nv_luma_range(plan, row_begin, row_end, &luma_begin, &luma_end);
+
+	for (unsigned r = luma_begin; r < luma_end; ++r) {
+		void *row = increment_ptr(dst, plan.dst_stride[0] * r);
+		lookup_row(plan, 0, row, row, plan.width);
+	}
+}
+
+// Each packed row is unpacked once into a cache of chroma rows read by the
+// filter, while its luma goes straight to the frame. Rows beyond the band are
+// unpacked by the neighbouring bands as well, with their luma discarded here.
+void unpack_rows_420(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const unsigned slots = 8;
+
+	unsigned luma_begin, luma_end;
+	nv_luma_range(plan, row_begin, row_end, &luma_begin, &luma_end);
+
+	unsigned chroma_width = plan.kernel_width >> plan.traits->subsample_w;
+	size_t chroma_bytes = line_buffer_bytes(plan, (plan.kernel_width + 1) / 2);
+
+	std::vector<unsigned char> scratch(2 * slots * chroma_bytes + line_buffer_bytes(plan, plan.kernel_width));
+	std::vector<bool> done(luma_end - luma_begin);
+	unsigned tag[slots];
+	std::fill_n(tag, slots, UINT_MAX);
+
+	unsigned char *discard = scratch.data() + 2 * slots * chroma_bytes;
+	auto line = [&](unsigned slot, unsigned p) { return scratch.data() + (slot * 2 + p - 1) * chroma_bytes; };
+
+	auto unpack_row = [&](unsigned r)
+	{
+		unsigned slot = r % slots;
+		if (tag[slot] == r)
+			return slot;
+
+		bool own = r >= luma_begin && r < luma_end;
+		void *dst_p[4] = { own ? increment_ptr(dst[0], plan.dst_stride[0] * r) : discard, line(slot, 1), line(slot, 2), nullptr };
+
+		unpack_span(plan, increment_ptr(src[0], plan.src_stride[0] * r), dst_p, 0, plan.kernel_width);
+		tag[slot] = r;
+		if (own) {
+			lookup_row(plan, 0, dst_p[0], dst_p[0], plan.kernel_width);
+			done[r - luma_begin] = true;
+		}
+		return slot;
+	};
+
+	int first_tap = plan.chroma_taps == 4 ? -1 : 0;
+
+	for (unsigned c = row_begin; c < row_end; ++c) {
+		unsigned slot[4];
+		for (unsigned k = 0; k < plan.chroma_taps; ++k) {
+			slot[k] = unpack_row(chroma_source_row(plan, c, first_tap + static_cast<int>(k)));
+		}
+
+		for (unsigned p = 1; p < 3; ++p) {
+			const void *taps[4];
+			for (unsigned k = 0; k < plan.chroma_taps; ++k) {
+				taps[k] = line(slot[k], p);
+			}
+			void *row = increment_ptr(dst[p], plan.dst_stride[p] * c);
+			plan.chroma_filter(taps, row, chroma_width);
+			lookup_row(plan, p, row, row, chroma_width);
+		}
+	}
+
+	// Rows without chroma of their own.
+	for (unsigned r = luma_begin; r < luma_end; ++r) {
+		if (!done[r - luma_begin])
+			unpack_row(r);
+	}
+}
+
+// Resampled color rows through the color matrix, then the lookup tables. NV
+// luma that is not written to the frame is converted from luma into a line
+// buffer for the matrix, or read as zero if skipped.
+void convert_planar_rows(const p2p_plan &plan, unsigned first, unsigned last, const void *luma, void * const dst[4])
+{
+	bool luma_line = plan.matrix && !dst[0];
+	std::vector<unsigned char> scratch(luma_line ? line_buffer_bytes(plan, plan.kernel_width) : 0);
+
+	for (unsigned r = first; r < last; ++r) {
+		void *rows[3];
+		for (unsigned p = 0; p < 3; ++p) {
+			rows[p] = dst[p] ? increment_ptr(dst[p], plan.dst_stride[p] * r) : nullptr;
+		}
+
+		if (luma_line && luma && plan.nv_plane)
+			plan.nv_plane(increment_ptr(luma, plan.src_stride[0] * r), scratch.data(), 0, 0, *plan.traits, plan.width, 1);
+		if (luma_line)
+			rows[0] = scratch.data();
+
+		if (plan.matrix)
+			plan.matrix(rows, rows, plan.kernel_width, plan.colors);
+		for (unsigned p = 0; p < 3; ++p) {
+			if (dst[p])
+				lookup_row(plan, p, rows[p], rows[p], plan.kernel_width);
+		}
+	}
+}
+
+// Interleaved rows are unpacked once into a cache of chroma line buffers,
+// filtered vertically for 4:2:0 NV packings, and upsampled into the frame.
+// Luma of other packings goes straight to the frame; NV luma follows strip by
+// strip.
+void unpack_rows_resampled(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+	const unsigned slots = 8;
+
+	unsigned chroma_width = (plan.kernel_width + 1) / 2;
+	size_t chroma_bytes = line_buffer_bytes(plan, chroma_width);
+
+	// Cached rows, then the vertically filtered row.
+	std::vector<unsigned char> scratch(2 * (slots + 1) * chroma_bytes);
+	unsigned tag[slots];
+	std::fill_n(tag, slots, UINT_MAX);
+
+	auto line = [&](unsigned slot, unsigned p) { return scratch.data() + (slot * 2 + p - 1) * chroma_bytes; };
+
+	unsigned packed_plane = traits.is_nv ? 1 : 0;
+	auto unpack_row = [&](unsigned r)
+	{
+		unsigned slot = r % slots;
+		if (tag[slot] == r)
+			return slot;
+
+		void *dst_p[4] = {
+			dst[0] && !traits.is_nv ? increment_ptr(dst[0], plan.dst_stride[0] * r) : dst[0],
+			line(slot, 1),
+			line(slot, 2),
+			dst[3] && !traits.is_nv ? increment_ptr(dst[3], plan.dst_stride[3] * r) : dst[3],
+		};
+		unpack_span(plan, increment_ptr(src[packed_plane], plan.src_stride[packed_plane] * r), dst_p, 0, plan.kernel_width);
+		tag[slot] = r;
+		return slot;
+	};
+
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	unsigned strip_rows = do_luma ? plan.strip_rows : row_end - row_begin;
+
+	for (unsigned i = row_begin; i < row_end; i += strip_rows) {
+		unsigned strip_end = std::min(i + strip_rows, row_end);
+		unsigned first, last;
+		nv_luma_range(plan, i, strip_end, &first, &last);
+
+		for (unsigned r = first; r < last; ++r) {
+			unsigned slot[2];
+
+			if (traits.subsample_h) {
+				unsigned c, n;
+				chroma_dest_rows(plan, r, &c, &n);
+				slot[0] = unpack_row(c);
+				slot[1] = plan.chroma_filter ? unpack_row(n) : slot[0];
+			} else {
+				slot[0] = slot[1] = unpack_row(r);
+			}
+
+			for (unsigned p = 1; p < 3; ++p) {
+				const void *line_p = line(slot[0], p);
+
+				if (slot[1] != slot[0]) {
+					const void *rows[2] = { line(slot[0], p), line(slot[1], p) };
+					plan.chroma_filter(rows, line(slots, p), chroma_width);
+					line_p = line(slots, p);
+				}
+				plan.chroma_h(line_p, increment_ptr(dst[p], plan.dst_stride[p] * r), (plan.width + 1) / 2, plan.kernel_width);
+			}
+			if ((plan.matrix || plan.lut) && !traits.is_nv)
+				convert_planar_rows(plan, r, r + 1, nullptr, dst);
+		}
+		if (do_luma)
+			convert_nv_luma(plan, i, strip_end, src[0], dst[0]);
+		if ((plan.matrix || plan.lut) && traits.is_nv) {
+			void * const planes[4] = { do_luma ? dst[0] : nullptr, dst[1], dst[2], dst[3] };
+			convert_planar_rows(plan, first, last, src[0], planes);
+		}
+	}
+}
+
+// Chroma of each packed row is filtered into line buffers, vertically then
+// horizontally, ahead of the pack kernel. NV luma follows strip by strip, or
+// is written from the converted rows as they are converted.
+void pack_rows_resampled(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+
+	// Interleaved rows, which are planar chroma rows unless resampled to 4:2:0.
+	unsigned first = row_begin;
+	unsigned last = row_end;
+	if (plan.chroma_420)
+		nv_luma_range(plan, row_begin, row_end, &first, &last);
+
+	// Vertical filters run at the planar width, which is the packed chroma
+	// width unless resampled from 4:4:4.
+	unsigned vertical_width = plan.chroma_444 ? plan.kernel_width : plan.kernel_width >> traits.subsample_w;
+	unsigned chroma_width = (plan.kernel_width + 1) / 2;
+	size_t vertical_bytes = line_buffer_bytes(plan, vertical_width);
+	size_t chroma_bytes = line_buffer_bytes(plan, chroma_width);
+
+	std::vector<unsigned char> scratch(2 * (vertical_bytes + chroma_bytes));
+	auto vertical_line = [&](unsigned p) { return scratch.data() + (p - 1) * vertical_bytes; };
+	auto chroma_line = [&](unsigned p) { return scratch.data() + 2 * vertical_bytes + (p - 1) * chroma_bytes; };
+
+	unsigned packed_plane = traits.is_nv ? 1 : 0;
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	unsigned strip_rows = do_luma ? plan.strip_rows : last - first;
+	int first_tap = plan.chroma_taps == 4 ? -1 : 0;
+
+	// Planar rows through the lookup tables and the color matrix, cached for
+	// the vertical taps, and dithered rows ahead of the pack kernel.
+	const unsigned slots = 8;
+	size_t planar_bytes = line_buffer_bytes(plan, plan.kernel_width);
+	std::vector<unsigned char> converted(plan.matrix || plan.lut || plan.dither ? 3 * slots * planar_bytes : 0);
+	unsigned tag[slots][3];
+	std::fill_n(&tag[0][0], slots * 3, UINT_MAX);
+	std::vector<unsigned char> dithered(plan.dither ? 3 * planar_bytes : 0);
+
+	unsigned luma_begin, luma_end;
+	nv_luma_range(plan, row_begin, row_end, &luma_begin, &luma_end);
+	bool luma_rows = traits.is_nv && (plan.matrix || plan.luts[0].entries || plan.dither);
+	std::vector<bool> done(luma_rows ? luma_end - luma_begin : 0);
+
+	auto planar_row = [&](unsigned p, unsigned row) -> const void *
+	{
+		if (!plan.matrix && !plan.luts[p].entries && !(p == 0 && luma_rows))
+			return increment_ptr(src[p], plan.src_stride[p] * row);
+
+		unsigned slot = row % slots;
+		auto line = [&](unsigned q) { return converted.data() + (slot * 3 + q) * planar_bytes; };
+
+		if (tag[slot][p] != row) {
+			// The matrix mixes the planes of a row, while tables keep to one.
+			unsigned q_begin = plan.matrix ? 0 : p;
+			unsigned q_end = plan.matrix ? 3 : p + 1;
+			const void *rows[3];
+			void *lines[3] = { line(0), line(1), line(2) };
+
+			for (unsigned q = q_begin; q < q_end; ++q) {
+				unsigned n = q ? vertical_width : plan.kernel_width;
+				rows[q] = increment_ptr(src[q], plan.src_stride[q] * row);
+				if (plan.luts[q].entries) {
+					plan.lut(rows[q], lines[q], n, plan.luts[q]);
+					rows[q] = lines[q];
+				}
+				tag[slot][q] = row;
+			}
+			if (plan.matrix)
+				plan.matrix(rows, lines, plan.kernel_width, plan.colors);
+
+			if (q_begin == 0 && luma_rows && row >= luma_begin && row < luma_end) {
+				const void *luma = plan.matrix ? lines[0] : rows[0];
+				if (plan.dither) {
+					plan.dither(luma, lines[0], plan.width, row, plan.dither_depth);
+					luma = lines[0];
+				}
+				if (do_luma)
+					plan.nv_plane(luma, increment_ptr(dst[0], plan.dst_stride[0] * row), 0, 0, traits, plan.width, 1);
+				done[row - luma_begin] = true;
+			}
+		}
+		return line(p);
+	};
+
+	for (unsigned i = first; i < last; i += strip_rows) {
+		unsigned strip_end = std::min(i + strip_rows, last);
+
+		for (unsigned r = i; r < strip_end; ++r) {
+			const void *src_p[4] = {
+				traits.is_nv ? src[0] : planar_row(0, r),
+				nullptr,
+				nullptr,
+				src[3] && !traits.is_nv ? increment_ptr(src[3], plan.src_stride[3] * r) : src[3],
+			};
+
+			for (unsigned p = 1; p < 3; ++p) {
+				const void *taps[4];
+				const void *line;
+
+				if (plan.chroma_420) {
+					unsigned c, n;
+					chroma_dest_rows(plan, r, &c, &n);
+					taps[0] = planar_row(p, c);
+					taps[1] = planar_row(p, n);
+					line = taps[0];
+				} else if (plan.chroma_taps) {
+					for (unsigned k = 0; k < plan.chroma_taps; ++k) {
+						taps[k] = planar_row(p, chroma_source_row(plan, r, first_tap + static_cast<int>(k)));
+					}
+					line = taps[0];
+				} else {
+					line = planar_row(p, r);
+				}
+
+				if (plan.chroma_filter) {
+					plan.chroma_filter(taps, vertical_line(p), vertical_width);
+					line = vertical_line(p);
+				}
+				if (plan.chroma_h) {
+					plan.chroma_h(line, chroma_line(p), plan.width, chroma_width);
+					line = chroma_line(p);
+				}
+				src_p[p] = line;
+			}
+			for (unsigned p = traits.is_nv ? 1 : 0; plan.dither && p < 3; ++p) {
+				unsigned n = p == 0 ? plan.kernel_width : plan.chroma_h ? chroma_width : vertical_width;
+				plan.dither(src_p[p], dithered.data() + p * planar_bytes, n, r, plan.dither_depth);
+				src_p[p] = dithered.data() + p * planar_bytes;
+			}
+			pack_span(plan, src_p, increment_ptr(dst[packed_plane], plan.dst_stride[packed_plane] * r), 0, plan.kernel_width);
+		}
+		if (do_luma && !luma_rows)
+			convert_nv_luma(plan, i, strip_end, src[0], dst[0]);
+	}
+
+	// Luma rows not read by any chroma tap, such as the last of an odd height.
+	for (unsigned row = luma_begin; row < luma_begin + done.size(); ++row) {
+		if (!done[row - luma_begin])
+			planar_row(0, row);
+	}
+}
+
+// Planar rows are converted in place as soon as the unpack kernel has written
+// them, by the color matrix, the lookup tables, and then alpha. Planes that the
+// caller does not want, but that the matrix or alpha reads, go to line buffers.
+// NV luma rows follow the chroma row that covers them.
+void unpack_rows_planar(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+	unsigned packed_plane = traits.is_nv ? 1 : 0;
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	size_t line_bytes = line_buffer_bytes(plan, plan.kernel_width);
+	std::vector<unsigned char> scratch(plan.matrix || plan.alpha ? 4 * line_bytes : 0);
+
+	void *lines[4] = {};
+	for (unsigned p = 0; p < 4 && !scratch.empty(); ++p) {
+		bool needed = p < 3 ? !traits.is_nv : !!plan.alpha;
+		lines[p] = needed && !dst[p] ? scratch.data() + p * line_bytes : nullptr;
+	}
+
+	for (unsigned r = row_begin; r < row_end; ++r) {
+		void *dst_p[4];
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = dst[p] && !(traits.is_nv && p == 0) ? increment_ptr(dst[p], plan.dst_stride[p] * r) : lines[p];
+		}
+		unpack_span(plan, increment_ptr(src[packed_plane], plan.src_stride[packed_plane] * r), dst_p, 0, plan.kernel_width);
+
+		if (plan.matrix)
+			plan.matrix(dst_p, dst_p, plan.kernel_width, plan.colors);
+
+		for (unsigned p = 0; plan.lut && p < 4; ++p) {
+			if (dst_p[p])
+				lookup_row(plan, p, dst_p[p], dst_p[p], planar_width(plan, p));
+		}
+
+		for (unsigned p = 0; plan.alpha && p < 3; ++p) {
+			plan.alpha(dst_p[p], dst_p[3], dst_p[p], plan.kernel_width, plan.alpha_scales[p]);
+		}
+
+		if (do_luma) {
+			convert_nv_luma(plan, r, r + 1, src[0], dst[0]);
+			lookup_nv_luma(plan, r, r + 1, dst[0]);
+		}
+	}
+}
+
+// Color rows are unpremultiplied, looked up, converted by the color matrix and
+// dithered into line buffers ahead of the pack kernel. NV luma rows follow the chroma
+// row that covers them.
+void pack_rows_planar(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+	unsigned packed_plane = traits.is_nv ? 1 : 0;
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+	size_t line_bytes = line_buffer_bytes(plan, plan.kernel_width);
+	std::vector<unsigned char> scratch(4 * line_bytes);
+	void *lines[4] = { scratch.data(), scratch.data() + line_bytes, scratch.data() + 2 * line_bytes, scratch.data() + 3 * line_bytes };
+
+	for (unsigned r = row_begin; r < row_end; ++r) {
+		const void *src_p[4];
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = src[p] && !(traits.is_nv && p == 0) ? increment_ptr(src[p], plan.src_stride[p] * r) : nullptr;
+		}
+
+		if (plan.alpha && src_p[3]) {
+			for (unsigned p = 0; p < 3; ++p) {
+				plan.alpha(src_p[p], src_p[3], lines[p], plan.kernel_width, plan.alpha_scales[p]);
+				src_p[p] = lines[p];
+			}
+		}
+		for (unsigned p = 0; p < 4; ++p) {
+			if (src_p[p] && plan.luts[p].entries) {
+				plan.lut(src_p[p], lines[p], planar_width(plan, p), plan.luts[p]);
+				src_p[p] = lines[p];
+			}
+		}
+		if (plan.matrix) {
+			plan.matrix(src_p, lines, plan.kernel_width, plan.colors);
+			std::copy_n(lines, 3, src_p);
+		}
+		for (unsigned p = 0; plan.dither && p < 3; ++p) {
+			if (src_p[p]) {
+				plan.dither(src_p[p], lines[p], planar_width(plan, p), r, plan.dither_depth);
+				src_p[p] = lines[p];
+			}
+		}
+		pack_span(plan, src_p, increment_ptr(dst[packed_plane], plan.dst_stride[packed_plane] * r), 0, plan.kernel_width);
+
+		if (do_luma) {
+			unsigned luma_begin, luma_end;
+			nv_luma_range(plan, r, r + 1, &luma_begin, &luma_end);
+
+			for (unsigned l = luma_begin; l < luma_end; ++l) {
+				const void *luma = increment_ptr(src[0], plan.src_stride[0] * l);
+				if (plan.luts[0].entries) {
+					plan.lut(luma, lines[0], plan.width, plan.luts[0]);
+					luma = lines[0];
+				}
+				if (plan.dither) {
+					plan.dither(luma, lines[0], plan.width, l, plan.dither_depth);
+					luma = lines[0];
+				}
+				plan.nv_plane(luma, increment_ptr(dst[0], plan.dst_stride[0] * l), 0, 0, traits, plan.width, 1);
+			}
+		}
+	}
+}
+
+// Resampled frames of a single row have no 4:2:0 chroma row, or no interleaved
+// row for NV packings, and only their luma is converted. Packing to 4:2:2 from
+// 4:2:0, and unpacking through the color matrix, need chroma that is not in the
+// frame, so such frames are left as they are.
+void execute_luma_rows(const p2p_plan &plan, const void * const src[4], void * const dst[4])
+{
+	bool do_luma = plan.nv_plane && src[0] && dst[0];
+
+	if (plan.chroma_420 && !plan.is_pack) {
+		unpack_rows_420(plan, 0, 0, src, dst);
+	} else if (plan.is_pack && plan.traits->is_nv && (plan.matrix || plan.luts[0].entries || plan.dither)) {
+		pack_rows_resampled(plan, 0, 0, src, dst);
+	} else if (do_luma && !plan.matrix) {
+		convert_nv_luma(plan, 0, 0, src[0], dst[0]);
+		if (!plan.is_pack)
+			lookup_nv_luma(plan, 0, 0, dst[0]);
+	}
+}
+
+void execute_rows(const p2p_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	if ((plan.chroma_420 || plan.chroma_444) && !plan.rows) {
+		execute_luma_rows(plan, src, dst);
+		return;
+	}
+
+	if ((plan.chroma_420 || plan.chroma_444) && plan.is_pack)
+		pack_rows_resampled(plan, row_begin, row_end, src, dst);
+	else if (plan.chroma_444)
+		unpack_rows_resampled(plan, row_begin, row_end, src, dst);
+	else if (plan.chroma_420)
+		unpack_rows_420(plan, row_begin, row_end, src, dst);
+	else if ((plan.alpha || plan.matrix || plan.lut) && !plan.is_pack)
+		unpack_rows_planar(plan, row_begin, row_end, src, dst);
+	else if ((plan.alpha && src[3]) || plan.matrix || plan.lut || plan.dither)
+		pack_rows_planar(plan, row_begin, row_end, src, dst);
+	else if (plan.is_pack)
+		pack_rows(plan, row_begin, row_end, src, dst);
+	else
+		unpack_rows(plan, row_begin, row_end, src, dst);
+
+	// The fence only orders the stores of the executing thread.
+	if (plan.stream)
+		store_fence();
+}
+
+void execute_band(const p2p_plan &plan, unsigned band, const void * const src[4], void * const dst[4])
+{
+	unsigned row_begin = std::min(band * plan.band_rows, plan.rows);
+	unsigned row_end = std::min(row_begin + plan.band_rows, plan.rows);
+	execute_rows(plan, row_begin, row_end, src, dst);
+}
+
+// Node local to the packed buffer, which is the one usually placed by a
+// capture or network device, or -1 for any node.
+int select_node(const p2p_plan &plan, const void * const src[4], void * const dst[4])
+{
+	unsigned p = plan.traits->is_nv ? 1 : 0;
+	return p2p::thread_pool::global().node_of(plan.is_pack ? dst[p] : src[p]);
+}
+
+void execute_bands(const p2p_plan &plan, int node, const void * const src[4], void * const dst[4])
+{
+	p2p::thread_pool::global().parallel_for(plan.num_bands, [&](unsigned band) { execute_band(plan, band, src, dst); }, plan.priority, node);
+}
+
+void execute_plan(const p2p_plan &plan, const void * const src[4], void * const dst[4])
+{
+	if (plan.threaded && plan.num_bands > 1)
+		execute_bands(plan, select_node(plan, src, dst), src, dst);
+	else
+		execute_rows(plan, 0, plan.rows, src, dst);
+}
+
+void execute_frame(const struct p2p_buffer_param *param, unsigned long flags, bool is_pack, const void * const *luts = nullptr)
+{
+	p2p_plan plan;
+	init_plan(plan, param, flags, is_pack, luts);
+
+	if (plan.threaded) {
+		int node = select_node(plan, param->src, param->dst);
+		partition_plan(plan, p2p::thread_pool::global().num_threads(node));
+		execute_bands(plan, node, param->src, param->dst);
+	} else {
+		execute_rows(plan, 0, plan.rows, param->src, param->dst);
+	}
+}
+
+// Plan whose destination planes are read back strip by strip while still in
+// the cache. Bands hold whole groups of align rows.
+void init_strip_plan(p2p_plan &plan, const struct p2p_buffer_param *param, unsigned long flags, bool is_pack, unsigned align)
+{
+	init_plan(plan, param, flags, is_pack);
+
+	// Streaming would evict the planes before they are read back.
+	if (plan.stream && is_pack)
+		plan.pack_2d = flags & P2P_ALPHA_SET_ONE ? plan.traits->pack_2d_one_fill : plan.traits->pack_2d;
+	else if (plan.stream)
+		plan.unpack_2d = plan.traits->unpack_2d;
+	plan.stream = false;
+
+	if (plan.threaded) {
+		partition_plan(plan, p2p::thread_pool::global().num_threads(select_node(plan, param->src, param->dst)));
+		plan.band_rows = (plan.band_rows + align - 1) / align * align;
+		plan.num_bands = std::max((plan.rows + plan.band_rows - 1) / plan.band_rows, 1U);
+	}
+}
+
+// Rows of a band are converted in strips that stay in the L2 cache, and each
+// strip is passed to the consumer before the next one is converted. Strips
+// hold whole groups of align rows.
+template <class Consumer>
+void execute_band_strips(const p2p_plan &plan, unsigned align, unsigned band, const void * const src[4], void * const dst[4], Consumer consume)
+{
+	size_t row_bytes = 2 * plan_frame_bytes(plan) / std::max(plan.rows, 1U);
+	size_t strip_rows = cache_sizes().l2 / 2 / std::max(row_bytes, static_cast<size_t>(1));
+	unsigned strip = static_cast<unsigned>(std::max(std::min(strip_rows, static_cast<size_t>(plan.rows)) / align * align, static_cast<size_t>(align)));
+
+	unsigned row_begin = std::min(band * plan.band_rows, plan.rows);
+	unsigned row_end = std::min(row_begin + plan.band_rows, plan.rows);
+
+	for (unsigned r = row_begin; r < row_end; r += strip) {
+		unsigned strip_end = std::min(r + strip, row_end);
+
+		execute_rows(plan, r, strip_end, src, dst);
+		consume(r, strip_end);
+	}
+}
+
+// The consumer also takes the band of the strip.
+template <class Consumer>
+void execute_frame_strips(const p2p_plan &plan, unsigned align, const void * const src[4], void * const dst[4], Consumer consume)
+{
+	auto func = [&](unsigned band)
+	{
+		execute_band_strips(plan, align, band, src, dst, [&](unsigned row_begin, unsigned row_end) { consume(band, row_begin, row_end); });
+	};
+
+	if (plan.threaded && plan.num_bands > 1)
+		p2p::thread_pool::global().parallel_for(plan.num_bands, func, plan.priority, select_node(plan, src, dst));
+	else
+		func(0);
+}
+
+// Planar rows of a plane for a range of interleaved rows.
+void planar_plane_rows(const p2p_plan &plan, unsigned p, unsigned row_begin, unsigned row_end, unsigned *begin, unsigned *end)
+{
+	bool chroma = p == 1 || p == 2;
+	unsigned shift = !chroma || (plan.chroma_444 && plan.traits->subsample_h) ? plan.subsample_h : 0;
+
+	*begin = row_begin << shift;
+	*end = row_end == plan.rows ? (shift ? plan.height : plan.rows) : row_end << shift;
+}
+
+// Samples in a row of a planar plane, without padding.
+unsigned planar_plane_width(const p2p_plan &plan, unsigned p)
+{
+	const packing_traits &traits = *plan.traits;
+	return (p == 1 || p == 2) && !plan.chroma_444 ? (plan.width + traits.subsample_w) >> traits.subsample_w : plan.width;
+}
+
+// Whether the unpack writes a planar plane. NV luma needs both of its planes.
+bool writes_plane(const p2p_plan &plan, unsigned p, const void * const src[4], void * const dst[4])
+{
+	const packing_traits &traits = *plan.traits;
+	return dst[p] && (p != 0 || !traits.is_nv || (plan.nv_plane && src[0])) && (p != 3 || traits.has_alpha);
+}
+
+// Box filters of a preview, for whole and partial boxes.
+struct preview_filter {
+	const p2p_preview_param *param;
+	box_filter_func full;
+	box_rows_func rows;
+};
+
+// Filters the planar rows of whole boxes just written for the interleaved
+// rows, which start on a box boundary and end on one or at the frame end.
+void preview_rows(const p2p_plan &plan, const preview_filter &filter, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const p2p_preview_param &preview = *filter.param;
+	unsigned scale = preview.scale;
+
+	for (unsigned p = 0; p < 4; ++p) {
+		if (!writes_plane(plan, p, src, dst) || !preview.dst[p])
+			continue;
+
+		unsigned width = planar_plane_width(plan, p);
+		unsigned begin, end;
+		planar_plane_rows(plan, p, row_begin, row_end, &begin, &end);
+
+		for (unsigned r = begin; r < end; r += scale) {
+			unsigned rows = std::min(scale, end - r);
+			const void *src_p[4];
+			for (unsigned k = 0; k < rows; ++k) {
+				src_p[k] = increment_ptr(dst[p], plan.dst_stride[p] * (r + k));
+			}
+
+			void *dst_p = increment_ptr(preview.dst[p], preview.dst_stride[p] * (r / scale));
+			if (rows == scale && filter.full)
+				filter.full(src_p, dst_p, width);
+			else
+				filter.rows(src_p, rows, dst_p, width, scale);
+		}
+	}
+}
+
+// Strips and bands hold whole boxes of every preview.
+int unpack_frame_preview(const struct p2p_buffer_param *param, const p2p_preview_param *previews, unsigned count, unsigned long flags)
+{
+	unsigned align = 1;
+	for (unsigned i = 0; i < count; ++i) {
+		if (previews[i].scale != 2 && previews[i].scale != 4)
+			return -1;
+		align = std::max(align, previews[i].scale);
+	}
+
+	p2p_plan plan;
+	init_strip_plan(plan, param, flags, false, align);
+
+	std::vector<preview_filter> filters(count);
+	for (unsigned i = 0; i < count; ++i) {
+		filters[i] = { &previews[i], select_box_filter(previews[i].scale, *plan.traits, flags), select_box_rows(*plan.traits, flags) };
+	}
+
+	execute_frame_strips(plan, align, param->src, param->dst, [&](unsigned, unsigned row_begin, unsigned row_end)
+	{
+		for (const preview_filter &filter : filters) {
+			preview_rows(plan, filter, row_begin, row_end, param->src, param->dst);
+		}
+	});
+	return 0;
+}
+
+// Statistics of the planes over some rows, added to those of the caller once
+// the rows are done. Integer samples also go to the histograms, if any.
+struct band_stats {
+	sample_stats ints[4];
+	fp_stats fp[4];
+	unsigned long long count[4];
+	unsigned long long *histograms[4];
+};
+
+void init_band_stats(band_stats &band, unsigned long long * const histograms[4])
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		band.ints[p] = { UINT32_MAX, 0, 0 };
+		band.fp[p] = { INFINITY, -INFINITY, 0.0 };
+		band.count[p] = 0;
+		band.histograms[p] = histograms[p];
+	}
+}
+
+void stats_rows(const p2p_plan &plan, const stats_kernels &kernels, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4],
+                band_stats &band)
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		if (!writes_plane(plan, p, src, dst))
+			continue;
+
+		unsigned width = planar_plane_width(plan, p);
+		unsigned begin, end;
+		planar_plane_rows(plan, p, row_begin, row_end, &begin, &end);
+
+		for (unsigned r = begin; r < end; ++r) {
+			const void *row = increment_ptr(dst[p], plan.dst_stride[p] * r);
+
+			if (kernels.fp) {
+				kernels.fp(row, width, band.fp[p]);
+			} else {
+				kernels.ints(row, width, band.ints[p]);
+				if (band.histograms[p])
+					kernels.histogram(row, width, kernels.masks[p], band.histograms[p]);
+			}
+		}
+		band.count[p] += static_cast<unsigned long long>(width) * (end - begin);
+	}
+}
+
+void merge_stats(const band_stats &band, bool fp, struct p2p_plane_stats stats[4])
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		if (!band.count[p])
+			continue;
+
+		double min = fp ? band.fp[p].min : band.ints[p].min;
+		double max = fp ? band.fp[p].max : band.ints[p].max;
+		double sum = fp ? band.fp[p].sum : static_cast<double>(band.ints[p].sum);
+
+		stats[p].min = stats[p].count ? std::min(stats[p].min, min) : min;
+		stats[p].max = stats[p].count ? std::max(stats[p].max, max) : max;
+		stats[p].sum += sum;
+		stats[p].count += band.count[p];
+	}
+}
+
+// Bands other than the first count into their own histograms, which are
+// added to the caller's at the end.
+void unpack_frame_stats(const struct p2p_buffer_param *param, struct p2p_plane_stats stats[4], unsigned long flags)
+{
+	p2p_plan plan;
+	init_strip_plan(plan, param, flags, false, 1);
+
+	const stats_kernels &kernels = plan.stats;
+	std::vector<band_stats> bands(plan.num_bands);
+	std::vector<std::vector<unsigned long long>> partials(4 * plan.num_bands);
+
+	for (unsigned band = 0; band < plan.num_bands; ++band) {
+		unsigned long long *histograms[4] = {};
+		for (unsigned p = 0; p < 4; ++p) {
+			if (!stats[p].histogram || kernels.fp)
+				continue;
+			if (band) {
+				partials[band * 4 + p].resize(static_cast<size_t>(kernels.masks[p]) + 1);
+				histograms[p] = partials[band * 4 + p].data();
+			} else {
+				histograms[p] = stats[p].histogram;
+			}
+		}
+		init_band_stats(bands[band], histograms);
+	}
+
+	execute_frame_strips(plan, 1, param->src, param->dst, [&](unsigned band, unsigned row_begin, unsigned row_end)
+	{
+		stats_rows(plan, kernels, row_begin, row_end, param->src, param->dst, bands[band]);
+	});
+
+	for (unsigned band = 0; band < plan.num_bands; ++band) {
+		merge_stats(bands[band], !!kernels.fp, stats);
+		for (unsigned p = 0; p < 4; ++p) {
+			const std::vector<unsigned long long> &partial = partials[band * 4 + p];
+			for (size_t i = 0; i < partial.size(); ++i) {
+				stats[p].histogram[i] += partial[i];
+			}
+		}
+	}
+}
+
+void execute_band_stats(const p2p_plan &plan, unsigned band, const void * const src[4], void * const dst[4], struct p2p_plane_stats stats[4])
+{
+	const stats_kernels &kernels = plan.stats;
+	unsigned long long *histograms[4];
+	for (unsigned p = 0; p < 4; ++p) {
+		histograms[p] = stats[p].histogram;
+	}
+
+	band_stats partial;
+	init_band_stats(partial, histograms);
+	execute_band_strips(plan, 1, band, src, dst, [&](unsigned row_begin, unsigned row_end)
+	{
+		stats_rows(plan, kernels, row_begin, row_end, src, dst, partial);
+	});
+	merge_stats(partial, !!kernels.fp, stats);
+}
+
+// Destination rows of a plane for a range of interleaved rows, and the bytes
+// in each row without padding. Returns false if the plane is not written.
+bool destination_rows(const p2p_plan &plan, unsigned p, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4],
+                      unsigned *begin, unsigned *end, size_t *bytes)
+{
+	const packing_traits &traits = *plan.traits;
+
+	if (!plan.is_pack) {
+		if (!writes_plane(plan, p, src, dst))
+			return false;
+		planar_plane_rows(plan, p, row_begin, row_end, begin, end);
+		*bytes = static_cast<size_t>(planar_plane_width(plan, p)) * plan.planar_bytes;
+	} else if (traits.is_nv && p == 0) {
+		if (!plan.nv_plane || !src[0] || !dst[0])
+			return false;
+		nv_luma_range(plan, row_begin, row_end, begin, end);
+		*bytes = planar_linesize(traits, plan.width, 0);
+	} else if (p == (traits.is_nv ? 1U : 0U)) {
+		if (plan.chroma_420) {
+			nv_luma_range(plan, row_begin, row_end, begin, end);
+		} else {
+			*begin = row_begin;
+			*end = row_end;
+		}
+		*bytes = packed_linesize(traits, plan.width);
+	} else {
+		return false;
+	}
+	return true;
+}
+
+// Checksums of the destination planes over some rows. CRCs start from zero
+// for each band, and are combined in band order once the bands are done.
+struct band_hash {
+	uint32_t crc[4];
+	unsigned long long bytes[4];
+	xxh64_state xxh[4];
+};
+
+void init_band_hash(band_hash &band)
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		band.crc[p] = 0;
+		band.bytes[p] = 0;
+		xxh64_init(band.xxh[p]);
+	}
+}
+
+void hash_rows(const p2p_plan &plan, p2p_hash type, crc32c_func crc32c, unsigned row_begin, unsigned row_end,
+               const void * const src[4], void * const dst[4], band_hash &band)
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		unsigned begin, end;
+		size_t bytes;
+		if (!destination_rows(plan, p, row_begin, row_end, src, dst, &begin, &end, &bytes))
+			continue;
+
+		for (unsigned r = begin; r < end; ++r) {
+			const void *row = increment_ptr(dst[p], plan.dst_stride[p] * r);
+
+			if (type == p2p_hash_crc32c)
+				band.crc[p] = crc32c(band.crc[p], row, bytes);
+			else
+				xxh64_update(band.xxh[p], row, bytes);
+		}
+		band.bytes[p] += static_cast<unsigned long long>(bytes) * (end - begin);
+	}
+}
+
+void execute_frame_hash(const struct p2p_buffer_param *param, p2p_hash type, struct p2p_frame_hash *hash, unsigned long flags, bool is_pack)
+{
+	p2p_plan plan;
+	init_strip_plan(plan, param, flags, is_pack, 1);
+
+	crc32c_func crc32c = select_crc32c();
+	std::vector<band_hash> bands(plan.num_bands);
+	for (band_hash &band : bands) {
+		init_band_hash(band);
+	}
+
+	// XXH64 states cannot be combined, so concurrent bands leave the hashing
+	// to a pass over the whole frame.
+	if (type == p2p_hash_xxh64 && plan.threaded && plan.num_bands > 1) {
+		execute_plan(plan, param->src, param->dst);
+		hash_rows(plan, type, crc32c, 0, plan.rows, param->src, param->dst, bands[0]);
+	} else {
+		execute_frame_strips(plan, 1, param->src, param->dst, [&](unsigned band, unsigned row_begin, unsigned row_end)
+		{
+			hash_rows(plan, type, crc32c, row_begin, row_end, param->src, param->dst, bands[band]);
+		});
+	}
+
+	unsigned char planes[4 * 8];
+	size_t planes_bytes = 0;
+
+	for (unsigned p = 0; p < 4; ++p) {
+		unsigned begin, end;
+		size_t bytes;
+		hash->plane[p] = 0;
+		if (!destination_rows(plan, p, 0, plan.rows, param->src, param->dst, &begin, &end, &bytes))
+			continue;
+
+		if (type == p2p_hash_crc32c) {
+			uint32_t crc = 0;
+			for (const band_hash &band : bands) {
+				crc = crc32c_combine(crc, band.crc[p], band.bytes[p]);
+			}
+			hash->plane[p] = crc;
+		} else {
+			hash->plane[p] = xxh64_digest(bands[0].xxh[p]);
+		}
+
+		for (unsigned k = 0; k < 8; ++k) {
+			planes[planes_bytes++] = static_cast<unsigned char>(hash->plane[p] >> (8 * k));
+		}
+	}
+
+	if (type == p2p_hash_crc32c) {
+		hash->frame = crc32c(0, planes, planes_bytes);
+	} else {
+		xxh64_state frame;
+		xxh64_init(frame);
+		xxh64_update(frame, planes, planes_bytes);
+		hash->frame = xxh64_digest(frame);
+	}
+}
+
+p2p_plan *create_plan(const struct p2p_buffer_param *param, unsigned long flags, bool is_pack, const void * const *luts = nullptr)
+{
+	p2p_plan *plan = new (std::nothrow) p2p_plan;
+	if (plan) {
+		static const unsigned threads = std::max(std::thread::hardware_concurrency(), 1U);
+
+		init_plan(*plan, param, flags, is_pack, luts);
+		partition_plan(*plan, threads);
+	}
+	return plan;
+}
+
+void execute_batch(const struct p2p_buffer_param *params, unsigned count, unsigned long flags, bool is_pack)
+{
+	// Frames [first, last) in kernel order, restricted to rows [row_begin, row_end).
+	struct task {
+		unsigned first;
+		unsigned last;
+		unsigned row_begin;
+		unsigned row_end;
+	};
+
+	p2p::thread_pool &pool = p2p::thread_pool::global();
+
+	std::vector<p2p_plan> plans(count);
+	std::vector<unsigned> order(count);
+	std::vector<task> tasks;
+
+	for (unsigned i = 0; i < count; ++i) {
+		init_plan(plans[i], &params[i], flags, is_pack);
+	}
+
+	// Group frames sharing a kernel.
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return params[a].packing < params[b].packing; });
+
+	// Without threads, frames are converted in turn on the calling thread.
+	if (!(flags & P2P_USE_THREADS)) {
+		for (unsigned k = 0; k < count; ++k) {
+			execute_rows(plans[order[k]], 0, plans[order[k]].rows, params[order[k]].src, params[order[k]].dst);
+		}
+		return;
+	}
+
+	// Split large frames into bands and merge runs of small frames.
+	size_t run_bytes = 0;
+
+	for (unsigned k = 0; k < count; ++k) {
+		p2p_plan &plan = plans[order[k]];
+		size_t frame_bytes = plan_frame_bytes(plan);
+
+		if (frame_bytes >= min_band_bytes) {
+			partition_plan(plan, pool.num_threads());
+
+			for (unsigned band = 0; band < plan.num_bands; ++band) {
+				tasks.push_back({ k, k + 1, band * plan.band_rows, std::min((band + 1) * plan.band_rows, plan.rows) });
+			}
+			run_bytes = 0;
+		} else if (run_bytes && run_bytes < min_band_bytes && plans[order[k - 1]].traits == plan.traits) {
+			tasks.back().last = k + 1;
+			run_bytes += frame_bytes;
+		} else {
+			tasks.push_back({ k, k + 1, 0, plan.rows });
+			run_bytes = std::max(frame_bytes, static_cast<size_t>(1));
+		}
+	}
+
+	p2p::thread_pool::priority priority = count ? plans[0].priority : p2p::thread_pool::normal;
+
+	pool.parallel_for(static_cast<unsigned>(tasks.size()), [&](unsigned idx)
+	{
+		const task &t = tasks[idx];
+
+		for (unsigned k = t.first; k < t.last; ++k) {
+			const p2p_plan &plan = plans[order[k]];
+			const struct p2p_buffer_param &param = params[order[k]];
+			unsigned row_end = t.last - t.first > 1 ? plan.rows : t.row_end;
+
+			execute_rows(plan, t.row_begin, row_end, param.src, param.dst);
+		}
+	}, priority);
+}
+
+p2p_job *submit_job(const struct p2p_buffer_param *param, unsigned long flags, bool is_pack, p2p_job_callback callback, void *user)
+{
+	p2p_job *job = new (std::nothrow) p2p_job;
+	if (!job)
+		return nullptr;
+
+	p2p_plan plan;
+	init_plan(plan, param, flags, is_pack);
+
+	p2p::thread_pool &pool = p2p::thread_pool::global();
+	int node = select_node(plan, param->src, param->dst);
+	partition_plan(plan, pool.num_threads(node));
+
+	struct p2p_buffer_param buffers = *param;
+	auto func = [=](unsigned band)
+	{
+		execute_band(plan, band, buffers.src, buffers.dst);
+	};
+	auto complete = [=](bool cancelled)
+	{
+		if (callback)
+			callback(user, cancelled ? P2P_JOB_CANCELLED : P2P_JOB_COMPLETE);
+	};
+
+	job->pool = &pool;
+	job->task = pool.submit(plan.num_bands, func, complete, plan.priority, node);
+	return job;
+}
+
+using p2p::detail::byte_transform;
+
+// Single-pass transform equivalent to a conversion between two packings.
+struct fused_transform {
+	bool valid;
+	byte_transform t;
+};
+
+const bool host_is_le = std::is_same<p2p::native_endian_t, p2p::little_endian_t>::value;
+
+void set_identity(uint8_t shuffle[16])
+{
+	for (unsigned i = 0; i < 16; ++i) {
+		shuffle[i] = static_cast<uint8_t>(i);
+	}
+}
+
+// Exchange the bytes of each 16-bit lane.
+void set_lane_swap(uint8_t shuffle[16])
+{
+	for (unsigned i = 0; i < 16; ++i) {
+		shuffle[i] = static_cast<uint8_t>(i ^ 1);
+	}
+}
+
+uint16_t load_le16(const uint8_t *p, bool swap)
+{
+	return swap ? (p[0] << 8) | p[1] : p[0] | (p[1] << 8);
+}
+
+// Match each destination byte to a source byte, as for component reorders
+// and byte swaps at the same depth.
+bool match_bytes(const std::vector<uint8_t> &src, const std::vector<uint8_t> &dst, unsigned bytes_per_pack, byte_transform &t)
+{
+	unsigned packs = static_cast<unsigned>(src.size() / bytes_per_pack);
+
+	for (unsigned j = 0; j < bytes_per_pack; ++j) {
+		unsigned k;
+
+		for (k = 0; k < bytes_per_pack; ++k) {
+			bool match = true;
+			for (unsigned n = 0; n < packs && match; ++n) {
+				match = dst[n * bytes_per_pack + j] == src[n * bytes_per_pack + k];
+			}
+			if (match)
+				break;
+		}
+		if (k == bytes_per_pack)
+			return false;
+
+		uint8_t mask = 0;
+		for (unsigned n = 0; n < packs; ++n) {
+			mask |= dst[n * bytes_per_pack + j];
+		}
+
+		for (unsigned i = j; i < 16; i += bytes_per_pack) {
+			t.shuffle[i] = static_cast<uint8_t>(i - j + k);
+			t.mask[i] = mask;
+		}
+	}
+
+	set_identity(t.shuffle_out);
+	t.shift_right = 0;
+	t.shift_left = 0;
+	return true;
+}
+
+// Find the source word and byte order producing a destination word.
+bool match_word(const std::vector<uint8_t> &src, const std::vector<uint8_t> &dst, unsigned bytes_per_pack, unsigned j,
+                bool swap_out, unsigned shift_right, unsigned shift_left, uint16_t mask, unsigned *k_out, bool *swap_in_out)
+{
+	unsigned packs = static_cast<unsigned>(src.size() / bytes_per_pack);
+
+	for (unsigned k = 0; k < bytes_per_pack / 2; ++k) {
+		for (bool swap_in : { false, true }) {
+			bool match = true;
+			for (unsigned n = 0; n < packs && match; ++n) {
+				uint16_t x = load_le16(&src[n * bytes_per_pack + k * 2], swap_in);
+				uint16_t y = load_le16(&dst[n * bytes_per_pack + j * 2], swap_out);
+				match = static_cast<uint16_t>((x >> shift_right) << shift_left & mask) == y;
+			}
+			if (match) {
+				*k_out = k;
+				*swap_in_out = swap_in;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Match each destination word to a shifted source word, as for changes of
+// endianness and alignment of 16-bit samples.
+bool match_words(const std::vector<uint8_t> &src, const std::vector<uint8_t> &dst, unsigned bytes_per_pack, byte_transform &t)
+{
+	unsigned packs = static_cast<unsigned>(src.size() / bytes_per_pack);
+	unsigned words = bytes_per_pack / 2;
+
+	for (bool swap_out : { false, true }) {
+		for (unsigned shift_right = 0; shift_right < 16; ++shift_right) {
+			for (unsigned shift_left = 0; shift_left < 16; ++shift_left) {
+				unsigned j;
+
+				for (j = 0; j < words; ++j) {
+					uint16_t mask = 0;
+					for (unsigned n = 0; n < packs; ++n) {
+						mask |= load_le16(&dst[n * bytes_per_pack + j * 2], swap_out);
+					}
+
+					unsigned k;
+					bool swap_in;
+					if (!match_word(src, dst, bytes_per_pack, j, swap_out, shift_right, shift_left, mask, &k, &swap_in))
+						break;
+
+					for (unsigned i = j * 2; i < 16; i += bytes_per_pack) {
+						unsigned base = i - j * 2 + k * 2;
+						t.shuffle[i] = static_cast<uint8_t>(base + swap_in);
+						t.shuffle[i + 1] = static_cast<uint8_t>(base + !swap_in);
+						t.mask[i] = static_cast<uint8_t>(mask);
+						t.mask[i + 1] = static_cast<uint8_t>(mask >> 8);
+					}
+				}
+				if (j < words)
+					continue;
+
+				if (swap_out)
+					set_lane_swap(t.shuffle_out);
+				else
+					set_identity(t.shuffle_out);
+				t.shift_right = static_cast<uint8_t>(shift_right);
+				t.shift_left = static_cast<uint8_t>(shift_left);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Detect single-pass conversions by converting random packs and matching
+// the result to the source. Padding bits of the source are cleared by the
+// mask, so that the result is identical to the two-pass conversion.
+fused_transform probe_transform(const packing_traits &src, const packing_traits &dst, bool alpha_one_fill)
+{
+	fused_transform fused = {};
+
+	unsigned bytes_per_pack = src.bytes_per_pack;
+	if (src.is_nv != dst.is_nv || src.pel_per_pack != dst.pel_per_pack || bytes_per_pack != dst.bytes_per_pack || 16 % bytes_per_pack)
+		return fused;
+
+	const unsigned packs = 64;
+	unsigned width = packs * src.pel_per_pack;
+	size_t plane_bytes = static_cast<size_t>(width) * src.bytes_per_sample;
+
+	std::vector<uint8_t> planar(4 * plane_bytes);
+	std::vector<uint8_t> packed(packs * bytes_per_pack);
+	std::vector<uint8_t> converted(packs * bytes_per_pack);
+	void *unpack_planes[4] = { &planar[0], &planar[plane_bytes], &planar[2 * plane_bytes], &planar[3 * plane_bytes] };
+	const void *pack_planes[4] = { unpack_planes[0], unpack_planes[1], unpack_planes[2], src.has_alpha ? unpack_planes[3] : nullptr };
+
+	uint32_t seed = 0x9E3779B9;
+	for (uint8_t &x : packed) {
+		seed = seed * 1664525 + 1013904223;
+		x = static_cast<uint8_t>(seed >> 24);
+	}
+
+	// Clear the padding bits of the source, as the two-pass conversion would.
+	src.unpack(packed.data(), unpack_planes, 0, width);
+	src.pack(pack_planes, packed.data(), 0, width);
+
+	src.unpack(packed.data(), unpack_planes, 0, width);
+	(alpha_one_fill ? dst.pack_one_fill : dst.pack)(pack_planes, converted.data(), 0, width);
+
+	fused.valid = match_bytes(packed, converted, bytes_per_pack, fused.t) ||
+		(src.bytes_per_sample == 2 && match_words(packed, converted, bytes_per_pack, fused.t));
+	return fused;
+}
+
+const fused_transform &find_transform(const packing_traits &src, const packing_traits &dst, bool alpha_one_fill)
+{
+	static std::mutex mutex;
+	static std::map<std::tuple<int, int, bool>, fused_transform> cache;
+
+	std::lock_guard<std::mutex> lock{ mutex };
+	auto key = std::make_tuple(static_cast<int>(src.packing), static_cast<int>(dst.packing), alpha_one_fill);
+	auto it = cache.find(key);
+	if (it == cache.end())
+		it = cache.emplace(key, probe_transform(src, dst, alpha_one_fill)).first;
+	return it->second;
+}
+
+// Transform of the NV luma plane, which is stored as plain samples.
+byte_transform nv_luma_transform(const packing_traits &src, const packing_traits &dst)
+{
+	byte_transform t;
+
+	if (src.bytes_per_sample == 2 && src.native_endian != host_is_le)
+		set_lane_swap(t.shuffle);
+	else
+		set_identity(t.shuffle);
+	if (dst.bytes_per_sample == 2 && dst.native_endian != host_is_le)
+		set_lane_swap(t.shuffle_out);
+	else
+		set_identity(t.shuffle_out);
+
+	std::fill_n(t.mask, 16, 0xFF);
+	t.shift_right = src.nv_shift;
+	t.shift_left = dst.nv_shift;
+	return t;
+}
+
+bool is_identity(const byte_transform &t)
+{
+	uint8_t identity[16];
+	set_identity(identity);
+
+	return !memcmp(t.shuffle, identity, 16) && !memcmp(t.shuffle_out, identity, 16) && !t.shift_right && !t.shift_left &&
+		std::all_of(t.mask, t.mask + 16, [](uint8_t x) { return x == 0xFF; });
+}
+
+typedef void (*transform_func)(const void *src, void *dst, size_t n, const byte_transform &t);
+
+void transform_bytes_c(const void *src, void *dst, size_t n, const byte_transform &t)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+
+	for (size_t i = 0; i < n; i += 16) {
+		size_t m = std::min(n - i, static_cast<size_t>(16));
+		uint8_t tmp[16] = {};
+		uint8_t x[16];
+
+		// Source and destination may alias.
+		memcpy(tmp, src_p + i, m);
+		for (unsigned j = 0; j < 16; ++j) {
+			x[j] = tmp[t.shuffle[j]];
+		}
+		for (unsigned j = 0; j < 16; j += 2) {
+			uint16_t w = static_cast<uint16_t>(((x[j] | (x[j + 1] << 8)) >> t.shift_right) << t.shift_left);
+			x[j] = static_cast<uint8_t>(w) & t.mask[j];
+			x[j + 1] = static_cast<uint8_t>(w >> 8) & t.mask[j + 1];
+		}
+		for (size_t j = 0; j < m; ++j) {
+			dst_p[i + j] = x[t.shuffle_out[j]];
+		}
+	}
+}
+
+transform_func select_transform_func()
+{
+#ifdef P2P_SIMD
+	static const transform_func simd_func = p2p::detail::search_transform_func();
+	if (simd_func)
+		return simd_func;
+#endif
+	return transform_bytes_c;
+}
+
+/**
+ * Packed-to-packed frame conversion.
+ *
+ * Conversions that only move or shift bytes run in a single pass. Others
+ * unpack strips of rows into a planar buffer sized to the L2 cache and pack
+ * them at once. Both may run in place if the packings have the same pack size.
+ */
+struct convert_plan {
+	const fused_transform *fused; // Single-pass transform, or null.
+	byte_transform luma;          // Likewise for the NV luma plane.
+	bool convert_luma;
+	p2p_plan unpack;              // Source to strip buffer.
+	p2p_plan pack;                // Strip buffer to destination.
+	unsigned strip_rows;
+	ptrdiff_t scratch_stride[4];
+	size_t scratch_offset[4];     // Plane offsets in the strip buffer, or SIZE_MAX if unused.
+	size_t scratch_bytes;
+};
+
+// Rows of a plane covered by a range of interleaved rows.
+unsigned plane_row(const p2p_plan &plan, unsigned p, unsigned row)
+{
+	return p == 0 || p == 3 ? row << plan.subsample_h : row;
+}
+
+// Restrict a plan to rows [row_begin, row_end).
+p2p_plan slice_plan(const p2p_plan &plan, unsigned row_begin, unsigned row_end)
+{
+	unsigned luma_begin, luma_end;
+	nv_luma_range(plan, row_begin, row_end, &luma_begin, &luma_end);
+
+	p2p_plan slice = plan;
+	slice.rows = row_end - row_begin;
+	slice.height = luma_end - luma_begin;
+	return slice;
+}
+
+template <class T>
+void offset_planes(const p2p_plan &plan, const ptrdiff_t stride[4], unsigned row, T * const in[4], T *out[4])
+{
+	for (unsigned p = 0; p < 4; ++p) {
+		out[p] = in[p] ? increment_ptr(in[p], stride[p] * plane_row(plan, p, row)) : nullptr;
+	}
+}
+
+bool init_convert_plan(convert_plan &plan, const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags)
+{
+	// Range conversion on both sides would cancel out, as would resampling,
+	// premultiplication, and color matrices.
+	flags &= ~(range_flags | chroma_flags | P2P_ALPHA_PREMULTIPLIED | matrix_flags);
+
+	const packing_traits &src = lookup_traits(param->packing, flags);
+	const packing_traits &dst = lookup_traits(dst_packing, flags);
+
+	// Rescaling through wider samples also bridges different sample sizes.
+	bool rescale = !!(flags & planar_type_flags);
+
+	if ((!rescale && src.bytes_per_sample != dst.bytes_per_sample) || src.subsample_w != dst.subsample_w || src.subsample_h != dst.subsample_h)
+		return false;
+
+	// Strip buffer rows, with room for padded kernels.
+	bool has_alpha = src.has_alpha && dst.has_alpha;
+	unsigned width = param->width;
+
+	for (unsigned p = 0; p < 4; ++p) {
+		size_t linesize = planar_linesize(src, width, p, planar_sample_bytes(src, flags)) + max_overrun_bytes;
+		plan.scratch_stride[p] = (linesize + 63) & ~static_cast<size_t>(63);
+	}
+
+	// The luma of an NV source is only skipped if the destination is NV too.
+	unsigned long unpack_flags = flags & ~P2P_STREAMING_STORES;
+	if (!dst.is_nv)
+		unpack_flags &= ~P2P_SKIP_UNPACKED_PLANES;
+
+	struct p2p_buffer_param unpack_param = *param;
+	std::copy_n(plan.scratch_stride, 4, unpack_param.dst_stride);
+	init_plan(plan.unpack, &unpack_param, unpack_flags, false);
+
+	// Only the destination is worth streaming.
+	if (plan.unpack.stream)
+		plan.unpack.unpack_2d = src.unpack_2d;
+	plan.unpack.stream = false;
+
+	struct p2p_buffer_param pack_param = *param;
+	pack_param.packing = dst_packing;
+	std::copy_n(plan.scratch_stride, 4, pack_param.src_stride);
+	std::copy_n(param->dst_stride, 4, pack_param.dst_stride);
+	init_plan(plan.pack, &pack_param, flags, true);
+
+	// Strips keep the source, destination, and planar rows in half of the L2.
+	size_t scratch_row = 2 * plan.scratch_stride[1] + (static_cast<size_t>(plan.scratch_stride[0]) << src.subsample_h) * (has_alpha ? 2 : 1);
+	size_t row_bytes = packed_linesize(src, width) + packed_linesize(dst, width) + scratch_row;
+	if (src.is_nv)
+		row_bytes += planar_linesize(src, width, 0) << src.subsample_h;
+	if (dst.is_nv)
+		row_bytes += planar_linesize(dst, width, 0) << dst.subsample_h;
+
+	size_t strip_rows = cache_sizes().l2 / 2 / row_bytes;
+	plan.strip_rows = static_cast<unsigned>(std::min(std::max(strip_rows, static_cast<size_t>(1)), static_cast<size_t>(std::max(plan.pack.rows, 1U))));
+
+	plan.scratch_bytes = 0;
+	for (unsigned p = 0; p < 4; ++p) {
+		if (p == 3 && !has_alpha) {
+			plan.scratch_offset[p] = SIZE_MAX;
+			continue;
+		}
+		// The last strip of an odd-height frame has an extra luma row.
+		unsigned rows = p == 1 || p == 2 ? plan.strip_rows : (plan.strip_rows << src.subsample_h) + src.subsample_h;
+
+		plan.scratch_offset[p] = plan.scratch_bytes;
+		plan.scratch_bytes += static_cast<size_t>(plan.scratch_stride[p]) * rows;
+	}
+
+	const fused_transform *fused = rescale ? nullptr : &find_transform(src, dst, !!(flags & P2P_ALPHA_SET_ONE));
+
+	plan.fused = fused && fused->valid ? fused : nullptr;
+	plan.luma = nv_luma_transform(src, dst);
+	plan.convert_luma = src.is_nv && !(flags & P2P_SKIP_UNPACKED_PLANES);
+	return true;
+}
+
+void transform_plane(const void *src, void *dst, ptrdiff_t src_stride, ptrdiff_t dst_stride, size_t linesize, unsigned height, const byte_transform &t)
+{
+	static const transform_func transform = select_transform_func();
+
+	if (is_identity(t)) {
+		if (src != dst)
+			copy_plane_fast(src, dst, src_stride, dst_stride, static_cast<unsigned>(linesize), height);
+	} else if (src_stride == static_cast<ptrdiff_t>(linesize) && dst_stride == static_cast<ptrdiff_t>(linesize)) {
+		transform(src, dst, linesize * height, t);
+	} else {
+		for (unsigned i = 0; i < height; ++i) {
+			transform(src, dst, linesize, t);
+			src = increment_ptr(src, src_stride);
+			dst = increment_ptr(dst, dst_stride);
+		}
+	}
+}
+
+void transform_rows(const convert_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	const p2p_plan &layout = plan.pack;
+	const packing_traits &traits = *layout.traits;
+	const ptrdiff_t *src_stride = plan.unpack.src_stride;
+	const ptrdiff_t *dst_stride = layout.dst_stride;
+	unsigned p = traits.is_nv ? 1 : 0;
+
+	transform_plane(increment_ptr(src[p], src_stride[p] * row_begin), increment_ptr(dst[p], dst_stride[p] * row_begin), src_stride[p], dst_stride[p],
+	                packed_linesize(traits, layout.width), row_end - row_begin, plan.fused->t);
+
+	if (plan.convert_luma && src[0] && dst[0]) {
+		unsigned luma_begin, luma_end;
+		nv_luma_range(layout, row_begin, row_end, &luma_begin, &luma_end);
+
+		transform_plane(increment_ptr(src[0], src_stride[0] * luma_begin), increment_ptr(dst[0], dst_stride[0] * luma_begin), src_stride[0], dst_stride[0],
+		                planar_linesize(traits, layout.width, 0), luma_end - luma_begin, plan.luma);
+	}
+}
+
+void convert_rows(const convert_plan &plan, unsigned row_begin, unsigned row_end, const void * const src[4], void * const dst[4])
+{
+	if (row_begin >= row_end)
+		return;
+
+	if (plan.fused) {
+		transform_rows(plan, row_begin, row_end, src, dst);
+		return;
+	}
+
+	std::vector<unsigned char> scratch(plan.scratch_bytes);
+	void *scratch_p[4];
+	const void *scratch_cp[4];
+
+	for (unsigned p = 0; p < 4; ++p) {
+		scratch_p[p] = plan.scratch_offset[p] == SIZE_MAX ? nullptr : scratch.data() + plan.scratch_offset[p];
+		scratch_cp[p] = scratch_p[p];
+	}
+
+	for (unsigned i = row_begin; i < row_end; i += plan.strip_rows) {
+		unsigned n = std::min(plan.strip_rows, row_end - i);
+		const void *src_p[4];
+		void *dst_p[4];
+
+		offset_planes(plan.unpack, plan.unpack.src_stride, i, src, src_p);
+		offset_planes(plan.pack, plan.pack.dst_stride, i, dst, dst_p);
+
+		execute_rows(slice_plan(plan.unpack, i, i + n), 0, n, src_p, scratch_p);
+		execute_rows(slice_plan(plan.pack, i, i + n), 0, n, scratch_cp, dst_p);
+	}
+}
+
+int convert_frame(const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags)
+{
+	convert_plan plan;
+	if (!init_convert_plan(plan, param, dst_packing, flags))
+		return -1;
+
+	if (plan.pack.threaded) {
+		p2p::thread_pool &pool = p2p::thread_pool::global();
+		int node = select_node(plan.unpack, param->src, param->dst);
+		partition_plan(plan.pack, pool.num_threads(node));
+
+		const p2p_plan &bands = plan.pack;
+		pool.parallel_for(bands.num_bands, [&](unsigned band)
+		{
+			unsigned row_begin = std::min(band * bands.band_rows, bands.rows);
+			unsigned row_end = std::min(row_begin + bands.band_rows, bands.rows);
+			convert_rows(plan, row_begin, row_end, param->src, param->dst);
+		}, bands.priority, node);
+	} else {
+		convert_rows(plan, 0, plan.pack.rows, param->src, param->dst);
+	}
+	return 0;
+}
+
+} // namespace
+
+
+p2p_unpack_func p2p_select_unpack_func(enum p2p_packing packing)
+{
+	return lookup_traits(packing).unpack;
+}
+
+p2p_pack_func p2p_select_pack_func(enum p2p_packing packing)
+{
+	return p2p_select_pack_func_ex(packing, 0);
+}
+
+p2p_pack_func p2p_select_pack_func_ex(enum p2p_packing packing, int alpha_one_fill)
+{
+	const packing_traits &traits = lookup_traits(packing);
+	return alpha_one_fill ? traits.pack_one_fill : traits.pack;
+}
+
+p2p_unpack_2d_func p2p_select_unpack_2d_func(enum p2p_packing packing)
+{
+	return lookup_traits(packing).unpack_2d;
+}
+
+p2p_pack_2d_func p2p_select_pack_2d_func(enum p2p_packing packing, int alpha_one_fill)
+{
+	const packing_traits &traits = lookup_traits(packing);
+	return alpha_one_fill ? traits.pack_2d_one_fill : traits.pack_2d;
+}
+
+void p2p_unpack_frame(const struct p2p_buffer_param *param, unsigned long flags)
+{
+	execute_frame(param, flags, false);
+}
+
+void p2p_pack_frame(const struct p2p_buffer_param *param, unsigned long flags)
+{
+	execute_frame(param, flags, true);
+}
+
+void p2p_unpack_frame_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags)
+{
+	execute_frame(param, flags, false, lut);
+}
+
+void p2p_pack_frame_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags)
+{
+	execute_frame(param, flags, true, lut);
+}
+
+int p2p_unpack_frame_preview(const struct p2p_buffer_param *param, const struct p2p_preview_param *previews, unsigned count, unsigned long flags)
+{
+	return unpack_frame_preview(param, previews, count, flags);
+}
+
+void p2p_unpack_frame_stats(const struct p2p_buffer_param *param, struct p2p_plane_stats stats[4], unsigned long flags)
+{
+	unpack_frame_stats(param, stats, flags);
+}
+
+void p2p_unpack_frame_hash(const struct p2p_buffer_param *param, enum p2p_hash type, struct p2p_frame_hash *hash, unsigned long flags)
+{
+	execute_frame_hash(param, type, hash, flags, false);
+}
+
+void p2p_pack_frame_hash(const struct p2p_buffer_param *param, enum p2p_hash type, struct p2p_frame_hash *hash, unsigned long flags)
+{
+	execute_frame_hash(param, type, hash, flags, true);
+}
+
+int p2p_convert_frame(const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags)
+{
+	return convert_frame(param, dst_packing, flags);
+}
+
+int p2p_convert_frame_inplace(const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags)
+{
+	const packing_traits &src = lookup_traits(param->packing);
+	const packing_traits &dst = lookup_traits(dst_packing);
+
+	if (src.is_nv != dst.is_nv || src.pel_per_pack != dst.pel_per_pack || src.bytes_per_pack != dst.bytes_per_pack)
+		return -1;
+
+	struct p2p_buffer_param inplace = *param;
+	std::copy_n(param->dst, 4, inplace.src);
+	std::copy_n(param->dst_stride, 4, inplace.src_stride);
+	return convert_frame(&inplace, dst_packing, flags);
+}
+
+struct p2p_plan *p2p_create_unpack_plan(const struct p2p_buffer_param *param, unsigned long flags)
+{
+	return create_plan(param, flags, false);
+}
+
+struct p2p_plan *p2p_create_pack_plan(const struct p2p_buffer_param *param, unsigned long flags)
+{
+	return create_plan(param, flags, true);
+}
+
+struct p2p_plan *p2p_create_unpack_plan_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags)
+{
+	return create_plan(param, flags, false, lut);
+}
+
+struct p2p_plan *p2p_create_pack_plan_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags)
+{
+	return create_plan(param, flags, true, lut);
+}
+
+void p2p_destroy_plan(struct p2p_plan *plan)
+{
+	delete plan;
+}
+
+void p2p_execute_plan(const struct p2p_plan *plan, const void * const src[4], void * const dst[4])
+{
+	execute_plan(*plan, src, dst);
+}
+
+unsigned p2p_plan_num_bands(const struct p2p_plan *plan)
+{
+	return plan->num_bands;
+}
+
+void p2p_execute_plan_band(const struct p2p_plan *plan, unsigned band, const void * const src[4], void * const dst[4])
+{
+	assert(band < plan->num_bands);
+	execute_band(*plan, band, src, dst);
+}
+
+void p2p_execute_plan_band_stats(const struct p2p_plan *plan, unsigned band, const void * const src[4], void * const dst[4], struct p2p_plane_stats stats[4])
+{
+	assert(band < plan->num_bands && !plan->is_pack);
+	execute_band_stats(*plan, band, src, dst, stats);
+}
+
+void p2p_unpack_frame_batch(const struct p2p_buffer_param *params, unsigned count, unsigned long flags)
+{
+	execute_batch(params, count, flags, false);
+}
+
+void p2p_pack_frame_batch(const struct p2p_buffer_param *params, unsigned count, unsigned long flags)
+{
+	execute_batch(params, count, flags, true);
+}
+
+struct p2p_job *p2p_submit_unpack_frame(const struct p2p_buffer_param *param, unsigned long flags, p2p_job_callback callback, void *user)
+{
+	return submit_job(param, flags, false, callback, user);
+}
+
+struct p2p_job *p2p_submit_pack_frame(const struct p2p_buffer_param *param, unsigned long flags, p2p_job_callback callback, void *user)
+{
+	return submit_job(param, flags, true, callback, user);
+}
+
+int p2p_cancel_job(struct p2p_job *job)
+{
+	return job->pool->cancel(job->task);
+}
+
+int p2p_wait_job(struct p2p_job *job)
+{
+	return job->pool->wait(job->task) ? P2P_JOB_CANCELLED : P2P_JOB_COMPLETE;
+}
+
+void p2p_release_job(struct p2p_job *job)
+{
+	delete job;
 }
@@ -154,16 +154,181 @@ p2p_unpack_func p2p_select_unpack_func(enum p2p_packing packing);
 p2p_pack_func p2p_select_pack_func(enum p2p_packing packing);
 p2p_pack_func p2p_select_pack_func_ex(enum p2p_packing packing, int alpha_one_fill);
 
+/** Pack/unpack a range of pixels from consecutive scanlines. Strides are in bytes. */
+typedef void (*p2p_unpack_2d_func)(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4],
+                                   unsigned left, unsigned right, unsigned height);
+typedef void (*p2p_pack_2d_func)(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride,
+                                 unsigned left, unsigned right, unsigned height);
+
+/** Select a multi-line pack/unpack function. */
+p2p_unpack_2d_func p2p_select_unpack_2d_func(enum p2p_packing packing);
+p2p_pack_2d_func p2p_select_pack_2d_func(enum p2p_packing packing, int alpha_one_fill);
+
 
 /** When processing formats like NV12, ignore the unpacked plane. */
 #define P2P_SKIP_UNPACKED_PLANES (1UL << 0)
 /** When packing, store a bit pattern of all ones in the alpha channel instead of all zeros. */
 #define P2P_ALPHA_SET_ONE (1UL << 1)
+/** Split the frame into row bands run on the shared library thread pool. */
+#define P2P_USE_THREADS (1UL << 2)
+/** Scheduling class of pooled work. Realtime bands are taken before others, background bands after. */
+#define P2P_PRIORITY_REALTIME (1UL << 3)
+#define P2P_PRIORITY_BACKGROUND (1UL << 4)
+/** Write the output with non-temporal stores. Automatic for frames over half the last-level cache. */
+#define P2P_STREAMING_STORES (1UL << 5)
+/** Rows of every plane may be read and written up to 64 bytes past their end. Padding bytes are unspecified. */
+#define P2P_PADDED_BUFFERS (1UL << 6)
+/** Planar samples are 16-bit regardless of the packed depth: widened when unpacking, rounded when packing. */
+#define P2P_PLANAR_16BIT (1UL << 7)
+/** With {@ref P2P_PLANAR_16BIT}, widen by bit replication and narrow by rounded scaling. */
+#define P2P_BIT_REPLICATE (1UL << 8)
+/** Planar samples are floats, with 1.0 the maximum of each packed component. Packing clamps to [0, 1]. */
+#define P2P_PLANAR_FLOAT (1UL << 9)
+/** Planar samples are half floats, normalized as with {@ref P2P_PLANAR_FLOAT}. Takes precedence over
+ *  {@ref P2P_PLANAR_16BIT}. */
+#define P2P_PLANAR_HALF (1UL << 10)
+/** Convert LSB-padded packings, e.g. P010, as their 16-bit counterparts, keeping the padding bits. */
+#define P2P_MSB_ALIGNED (1UL << 11)
+/** Packed samples are limited range and planar samples full range. Alpha is unchanged. Native planar samples only. */
+#define P2P_PLANAR_FULL_RANGE (1UL << 12)
+/** Packed samples are full range and planar samples limited range. See {@ref P2P_PLANAR_FULL_RANGE}. */
+#define P2P_PLANAR_LIMITED_RANGE (1UL << 13)
+/**
+ * Planar chroma of 4:2:2 interleaved packings is 4:2:0, averaged when unpacking and repeated when packing.
+ * A frame of one row has no planar chroma: only its luma is unpacked, and it is not packed.
+ */
+#define P2P_CHROMA_420 (1UL << 14)
+/** Resample chroma by [1 3 3 1] / 8 and [3 1] / 4 filters instead of averaging and repeating. */
+#define P2P_CHROMA_LINEAR (1UL << 15)
+/** With {@ref P2P_CHROMA_420}, resample chroma within each of two interleaved fields. */
+#define P2P_CHROMA_INTERLACED (1UL << 16)
+/** Planar chroma is full resolution for subsampled packings. Takes precedence over {@ref P2P_CHROMA_420}. */
+#define P2P_CHROMA_444 (1UL << 17)
+/** With {@ref P2P_CHROMA_444}, chroma is sited halfway between luma samples instead of cosited with even samples. */
+#define P2P_CHROMA_CENTERED (1UL << 18)
+/** Planar color is premultiplied by alpha, and packed color is straight. No effect on packings without alpha. */
+#define P2P_ALPHA_PREMULTIPLIED (1UL << 19)
+/** Convert between planar RGB and YUV packings, or planar YUV and RGB packings, by the given matrix. */
+#define P2P_MATRIX_BT601 (1UL << 20)
+#define P2P_MATRIX_BT709 (2UL << 20)
+#define P2P_MATRIX_BT2020 (3UL << 20)
+#define P2P_MATRIX_MASK (3UL << 20)
+/** YUV samples converted by a color matrix are full range. */
+#define P2P_MATRIX_FULL_RANGE (1UL << 22)
+/** When packing, dither color samples more precise than the packing. Alpha is rounded. */
+#define P2P_DITHER_ORDERED (1UL << 23)
+#define P2P_DITHER_ERROR_DIFFUSION (2UL << 23)
+#define P2P_DITHER_MASK (3UL << 23)
 
 /** Helper function to pack/unpack between memory locations. */
 void p2p_unpack_frame(const struct p2p_buffer_param *param, unsigned long flags);
 void p2p_pack_frame(const struct p2p_buffer_param *param, unsigned long flags);
 
+/**
+ * Pack/unpack with a lookup table per planar component, indexed by the planar sample. NULL tables are skipped.
+ * Tables have 2^depth entries of the planar sample type, and are ignored with floating point samples.
+ */
+void p2p_unpack_frame_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags);
+void p2p_pack_frame_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags);
+
+/** Downscaled copy of a planar frame, in planar order. */
+struct p2p_preview_param {
+	void *dst[4];
+	ptrdiff_t dst_stride[4];
+	unsigned scale; /* 2 or 4 */
+};
+
+/** Unpack, and also write box-averaged previews of the planar frame. Returns -1 if a scale is invalid. */
+int p2p_unpack_frame_preview(const struct p2p_buffer_param *param, const struct p2p_preview_param *previews, unsigned count, unsigned long flags);
+
+/** Statistics of a planar plane. */
+struct p2p_plane_stats {
+	unsigned long long *histogram; /* 2^depth bins of integer samples, or NULL. */
+	unsigned long long count;
+	double sum;
+	double min; /* Valid if count is non-zero. */
+	double max;
+};
+
+/** Unpack, and also add statistics of the planar frame to stats. Planes not written are skipped. */
+void p2p_unpack_frame_stats(const struct p2p_buffer_param *param, struct p2p_plane_stats stats[4], unsigned long flags);
+
+/** Checksum algorithms. */
+enum p2p_hash {
+	p2p_hash_crc32c, /* CRC-32C (Castagnoli), as in iSCSI and SSE4.2 */
+	p2p_hash_xxh64,  /* XXH64 with seed 0 */
+};
+
+/** Checksums of the planes written by a conversion, and of the frame. */
+struct p2p_frame_hash {
+	unsigned long long plane[4]; /* Zero for planes not written. */
+	unsigned long long frame;
+};
+
+/**
+ * Pack/unpack, and also checksum the destination planes, row by row without stride padding.
+ * The frame checksum is that of the plane checksums, each as 8 little-endian bytes.
+ */
+void p2p_unpack_frame_hash(const struct p2p_buffer_param *param, enum p2p_hash type, struct p2p_frame_hash *hash, unsigned long flags);
+void p2p_pack_frame_hash(const struct p2p_buffer_param *param, enum p2p_hash type, struct p2p_frame_hash *hash, unsigned long flags);
+
+/** Convert between packings of the same subsampling. Returns -1 if the packings are incompatible. */
+int p2p_convert_frame(const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags);
+
+/** Convert a frame in dst in place. The packings must also have the same pack size. */
+int p2p_convert_frame_inplace(const struct p2p_buffer_param *param, enum p2p_packing dst_packing, unsigned long flags);
+
+/** Pack/unpack a batch of frames, grouped by kernel. */
+void p2p_unpack_frame_batch(const struct p2p_buffer_param *params, unsigned count, unsigned long flags);
+void p2p_pack_frame_batch(const struct p2p_buffer_param *params, unsigned count, unsigned long flags);
+
+
+/** Asynchronous frame conversion. */
+struct p2p_job;
+
+/** Job status. */
+#define P2P_JOB_COMPLETE 0
+#define P2P_JOB_CANCELLED 1
+
+/** Completion callback, invoked once from a worker thread. */
+typedef void (*p2p_job_callback)(void *user, int status);
+
+/** Submit a frame conversion to the library thread pool. Buffers must remain valid until the job completes. */
+struct p2p_job *p2p_submit_unpack_frame(const struct p2p_buffer_param *param, unsigned long flags, p2p_job_callback callback, void *user);
+struct p2p_job *p2p_submit_pack_frame(const struct p2p_buffer_param *param, unsigned long flags, p2p_job_callback callback, void *user);
+
+/** Skip the parts of a job not yet started. Returns non-zero if any part was skipped. */
+int p2p_cancel_job(struct p2p_job *job);
+
+/** Wait for a job to complete. Returns the job status. */
+int p2p_wait_job(struct p2p_job *job);
+
+/** Release a job handle. The job continues if still running. */
+void p2p_release_job(struct p2p_job *job);
+
+
+/** Precompiled frame conversion. Buffer pointers in the parameters are ignored. */
+struct p2p_plan;
+
+/** Create a plan. Returns NULL on allocation failure. */
+struct p2p_plan *p2p_create_unpack_plan(const struct p2p_buffer_param *param, unsigned long flags);
+struct p2p_plan *p2p_create_pack_plan(const struct p2p_buffer_param *param, unsigned long flags);
+void p2p_destroy_plan(struct p2p_plan *plan);
+
+/** Create a plan with lookup tables, which must remain valid while the plan is in use. */
+struct p2p_plan *p2p_create_unpack_plan_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags);
+struct p2p_plan *p2p_create_pack_plan_lut(const struct p2p_buffer_param *param, const void * const lut[4], unsigned long flags);
+
+/** Execute a plan between memory locations. Pointers follow {@ref p2p_buffer_param}. */
+void p2p_execute_plan(const struct p2p_plan *plan, const void * const src[4], void * const dst[4]);
+
+/** Execute one row band of a plan. Bands may be executed concurrently. */
+unsigned p2p_plan_num_bands(const struct p2p_plan *plan);
+void p2p_execute_plan_band(const struct p2p_plan *plan, unsigned band, const void * const src[4], void * const dst[4]);
+
+/** Execute one row band of an unpack plan, and add the statistics of its rows to stats. */
+void p2p_execute_plan_band_stats(const struct p2p_plan *plan, unsigned band, const void * const src[4], void * const dst[4], struct p2p_plane_stats stats[4]);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
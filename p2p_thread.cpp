@@ -0,0 +1,360 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <system_error>
+#include "p2p_thread.h"
+
+#ifdef __linux__
+  #include <pthread.h>
+  #include <sched.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+namespace P2P_NAMESPACE {
+
+namespace {
+
+#ifdef __linux__
+// Parse a sysfs list such as "0-3,8-11".
+std::vector<unsigned> read_sysfs_list(const char *path)
+{
+	std::vector<unsigned> list;
+	FILE *f = std::fopen(path, "r");
+	if (!f)
+		return list;
+
+	unsigned first, last;
+	int n;
+	while ((n = std::fscanf(f, "%u-%u", &first, &last)) >= 1) {
+		if (n == 1)
+			last = first;
+		for (unsigned i = first; i <= last; ++i) {
+			list.push_back(i);
+		}
+		if (std::fgetc(f) != ',')
+			break;
+	}
+
+	std::fclose(f);
+	return list;
+}
+
+// CPUs of each online NUMA node, indexed by node number.
+std::vector<std::vector<unsigned>> numa_topology()
+{
+	std::vector<std::vector<unsigned>> nodes;
+
+	for (unsigned node : read_sysfs_list("/sys/devices/system/node/online")) {
+		char path[64];
+		std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+
+		if (nodes.size() <= node)
+			nodes.resize(node + 1);
+		nodes[node] = read_sysfs_list(path);
+	}
+	return nodes;
+}
+
+// Node of a resident page, or -1. Queried with move_pages, which does not
+// fault the page in or migrate it when no target nodes are given.
+int numa_node_of(const void *ptr)
+{
+	static const uintptr_t page_mask = ~static_cast<uintptr_t>(sysconf(_SC_PAGESIZE) - 1);
+
+	void *page = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(ptr) & page_mask);
+	int status = -1;
+
+	if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) != 0)
+		return -1;
+	return status;
+}
+
+void set_affinity(std::thread &th, const std::vector<unsigned> &cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned cpu : cpus) {
+		if (cpu < CPU_SETSIZE)
+			CPU_SET(cpu, &set);
+	}
+
+	// Affinity is advisory; a restricted cpuset may reject it.
+	pthread_setaffinity_np(th.native_handle(), sizeof(set), &set);
+}
+#endif // __linux__
+
+} // namespace
+
+struct thread_pool::task {
+	std::function<void(unsigned)> func;
+	std::function<void(bool)> complete;
+	unsigned count;
+	unsigned next;
+	unsigned active;
+	priority prio;
+	int node;
+	bool cancelled;
+	bool completed;
+};
+
+thread_pool::thread_pool(unsigned num_threads) : thread_pool(num_threads, {})
+{
+}
+
+thread_pool::thread_pool(unsigned num_threads, const std::vector<unsigned> &cpus) : m_running{}, m_waiting{}, m_quit{}
+{
+	// Workers read the thread count, so hold them until all are started.
+	std::lock_guard<std::mutex> lock{ m_mutex };
+
+	try {
+		for (unsigned i = 1; i < num_threads; ++i) {
+			m_threads.emplace_back(&thread_pool::worker, this, -1);
+#ifdef __linux__
+			if (!cpus.empty())
+				set_affinity(m_threads.back(), cpus);
+#else
+			(void)cpus;
+#endif
+		}
+	} catch (const std::system_error &) {
+		// Continue with the threads that could be started.
+	}
+}
+
+thread_pool::thread_pool(const std::vector<std::vector<unsigned>> &nodes) : m_node_threads(nodes.size()), m_running{}, m_waiting{}, m_quit{}
+{
+	std::lock_guard<std::mutex> lock{ m_mutex };
+	bool submitter = true;
+
+	try {
+		for (size_t node = 0; node < nodes.size(); ++node) {
+			for (size_t i = submitter && !nodes[node].empty() ? 1 : 0; i < nodes[node].size(); ++i) {
+				m_threads.emplace_back(&thread_pool::worker, this, static_cast<int>(node));
+				++m_node_threads[node];
+#ifdef __linux__
+				set_affinity(m_threads.back(), nodes[node]);
+#endif
+			}
+			submitter = submitter && nodes[node].empty();
+		}
+	} catch (const std::system_error &) {
+		// Continue with the threads that could be started.
+	}
+}
+
+thread_pool::~thread_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_mutex };
+		m_quit = true;
+	}
+	m_work_cond.notify_all();
+
+	for (std::thread &th : m_threads) {
+		th.join();
+	}
+}
+
+thread_pool &thread_pool::global()
+{
+	struct pool_holder {
+		std::unique_ptr<thread_pool> pool;
+
+		pool_holder()
+		{
+#ifdef __linux__
+			std::vector<std::vector<unsigned>> nodes = numa_topology();
+			if (nodes.size() > 1) {
+				pool.reset(new thread_pool{ nodes });
+				if (pool->num_threads() >= 2)
+					return;
+			}
+#endif
+			// Asynchronous tasks need at least one worker besides the submitter.
+			pool.reset(new thread_pool{ std::max(std::thread::hardware_concurrency(), 2U) });
+		}
+	};
+	static pool_holder holder;
+	return *holder.pool;
+}
+
+int thread_pool::node_of(const void *ptr) const
+{
+#ifdef __linux__
+	if (ptr && !m_node_threads.empty()) {
+		int node = numa_node_of(ptr);
+		if (node >= 0 && static_cast<size_t>(node) < m_node_threads.size() && m_node_threads[node])
+			return node;
+	}
+#else
+	(void)ptr;
+#endif
+	return -1;
+}
+
+unsigned thread_pool::num_threads(int node) const
+{
+	if (node >= 0 && static_cast<size_t>(node) < m_node_threads.size() && m_node_threads[node])
+		return m_node_threads[node] + 1;
+	return num_threads();
+}
+
+void thread_pool::enqueue(const task_ptr &t, std::unique_lock<std::mutex> &lock)
+{
+	if (!t->count) {
+		finish(t, lock);
+		return;
+	}
+
+	m_tasks[t->prio].push_back(t);
+	m_work_cond.notify_all();
+}
+
+// First task with unclaimed indices that may run on a node, or on any node
+// if node is -1.
+thread_pool::task_ptr thread_pool::next_task(unsigned max_priority, int node)
+{
+	for (unsigned p = 0; p <= max_priority && p < num_priorities; ++p) {
+		std::deque<task_ptr> &queue = m_tasks[p];
+
+		// Drop tasks whose indices have all been claimed.
+		while (!queue.empty() && queue.front()->next >= queue.front()->count) {
+			queue.pop_front();
+		}
+		for (const task_ptr &t : queue) {
+			if (t->next < t->count && (node < 0 || t->node < 0 || t->node == node))
+				return t;
+		}
+	}
+	return nullptr;
+}
+
+bool thread_pool::run_one(const task_ptr &t, std::unique_lock<std::mutex> &lock)
+{
+	if (t->next >= t->count)
+		return false;
+
+	unsigned idx = t->next++;
+	++t->active;
+	++m_running;
+
+	lock.unlock();
+	t->func(idx);
+	lock.lock();
+
+	// Hand the slot to a worker or a waiting submitter. Any worker may take it
+	// unless workers are bound to nodes.
+	--m_running;
+	if (m_node_threads.empty())
+		m_work_cond.notify_one();
+	else
+		m_work_cond.notify_all();
+	if (m_waiting)
+		m_done_cond.notify_all();
+
+	if (!--t->active && t->next >= t->count)
+		finish(t, lock);
+
+	return true;
+}
+
+void thread_pool::finish(const task_ptr &t, std::unique_lock<std::mutex> &lock)
+{
+	std::deque<task_ptr> &queue = m_tasks[t->prio];
+	auto it = std::find(queue.begin(), queue.end(), t);
+	if (it != queue.end())
+		queue.erase(it);
+
+	if (t->complete) {
+		lock.unlock();
+		t->complete(t->cancelled);
+		lock.lock();
+	}
+
+	t->completed = true;
+	m_done_cond.notify_all();
+}
+
+void thread_pool::worker(int node)
+{
+	std::unique_lock<std::mutex> lock{ m_mutex };
+
+	while (!m_quit) {
+		task_ptr t = m_running < num_threads() ? next_task(num_priorities, node) : nullptr;
+		if (t)
+			run_one(t, lock);
+		else
+			m_work_cond.wait(lock);
+	}
+}
+
+thread_pool::task_ptr thread_pool::submit(unsigned count, std::function<void(unsigned)> func, std::function<void(bool)> complete, priority prio, int node)
+{
+	task_ptr t = std::make_shared<task>();
+	t->func = std::move(func);
+	t->complete = std::move(complete);
+	t->count = count;
+	t->next = 0;
+	t->active = 0;
+	t->prio = prio;
+	// Nodes without workers, or holding all of them, do not restrict the task.
+	t->node = num_threads(node) < num_threads() ? node : -1;
+	t->cancelled = false;
+	t->completed = false;
+
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	enqueue(t, lock);
+	return t;
+}
+
+bool thread_pool::cancel(const task_ptr &t)
+{
+	std::unique_lock<std::mutex> lock{ m_mutex };
+
+	if (t->next >= t->count)
+		return false;
+
+	t->cancelled = true;
+	t->next = t->count;
+
+	if (!t->active)
+		finish(t, lock);
+
+	return true;
+}
+
+bool thread_pool::wait(const task_ptr &t)
+{
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	m_done_cond.wait(lock, [&]() { return t->completed; });
+	return t->cancelled;
+}
+
+void thread_pool::parallel_for(unsigned count, const std::function<void(unsigned)> &func, priority prio, int node)
+{
+	if (count <= 1 || m_threads.empty()) {
+		for (unsigned i = 0; i < count; ++i) {
+			func(i);
+		}
+		return;
+	}
+
+	task_ptr t = submit(count, [&](unsigned i) { func(i); }, nullptr, prio, node);
+
+	// Help with the task while a thread slot is free and no more urgent work
+	// is queued. Otherwise, leave it to the workers.
+	std::unique_lock<std::mutex> lock{ m_mutex };
+	while (!t->completed) {
+		if (t->next < t->count && m_running < num_threads() && (!prio || !next_task(prio - 1, -1))) {
+			run_one(t, lock);
+		} else {
+			++m_waiting;
+			m_done_cond.wait(lock);
+			--m_waiting;
+		}
+	}
+}
+
+} // namespace p2p
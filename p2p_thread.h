@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef P2P_THREAD_H_
+#define P2P_THREAD_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "p2p.h"
+
+namespace P2P_NAMESPACE {
+
+/**
+ * Pool of worker threads shared by all frame helpers in the process.
+ *
+ * Work is submitted as a task covering a range of independent indices. Idle
+ * workers take indices from the queued tasks of every submitter, so that the
+ * row bands of many concurrent streams are spread over a fixed set of threads.
+ * Tasks are served by priority class, then in submission order, so that a
+ * task may begin while the final indices of the previous task are running.
+ *
+ * Threads waiting on their own task help with it, but the total number of
+ * threads executing indices never exceeds {@ref num_threads}.
+ *
+ * Workers may be pinned to NUMA nodes. A task bound to a node only runs on the
+ * workers of that node and on its submitter.
+ */
+class thread_pool {
+public:
+	struct task;
+	typedef std::shared_ptr<task> task_ptr;
+
+	/** Scheduling class. Lower values are served first. */
+	enum priority {
+		realtime,
+		normal,
+		background,
+		num_priorities,
+	};
+private:
+	std::vector<std::thread> m_threads;
+	std::vector<unsigned> m_node_threads; // Workers of each node, or empty if unpinned.
+	std::deque<task_ptr> m_tasks[num_priorities];
+	std::mutex m_mutex;
+	std::condition_variable m_work_cond;
+	std::condition_variable m_done_cond;
+	unsigned m_running;
+	unsigned m_waiting;
+	bool m_quit;
+
+	void enqueue(const task_ptr &t, std::unique_lock<std::mutex> &lock);
+	task_ptr next_task(unsigned max_priority, int node);
+	bool run_one(const task_ptr &t, std::unique_lock<std::mutex> &lock);
+	void finish(const task_ptr &t, std::unique_lock<std::mutex> &lock);
+	void worker(int node);
+public:
+	/**
+	 * Start a pool.
+	 *
+	 * @param num_threads number of threads, including the submitting thread
+	 */
+	explicit thread_pool(unsigned num_threads);
+
+	/**
+	 * Start a pool with workers restricted to a set of CPUs.
+	 *
+	 * @param num_threads number of threads, including the submitting thread
+	 * @param cpus CPU numbers, or empty to leave workers unrestricted
+	 */
+	thread_pool(unsigned num_threads, const std::vector<unsigned> &cpus);
+
+	/**
+	 * Start a pool with a thread per CPU of each NUMA node, pinned to the CPUs
+	 * of its node. The submitting thread takes the place of one worker.
+	 *
+	 * @param nodes CPU numbers of each node, indexed by node number
+	 */
+	explicit thread_pool(const std::vector<std::vector<unsigned>> &nodes);
+
+	thread_pool(const thread_pool &) = delete;
+	thread_pool &operator=(const thread_pool &) = delete;
+
+	~thread_pool();
+
+	/** Process-wide pool sized to the hardware concurrency, with workers pinned by node on NUMA systems. */
+	static thread_pool &global();
+
+	/**
+	 * NUMA node that owns a memory location, or -1 if the pool has no workers
+	 * on it, e.g. on UMA systems, or if the page is not yet resident.
+	 */
+	int node_of(const void *ptr) const;
+
+	/** Number of threads, including the submitting thread. */
+	unsigned num_threads() const { return static_cast<unsigned>(m_threads.size()) + 1; }
+
+	/** Number of threads that may run a task bound to a node, including the submitting thread. */
+	unsigned num_threads(int node) const;
+
+	/**
+	 * Asynchronously call a function once for each index in [0, count).
+	 *
+	 * @param count number of indices
+	 * @param func function to call
+	 * @param complete function called once after the last index, with a flag
+	 *        indicating whether the task was cancelled
+	 * @param prio scheduling class
+	 * @param node NUMA node to run on, or -1 for any
+	 * @return task handle
+	 */
+	task_ptr submit(unsigned count, std::function<void(unsigned)> func, std::function<void(bool)> complete = nullptr, priority prio = normal, int node = -1);
+
+	/**
+	 * Skip the indices of a task that have not yet started.
+	 *
+	 * @return true if any index was skipped
+	 */
+	bool cancel(const task_ptr &t);
+
+	/**
+	 * Wait for a task to complete.
+	 *
+	 * @return true if the task was cancelled
+	 */
+	bool wait(const task_ptr &t);
+
+	/**
+	 * Call a function once for each index in [0, count).
+	 *
+	 * The calling thread participates in the work.
+	 *
+	 * @param count number of indices
+	 * @param func function to call
+	 * @param prio scheduling class
+	 * @param node NUMA node to run on, or -1 for any
+	 */
+	void parallel_for(unsigned count, const std::function<void(unsigned)> &func, priority prio = normal, int node = -1);
+};
+
+} // namespace p2p
+
+#endif // P2P_THREAD_H_
@@ -0,0 +1,97 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstdint>
+#include <immintrin.h>
+#include "../p2p.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+namespace {
+
+// Table lookups by 32-bit gathers. A lane reads the dword starting at its
+// entry, or the last dword of the table for the last few entries, and shifts
+// the entry down, so that the gather never reads past the table.
+template <class T>
+__m256i lookup_epi32(const T *table, __m256i idx, __m256i last_dword)
+{
+	const __m256i entry_mask = _mm256_set1_epi32(sizeof(T) == 1 ? 0xFF : 0xFFFF);
+
+	__m256i pos = _mm256_min_epu32(idx, last_dword);
+	__m256i shift = _mm256_slli_epi32(_mm256_sub_epi32(idx, pos), sizeof(T) == 1 ? 3 : 4);
+	__m256i x = _mm256_i32gather_epi32(reinterpret_cast<const int *>(table), pos, sizeof(T));
+	return _mm256_and_si256(_mm256_srlv_epi32(x, shift), entry_mask);
+}
+
+void lut_u8_avx2(const void *src, void *dst, unsigned n, const detail::lut_table &t)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	const uint8_t *table = static_cast<const uint8_t *>(t.entries);
+	unsigned i = 0;
+
+	// Tables too small for a dword are left to the scalar loop.
+	if (t.mask >= 3) {
+		const __m256i mask = _mm256_set1_epi32(t.mask);
+		const __m256i last_dword = _mm256_set1_epi32(t.mask - 3);
+
+		for (; i + 16 <= n; i += 16) {
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src_p + i));
+			__m256i lo = _mm256_and_si256(_mm256_cvtepu8_epi32(x), mask);
+			__m256i hi = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_srli_si128(x, 8)), mask);
+
+			lo = lookup_epi32(table, lo, last_dword);
+			hi = lookup_epi32(table, hi, last_dword);
+
+			__m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+			y = _mm256_packus_epi16(y, y);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst_p + i), _mm256_castsi256_si128(_mm256_permute4x64_epi64(y, 0x08)));
+		}
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = table[src_p[i] & t.mask];
+	}
+}
+
+void lut_u16_avx2(const void *src, void *dst, unsigned n, const detail::lut_table &t)
+{
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	const uint16_t *table = static_cast<const uint16_t *>(t.entries);
+	unsigned i = 0;
+
+	if (t.mask >= 1) {
+		const __m256i mask = _mm256_set1_epi32(t.mask);
+		const __m256i last_dword = _mm256_set1_epi32(t.mask - 1);
+
+		for (; i + 16 <= n; i += 16) {
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src_p + i));
+			__m256i lo = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_castsi256_si128(x)), mask);
+			__m256i hi = _mm256_and_si256(_mm256_cvtepu16_epi32(_mm256_extracti128_si256(x, 1)), mask);
+
+			lo = lookup_epi32(table, lo, last_dword);
+			hi = lookup_epi32(table, hi, last_dword);
+
+			__m256i y = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst_p + i), y);
+		}
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = table[src_p[i] & t.mask];
+	}
+}
+
+} // namespace
+
+
+detail::lut_func select_lut_avx2(unsigned bytes_per_sample)
+{
+	return bytes_per_sample == 1 ? lut_u8_avx2 : lut_u16_avx2;
+}
+
+} // namespace simd
+} // namespace p2p
+
+#endif // x86
+#endif // P2P_SIMD
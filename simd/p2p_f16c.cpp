@@ -0,0 +1,247 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstdint>
+#include <immintrin.h>
+#include "../p2p.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+namespace {
+
+// Variants with half-precision planar samples, normalized to [0, 1]. Samples
+// are computed in single precision as in the float kernels, then converted
+// with round to nearest even, which matches planar_codec.
+typedef detail::planar_codec<half, 0, false> half_codec;
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA>
+void unpack_rgb32_f16_f16c(const void *src, void * const * dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	half *dst_r = static_cast<half *>(dst[0]);
+	half *dst_g = static_cast<half *>(dst[1]);
+	half *dst_b = static_cast<half *>(dst[2]);
+	half *dst_a = static_cast<half *>(dst[3]);
+
+	if (!dst_a)
+		dst_a = dst_r; // Write alpha to some other channel if disabled.
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	// Must always write alpha component first!
+	auto scalar_iter = [&](size_t i)
+	{
+		uint32_t x = src_p[i];
+		dst_a[i] = half_codec::decode((x >> (IdxA * 8)) & 0xFFU, 8);
+		dst_r[i] = half_codec::decode((x >> (IdxR * 8)) & 0xFFU, 8);
+		dst_g[i] = half_codec::decode((x >> (IdxG * 8)) & 0xFFU, 8);
+		dst_b[i] = half_codec::decode((x >> (IdxB * 8)) & 0xFFU, 8);
+	};
+	auto convert = [&](__m128i x)
+	{
+		return _mm_cvtps_ph(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(x)), scale), _MM_FROUND_TO_NEAREST_INT);
+	};
+	auto store_scaled = [&](half *p, __m128i x)
+	{
+		_mm_storeu_si128((__m128i *)(p + 0), _mm_unpacklo_epi64(convert(x), convert(_mm_srli_si128(x, 4))));
+		_mm_storeu_si128((__m128i *)(p + 8), _mm_unpacklo_epi64(convert(_mm_srli_si128(x, 8)), convert(_mm_srli_si128(x, 12))));
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(src_p + i));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(src_p + i + 4));
+		__m128i x2 = _mm_loadu_si128((const __m128i *)(src_p + i + 8));
+		__m128i x3 = _mm_loadu_si128((const __m128i *)(src_p + i + 12));
+
+		x0 = _mm_shuffle_epi8(x0, shuffle);
+		x1 = _mm_shuffle_epi8(x1, shuffle);
+		x2 = _mm_shuffle_epi8(x2, shuffle);
+		x3 = _mm_shuffle_epi8(x3, shuffle);
+
+		__m128 x0s = _mm_castsi128_ps(x0), x1s = _mm_castsi128_ps(x1), x2s = _mm_castsi128_ps(x2), x3s = _mm_castsi128_ps(x3);
+		_MM_TRANSPOSE4_PS(x0s, x1s, x2s, x3s);
+		x0 = _mm_castps_si128(x0s); x1 = _mm_castps_si128(x1s); x2 = _mm_castps_si128(x2s); x3 = _mm_castps_si128(x3s);
+
+		__m128i regs[4] = { x0, x1, x2, x3 };
+		store_scaled(dst_a + i, regs[IdxA]);
+		store_scaled(dst_r + i, regs[IdxR]);
+		store_scaled(dst_g + i, regs[IdxG]);
+		store_scaled(dst_b + i, regs[IdxB]);
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill>
+void pack_rgb32_f16_f16c(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+	const __m128i alpha_fill = _mm_set1_epi8(AlphaOneFill ? -1 : 0);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 round = _mm_set1_ps(0.5f);
+
+	const half *src_r = static_cast<const half *>(src[0]);
+	const half *src_g = static_cast<const half *>(src[1]);
+	const half *src_b = static_cast<const half *>(src[2]);
+	const half *src_a = static_cast<const half *>(src[3]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	auto scalar_iter = [&](size_t i)
+	{
+		uint32_t r = half_codec::encode(src_r[i], 8);
+		uint32_t g = half_codec::encode(src_g[i], 8);
+		uint32_t b = half_codec::encode(src_b[i], 8);
+		uint32_t a = src_a ? half_codec::encode(src_a[i], 8) : AlphaOneFill ? 0xFF : 0;
+
+		dst_p[i] = (r << (IdxR * 8)) | (g << (IdxG * 8)) | (b << (IdxB * 8)) | (a << (IdxA * 8));
+	};
+	auto quantize = [&](__m128i x)
+	{
+		__m128 f = _mm_min_ps(_mm_max_ps(_mm_cvtph_ps(x), _mm_setzero_ps()), one);
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, scale), round));
+	};
+	auto load_quantized = [&](const half *p)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(p + 0));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(p + 8));
+		__m128i lo = _mm_packus_epi32(quantize(x0), quantize(_mm_srli_si128(x0, 8)));
+		__m128i hi = _mm_packus_epi32(quantize(x1), quantize(_mm_srli_si128(x1, 8)));
+		return _mm_packus_epi16(lo, hi);
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i r = load_quantized(src_r + i);
+		__m128i g = load_quantized(src_g + i);
+		__m128i b = load_quantized(src_b + i);
+		__m128i a = src_a ? load_quantized(src_a + i) : alpha_fill;
+
+		__m128 regs[4];
+		regs[IdxR] = _mm_castsi128_ps(r);
+		regs[IdxG] = _mm_castsi128_ps(g);
+		regs[IdxB] = _mm_castsi128_ps(b);
+		regs[IdxA] = _mm_castsi128_ps(a);
+		_MM_TRANSPOSE4_PS(regs[0], regs[1], regs[2], regs[3]);
+
+		__m128i x0 = _mm_castps_si128(regs[0]), x1 = _mm_castps_si128(regs[1]), x2 = _mm_castps_si128(regs[2]), x3 = _mm_castps_si128(regs[3]);
+		_mm_storeu_si128((__m128i *)(dst_p + i + 0), _mm_shuffle_epi8(x0, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 4), _mm_shuffle_epi8(x1, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 8), _mm_shuffle_epi8(x2, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 12), _mm_shuffle_epi8(x3, shuffle));
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+// Multi-row kernels prefetch the start of the next row, as in the SSE4.1
+// kernels.
+const size_t row_prefetch_bytes = 256;
+
+void prefetch_row(const void *row, size_t offset)
+{
+	for (size_t i = 0; i < row_prefetch_bytes; i += 64) {
+		_mm_prefetch(static_cast<const char *>(row) + offset + i, _MM_HINT_T0);
+	}
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA>
+void unpack_rgb32_f16_2d_f16c(const void *src, ptrdiff_t src_stride, void * const *dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		if (i + 1 < height)
+			prefetch_row(detail::increment_ptr(src, src_stride), static_cast<size_t>(left) * 4);
+
+		unpack_rgb32_f16_f16c<IdxR, IdxG, IdxB, IdxA>(src, dst_p, left, right);
+
+		src = detail::increment_ptr(src, src_stride);
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = detail::increment_ptr(dst_p[p], dst_stride[p]);
+		}
+	}
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill>
+void pack_rgb32_f16_2d_f16c(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		for (unsigned p = 0; p < 4 && i + 1 < height; ++p) {
+			if (src_p[p])
+				prefetch_row(detail::increment_ptr(src_p[p], src_stride[p]), static_cast<size_t>(left) * 2);
+		}
+
+		pack_rgb32_f16_f16c<IdxR, IdxG, IdxB, IdxA, AlphaOneFill>(src_p, dst, left, right);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = detail::increment_ptr(src_p[p], src_stride[p]);
+		}
+		dst = detail::increment_ptr(dst, dst_stride);
+	}
+}
+
+} // namespace
+
+
+#define RGB32_F16_F16C(format, a, b, c, d) \
+  void unpack_##format##_f16_f16c(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb32_f16_f16c<a, b, c, d>(src, dst, left, right); \
+  } \
+  void pack_##format##_f16_0_f16c(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_f16_f16c<a, b, c, d, 0>(src, dst, left, right); \
+  } \
+  void pack_##format##_f16_1_f16c(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_f16_f16c<a, b, c, d, 1>(src, dst, left, right); \
+  } \
+  void unpack_##format##_f16_2d_f16c(const void *src, ptrdiff_t src_stride, void * const * dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    unpack_rgb32_f16_2d_f16c<a, b, c, d>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_f16_0_2d_f16c(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_rgb32_f16_2d_f16c<a, b, c, d, 0>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_f16_1_2d_f16c(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_rgb32_f16_2d_f16c<a, b, c, d, 1>(src, src_stride, dst, dst_stride, left, right, height); \
+  }
+
+RGB32_F16_F16C(argb32_be, 1, 2, 3, 0)
+RGB32_F16_F16C(argb32_le, 2, 1, 0, 3)
+RGB32_F16_F16C(rgba32_be, 0, 1, 2, 3)
+RGB32_F16_F16C(rgba32_le, 3, 2, 1, 0)
+
+} // namespace simd
+} // namespace p2p
+
+#endif // x86
+#endif // P2P_SIMD
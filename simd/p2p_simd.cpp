@@ -3,7 +3,6 @@
 #include <array>
 #include <typeinfo>
 #include <tuple>
-#include <utility>
 #include "../p2p.h"
 #include "cpuinfo_x86.h"
 #include "p2p_simd.h"
@@ -13,8 +12,9 @@ namespace detail {
 
 namespace {
 
-typedef std::pair<const std::type_info *, detail::unpack_func> unpack_table_entry;
-typedef std::tuple<const std::type_info *, detail::pack_func, detail::pack_func> pack_table_entry;
+typedef std::tuple<const std::type_info *, detail::unpack_func, detail::unpack_2d_func, detail::unpack_2d_func> unpack_table_entry;
+typedef std::tuple<const std::type_info *, detail::pack_func, detail::pack_func, detail::pack_2d_func, detail::pack_2d_func,
+                   detail::pack_2d_func, detail::pack_2d_func> pack_table_entry;
 
 auto populate_unpack_table()
 {
@@ -25,12 +25,35 @@ auto populate_unpack_table()
 	simd::X86Capabilities x86 = simd::query_x86_capabilities();
 
 	if (x86.sse41) {
-#define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ &typeid(packed_##format), simd::unpack_##format##_##cpu }
+#define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ \
+  &typeid(packed_##format), simd::unpack_##format##_##cpu, simd::unpack_##format##_2d_##cpu, simd::unpack_##format##_2d_nt_##cpu }
 		ENTRY(argb32_be, sse41);
 		ENTRY(argb32_le, sse41);
 		ENTRY(rgba32_be, sse41);
 		ENTRY(rgba32_le, sse41);
 #undef ENTRY
+
+#define ENTRY(format, cpu) \
+  table[idx++] = unpack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, uint16_t>), simd::unpack_##format##_w16_##cpu, simd::unpack_##format##_w16_2d_##cpu, nullptr }; \
+  table[idx++] = unpack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, uint16_t, 16, true>), simd::unpack_##format##_w16r_##cpu, simd::unpack_##format##_w16r_2d_##cpu, nullptr }; \
+  table[idx++] = unpack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, float>), simd::unpack_##format##_f32_##cpu, simd::unpack_##format##_f32_2d_##cpu, nullptr }
+		ENTRY(argb32_be, sse41);
+		ENTRY(argb32_le, sse41);
+		ENTRY(rgba32_be, sse41);
+		ENTRY(rgba32_le, sse41);
+#undef ENTRY
+	}
+	if (x86.f16c) {
+#define ENTRY(format, cpu) table[idx++] = unpack_table_entry{ \
+  &typeid(rescale_traits<packed_##format, half>), simd::unpack_##format##_f16_##cpu, simd::unpack_##format##_f16_2d_##cpu, nullptr }
+		ENTRY(argb32_be, f16c);
+		ENTRY(argb32_le, f16c);
+		ENTRY(rgba32_be, f16c);
+		ENTRY(rgba32_le, f16c);
+#undef ENTRY
 	}
 #endif
 
@@ -46,11 +69,39 @@ auto populate_pack_table()
 	simd::X86Capabilities x86 = simd::query_x86_capabilities();
 
 	if (x86.sse41) {
-#define ENTRY(format, cpu) table[idx++] = pack_table_entry{ &typeid(packed_##format), simd::pack_##format##_0_##cpu, simd::pack_##format##_1_##cpu }
+#define ENTRY(format, cpu) table[idx++] = pack_table_entry{ \
+  &typeid(packed_##format), simd::pack_##format##_0_##cpu, simd::pack_##format##_1_##cpu, simd::pack_##format##_0_2d_##cpu, simd::pack_##format##_1_2d_##cpu, \
+  simd::pack_##format##_0_2d_nt_##cpu, simd::pack_##format##_1_2d_nt_##cpu }
+		ENTRY(argb32_be, sse41);
+		ENTRY(argb32_le, sse41);
+		ENTRY(rgba32_be, sse41);
+		ENTRY(rgba32_le, sse41);
+#undef ENTRY
+
+#define ENTRY(format, cpu) \
+  table[idx++] = pack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, uint16_t>), simd::pack_##format##_w16_0_##cpu, simd::pack_##format##_w16_1_##cpu, \
+    simd::pack_##format##_w16_0_2d_##cpu, simd::pack_##format##_w16_1_2d_##cpu, nullptr, nullptr }; \
+  table[idx++] = pack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, uint16_t, 16, true>), simd::pack_##format##_w16r_0_##cpu, simd::pack_##format##_w16r_1_##cpu, \
+    simd::pack_##format##_w16r_0_2d_##cpu, simd::pack_##format##_w16r_1_2d_##cpu, nullptr, nullptr }; \
+  table[idx++] = pack_table_entry{ \
+    &typeid(rescale_traits<packed_##format, float>), simd::pack_##format##_f32_0_##cpu, simd::pack_##format##_f32_1_##cpu, \
+    simd::pack_##format##_f32_0_2d_##cpu, simd::pack_##format##_f32_1_2d_##cpu, nullptr, nullptr }
 		ENTRY(argb32_be, sse41);
 		ENTRY(argb32_le, sse41);
 		ENTRY(rgba32_be, sse41);
 		ENTRY(rgba32_le, sse41);
+#undef ENTRY
+	}
+	if (x86.f16c) {
+#define ENTRY(format, cpu) table[idx++] = pack_table_entry{ \
+  &typeid(rescale_traits<packed_##format, half>), simd::pack_##format##_f16_0_##cpu, simd::pack_##format##_f16_1_##cpu, \
+  simd::pack_##format##_f16_0_2d_##cpu, simd::pack_##format##_f16_1_2d_##cpu, nullptr, nullptr }
+		ENTRY(argb32_be, f16c);
+		ENTRY(argb32_le, f16c);
+		ENTRY(rgba32_be, f16c);
+		ENTRY(rgba32_le, f16c);
 #undef ENTRY
 	}
 #endif
@@ -58,33 +109,178 @@ auto populate_pack_table()
 	return table;
 }
 
-} // namespace
-
-
-unpack_func search_unpack_func(const std::type_info &ti)
+const unpack_table_entry *search_unpack_table(const std::type_info &ti)
 {
 	static const auto g_unpack_table = populate_unpack_table();
 
 	for (const auto &entry : g_unpack_table) {
-		if (entry.first == &ti)
-			return entry.second;
-		if (!entry.first)
+		if (std::get<0>(entry) == &ti)
+			return &entry;
+		if (!std::get<0>(entry))
 			break;
 	}
 	return nullptr;
 }
 
-pack_func search_pack_func(const std::type_info &ti, bool alpha_one_fill)
+const pack_table_entry *search_pack_table(const std::type_info &ti)
 {
 	static const auto g_pack_table = populate_pack_table();
 
 	for (const auto &entry : g_pack_table) {
 		if (std::get<0>(entry) == &ti)
-			return alpha_one_fill ? std::get<2>(entry) : std::get<1>(entry);
+			return &entry;
 		if (!std::get<0>(entry))
 			break;
 	}
+	return nullptr;
+}
+
+} // namespace
 
+
+unpack_func search_unpack_func(const std::type_info &ti)
+{
+	const unpack_table_entry *entry = search_unpack_table(ti);
+	return entry ? std::get<1>(*entry) : nullptr;
+}
+
+pack_func search_pack_func(const std::type_info &ti, bool alpha_one_fill)
+{
+	const pack_table_entry *entry = search_pack_table(ti);
+	if (!entry)
+		return nullptr;
+	return alpha_one_fill ? std::get<2>(*entry) : std::get<1>(*entry);
+}
+
+unpack_2d_func search_unpack_2d_func(const std::type_info &ti)
+{
+	const unpack_table_entry *entry = search_unpack_table(ti);
+	return entry ? std::get<2>(*entry) : nullptr;
+}
+
+pack_2d_func search_pack_2d_func(const std::type_info &ti, bool alpha_one_fill)
+{
+	const pack_table_entry *entry = search_pack_table(ti);
+	if (!entry)
+		return nullptr;
+	return alpha_one_fill ? std::get<4>(*entry) : std::get<3>(*entry);
+}
+
+unpack_2d_func search_unpack_2d_nt_func(const std::type_info &ti)
+{
+	const unpack_table_entry *entry = search_unpack_table(ti);
+	return entry ? std::get<3>(*entry) : nullptr;
+}
+
+pack_2d_func search_pack_2d_nt_func(const std::type_info &ti, bool alpha_one_fill)
+{
+	const pack_table_entry *entry = search_pack_table(ti);
+	if (!entry)
+		return nullptr;
+	return alpha_one_fill ? std::get<6>(*entry) : std::get<5>(*entry);
+}
+
+transform_func search_transform_func()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::transform_bytes_sse41;
+#endif
+	return nullptr;
+}
+
+row_filter_func search_row_filter_func(row_filter filter, unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_row_filter_sse41(filter, bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+chroma_resample_func search_chroma_resample_func(chroma_resample resample, unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_chroma_resample_sse41(resample, bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+alpha_func search_alpha_func(alpha_op op, unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_alpha_sse41(op, bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+matrix_func search_matrix_func(unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_matrix_sse41(bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+lut_func search_lut_func(unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().avx2)
+		return simd::select_lut_avx2(bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+dither_func search_dither_func(dither_mode mode)
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_dither_sse41(mode);
+#endif
+	return nullptr;
+}
+
+box_filter_func search_box_filter_func(unsigned scale, unsigned bytes_per_sample)
+{
+	if ((scale != 2 && scale != 4) || (bytes_per_sample != 1 && bytes_per_sample != 2))
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_box_filter_sse41(scale, bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+stats_func search_stats_func(unsigned bytes_per_sample)
+{
+	if (bytes_per_sample != 1 && bytes_per_sample != 2)
+		return nullptr;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse41)
+		return simd::select_stats_sse41(bytes_per_sample);
+#endif
+	return nullptr;
+}
+
+crc32c_func search_crc32c_func()
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+	if (simd::query_x86_capabilities().sse42)
+		return simd::select_crc32c_sse42();
+#endif
 	return nullptr;
 }
 
@@ -10,10 +10,21 @@
 namespace P2P_NAMESPACE {
 namespace simd {
 
-#define UNPACK(format, cpu) void unpack_##format##_##cpu(const void *, void * const *, unsigned, unsigned);
+#define UNPACK(format, cpu) \
+  void unpack_##format##_##cpu(const void *, void * const *, unsigned, unsigned); \
+  void unpack_##format##_2d_##cpu(const void *, ptrdiff_t, void * const *, const ptrdiff_t *, unsigned, unsigned, unsigned);
 #define PACK(format, cpu) \
   void pack_##format##_0_##cpu(const void * const *, void *, unsigned, unsigned); \
-  void pack_##format##_1_##cpu(const void * const *, void *, unsigned, unsigned);
+  void pack_##format##_1_##cpu(const void * const *, void *, unsigned, unsigned); \
+  void pack_##format##_0_2d_##cpu(const void * const *, const ptrdiff_t *, void *, ptrdiff_t, unsigned, unsigned, unsigned); \
+  void pack_##format##_1_2d_##cpu(const void * const *, const ptrdiff_t *, void *, ptrdiff_t, unsigned, unsigned, unsigned);
+
+// Variants with non-temporal stores. The caller issues the store fence.
+#define UNPACK_NT(format, cpu) \
+  void unpack_##format##_2d_nt_##cpu(const void *, ptrdiff_t, void * const *, const ptrdiff_t *, unsigned, unsigned, unsigned);
+#define PACK_NT(format, cpu) \
+  void pack_##format##_0_2d_nt_##cpu(const void * const *, const ptrdiff_t *, void *, ptrdiff_t, unsigned, unsigned, unsigned); \
+  void pack_##format##_1_2d_nt_##cpu(const void * const *, const ptrdiff_t *, void *, ptrdiff_t, unsigned, unsigned, unsigned);
 
 #if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
 UNPACK(argb32_be, sse41)
@@ -25,8 +36,73 @@ PACK(argb32_be, sse41)
 PACK(argb32_le, sse41)
 PACK(rgba32_be, sse41)
 PACK(rgba32_le, sse41)
+
+UNPACK_NT(argb32_be, sse41)
+UNPACK_NT(argb32_le, sse41)
+UNPACK_NT(rgba32_be, sse41)
+UNPACK_NT(rgba32_le, sse41)
+
+PACK_NT(argb32_be, sse41)
+PACK_NT(argb32_le, sse41)
+PACK_NT(rgba32_be, sse41)
+PACK_NT(rgba32_le, sse41)
+
+// Variants with 16-bit planar samples. The "w16r" variants scale by bit replication.
+UNPACK(argb32_be_w16, sse41)
+UNPACK(argb32_le_w16, sse41)
+UNPACK(rgba32_be_w16, sse41)
+UNPACK(rgba32_le_w16, sse41)
+
+UNPACK(argb32_be_w16r, sse41)
+UNPACK(argb32_le_w16r, sse41)
+UNPACK(rgba32_be_w16r, sse41)
+UNPACK(rgba32_le_w16r, sse41)
+
+PACK(argb32_be_w16, sse41)
+PACK(argb32_le_w16, sse41)
+PACK(rgba32_be_w16, sse41)
+PACK(rgba32_le_w16, sse41)
+
+PACK(argb32_be_w16r, sse41)
+PACK(argb32_le_w16r, sse41)
+PACK(rgba32_be_w16r, sse41)
+PACK(rgba32_le_w16r, sse41)
+
+// Variants with float planar samples, and half-precision samples with F16C.
+UNPACK(argb32_be_f32, sse41)
+UNPACK(argb32_le_f32, sse41)
+UNPACK(rgba32_be_f32, sse41)
+UNPACK(rgba32_le_f32, sse41)
+
+PACK(argb32_be_f32, sse41)
+PACK(argb32_le_f32, sse41)
+PACK(rgba32_be_f32, sse41)
+PACK(rgba32_le_f32, sse41)
+
+UNPACK(argb32_be_f16, f16c)
+UNPACK(argb32_le_f16, f16c)
+UNPACK(rgba32_be_f16, f16c)
+UNPACK(rgba32_le_f16, f16c)
+
+PACK(argb32_be_f16, f16c)
+PACK(argb32_le_f16, f16c)
+PACK(rgba32_be_f16, f16c)
+PACK(rgba32_le_f16, f16c)
+
+void transform_bytes_sse41(const void *src, void *dst, size_t n, const detail::byte_transform &t);
+detail::row_filter_func select_row_filter_sse41(detail::row_filter filter, unsigned bytes_per_sample);
+detail::chroma_resample_func select_chroma_resample_sse41(detail::chroma_resample resample, unsigned bytes_per_sample);
+detail::alpha_func select_alpha_sse41(detail::alpha_op op, unsigned bytes_per_sample);
+detail::matrix_func select_matrix_sse41(unsigned bytes_per_sample);
+detail::dither_func select_dither_sse41(detail::dither_mode mode);
+detail::box_filter_func select_box_filter_sse41(unsigned scale, unsigned bytes_per_sample);
+detail::stats_func select_stats_sse41(unsigned bytes_per_sample);
+detail::crc32c_func select_crc32c_sse42();
+detail::lut_func select_lut_avx2(unsigned bytes_per_sample);
 #endif // x86
 
+#undef PACK_NT
+#undef UNPACK_NT
 #undef PACK
 #undef UNPACK
 
@@ -1,7 +1,9 @@
 #ifdef P2P_SIMD
 #if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <smmintrin.h>
 #include "../p2p.h"
 
@@ -16,7 +18,22 @@ uint32_t extract_epi32(__m128i x)
 	return Idx == 0 ? _mm_cvtsi128_si32(x) : _mm_extract_epi32(x, Idx);
 }
 
-template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA>
+// Store a vector, bypassing the cache if requested and the address allows it.
+template <bool Stream>
+void store_si128(void *p, __m128i x, bool aligned)
+{
+	if (Stream && aligned)
+		_mm_stream_si128((__m128i *)p, x);
+	else
+		_mm_storeu_si128((__m128i *)p, x);
+}
+
+bool is_aligned16(const void *p)
+{
+	return !(reinterpret_cast<uintptr_t>(p) & 15);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool Stream>
 void unpack_rgb32_sse41(const void *src, void * const * dst, unsigned left, unsigned right)
 {
 	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
@@ -30,6 +47,8 @@ void unpack_rgb32_sse41(const void *src, void * const * dst, unsigned left, unsi
 	if (!dst_a)
 		dst_a = dst_r; // Write alpha to some other channel if disabled.
 
+	bool aligned = is_aligned16(dst_r) && is_aligned16(dst_g) && is_aligned16(dst_b) && is_aligned16(dst_a);
+
 	size_t vec4_left = (left + 3) & ~3U;
 	size_t vec16_left = (left + 15) & ~15U;
 	size_t vec16_right = right & ~15U;
@@ -71,10 +90,10 @@ void unpack_rgb32_sse41(const void *src, void * const * dst, unsigned left, unsi
 		x0 = _mm_castps_si128(x0s); x1 = _mm_castps_si128(x1s); x2 = _mm_castps_si128(x2s); x3 = _mm_castps_si128(x3s);
 
 		__m128i regs[4] = { x0, x1, x2, x3 };
-		_mm_storeu_si128((__m128i *)(dst_a + i), regs[IdxA]);
-		_mm_storeu_si128((__m128i *)(dst_r + i), regs[IdxR]);
-		_mm_storeu_si128((__m128i *)(dst_g + i), regs[IdxG]);
-		_mm_storeu_si128((__m128i *)(dst_b + i), regs[IdxB]);
+		store_si128<Stream>(dst_a + i, regs[IdxA], aligned);
+		store_si128<Stream>(dst_r + i, regs[IdxR], aligned);
+		store_si128<Stream>(dst_g + i, regs[IdxG], aligned);
+		store_si128<Stream>(dst_b + i, regs[IdxB], aligned);
 	};
 
 	for (size_t i = left; i < vec4_left; ++i)
@@ -89,7 +108,7 @@ void unpack_rgb32_sse41(const void *src, void * const * dst, unsigned left, unsi
 		scalar_iter(i);
 }
 
-template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill>
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill, bool Stream>
 void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigned right)
 {
 #define X (AlphaOneFill ? 0xFF : 0)
@@ -103,6 +122,7 @@ void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigne
 	const uint8_t *src_a = static_cast<const uint8_t *>(src[3]);
 	size_t alpha_addr_mask = ~static_cast<size_t>(0);
 	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+	bool aligned = is_aligned16(dst_p);
 
 	size_t vec4_left = (left + 3) & ~3U;
 	size_t vec16_left = (left + 15) & ~15U;
@@ -167,10 +187,10 @@ void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigne
 		x2 = _mm_shuffle_epi8(x2, shuffle);
 		x3 = _mm_shuffle_epi8(x3, shuffle);
 
-		_mm_storeu_si128((__m128i *)(dst_p + i + 0), x0);
-		_mm_storeu_si128((__m128i *)(dst_p + i + 4), x1);
-		_mm_storeu_si128((__m128i *)(dst_p + i + 8), x2);
-		_mm_storeu_si128((__m128i *)(dst_p + i + 12), x3);
+		store_si128<Stream>(dst_p + i + 0, x0, aligned);
+		store_si128<Stream>(dst_p + i + 4, x1, aligned);
+		store_si128<Stream>(dst_p + i + 8, x2, aligned);
+		store_si128<Stream>(dst_p + i + 12, x3, aligned);
 	};
 
 	for (size_t i = left; i < vec4_left; ++i)
@@ -185,21 +205,396 @@ void pack_rgb32_sse41(const void * const *src, void *dst, unsigned left, unsigne
 		scalar_iter(i);
 }
 
+// Variants with 16-bit planar samples. Widening places the byte in the MSB and
+// fills the LSB with zeros or a copy of the byte. Narrowing rounds x / 256, or
+// x / 257 when replicating, computed as (t - (t >> 8)) >> 8 with t = x + 128.
+template <bool BitReplicate>
+uint16_t widen_u8(uint8_t x)
+{
+	return static_cast<uint16_t>(detail::rescale_depth<BitReplicate>(x, 8, 16));
+}
+
+template <bool BitReplicate>
+uint8_t narrow_u16(uint16_t x)
+{
+	return static_cast<uint8_t>(detail::rescale_depth<BitReplicate>(x, 16, 8));
+}
+
+template <bool BitReplicate>
+__m128i narrow_epu16(__m128i x)
+{
+	__m128i t = _mm_adds_epu16(x, _mm_set1_epi16(0x80));
+	if (BitReplicate)
+		t = _mm_sub_epi16(t, _mm_srli_epi16(t, 8));
+	return _mm_srli_epi16(t, 8);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool BitReplicate>
+void unpack_rgb32_w16_sse41(const void *src, void * const * dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	uint16_t *dst_r = static_cast<uint16_t *>(dst[0]);
+	uint16_t *dst_g = static_cast<uint16_t *>(dst[1]);
+	uint16_t *dst_b = static_cast<uint16_t *>(dst[2]);
+	uint16_t *dst_a = static_cast<uint16_t *>(dst[3]);
+
+	if (!dst_a)
+		dst_a = dst_r; // Write alpha to some other channel if disabled.
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	// Must always write alpha component first!
+	auto scalar_iter = [&](size_t i)
+	{
+		uint32_t x = src_p[i];
+		dst_a[i] = widen_u8<BitReplicate>(static_cast<uint8_t>(x >> (IdxA * 8)));
+		dst_r[i] = widen_u8<BitReplicate>(static_cast<uint8_t>(x >> (IdxR * 8)));
+		dst_g[i] = widen_u8<BitReplicate>(static_cast<uint8_t>(x >> (IdxG * 8)));
+		dst_b[i] = widen_u8<BitReplicate>(static_cast<uint8_t>(x >> (IdxB * 8)));
+	};
+	auto store_widened = [&](uint16_t *p, __m128i x)
+	{
+		__m128i lsb = BitReplicate ? x : _mm_setzero_si128();
+		_mm_storeu_si128((__m128i *)p, _mm_unpacklo_epi8(lsb, x));
+		_mm_storeu_si128((__m128i *)(p + 8), _mm_unpackhi_epi8(lsb, x));
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(src_p + i));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(src_p + i + 4));
+		__m128i x2 = _mm_loadu_si128((const __m128i *)(src_p + i + 8));
+		__m128i x3 = _mm_loadu_si128((const __m128i *)(src_p + i + 12));
+
+		x0 = _mm_shuffle_epi8(x0, shuffle);
+		x1 = _mm_shuffle_epi8(x1, shuffle);
+		x2 = _mm_shuffle_epi8(x2, shuffle);
+		x3 = _mm_shuffle_epi8(x3, shuffle);
+
+		__m128 x0s = _mm_castsi128_ps(x0), x1s = _mm_castsi128_ps(x1), x2s = _mm_castsi128_ps(x2), x3s = _mm_castsi128_ps(x3);
+		_MM_TRANSPOSE4_PS(x0s, x1s, x2s, x3s);
+		x0 = _mm_castps_si128(x0s); x1 = _mm_castps_si128(x1s); x2 = _mm_castps_si128(x2s); x3 = _mm_castps_si128(x3s);
+
+		__m128i regs[4] = { x0, x1, x2, x3 };
+		store_widened(dst_a + i, regs[IdxA]);
+		store_widened(dst_r + i, regs[IdxR]);
+		store_widened(dst_g + i, regs[IdxG]);
+		store_widened(dst_b + i, regs[IdxB]);
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool BitReplicate, bool AlphaOneFill>
+void pack_rgb32_w16_sse41(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+	const __m128i alpha_fill = _mm_set1_epi8(AlphaOneFill ? -1 : 0);
+
+	const uint16_t *src_r = static_cast<const uint16_t *>(src[0]);
+	const uint16_t *src_g = static_cast<const uint16_t *>(src[1]);
+	const uint16_t *src_b = static_cast<const uint16_t *>(src[2]);
+	const uint16_t *src_a = static_cast<const uint16_t *>(src[3]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	auto scalar_iter = [&](size_t i)
+	{
+		uint8_t r = narrow_u16<BitReplicate>(src_r[i]);
+		uint8_t g = narrow_u16<BitReplicate>(src_g[i]);
+		uint8_t b = narrow_u16<BitReplicate>(src_b[i]);
+		uint8_t a = src_a ? narrow_u16<BitReplicate>(src_a[i]) : AlphaOneFill ? 0xFF : 0;
+
+		uint32_t val = (static_cast<uint32_t>(r) << (IdxR * 8)) |
+			(static_cast<uint32_t>(g) << (IdxG * 8)) |
+			(static_cast<uint32_t>(b) << (IdxB * 8)) |
+			(static_cast<uint32_t>(a) << (IdxA * 8));
+		dst_p[i] = val;
+	};
+	auto load_narrowed = [&](const uint16_t *p)
+	{
+		__m128i lo = narrow_epu16<BitReplicate>(_mm_loadu_si128((const __m128i *)p));
+		__m128i hi = narrow_epu16<BitReplicate>(_mm_loadu_si128((const __m128i *)(p + 8)));
+		return _mm_packus_epi16(lo, hi);
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i r = load_narrowed(src_r + i);
+		__m128i g = load_narrowed(src_g + i);
+		__m128i b = load_narrowed(src_b + i);
+		__m128i a = src_a ? load_narrowed(src_a + i) : alpha_fill;
+
+		__m128 regs[4];
+		regs[IdxR] = _mm_castsi128_ps(r);
+		regs[IdxG] = _mm_castsi128_ps(g);
+		regs[IdxB] = _mm_castsi128_ps(b);
+		regs[IdxA] = _mm_castsi128_ps(a);
+		_MM_TRANSPOSE4_PS(regs[0], regs[1], regs[2], regs[3]);
+
+		__m128i x0 = _mm_castps_si128(regs[0]), x1 = _mm_castps_si128(regs[1]), x2 = _mm_castps_si128(regs[2]), x3 = _mm_castps_si128(regs[3]);
+		_mm_storeu_si128((__m128i *)(dst_p + i + 0), _mm_shuffle_epi8(x0, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 4), _mm_shuffle_epi8(x1, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 8), _mm_shuffle_epi8(x2, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 12), _mm_shuffle_epi8(x3, shuffle));
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+// Variants with float planar samples, normalized to [0, 1]. The scalar and
+// vector paths use the same operations as planar_codec, so that both round
+// identically. Packing clamps with max(x, 0) first, which maps NaN to zero.
+typedef detail::planar_codec<float, 0, false> float_codec;
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA>
+void unpack_rgb32_f32_sse41(const void *src, void * const * dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+	const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+	const uint32_t *src_p = static_cast<const uint32_t *>(src);
+	float *dst_r = static_cast<float *>(dst[0]);
+	float *dst_g = static_cast<float *>(dst[1]);
+	float *dst_b = static_cast<float *>(dst[2]);
+	float *dst_a = static_cast<float *>(dst[3]);
+
+	if (!dst_a)
+		dst_a = dst_r; // Write alpha to some other channel if disabled.
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	// Must always write alpha component first!
+	auto scalar_iter = [&](size_t i)
+	{
+		uint32_t x = src_p[i];
+		dst_a[i] = float_codec::decode((x >> (IdxA * 8)) & 0xFFU, 8);
+		dst_r[i] = float_codec::decode((x >> (IdxR * 8)) & 0xFFU, 8);
+		dst_g[i] = float_codec::decode((x >> (IdxG * 8)) & 0xFFU, 8);
+		dst_b[i] = float_codec::decode((x >> (IdxB * 8)) & 0xFFU, 8);
+	};
+	auto store_scaled = [&](float *p, __m128i x)
+	{
+		_mm_storeu_ps(p + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(x)), scale));
+		_mm_storeu_ps(p + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(x, 4))), scale));
+		_mm_storeu_ps(p + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(x, 8))), scale));
+		_mm_storeu_ps(p + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(x, 12))), scale));
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(src_p + i));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(src_p + i + 4));
+		__m128i x2 = _mm_loadu_si128((const __m128i *)(src_p + i + 8));
+		__m128i x3 = _mm_loadu_si128((const __m128i *)(src_p + i + 12));
+
+		x0 = _mm_shuffle_epi8(x0, shuffle);
+		x1 = _mm_shuffle_epi8(x1, shuffle);
+		x2 = _mm_shuffle_epi8(x2, shuffle);
+		x3 = _mm_shuffle_epi8(x3, shuffle);
+
+		__m128 x0s = _mm_castsi128_ps(x0), x1s = _mm_castsi128_ps(x1), x2s = _mm_castsi128_ps(x2), x3s = _mm_castsi128_ps(x3);
+		_MM_TRANSPOSE4_PS(x0s, x1s, x2s, x3s);
+		x0 = _mm_castps_si128(x0s); x1 = _mm_castps_si128(x1s); x2 = _mm_castps_si128(x2s); x3 = _mm_castps_si128(x3s);
+
+		__m128i regs[4] = { x0, x1, x2, x3 };
+		store_scaled(dst_a + i, regs[IdxA]);
+		store_scaled(dst_r + i, regs[IdxR]);
+		store_scaled(dst_g + i, regs[IdxG]);
+		store_scaled(dst_b + i, regs[IdxB]);
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+template <unsigned IdxR, unsigned IdxG, unsigned IdxB, unsigned IdxA, bool AlphaOneFill>
+void pack_rgb32_f32_sse41(const void * const *src, void *dst, unsigned left, unsigned right)
+{
+	const __m128i shuffle = _mm_set_epi8(15, 11, 7, 3, 14, 10, 6, 2, 13, 9, 5, 1, 12, 8, 4, 0);
+	const __m128i alpha_fill = _mm_set1_epi8(AlphaOneFill ? -1 : 0);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 scale = _mm_set1_ps(255.0f);
+	const __m128 round = _mm_set1_ps(0.5f);
+
+	const float *src_r = static_cast<const float *>(src[0]);
+	const float *src_g = static_cast<const float *>(src[1]);
+	const float *src_b = static_cast<const float *>(src[2]);
+	const float *src_a = static_cast<const float *>(src[3]);
+	uint32_t *dst_p = static_cast<uint32_t *>(dst);
+
+	size_t vec16_left = (left + 15) & ~15U;
+	size_t vec16_right = right & ~15U;
+
+	if (vec16_left > right)
+		vec16_left = vec16_right = right;
+
+	auto scalar_iter = [&](size_t i)
+	{
+		uint32_t r = float_codec::encode(src_r[i], 8);
+		uint32_t g = float_codec::encode(src_g[i], 8);
+		uint32_t b = float_codec::encode(src_b[i], 8);
+		uint32_t a = src_a ? float_codec::encode(src_a[i], 8) : AlphaOneFill ? 0xFF : 0;
+
+		dst_p[i] = (r << (IdxR * 8)) | (g << (IdxG * 8)) | (b << (IdxB * 8)) | (a << (IdxA * 8));
+	};
+	auto quantize = [&](const float *p)
+	{
+		__m128 x = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(p), _mm_setzero_ps()), one);
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, scale), round));
+	};
+	auto load_quantized = [&](const float *p)
+	{
+		__m128i lo = _mm_packus_epi32(quantize(p), quantize(p + 4));
+		__m128i hi = _mm_packus_epi32(quantize(p + 8), quantize(p + 12));
+		return _mm_packus_epi16(lo, hi);
+	};
+	auto vec16_iter = [&](size_t i)
+	{
+		__m128i r = load_quantized(src_r + i);
+		__m128i g = load_quantized(src_g + i);
+		__m128i b = load_quantized(src_b + i);
+		__m128i a = src_a ? load_quantized(src_a + i) : alpha_fill;
+
+		__m128 regs[4];
+		regs[IdxR] = _mm_castsi128_ps(r);
+		regs[IdxG] = _mm_castsi128_ps(g);
+		regs[IdxB] = _mm_castsi128_ps(b);
+		regs[IdxA] = _mm_castsi128_ps(a);
+		_MM_TRANSPOSE4_PS(regs[0], regs[1], regs[2], regs[3]);
+
+		__m128i x0 = _mm_castps_si128(regs[0]), x1 = _mm_castps_si128(regs[1]), x2 = _mm_castps_si128(regs[2]), x3 = _mm_castps_si128(regs[3]);
+		_mm_storeu_si128((__m128i *)(dst_p + i + 0), _mm_shuffle_epi8(x0, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 4), _mm_shuffle_epi8(x1, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 8), _mm_shuffle_epi8(x2, shuffle));
+		_mm_storeu_si128((__m128i *)(dst_p + i + 12), _mm_shuffle_epi8(x3, shuffle));
+	};
+
+	for (size_t i = left; i < vec16_left; ++i)
+		scalar_iter(i);
+	for (size_t i = vec16_left; i < vec16_right; i += 16)
+		vec16_iter(i);
+	for (size_t i = vec16_right; i < right; ++i)
+		scalar_iter(i);
+}
+
+// Bytes prefetched at the start of the next row. The hardware prefetcher
+// follows a row once it is being read, but cannot predict the jump across the
+// stride to the next one.
+const size_t row_prefetch_bytes = 256;
+
+void prefetch_row(const void *row, size_t offset)
+{
+	for (size_t i = 0; i < row_prefetch_bytes; i += 64) {
+		_mm_prefetch(static_cast<const char *>(row) + offset + i, _MM_HINT_T0);
+	}
+}
+
+// Multi-row kernels run the line kernel on each row, and prefetch the next
+// row while converting the current one.
+template <void (*Unpack)(const void *, void * const *, unsigned, unsigned)>
+void unpack_2d_sse41(const void *src, ptrdiff_t src_stride, void * const *dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		if (i + 1 < height)
+			prefetch_row(detail::increment_ptr(src, src_stride), static_cast<size_t>(left) * 4);
+
+		Unpack(src, dst_p, left, right);
+
+		src = detail::increment_ptr(src, src_stride);
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = detail::increment_ptr(dst_p[p], dst_stride[p]);
+		}
+	}
+}
+
+template <void (*Pack)(const void * const *, void *, unsigned, unsigned), unsigned BytesPerSample>
+void pack_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		for (unsigned p = 0; p < 4 && i + 1 < height; ++p) {
+			if (src_p[p])
+				prefetch_row(detail::increment_ptr(src_p[p], src_stride[p]), static_cast<size_t>(left) * BytesPerSample);
+		}
+
+		Pack(src_p, dst, left, right);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = detail::increment_ptr(src_p[p], src_stride[p]);
+		}
+		dst = detail::increment_ptr(dst, dst_stride);
+	}
+}
+
 } // namespace
 
 
 #define RGB32_SSE41(format, a, b, c, d) \
   void unpack_##format##_sse41(const void *src, void * const * dst, unsigned left, unsigned right) \
   { \
-    unpack_rgb32_sse41<a, b, c, d>(src, dst, left, right); \
+    unpack_rgb32_sse41<a, b, c, d, false>(src, dst, left, right); \
   } \
   void pack_##format##_0_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
   { \
-    pack_rgb32_sse41<a, b, c, d, 0>(src, dst, left, right); \
+    pack_rgb32_sse41<a, b, c, d, 0, false>(src, dst, left, right); \
   } \
   void pack_##format##_1_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
   { \
-    pack_rgb32_sse41<a, b, c, d, 1>(src, dst, left, right); \
+    pack_rgb32_sse41<a, b, c, d, 1, false>(src, dst, left, right); \
+  } \
+  void unpack_##format##_2d_sse41(const void *src, ptrdiff_t src_stride, void * const * dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    unpack_2d_sse41<unpack_rgb32_sse41<a, b, c, d, false>>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_0_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_sse41<a, b, c, d, 0, false>, 1>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_1_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_sse41<a, b, c, d, 1, false>, 1>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void unpack_##format##_2d_nt_sse41(const void *src, ptrdiff_t src_stride, void * const * dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    unpack_2d_sse41<unpack_rgb32_sse41<a, b, c, d, true>>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_0_2d_nt_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_sse41<a, b, c, d, 0, true>, 1>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_1_2d_nt_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_sse41<a, b, c, d, 1, true>, 1>(src, src_stride, dst, dst_stride, left, right, height); \
   }
 
 RGB32_SSE41(argb32_be, 1, 2, 3, 0)
@@ -207,6 +602,944 @@ RGB32_SSE41(argb32_le, 2, 1, 0, 3)
 RGB32_SSE41(rgba32_be, 0, 1, 2, 3)
 RGB32_SSE41(rgba32_le, 3, 2, 1, 0)
 
+#define RGB32_W16_SSE41_IMPL(format, a, b, c, d, r) \
+  void unpack_##format##_sse41(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb32_w16_sse41<a, b, c, d, r>(src, dst, left, right); \
+  } \
+  void pack_##format##_0_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_w16_sse41<a, b, c, d, r, 0>(src, dst, left, right); \
+  } \
+  void pack_##format##_1_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_w16_sse41<a, b, c, d, r, 1>(src, dst, left, right); \
+  } \
+  void unpack_##format##_2d_sse41(const void *src, ptrdiff_t src_stride, void * const * dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    unpack_2d_sse41<unpack_rgb32_w16_sse41<a, b, c, d, r>>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_0_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_w16_sse41<a, b, c, d, r, 0>, 2>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_1_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_w16_sse41<a, b, c, d, r, 1>, 2>(src, src_stride, dst, dst_stride, left, right, height); \
+  }
+#define RGB32_W16_SSE41(format, a, b, c, d) \
+  RGB32_W16_SSE41_IMPL(format##_w16, a, b, c, d, false) \
+  RGB32_W16_SSE41_IMPL(format##_w16r, a, b, c, d, true)
+
+RGB32_W16_SSE41(argb32_be, 1, 2, 3, 0)
+RGB32_W16_SSE41(argb32_le, 2, 1, 0, 3)
+RGB32_W16_SSE41(rgba32_be, 0, 1, 2, 3)
+RGB32_W16_SSE41(rgba32_le, 3, 2, 1, 0)
+
+#define RGB32_F32_SSE41(format, a, b, c, d) \
+  void unpack_##format##_f32_sse41(const void *src, void * const * dst, unsigned left, unsigned right) \
+  { \
+    unpack_rgb32_f32_sse41<a, b, c, d>(src, dst, left, right); \
+  } \
+  void pack_##format##_f32_0_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_f32_sse41<a, b, c, d, 0>(src, dst, left, right); \
+  } \
+  void pack_##format##_f32_1_sse41(const void * const *src, void *dst, unsigned left, unsigned right) \
+  { \
+    pack_rgb32_f32_sse41<a, b, c, d, 1>(src, dst, left, right); \
+  } \
+  void unpack_##format##_f32_2d_sse41(const void *src, ptrdiff_t src_stride, void * const * dst, const ptrdiff_t *dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    unpack_2d_sse41<unpack_rgb32_f32_sse41<a, b, c, d>>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_f32_0_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_f32_sse41<a, b, c, d, 0>, 4>(src, src_stride, dst, dst_stride, left, right, height); \
+  } \
+  void pack_##format##_f32_1_2d_sse41(const void * const *src, const ptrdiff_t *src_stride, void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height) \
+  { \
+    pack_2d_sse41<pack_rgb32_f32_sse41<a, b, c, d, 1>, 4>(src, src_stride, dst, dst_stride, left, right, height); \
+  }
+
+RGB32_F32_SSE41(argb32_be, 1, 2, 3, 0)
+RGB32_F32_SSE41(argb32_le, 2, 1, 0, 3)
+RGB32_F32_SSE41(rgba32_be, 0, 1, 2, 3)
+RGB32_F32_SSE41(rgba32_le, 3, 2, 1, 0)
+
+void transform_bytes_sse41(const void *src, void *dst, size_t n, const detail::byte_transform &t)
+{
+	const __m128i shuffle = _mm_loadu_si128((const __m128i *)t.shuffle);
+	const __m128i mask = _mm_loadu_si128((const __m128i *)t.mask);
+	const __m128i shuffle_out = _mm_loadu_si128((const __m128i *)t.shuffle_out);
+	const __m128i shift_right = _mm_cvtsi32_si128(t.shift_right);
+	const __m128i shift_left = _mm_cvtsi32_si128(t.shift_left);
+
+	auto transform = [&](__m128i x)
+	{
+		x = _mm_shuffle_epi8(x, shuffle);
+		x = _mm_sll_epi16(_mm_srl_epi16(x, shift_right), shift_left);
+		return _mm_shuffle_epi8(_mm_and_si128(x, mask), shuffle_out);
+	};
+
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	size_t i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + i));
+		_mm_storeu_si128((__m128i *)(dst_p + i), transform(x));
+	}
+	if (i < n) {
+		alignas(16) uint8_t tmp[16] = {};
+		memcpy(tmp, src_p + i, n - i);
+		_mm_store_si128((__m128i *)tmp, transform(_mm_load_si128((const __m128i *)tmp)));
+		memcpy(dst_p + i, tmp, n - i);
+	}
+}
+
+namespace {
+
+template <detail::row_filter Filter>
+uint32_t filter_sample(const void * const *src, unsigned i, unsigned bytes)
+{
+	auto load = [&](unsigned k) -> uint32_t
+	{
+		return bytes == 1 ? static_cast<const uint8_t *>(src[k])[i] : static_cast<const uint16_t *>(src[k])[i];
+	};
+
+	switch (Filter) {
+	case detail::row_average:
+		return (load(0) + load(1) + 1) >> 1;
+	case detail::row_interpolate:
+		return (3 * load(0) + load(1) + 2) >> 2;
+	default:
+		return (load(0) + 3 * (load(1) + load(2)) + load(3) + 4) >> 3;
+	}
+}
+
+// Weighted sum of 16-bit lanes of a row group, which cannot overflow for
+// 8-bit samples.
+template <detail::row_filter Filter>
+__m128i filter_epi16(const __m128i x[4])
+{
+	if (Filter == detail::row_interpolate) {
+		__m128i y = _mm_add_epi16(_mm_add_epi16(x[0], _mm_slli_epi16(x[0], 1)), x[1]);
+		return _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(2)), 2);
+	} else {
+		__m128i inner = _mm_add_epi16(x[1], x[2]);
+		__m128i y = _mm_add_epi16(_mm_add_epi16(x[0], x[3]), _mm_add_epi16(inner, _mm_slli_epi16(inner, 1)));
+		return _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(4)), 3);
+	}
+}
+
+// Likewise with 32-bit lanes for 16-bit samples.
+template <detail::row_filter Filter>
+__m128i filter_epi32(const __m128i x[4])
+{
+	if (Filter == detail::row_interpolate) {
+		__m128i y = _mm_add_epi32(_mm_add_epi32(x[0], _mm_slli_epi32(x[0], 1)), x[1]);
+		return _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(2)), 2);
+	} else {
+		__m128i inner = _mm_add_epi32(x[1], x[2]);
+		__m128i y = _mm_add_epi32(_mm_add_epi32(x[0], x[3]), _mm_add_epi32(inner, _mm_slli_epi32(inner, 1)));
+		return _mm_srli_epi32(_mm_add_epi32(y, _mm_set1_epi32(4)), 3);
+	}
+}
+
+template <detail::row_filter Filter>
+void filter_rows_u8_sse41(const void * const *src, void *dst, unsigned n)
+{
+	const unsigned taps = Filter == detail::row_smooth ? 4 : 2;
+	const __m128i zero = _mm_setzero_si128();
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		__m128i x[4];
+		for (unsigned k = 0; k < taps; ++k) {
+			x[k] = _mm_loadu_si128((const __m128i *)(static_cast<const uint8_t *>(src[k]) + i));
+		}
+
+		__m128i y;
+		if (Filter == detail::row_average) {
+			y = _mm_avg_epu8(x[0], x[1]);
+		} else {
+			__m128i lo[4], hi[4];
+			for (unsigned k = 0; k < taps; ++k) {
+				lo[k] = _mm_unpacklo_epi8(x[k], zero);
+				hi[k] = _mm_unpackhi_epi8(x[k], zero);
+			}
+			y = _mm_packus_epi16(filter_epi16<Filter>(lo), filter_epi16<Filter>(hi));
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + i), y);
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = static_cast<uint8_t>(filter_sample<Filter>(src, i, 1));
+	}
+}
+
+template <detail::row_filter Filter>
+void filter_rows_u16_sse41(const void * const *src, void *dst, unsigned n)
+{
+	const unsigned taps = Filter == detail::row_smooth ? 4 : 2;
+	const __m128i zero = _mm_setzero_si128();
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	unsigned i;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m128i x[4];
+		for (unsigned k = 0; k < taps; ++k) {
+			x[k] = _mm_loadu_si128((const __m128i *)(static_cast<const uint16_t *>(src[k]) + i));
+		}
+
+		__m128i y;
+		if (Filter == detail::row_average) {
+			y = _mm_avg_epu16(x[0], x[1]);
+		} else {
+			__m128i lo[4], hi[4];
+			for (unsigned k = 0; k < taps; ++k) {
+				lo[k] = _mm_cvtepu16_epi32(x[k]);
+				hi[k] = _mm_unpackhi_epi16(x[k], zero);
+			}
+			y = _mm_packus_epi32(filter_epi32<Filter>(lo), filter_epi32<Filter>(hi));
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + i), y);
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = static_cast<uint16_t>(filter_sample<Filter>(src, i, 2));
+	}
+}
+
+template <detail::chroma_resample Resample, class T>
+T resample_sample(const T *src, unsigned src_width, unsigned k)
+{
+	auto x = [=](int i) -> uint32_t { return src[std::min(std::max(i, 0), static_cast<int>(src_width) - 1)]; };
+	int i = 2 * k;
+	int h = k / 2;
+
+	switch (Resample) {
+	case detail::chroma_drop:
+		return static_cast<T>(x(i));
+	case detail::chroma_average:
+		return static_cast<T>((x(i) + x(i + 1) + 1) >> 1);
+	case detail::chroma_triangle:
+		return static_cast<T>((x(i - 1) + 2 * x(i) + x(i + 1) + 2) >> 2);
+	case detail::chroma_smooth:
+		return static_cast<T>((x(i - 1) + 3 * (x(i) + x(i + 1)) + x(i + 2) + 4) >> 3);
+	case detail::chroma_repeat:
+		return static_cast<T>(x(h));
+	case detail::chroma_linear_cosited:
+		return static_cast<T>(k % 2 ? (x(h) + x(h + 1) + 1) >> 1 : x(h));
+	default:
+		return static_cast<T>((3 * x(h) + x(k % 2 ? h + 1 : h - 1) + 2) >> 2);
+	}
+}
+
+// Decimation of even and odd samples, with the odd sample before and the even
+// sample after each pair, in 16-bit lanes for 8-bit samples.
+template <detail::chroma_resample Resample>
+__m128i decimate_epi16(__m128i prev, __m128i even, __m128i odd, __m128i next)
+{
+	switch (Resample) {
+	case detail::chroma_drop:
+		return even;
+	case detail::chroma_average:
+		return _mm_avg_epu16(even, odd);
+	case detail::chroma_triangle:
+		return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(prev, _mm_slli_epi16(even, 1)), _mm_add_epi16(odd, _mm_set1_epi16(2))), 2);
+	default: {
+		__m128i inner = _mm_add_epi16(even, odd);
+		__m128i outer = _mm_add_epi16(_mm_add_epi16(prev, next), _mm_set1_epi16(4));
+		return _mm_srli_epi16(_mm_add_epi16(outer, _mm_add_epi16(inner, _mm_slli_epi16(inner, 1))), 3);
+	}
+	}
+}
+
+// Likewise in 32-bit lanes for 16-bit samples.
+template <detail::chroma_resample Resample>
+__m128i decimate_epi32(__m128i prev, __m128i even, __m128i odd, __m128i next)
+{
+	switch (Resample) {
+	case detail::chroma_drop:
+		return even;
+	case detail::chroma_average:
+		return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), _mm_set1_epi32(1)), 1);
+	case detail::chroma_triangle:
+		return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(prev, _mm_slli_epi32(even, 1)), _mm_add_epi32(odd, _mm_set1_epi32(2))), 2);
+	default: {
+		__m128i inner = _mm_add_epi32(even, odd);
+		__m128i outer = _mm_add_epi32(_mm_add_epi32(prev, next), _mm_set1_epi32(4));
+		return _mm_srli_epi32(_mm_add_epi32(outer, _mm_add_epi32(inner, _mm_slli_epi32(inner, 1))), 3);
+	}
+	}
+}
+
+// Pairs of 8-bit samples are split by lane masks and shifts. Loads one pair
+// before and after the group feed the outer taps; edge groups are scalar.
+template <detail::chroma_resample Resample>
+void decimate_u8_sse41(const void *src, void *dst, unsigned src_width, unsigned dst_width)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned k = 0;
+
+	if (dst_width) {
+		dst_p[0] = resample_sample<Resample>(src_p, src_width, 0);
+		k = 1;
+	}
+
+	for (; k + 16 <= dst_width && 2 * k + 34 <= src_width; k += 16) {
+		const uint8_t *p = src_p + 2 * k;
+		__m128i y[2];
+
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(p + 16 * h));
+			__m128i prev = _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(p + 16 * h - 2)), 8);
+			__m128i next = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 16 * h + 2)), mask);
+			y[h] = decimate_epi16<Resample>(prev, _mm_and_si128(x, mask), _mm_srli_epi16(x, 8), next);
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + k), _mm_packus_epi16(y[0], y[1]));
+	}
+	for (; k < dst_width; ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+}
+
+template <detail::chroma_resample Resample>
+void decimate_u16_sse41(const void *src, void *dst, unsigned src_width, unsigned dst_width)
+{
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	unsigned k = 0;
+
+	if (dst_width) {
+		dst_p[0] = resample_sample<Resample>(src_p, src_width, 0);
+		k = 1;
+	}
+
+	for (; k + 8 <= dst_width && 2 * k + 18 <= src_width; k += 8) {
+		const uint16_t *p = src_p + 2 * k;
+		__m128i y[2];
+
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i x = _mm_loadu_si128((const __m128i *)(p + 8 * h));
+			__m128i prev = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)(p + 8 * h - 2)), 16);
+			__m128i next = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + 8 * h + 2)), mask);
+			y[h] = decimate_epi32<Resample>(prev, _mm_and_si128(x, mask), _mm_srli_epi32(x, 16), next);
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + k), _mm_packus_epi32(y[0], y[1]));
+	}
+	for (; k < dst_width; ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+}
+
+// Even and odd outputs of centered upsampling, from each sample and its
+// neighbours.
+void upsample_epi16(__m128i prev, __m128i x, __m128i next, __m128i *even, __m128i *odd)
+{
+	__m128i x3 = _mm_add_epi16(_mm_add_epi16(x, _mm_slli_epi16(x, 1)), _mm_set1_epi16(2));
+	*even = _mm_srli_epi16(_mm_add_epi16(x3, prev), 2);
+	*odd = _mm_srli_epi16(_mm_add_epi16(x3, next), 2);
+}
+
+void upsample_epi32(__m128i prev, __m128i x, __m128i next, __m128i *even, __m128i *odd)
+{
+	__m128i x3 = _mm_add_epi32(_mm_add_epi32(x, _mm_slli_epi32(x, 1)), _mm_set1_epi32(2));
+	*even = _mm_srli_epi32(_mm_add_epi32(x3, prev), 2);
+	*odd = _mm_srli_epi32(_mm_add_epi32(x3, next), 2);
+}
+
+// Each group of samples is loaded with its neighbours on either side, and the
+// even and odd outputs are interleaved. Edge groups are scalar.
+template <detail::chroma_resample Resample>
+void upsample_u8_sse41(const void *src, void *dst, unsigned src_width, unsigned dst_width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned k;
+
+	for (k = 0; k < std::min(dst_width, 2U); ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+
+	for (k = 1; k + 16 < src_width && 2 * k + 32 <= dst_width; k += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + k));
+		__m128i even = x;
+		__m128i odd = x;
+
+		if (Resample == detail::chroma_linear_cosited) {
+			odd = _mm_avg_epu8(x, _mm_loadu_si128((const __m128i *)(src_p + k + 1)));
+		} else if (Resample == detail::chroma_linear_centered) {
+			__m128i prev = _mm_loadu_si128((const __m128i *)(src_p + k - 1));
+			__m128i next = _mm_loadu_si128((const __m128i *)(src_p + k + 1));
+			__m128i even_lo, even_hi, odd_lo, odd_hi;
+
+			upsample_epi16(_mm_unpacklo_epi8(prev, zero), _mm_unpacklo_epi8(x, zero), _mm_unpacklo_epi8(next, zero), &even_lo, &odd_lo);
+			upsample_epi16(_mm_unpackhi_epi8(prev, zero), _mm_unpackhi_epi8(x, zero), _mm_unpackhi_epi8(next, zero), &even_hi, &odd_hi);
+			even = _mm_packus_epi16(even_lo, even_hi);
+			odd = _mm_packus_epi16(odd_lo, odd_hi);
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + 2 * k), _mm_unpacklo_epi8(even, odd));
+		_mm_storeu_si128((__m128i *)(dst_p + 2 * k + 16), _mm_unpackhi_epi8(even, odd));
+	}
+	for (k = std::max(2 * k, 2U); k < dst_width; ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+}
+
+template <detail::chroma_resample Resample>
+void upsample_u16_sse41(const void *src, void *dst, unsigned src_width, unsigned dst_width)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	unsigned k;
+
+	for (k = 0; k < std::min(dst_width, 2U); ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+
+	for (k = 1; k + 8 < src_width && 2 * k + 16 <= dst_width; k += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + k));
+		__m128i even = x;
+		__m128i odd = x;
+
+		if (Resample == detail::chroma_linear_cosited) {
+			odd = _mm_avg_epu16(x, _mm_loadu_si128((const __m128i *)(src_p + k + 1)));
+		} else if (Resample == detail::chroma_linear_centered) {
+			__m128i prev = _mm_loadu_si128((const __m128i *)(src_p + k - 1));
+			__m128i next = _mm_loadu_si128((const __m128i *)(src_p + k + 1));
+			__m128i even_lo, even_hi, odd_lo, odd_hi;
+
+			upsample_epi32(_mm_cvtepu16_epi32(prev), _mm_cvtepu16_epi32(x), _mm_cvtepu16_epi32(next), &even_lo, &odd_lo);
+			upsample_epi32(_mm_unpackhi_epi16(prev, zero), _mm_unpackhi_epi16(x, zero), _mm_unpackhi_epi16(next, zero), &even_hi, &odd_hi);
+			even = _mm_packus_epi32(even_lo, even_hi);
+			odd = _mm_packus_epi32(odd_lo, odd_hi);
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + 2 * k), _mm_unpacklo_epi16(even, odd));
+		_mm_storeu_si128((__m128i *)(dst_p + 2 * k + 8), _mm_unpackhi_epi16(even, odd));
+	}
+	for (k = std::max(2 * k, 2U); k < dst_width; ++k) {
+		dst_p[k] = resample_sample<Resample>(src_p, src_width, k);
+	}
+}
+
+// Scalar conversion of full-scale samples, for the row tails.
+template <detail::alpha_op Op, class T>
+T alpha_sample(T x, T a, bool centered)
+{
+	const uint32_t max = static_cast<T>(~0U);
+	uint32_t mid = centered ? max / 2 + 1 : 0;
+	bool negative = x < mid;
+	uint32_t m = negative ? mid - x : x - mid;
+	uint32_t r = 0;
+
+	if (Op == detail::alpha_premultiply)
+		r = static_cast<uint32_t>((2 * static_cast<uint64_t>(m) * a + max) / (2 * max));
+	else if (a)
+		r = static_cast<uint32_t>(std::min<uint64_t>((2 * static_cast<uint64_t>(m) * max + a) / (2 * a), negative ? mid : max - mid));
+	return static_cast<T>(negative ? mid - r : mid + r);
+}
+
+// Converted magnitudes of 8-bit samples widened to 16-bit lanes. Division by
+// 255 is exact with the usual add-and-shift, and reciprocals of alpha are
+// exact enough in single precision.
+template <detail::alpha_op Op>
+__m128i alpha_u8_epi16(__m128i m, __m128i a, __m128i limit)
+{
+	if (Op == detail::alpha_premultiply) {
+		__m128i t = _mm_add_epi16(_mm_mullo_epi16(m, a), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	}
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i q[2];
+
+	for (unsigned h = 0; h < 2; ++h) {
+		__m128 mf = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(m, zero) : _mm_unpacklo_epi16(m, zero));
+		__m128 af = _mm_cvtepi32_ps(h ? _mm_unpackhi_epi16(a, zero) : _mm_unpacklo_epi16(a, zero));
+		q[h] = _mm_cvttps_epi32(_mm_add_ps(_mm_div_ps(_mm_mul_ps(mf, _mm_set1_ps(255.0f)), af), _mm_set1_ps(0.5f)));
+	}
+	__m128i r = _mm_min_epi16(_mm_packs_epi32(q[0], q[1]), limit);
+	return _mm_andnot_si128(_mm_cmpeq_epi16(a, zero), r);
+}
+
+// Likewise for 16-bit samples, with 32-bit products and double precision
+// division.
+template <detail::alpha_op Op>
+__m128i alpha_u16_epi16(__m128i m, __m128i a, __m128i limit)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i r[2];
+
+	if (Op == detail::alpha_premultiply) {
+		__m128i lo = _mm_mullo_epi16(m, a);
+		__m128i hi = _mm_mulhi_epu16(m, a);
+
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i t = _mm_add_epi32(h ? _mm_unpackhi_epi16(lo, hi) : _mm_unpacklo_epi16(lo, hi), _mm_set1_epi32(32768));
+			r[h] = _mm_srli_epi32(_mm_add_epi32(t, _mm_srli_epi32(t, 16)), 16);
+		}
+		return _mm_packus_epi32(r[0], r[1]);
+	}
+
+	for (unsigned h = 0; h < 2; ++h) {
+		__m128i m32 = h ? _mm_unpackhi_epi16(m, zero) : _mm_unpacklo_epi16(m, zero);
+		__m128i a32 = h ? _mm_unpackhi_epi16(a, zero) : _mm_unpacklo_epi16(a, zero);
+		__m128i q[2];
+
+		for (unsigned k = 0; k < 2; ++k) {
+			__m128d md = _mm_cvtepi32_pd(k ? _mm_srli_si128(m32, 8) : m32);
+			__m128d ad = _mm_cvtepi32_pd(k ? _mm_srli_si128(a32, 8) : a32);
+			__m128d qd = _mm_add_pd(_mm_div_pd(_mm_mul_pd(md, _mm_set1_pd(65535.0)), ad), _mm_set1_pd(0.5));
+			q[k] = _mm_cvttpd_epi32(_mm_min_pd(qd, _mm_set1_pd(65535.0)));
+		}
+		r[h] = _mm_unpacklo_epi64(q[0], q[1]);
+	}
+	__m128i q = _mm_min_epu16(_mm_packus_epi32(r[0], r[1]), limit);
+	return _mm_andnot_si128(_mm_cmpeq_epi16(a, zero), q);
+}
+
+// Centered samples are biased to signed lanes, and converted by magnitude.
+template <detail::alpha_op Op>
+void alpha_u8_sse41(const void *src, const void *alpha, void *dst, unsigned n, const detail::alpha_scale &scale)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	const uint8_t *alpha_p = static_cast<const uint8_t *>(alpha);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	__m128i zero = _mm_setzero_si128();
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + i));
+		__m128i a = _mm_loadu_si128((const __m128i *)(alpha_p + i));
+		__m128i d = _mm_xor_si128(x, _mm_set1_epi8(-128));
+		__m128i y[2];
+
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i a16 = h ? _mm_unpackhi_epi8(a, zero) : _mm_cvtepu8_epi16(a);
+
+			if (scale.centered) {
+				__m128i d16 = _mm_cvtepi8_epi16(h ? _mm_srli_si128(d, 8) : d);
+				__m128i limit = _mm_sub_epi16(_mm_set1_epi16(127), _mm_cmplt_epi16(d16, zero));
+				__m128i r = alpha_u8_epi16<Op>(_mm_abs_epi16(d16), a16, limit);
+				y[h] = _mm_add_epi16(_mm_sign_epi16(r, d16), _mm_set1_epi16(128));
+			} else {
+				__m128i x16 = h ? _mm_unpackhi_epi8(x, zero) : _mm_cvtepu8_epi16(x);
+				y[h] = alpha_u8_epi16<Op>(x16, a16, _mm_set1_epi16(255));
+			}
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + i), _mm_packus_epi16(y[0], y[1]));
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = alpha_sample<Op>(src_p[i], alpha_p[i], scale.centered);
+	}
+}
+
+template <detail::alpha_op Op>
+void alpha_u16_sse41(const void *src, const void *alpha, void *dst, unsigned n, const detail::alpha_scale &scale)
+{
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	const uint16_t *alpha_p = static_cast<const uint16_t *>(alpha);
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	__m128i bias = _mm_set1_epi16(INT16_MIN);
+	unsigned i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + i));
+		__m128i a = _mm_loadu_si128((const __m128i *)(alpha_p + i));
+		__m128i y;
+
+		if (scale.centered) {
+			__m128i d = _mm_xor_si128(x, bias);
+			__m128i limit = _mm_sub_epi16(_mm_set1_epi16(INT16_MAX), _mm_cmplt_epi16(d, _mm_setzero_si128()));
+			__m128i r = alpha_u16_epi16<Op>(_mm_abs_epi16(d), a, limit);
+			y = _mm_xor_si128(_mm_sign_epi16(r, d), bias);
+		} else {
+			y = alpha_u16_epi16<Op>(x, a, _mm_set1_epi16(-1));
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + i), y);
+	}
+	for (; i < n; ++i) {
+		dst_p[i] = alpha_sample<Op>(src_p[i], alpha_p[i], scale.centered);
+	}
+}
+
+// Color matrix in 32-bit lanes. Products fit, as coefficients are below 2^15
+// and offset samples within 17 bits.
+struct matrix_vectors {
+	__m128i c[3][3];
+	__m128i in[3];
+	__m128i out[3];
+
+	explicit matrix_vectors(const detail::color_matrix &m)
+	{
+		for (unsigned i = 0; i < 3; ++i) {
+			for (unsigned j = 0; j < 3; ++j) {
+				c[i][j] = _mm_set1_epi32(m.c[i][j]);
+			}
+			in[i] = _mm_set1_epi32(m.in[i]);
+			out[i] = _mm_set1_epi32(m.out[i]);
+		}
+	}
+};
+
+void matrix_epi32(const matrix_vectors &m, const __m128i x[3], __m128i y[3])
+{
+	__m128i d[3];
+	for (unsigned j = 0; j < 3; ++j) {
+		d[j] = _mm_sub_epi32(x[j], m.in[j]);
+	}
+	for (unsigned i = 0; i < 3; ++i) {
+		__m128i acc = _mm_set1_epi32(1 << 12);
+		for (unsigned j = 0; j < 3; ++j) {
+			acc = _mm_add_epi32(acc, _mm_mullo_epi32(m.c[i][j], d[j]));
+		}
+		y[i] = _mm_add_epi32(_mm_srai_epi32(acc, 13), m.out[i]);
+	}
+}
+
+template <class T>
+void matrix_sample(const T * const src[3], T * const dst[3], unsigned i, const detail::color_matrix &m)
+{
+	int32_t d[3];
+	for (unsigned j = 0; j < 3; ++j) {
+		d[j] = src[j][i] - m.in[j];
+	}
+	for (unsigned k = 0; k < 3; ++k) {
+		int32_t y = ((m.c[k][0] * d[0] + m.c[k][1] * d[1] + m.c[k][2] * d[2] + (1 << 12)) >> 13) + m.out[k];
+		dst[k][i] = static_cast<T>(std::min(std::max(y, 0), m.max));
+	}
+}
+
+void matrix_u8_sse41(const void * const *src, void * const *dst, unsigned n, const detail::color_matrix &m)
+{
+	const uint8_t *src_p[3] = { static_cast<const uint8_t *>(src[0]), static_cast<const uint8_t *>(src[1]), static_cast<const uint8_t *>(src[2]) };
+	uint8_t *dst_p[3] = { static_cast<uint8_t *>(dst[0]), static_cast<uint8_t *>(dst[1]), static_cast<uint8_t *>(dst[2]) };
+	matrix_vectors mv{ m };
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i x[3];
+		__m128i y[4][3];
+
+		__m128i xg[4][3];
+
+		for (unsigned j = 0; j < 3; ++j) {
+			x[j] = _mm_loadu_si128((const __m128i *)(src_p[j] + i));
+			xg[0][j] = _mm_cvtepu8_epi32(x[j]);
+			xg[1][j] = _mm_cvtepu8_epi32(_mm_srli_si128(x[j], 4));
+			xg[2][j] = _mm_cvtepu8_epi32(_mm_srli_si128(x[j], 8));
+			xg[3][j] = _mm_cvtepu8_epi32(_mm_srli_si128(x[j], 12));
+		}
+		for (unsigned g = 0; g < 4; ++g) {
+			matrix_epi32(mv, xg[g], y[g]);
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			__m128i lo = _mm_packs_epi32(y[0][k], y[1][k]);
+			__m128i hi = _mm_packs_epi32(y[2][k], y[3][k]);
+			_mm_storeu_si128((__m128i *)(dst_p[k] + i), _mm_packus_epi16(lo, hi));
+		}
+	}
+	for (; i < n; ++i) {
+		matrix_sample(src_p, dst_p, i, m);
+	}
+}
+
+void matrix_u16_sse41(const void * const *src, void * const *dst, unsigned n, const detail::color_matrix &m)
+{
+	const uint16_t *src_p[3] = { static_cast<const uint16_t *>(src[0]), static_cast<const uint16_t *>(src[1]), static_cast<const uint16_t *>(src[2]) };
+	uint16_t *dst_p[3] = { static_cast<uint16_t *>(dst[0]), static_cast<uint16_t *>(dst[1]), static_cast<uint16_t *>(dst[2]) };
+	matrix_vectors mv{ m };
+	__m128i max = _mm_set1_epi16(static_cast<int16_t>(m.max));
+	__m128i zero = _mm_setzero_si128();
+	unsigned i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i x[3];
+		__m128i y[2][3];
+
+		for (unsigned j = 0; j < 3; ++j) {
+			x[j] = _mm_loadu_si128((const __m128i *)(src_p[j] + i));
+		}
+		for (unsigned h = 0; h < 2; ++h) {
+			__m128i xh[3];
+			for (unsigned j = 0; j < 3; ++j) {
+				xh[j] = h ? _mm_unpackhi_epi16(x[j], zero) : _mm_unpacklo_epi16(x[j], zero);
+			}
+			matrix_epi32(mv, xh, y[h]);
+		}
+		for (unsigned k = 0; k < 3; ++k) {
+			_mm_storeu_si128((__m128i *)(dst_p[k] + i), _mm_min_epu16(_mm_packus_epi32(y[0][k], y[1][k]), max));
+		}
+	}
+	for (; i < n; ++i) {
+		matrix_sample(src_p, dst_p, i, m);
+	}
+}
+
+// Ordered dithering of 16-bit samples to the top bits. Thresholds are in
+// units of the dropped bits, and the saturating add clamps to the largest
+// code, so that a shift down and up quantizes.
+void dither_ordered_u16_sse41(const void *src, void *dst, unsigned n, unsigned row, unsigned depth)
+{
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	unsigned shift = 16 - depth;
+
+	uint16_t thresholds[8];
+	for (unsigned k = 0; k < 8; ++k) {
+		thresholds[k] = static_cast<uint16_t>(((2 * detail::bayer_threshold(k, row) + 1) << shift) >> 7);
+	}
+
+	const __m128i t = _mm_loadu_si128((const __m128i *)thresholds);
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i x0 = _mm_loadu_si128((const __m128i *)(src_p + i + 0));
+		__m128i x1 = _mm_loadu_si128((const __m128i *)(src_p + i + 8));
+
+		x0 = _mm_sll_epi16(_mm_srl_epi16(_mm_adds_epu16(x0, t), count), count);
+		x1 = _mm_sll_epi16(_mm_srl_epi16(_mm_adds_epu16(x1, t), count), count);
+
+		_mm_storeu_si128((__m128i *)(dst_p + i + 0), x0);
+		_mm_storeu_si128((__m128i *)(dst_p + i + 8), x1);
+	}
+	for (; i < n; ++i) {
+		uint32_t x = std::min(src_p[i] + static_cast<uint32_t>(thresholds[i % 8]), UINT32_C(0xFFFF));
+		dst_p[i] = static_cast<uint16_t>(x >> shift << shift);
+	}
+}
+
+
+// Average of the boxes from sample i / Scale onwards, the last one partial.
+template <class T, unsigned Scale>
+void box_filter_tail(const void * const *src, void *dst, unsigned i, unsigned width)
+{
+	T *dst_p = static_cast<T *>(dst);
+
+	for (; i < width; i += Scale) {
+		unsigned end = std::min(i + Scale, width);
+		unsigned count = Scale * (end - i);
+		uint32_t sum = 0;
+
+		for (unsigned r = 0; r < Scale; ++r) {
+			const T *row = static_cast<const T *>(src[r]);
+			for (unsigned j = i; j < end; ++j) {
+				sum += row[j];
+			}
+		}
+		dst_p[i / Scale] = static_cast<T>((sum + count / 2) / count);
+	}
+}
+
+// Pairs are summed by a multiply-add with ones, and quads by a second one on
+// the pair sums, which stay within 16 bits.
+template <unsigned Scale>
+void box_filter_u8_sse41(const void * const *src, void *dst, unsigned width)
+{
+	const __m128i ones_u8 = _mm_set1_epi8(1);
+	const __m128i ones_i16 = _mm_set1_epi16(1);
+	const __m128i round = _mm_set1_epi32(Scale * Scale / 2);
+	uint8_t *dst_p = static_cast<uint8_t *>(dst);
+	unsigned i = 0;
+
+	for (; i + 16 * Scale <= width; i += 16 * Scale) {
+		__m128i pairs[Scale] = {};
+
+		for (unsigned r = 0; r < Scale; ++r) {
+			const uint8_t *row = static_cast<const uint8_t *>(src[r]) + i;
+			for (unsigned k = 0; k < Scale; ++k) {
+				pairs[k] = _mm_add_epi16(pairs[k], _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *)(row + 16 * k)), ones_u8));
+			}
+		}
+
+		__m128i y;
+		if (Scale == 2) {
+			__m128i lo = _mm_srli_epi16(_mm_add_epi16(pairs[0], _mm_set1_epi16(2)), 2);
+			__m128i hi = _mm_srli_epi16(_mm_add_epi16(pairs[1], _mm_set1_epi16(2)), 2);
+			y = _mm_packus_epi16(lo, hi);
+		} else {
+			__m128i q[Scale];
+			for (unsigned k = 0; k < Scale; ++k) {
+				q[k] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs[k], ones_i16), round), 4);
+			}
+			y = _mm_packus_epi16(_mm_packus_epi32(q[0], q[1]), _mm_packus_epi32(q[Scale - 2], q[Scale - 1]));
+		}
+		_mm_storeu_si128((__m128i *)(dst_p + i / Scale), y);
+	}
+	box_filter_tail<uint8_t, Scale>(src, dst, i, width);
+}
+
+// Even and odd samples are split into 32-bit lanes and summed, and quads are
+// summed by horizontal adds of the pair sums.
+template <unsigned Scale>
+void box_filter_u16_sse41(const void * const *src, void *dst, unsigned width)
+{
+	const __m128i lo_mask = _mm_set1_epi32(0xFFFF);
+	const __m128i round = _mm_set1_epi32(Scale * Scale / 2);
+	const int shift = Scale == 2 ? 2 : 4;
+	uint16_t *dst_p = static_cast<uint16_t *>(dst);
+	unsigned i = 0;
+
+	for (; i + 8 * Scale <= width; i += 8 * Scale) {
+		__m128i pairs[Scale] = {};
+
+		for (unsigned r = 0; r < Scale; ++r) {
+			const uint16_t *row = static_cast<const uint16_t *>(src[r]) + i;
+			for (unsigned k = 0; k < Scale; ++k) {
+				__m128i x = _mm_loadu_si128((const __m128i *)(row + 8 * k));
+				pairs[k] = _mm_add_epi32(pairs[k], _mm_add_epi32(_mm_and_si128(x, lo_mask), _mm_srli_epi32(x, 16)));
+			}
+		}
+
+		__m128i lo = Scale == 2 ? pairs[0] : _mm_hadd_epi32(pairs[0], pairs[1]);
+		__m128i hi = Scale == 2 ? pairs[1] : _mm_hadd_epi32(pairs[Scale - 2], pairs[Scale - 1]);
+		lo = _mm_srli_epi32(_mm_add_epi32(lo, round), shift);
+		hi = _mm_srli_epi32(_mm_add_epi32(hi, round), shift);
+		_mm_storeu_si128((__m128i *)(dst_p + i / Scale), _mm_packus_epi32(lo, hi));
+	}
+	box_filter_tail<uint16_t, Scale>(src, dst, i, width);
+}
+
+
+// Sums of bytes are taken by SAD against zero into 64-bit lanes.
+void stats_u8_sse41(const void *src, unsigned n, detail::sample_stats &stats)
+{
+	const uint8_t *src_p = static_cast<const uint8_t *>(src);
+	__m128i vmin = _mm_set1_epi8(static_cast<char>(std::min(stats.min, UINT32_C(0xFF))));
+	__m128i vmax = _mm_set1_epi8(static_cast<char>(stats.max));
+	__m128i sum = _mm_setzero_si128();
+	unsigned i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + i));
+		vmin = _mm_min_epu8(vmin, x);
+		vmax = _mm_max_epu8(vmax, x);
+		sum = _mm_add_epi64(sum, _mm_sad_epu8(x, _mm_setzero_si128()));
+	}
+
+	if (i) {
+		// Widen to 16 bits, where the horizontal minimum is one instruction.
+		vmin = _mm_min_epu16(_mm_cvtepu8_epi16(vmin), _mm_cvtepu8_epi16(_mm_srli_si128(vmin, 8)));
+		vmax = _mm_max_epu16(_mm_cvtepu8_epi16(vmax), _mm_cvtepu8_epi16(_mm_srli_si128(vmax, 8)));
+		stats.min = std::min(stats.min, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(vmin)) & 0xFFFF));
+		stats.max = std::max(stats.max, static_cast<uint32_t>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)))) & 0xFFFF));
+		uint64_t lanes[2];
+		_mm_storeu_si128((__m128i *)lanes, sum);
+		stats.sum += lanes[0] + lanes[1];
+	}
+	for (; i < n; ++i) {
+		stats.min = std::min(stats.min, static_cast<uint32_t>(src_p[i]));
+		stats.max = std::max(stats.max, static_cast<uint32_t>(src_p[i]));
+		stats.sum += src_p[i];
+	}
+}
+
+// Words are widened twice for the sum, into 64-bit lanes.
+void stats_u16_sse41(const void *src, unsigned n, detail::sample_stats &stats)
+{
+	const uint16_t *src_p = static_cast<const uint16_t *>(src);
+	__m128i vmin = _mm_set1_epi16(static_cast<short>(std::min(stats.min, UINT32_C(0xFFFF))));
+	__m128i vmax = _mm_set1_epi16(static_cast<short>(stats.max));
+	__m128i sum = _mm_setzero_si128();
+	unsigned i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(src_p + i));
+		vmin = _mm_min_epu16(vmin, x);
+		vmax = _mm_max_epu16(vmax, x);
+
+		__m128i pairs = _mm_add_epi32(_mm_cvtepu16_epi32(x), _mm_cvtepu16_epi32(_mm_srli_si128(x, 8)));
+		sum = _mm_add_epi64(sum, _mm_add_epi64(_mm_cvtepu32_epi64(pairs), _mm_cvtepu32_epi64(_mm_srli_si128(pairs, 8))));
+	}
+
+	if (i) {
+		stats.min = std::min(stats.min, static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(vmin)) & 0xFFFF));
+		stats.max = std::max(stats.max, static_cast<uint32_t>(~_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_xor_si128(vmax, _mm_set1_epi16(-1)))) & 0xFFFF));
+		uint64_t lanes[2];
+		_mm_storeu_si128((__m128i *)lanes, sum);
+		stats.sum += lanes[0] + lanes[1];
+	}
+	for (; i < n; ++i) {
+		stats.min = std::min(stats.min, static_cast<uint32_t>(src_p[i]));
+		stats.max = std::max(stats.max, static_cast<uint32_t>(src_p[i]));
+		stats.sum += src_p[i];
+	}
+}
+
+} // namespace
+
+
+detail::row_filter_func select_row_filter_sse41(detail::row_filter filter, unsigned bytes_per_sample)
+{
+	switch (filter) {
+	case detail::row_average:
+		return bytes_per_sample == 1 ? filter_rows_u8_sse41<detail::row_average> : filter_rows_u16_sse41<detail::row_average>;
+	case detail::row_interpolate:
+		return bytes_per_sample == 1 ? filter_rows_u8_sse41<detail::row_interpolate> : filter_rows_u16_sse41<detail::row_interpolate>;
+	default:
+		return bytes_per_sample == 1 ? filter_rows_u8_sse41<detail::row_smooth> : filter_rows_u16_sse41<detail::row_smooth>;
+	}
+}
+
+detail::chroma_resample_func select_chroma_resample_sse41(detail::chroma_resample resample, unsigned bytes_per_sample)
+{
+	switch (resample) {
+	case detail::chroma_drop:
+		return bytes_per_sample == 1 ? decimate_u8_sse41<detail::chroma_drop> : decimate_u16_sse41<detail::chroma_drop>;
+	case detail::chroma_average:
+		return bytes_per_sample == 1 ? decimate_u8_sse41<detail::chroma_average> : decimate_u16_sse41<detail::chroma_average>;
+	case detail::chroma_triangle:
+		return bytes_per_sample == 1 ? decimate_u8_sse41<detail::chroma_triangle> : decimate_u16_sse41<detail::chroma_triangle>;
+	case detail::chroma_smooth:
+		return bytes_per_sample == 1 ? decimate_u8_sse41<detail::chroma_smooth> : decimate_u16_sse41<detail::chroma_smooth>;
+	case detail::chroma_repeat:
+		return bytes_per_sample == 1 ? upsample_u8_sse41<detail::chroma_repeat> : upsample_u16_sse41<detail::chroma_repeat>;
+	case detail::chroma_linear_cosited:
+		return bytes_per_sample == 1 ? upsample_u8_sse41<detail::chroma_linear_cosited> : upsample_u16_sse41<detail::chroma_linear_cosited>;
+	default:
+		return bytes_per_sample == 1 ? upsample_u8_sse41<detail::chroma_linear_centered> : upsample_u16_sse41<detail::chroma_linear_centered>;
+	}
+}
+
+detail::alpha_func select_alpha_sse41(detail::alpha_op op, unsigned bytes_per_sample)
+{
+	if (op == detail::alpha_premultiply)
+		return bytes_per_sample == 1 ? alpha_u8_sse41<detail::alpha_premultiply> : alpha_u16_sse41<detail::alpha_premultiply>;
+	else
+		return bytes_per_sample == 1 ? alpha_u8_sse41<detail::alpha_unpremultiply> : alpha_u16_sse41<detail::alpha_unpremultiply>;
+}
+
+detail::matrix_func select_matrix_sse41(unsigned bytes_per_sample)
+{
+	return bytes_per_sample == 1 ? matrix_u8_sse41 : matrix_u16_sse41;
+}
+
+detail::dither_func select_dither_sse41(detail::dither_mode mode)
+{
+	return mode == detail::dither_ordered ? dither_ordered_u16_sse41 : nullptr;
+}
+
+detail::box_filter_func select_box_filter_sse41(unsigned scale, unsigned bytes_per_sample)
+{
+	if (scale == 2)
+		return bytes_per_sample == 1 ? box_filter_u8_sse41<2> : box_filter_u16_sse41<2>;
+	else
+		return bytes_per_sample == 1 ? box_filter_u8_sse41<4> : box_filter_u16_sse41<4>;
+}
+
+detail::stats_func select_stats_sse41(unsigned bytes_per_sample)
+{
+	return bytes_per_sample == 1 ? stats_u8_sse41 : stats_u16_sse41;
+}
+
 } // namespace simd
 } // namespace p2p
 
@@ -0,0 +1,53 @@
+#ifdef P2P_SIMD
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
+
+#include <cstdint>
+#include <cstring>
+#include <nmmintrin.h>
+#include "../p2p.h"
+
+namespace P2P_NAMESPACE {
+namespace simd {
+
+namespace {
+
+uint32_t crc32c_sse42(uint32_t crc, const void *src, size_t n)
+{
+	const unsigned char *src_p = static_cast<const unsigned char *>(src);
+	uint32_t c = ~crc;
+
+	// Bring the pointer to an 8-byte boundary, so that no load splits a line.
+	for (; n && (reinterpret_cast<uintptr_t>(src_p) & 7); --n) {
+		c = _mm_crc32_u8(c, *src_p++);
+	}
+#if defined(__x86_64__) || defined(_M_X64)
+	for (; n >= 8; n -= 8, src_p += 8) {
+		uint64_t x;
+		std::memcpy(&x, src_p, sizeof(x));
+		c = static_cast<uint32_t>(_mm_crc32_u64(c, x));
+	}
+#endif
+	for (; n >= 4; n -= 4, src_p += 4) {
+		uint32_t x;
+		std::memcpy(&x, src_p, sizeof(x));
+		c = _mm_crc32_u32(c, x);
+	}
+	for (; n; --n) {
+		c = _mm_crc32_u8(c, *src_p++);
+	}
+	return ~c;
+}
+
+} // namespace
+
+
+detail::crc32c_func select_crc32c_sse42()
+{
+	return crc32c_sse42;
+}
+
+} // namespace simd
+} // namespace p2p
+
+#endif // x86
+#endif // P2P_SIMD
@@ -1,6 +1,7 @@
 #include <array>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include "p2p.h"
 
 #include "gtest/gtest.h"
@@ -154,4 +155,176 @@ TEST_(p012_le, 0x0000_w, 0x0000_w, 0x010A_w, 0x020B_w, 0xA010B020_d);
 TEST_(p016_be, 0x0000_w, 0x0000_w, 0x0102_w, 0x0304_w, 0x03040102_d);
 TEST_(p016_le, 0x0000_w, 0x0000_w, 0x0102_w, 0x0304_w, 0x02010403_d);
 
+GTEST_TEST(ApiFormatTest, test_rescale_widen)
+{
+	basic_test_case<p2p::rescale_traits<p2p::packed_yuy2, uint16_t>>({ 0x0100_w, 0x0200_w, 0x1000_w, 0x2000_w }, to_be(0x01100220_d));
+	basic_test_case<p2p::rescale_traits<p2p::packed_rgb30_be, uint16_t, 16, true>>(
+		{ 0x4050_w, 0x80A0_w, 0xC0F0_w, 0xFFFF_w }, to_be(0b11'0100000001'1000000010'1100000011_d));
+}
+
+GTEST_TEST(ApiFormatTest, test_rescale_narrow)
+{
+	// 10-bit Y210 samples rounded to 8 bits, clamping at full scale.
+	const uint16_t y[2] = { 266, 769 };
+	const uint16_t u[1] = { 523 };
+	const uint16_t v[1] = { 1023 };
+	const void *src[4] = { y, u, v, nullptr };
+	uint64_t packed;
+	p2p::planar_to_packed<p2p::packed_y210_le>::pack(src, &packed, 0, 2);
+
+	uint8_t y8[2], u8[1], v8[1];
+	void *dst[4] = { y8, u8, v8, nullptr };
+	p2p::packed_to_planar<p2p::rescale_traits<p2p::packed_y210_le, uint8_t>>::unpack(&packed, dst, 0, 2);
+	EXPECT_EQ(67, y8[0]);
+	EXPECT_EQ(192, y8[1]);
+	EXPECT_EQ(131, u8[0]);
+	EXPECT_EQ(255, v8[0]);
+}
+
+GTEST_TEST(ApiFormatTest, test_rescale_round_trip)
+{
+	// Narrowing inverts bit replication.
+	for (unsigned depth : { 2U, 8U, 10U, 12U }) {
+		for (uint32_t x = 0; x < (1U << depth); ++x) {
+			uint32_t wide = p2p::detail::rescale_depth<true>(x, depth, 16);
+			ASSERT_EQ(x, p2p::detail::rescale_depth<true>(wide, 16, depth)) << depth;
+			ASSERT_EQ(x, p2p::detail::rescale_depth<false>(x << (16 - depth), 16, depth)) << depth;
+		}
+	}
+}
+
+GTEST_TEST(ApiFormatTest, test_rescale_float)
+{
+	// Clamped to [0, 1], with NaN mapped to zero.
+	const float r[1] = { -0.5f };
+	const float g[1] = { 0.5f };
+	const float b[1] = { 1.5f };
+	const float a[1] = { std::numeric_limits<float>::quiet_NaN() };
+	const void *src[4] = { r, g, b, a };
+	uint32_t packed;
+	p2p::planar_to_packed<p2p::rescale_traits<p2p::packed_argb32_be, float>>::pack(src, &packed, 0, 1);
+	EXPECT_EQ(to_be(0x000080FF_d), packed);
+
+	// Normalized by the depth of each component.
+	packed = to_be(0b10'1111111111'0000000000'1000000000_d);
+	p2p::half rh[1], gh[1], bh[1], ah[1];
+	void *dst[4] = { rh, gh, bh, ah };
+	p2p::packed_to_planar<p2p::rescale_traits<p2p::packed_rgb30_be, p2p::half>>::unpack(&packed, dst, 0, 1);
+	EXPECT_EQ(0x3C00, rh[0].bits);
+	EXPECT_EQ(0x0000, gh[0].bits);
+	EXPECT_EQ(p2p::detail::float_to_half(512.0f / 1023.0f), bh[0].bits);
+	EXPECT_EQ(p2p::detail::float_to_half(2.0f / 3.0f), ah[0].bits);
+}
+
+GTEST_TEST(ApiFormatTest, test_rescale_float_round_trip)
+{
+	typedef p2p::detail::planar_codec<float, 0, false> float_codec;
+	typedef p2p::detail::planar_codec<p2p::half, 0, false> half_codec;
+
+	for (unsigned depth : { 2U, 8U, 10U, 11U, 12U, 16U }) {
+		for (uint32_t x = 0; x < (1U << depth); ++x) {
+			ASSERT_EQ(x, float_codec::encode(float_codec::decode(x, depth), depth)) << depth;
+			if (depth <= 11)
+				ASSERT_EQ(x, half_codec::encode(half_codec::decode(x, depth), depth)) << depth;
+		}
+	}
+}
+
+GTEST_TEST(ApiFormatTest, test_msb_aligned)
+{
+	// Same layout as the 16-bit formats, with padding bits passed through.
+	basic_test_case<p2p::msb_traits<p2p::packed_y210_be>>({ 0x0102_w, 0x0304_w, 0x0506_w, 0x0708_w }, to_be(0x0102050603040708_q));
+	basic_test_case<p2p::msb_traits<p2p::packed_y412_le>>({ 0x0102_w, 0x0304_w, 0x0506_w, 0x0708_w }, to_be(0x0403020106050807_q));
+	basic_test_case<p2p::msb_traits<p2p::packed_p010_le>>({ 0x0000_w, 0x0000_w, 0x0102_w, 0x0304_w }, to_be(0x02010403_d));
+	basic_test_case<p2p::msb_traits<p2p::packed_rgb30_be>>({ 0x0101_w, 0x0202_w, 0x0303_w, 0x03_w }, to_be(0b11'0100000001'1000000010'1100000011_d));
+}
+
+GTEST_TEST(ApiFormatTest, test_range)
+{
+	// Black, white, and chroma extremes of limited range expand to full range.
+	basic_test_case<p2p::range_traits<p2p::packed_yuy2, p2p::range_limited_full>>({ 0x00_b, 0xFF_b, 0x00_b, 0xFF_b }, to_be(0x1010EBF0_d));
+	basic_test_case<p2p::range_traits<p2p::packed_rgb30_be, p2p::range_limited_full, false>>(
+		{ 0x0000_w, 0x03FF_w, 0x0000_w, 0x01_w }, to_be(0b01'0001000000'1110101100'0001000000_d));
+	basic_test_case<p2p::range_traits<p2p::packed_y210_le, p2p::range_full_limited>>(
+		{ 0x0040_w, 0x03AC_w, 0x0040_w, 0x03C0_w }, to_be(0x00000000C0FFC0FF_q));
+
+	// Full range chroma is centered at half scale.
+	const uint16_t y[2] = { 0x1FF, 0x200 };
+	const uint16_t u[1] = { 0x200 };
+	const uint16_t v[1] = { 0x3FF };
+	const void *src[4] = { y, u, v, nullptr };
+	uint64_t packed;
+	p2p::planar_to_packed<p2p::range_traits<p2p::packed_y210_le, p2p::range_limited_full>>::pack(src, &packed, 0, 2);
+
+	uint16_t y10[2], u10[1], v10[1];
+	void *dst[4] = { y10, u10, v10, nullptr };
+	p2p::packed_to_planar<p2p::packed_y210_le>::unpack(&packed, dst, 0, 2);
+	EXPECT_EQ(64 + 438, y10[0]);
+	EXPECT_EQ(64 + 438, y10[1]);
+	EXPECT_EQ(512, u10[0]);
+	EXPECT_EQ(960, v10[0]);
+
+	// Normalized floating point is not clamped on unpacking.
+	float yf[2], uf[1], vf[1];
+	void *dst_f[4] = { yf, uf, vf, nullptr };
+	packed = 0;
+	p2p::packed_to_planar<p2p::rescale_traits<p2p::range_traits<p2p::packed_y210_le, p2p::range_limited_full>, float>>::unpack(&packed, dst_f, 0, 2);
+	EXPECT_FLOAT_EQ(-16.0f / 219.0f, yf[0]);
+	EXPECT_FLOAT_EQ(0.5f - 128.0f / 224.0f, uf[0]);
+}
+
+GTEST_TEST(ApiFormatTest, test_range_round_trip)
+{
+	typedef p2p::detail::range_codec<uint16_t, 16, false, p2p::range_limited_full> wide_codec;
+	typedef p2p::detail::range_codec<uint16_t, 0, false, p2p::range_limited_full> codec;
+	typedef p2p::detail::range_codec<float, 0, false, p2p::range_limited_full> float_codec;
+
+	// Expansion is exact to invert. Integers clamp codes outside limited range,
+	// floating point keeps them.
+	for (unsigned depth : { 8U, 10U, 12U }) {
+		for (bool chroma : { false, true }) {
+			uint32_t lo = 16U << (depth - 8);
+			uint32_t hi = (chroma ? 240U : 235U) << (depth - 8);
+
+			for (uint32_t x = 0; x < (1U << depth); ++x) {
+				ASSERT_EQ(x, float_codec::encode(float_codec::decode(x, depth, chroma), depth, chroma)) << depth << ' ' << chroma;
+				if (x < lo || x > hi)
+					continue;
+				ASSERT_EQ(x, wide_codec::encode(wide_codec::decode(x, depth, chroma), depth, chroma)) << depth << ' ' << chroma;
+				ASSERT_EQ(x, codec::encode(codec::decode(x, depth, chroma), depth, chroma)) << depth << ' ' << chroma;
+			}
+		}
+	}
+}
+
+GTEST_TEST(ApiFormatTest, test_packed_to_packed)
+{
+	const std::array<uint32_t, 2> src = { to_be(0x04010203_d), to_be(0x08050607_d) };
+	const std::array<uint32_t, 2> expected = { to_be(0x04030201_d), to_be(0x08070605_d) };
+	std::array<uint32_t, 2> dst{};
+
+	p2p::packed_to_packed<p2p::packed_argb32_be, p2p::packed_rgba32_le>::convert(&src, &dst, 0, 2);
+	EXPECT_EQ(expected, dst);
+}
+
+GTEST_TEST(ApiFormatTest, test_packed_to_packed_long)
+{
+	// Longer than the line buffer, starting and ending mid-buffer.
+	const unsigned w = 1000;
+	const unsigned left = 6;
+	const unsigned right = 994;
+
+	std::array<uint8_t, w * 2> src;
+	std::array<uint8_t, w * 2> dst{};
+	for (unsigned i = 0; i < w * 2; ++i) {
+		src[i] = static_cast<uint8_t>(i * 7 + 3);
+	}
+
+	p2p::packed_to_packed<p2p::packed_yuy2, p2p::packed_uyvy>::convert(src.data(), dst.data(), left, right);
+	for (unsigned i = 0; i < w * 2; ++i) {
+		uint8_t expected = i >= left * 2 && i < right * 2 ? src[i ^ 1] : 0;
+		ASSERT_EQ(expected, dst[i]) << i;
+	}
+}
+
 } // namespace
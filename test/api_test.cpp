@@ -1,7 +1,13 @@
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
 #include <cstdint>
+#include <cstring>
 #include <memory>
 #include <vector>
+#include "p2p.h"
 #include "p2p_api.h"
 #include "gtest/gtest.h"
 
@@ -276,4 +282,2782 @@ GTEST_TEST(APITest, test_one_fill)
 	ASSERT_EQ(0xFF, packed[8]);
 }
 
+GTEST_TEST(APITest, test_plan)
+{
+	unsigned w = 64;
+	unsigned h = 33;
+
+	std::vector<uint8_t> packed(w * h * 4);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+	}
+
+	p2p_buffer_param param{};
+	param.src_stride[0] = w * 4;
+	param.dst_stride[0] = w;
+	param.dst_stride[1] = w;
+	param.dst_stride[2] = w;
+	param.dst_stride[3] = w;
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_argb32_le;
+
+	std::vector<uint8_t> planar(w * h * 4);
+	param.src[0] = packed.data();
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst[p] = planar.data() + p * w * h;
+	}
+	p2p_unpack_frame(&param, 0);
+
+	// Contiguous strides.
+	{
+		SCOPED_TRACE("unpack_plan");
+		std::vector<uint8_t> planar_tmp(planar.size());
+		void *dst[4];
+		for (unsigned p = 0; p < 4; ++p) {
+			dst[p] = planar_tmp.data() + p * w * h;
+		}
+
+		p2p_plan *plan = p2p_create_unpack_plan(&param, 0);
+		ASSERT_TRUE(plan);
+		p2p_execute_plan(plan, param.src, dst);
+		EXPECT_EQ(planar, planar_tmp);
+
+		std::fill(planar_tmp.begin(), planar_tmp.end(), 0);
+		for (unsigned band = 0; band < p2p_plan_num_bands(plan); ++band) {
+			p2p_execute_plan_band(plan, band, param.src, dst);
+		}
+		EXPECT_EQ(planar, planar_tmp);
+		p2p_destroy_plan(plan);
+	}
+
+	// Padded strides.
+	{
+		SCOPED_TRACE("pack_plan");
+		std::vector<uint8_t> planar_padded(w * 2 * h * 4);
+		const void *src[4];
+		for (unsigned p = 0; p < 4; ++p) {
+			for (unsigned i = 0; i < h; ++i) {
+				std::memcpy(&planar_padded[(p * h + i) * w * 2], &planar[(p * h + i) * w], w);
+			}
+			src[p] = planar_padded.data() + p * w * 2 * h;
+		}
+
+		std::vector<uint8_t> packed_tmp(packed.size());
+		void *dst[4] = { packed_tmp.data() };
+
+		p2p_buffer_param pack_param{};
+		pack_param.src_stride[0] = w * 2;
+		pack_param.src_stride[1] = w * 2;
+		pack_param.src_stride[2] = w * 2;
+		pack_param.src_stride[3] = w * 2;
+		pack_param.dst_stride[0] = w * 4;
+		pack_param.width = w;
+		pack_param.height = h;
+		pack_param.packing = p2p_argb32_le;
+
+		p2p_plan *plan = p2p_create_pack_plan(&pack_param, 0);
+		ASSERT_TRUE(plan);
+		p2p_execute_plan(plan, src, dst);
+		EXPECT_EQ(packed, packed_tmp);
+		p2p_destroy_plan(plan);
+	}
+}
+
+GTEST_TEST(APITest, test_nv_odd_height)
+{
+	// 4:2:0 with an odd number of luma rows and padded strides.
+	unsigned w = 8;
+	unsigned h = 5;
+	unsigned stride = 10;
+
+	std::vector<uint16_t> luma(stride * h);
+	std::vector<uint16_t> chroma(stride * (h / 2));
+	for (unsigned i = 0; i < h; ++i) {
+		for (unsigned j = 0; j < w; ++j) {
+			luma[i * stride + j] = static_cast<uint16_t>(((i * w + j) & 0x3FF) << 6);
+		}
+	}
+	for (unsigned i = 0; i < h / 2; ++i) {
+		for (unsigned j = 0; j < w; ++j) {
+			chroma[i * stride + j] = static_cast<uint16_t>(((i * w + j + 0x100) & 0x3FF) << 6);
+		}
+	}
+
+	std::vector<uint16_t> planar(stride * h * 2);
+	p2p_buffer_param param{};
+	param.src[0] = luma.data();
+	param.src[1] = chroma.data();
+	param.dst[0] = planar.data();
+	param.dst[1] = planar.data() + stride * h;
+	param.dst[2] = planar.data() + stride * h + stride / 2;
+	param.src_stride[0] = stride * sizeof(uint16_t);
+	param.src_stride[1] = stride * sizeof(uint16_t);
+	param.dst_stride[0] = stride * sizeof(uint16_t);
+	param.dst_stride[1] = stride * sizeof(uint16_t);
+	param.dst_stride[2] = stride * sizeof(uint16_t);
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_p010_le;
+
+	p2p_unpack_frame(&param, 0);
+
+	for (unsigned i = 0; i < h; ++i) {
+		for (unsigned j = 0; j < w; ++j) {
+			ASSERT_EQ(luma[i * stride + j] >> 6, planar[i * stride + j]) << '(' << i << ',' << j << ')';
+		}
+	}
+	for (unsigned i = 0; i < h / 2; ++i) {
+		for (unsigned j = 0; j < w / 2; ++j) {
+			ASSERT_EQ(chroma[i * stride + j * 2 + 0] >> 6, planar[stride * h + i * stride + j]) << '(' << i << ',' << j << ')';
+			ASSERT_EQ(chroma[i * stride + j * 2 + 1] >> 6, planar[stride * h + stride / 2 + i * stride + j]) << '(' << i << ',' << j << ')';
+		}
+	}
+
+	std::vector<uint16_t> luma_tmp(luma.size());
+	std::vector<uint16_t> chroma_tmp(chroma.size());
+	p2p_buffer_param pack_param{};
+	pack_param.src[0] = param.dst[0];
+	pack_param.src[1] = param.dst[1];
+	pack_param.src[2] = param.dst[2];
+	pack_param.dst[0] = luma_tmp.data();
+	pack_param.dst[1] = chroma_tmp.data();
+	std::copy_n(param.dst_stride, 4, pack_param.src_stride);
+	std::copy_n(param.src_stride, 4, pack_param.dst_stride);
+	pack_param.width = w;
+	pack_param.height = h;
+	pack_param.packing = p2p_p010_le;
+
+	p2p_pack_frame(&pack_param, 0);
+	for (unsigned i = 0; i < h; ++i) {
+		ASSERT_TRUE(std::equal(&luma[i * stride], &luma[i * stride + w], &luma_tmp[i * stride]));
+	}
+	for (unsigned i = 0; i < h / 2; ++i) {
+		ASSERT_TRUE(std::equal(&chroma[i * stride], &chroma[i * stride + w], &chroma_tmp[i * stride]));
+	}
+}
+
+GTEST_TEST(APITest, test_nv_strips)
+{
+	// Frame spanning many cache-sized strips.
+	unsigned w = 4096;
+	unsigned h = 601;
+
+	std::vector<uint8_t> luma(w * h);
+	std::vector<uint8_t> chroma(w * (h / 2));
+	for (size_t i = 0; i < luma.size(); ++i) {
+		luma[i] = static_cast<uint8_t>(i * 3 + 1);
+	}
+	for (size_t i = 0; i < chroma.size(); ++i) {
+		chroma[i] = static_cast<uint8_t>(i * 5 + 2);
+	}
+
+	std::vector<uint8_t> planar_y(w * h);
+	std::vector<uint8_t> planar_u(w / 2 * (h / 2));
+	std::vector<uint8_t> planar_v(w / 2 * (h / 2));
+
+	for (unsigned long flags : { 0UL, P2P_USE_THREADS }) {
+		p2p_buffer_param param{};
+		param.src[0] = luma.data();
+		param.src[1] = chroma.data();
+		param.dst[0] = planar_y.data();
+		param.dst[1] = planar_u.data();
+		param.dst[2] = planar_v.data();
+		param.src_stride[0] = w;
+		param.src_stride[1] = w;
+		param.dst_stride[0] = w;
+		param.dst_stride[1] = w / 2;
+		param.dst_stride[2] = w / 2;
+		param.width = w;
+		param.height = h;
+		param.packing = p2p_nv12_le;
+
+		std::fill(planar_y.begin(), planar_y.end(), 0);
+		std::fill(planar_u.begin(), planar_u.end(), 0);
+		std::fill(planar_v.begin(), planar_v.end(), 0);
+		p2p_unpack_frame(&param, flags);
+
+		ASSERT_EQ(luma, planar_y);
+		for (size_t i = 0; i < planar_u.size(); ++i) {
+			ASSERT_EQ(chroma[i * 2 + 0], planar_u[i]) << i;
+			ASSERT_EQ(chroma[i * 2 + 1], planar_v[i]) << i;
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_batch)
+{
+	// Mix of small frames in two formats and one frame large enough to be split.
+	const unsigned dims[][2] = { { 64, 64 }, { 32, 16 }, { 320, 240 }, { 64, 64 }, { 16, 8 } };
+	const p2p_packing packings[] = { p2p_argb32_le, p2p_yuy2, p2p_argb32_le, p2p_yuy2, p2p_argb32_le };
+	constexpr unsigned count = sizeof(dims) / sizeof(dims[0]);
+
+	std::vector<std::vector<uint8_t>> packed(count);
+	std::vector<std::vector<uint8_t>> planar(count);
+	std::vector<std::vector<uint8_t>> planar_batch(count);
+	std::vector<p2p_buffer_param> params(count);
+
+	for (unsigned n = 0; n < count; ++n) {
+		unsigned w = dims[n][0];
+		unsigned h = dims[n][1];
+		bool is_422 = packings[n] == p2p_yuy2;
+
+		packed[n].resize(w * h * (is_422 ? 2 : 4));
+		for (size_t i = 0; i < packed[n].size(); ++i) {
+			packed[n][i] = static_cast<uint8_t>(i * 13 + n);
+		}
+		planar[n].resize(w * h * 4);
+		planar_batch[n].resize(w * h * 4);
+
+		p2p_buffer_param &param = params[n];
+		param = {};
+		param.src[0] = packed[n].data();
+		param.src_stride[0] = w * (is_422 ? 2 : 4);
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar[n].data() + p * w * h;
+			param.dst_stride[p] = (p == 1 || p == 2) && is_422 ? w / 2 : w;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = packings[n];
+
+		p2p_unpack_frame(&param, 0);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar_batch[n].data() + p * w * h;
+		}
+	}
+
+	for (unsigned long threads : { 0UL, P2P_USE_THREADS }) {
+		SCOPED_TRACE(threads);
+
+		for (std::vector<uint8_t> &frame : planar_batch) {
+			std::fill(frame.begin(), frame.end(), 0);
+		}
+		p2p_unpack_frame_batch(params.data(), count, threads);
+
+		for (unsigned n = 0; n < count; ++n) {
+			SCOPED_TRACE(n);
+			EXPECT_EQ(planar[n], planar_batch[n]);
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_async)
+{
+	unsigned w = 256;
+	unsigned h = 128;
+
+	std::vector<uint8_t> packed(w * h * 4);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>(i * 5 + 1);
+	}
+
+	p2p_buffer_param param{};
+	param.src[0] = packed.data();
+	param.src_stride[0] = w * 4;
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst_stride[p] = w;
+	}
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_rgba32_be;
+
+	std::vector<uint8_t> planar(w * h * 4);
+	std::vector<uint8_t> planar_async(w * h * 4);
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst[p] = planar.data() + p * w * h;
+	}
+	p2p_unpack_frame(&param, 0);
+
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst[p] = planar_async.data() + p * w * h;
+	}
+
+	std::atomic<int> status{ -1 };
+	p2p_job *job = p2p_submit_unpack_frame(&param, 0, [](void *user, int s) { static_cast<std::atomic<int> *>(user)->store(s); }, &status);
+	ASSERT_TRUE(job);
+
+	ASSERT_EQ(P2P_JOB_COMPLETE, p2p_wait_job(job));
+	ASSERT_EQ(P2P_JOB_COMPLETE, status.load());
+	ASSERT_EQ(0, p2p_cancel_job(job));
+	p2p_release_job(job);
+
+	EXPECT_EQ(planar, planar_async);
+}
+
+GTEST_TEST(APITest, test_threaded)
+{
+	unsigned w = 640;
+	unsigned h = 480;
+
+	std::vector<uint8_t> packed(w * h * 4);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>(i * 7 + 3);
+	}
+
+	p2p_buffer_param param{};
+	param.src[0] = packed.data();
+	param.src_stride[0] = w * 4;
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst_stride[p] = w;
+	}
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_argb32_le;
+
+	std::vector<uint8_t> planar(w * h * 4);
+	for (unsigned p = 0; p < 4; ++p) {
+		param.dst[p] = planar.data() + p * w * h;
+	}
+	p2p_unpack_frame(&param, 0);
+
+	const unsigned long flags[] = { P2P_USE_THREADS, P2P_USE_THREADS | P2P_PRIORITY_REALTIME, P2P_USE_THREADS | P2P_PRIORITY_BACKGROUND };
+
+	for (unsigned long f : flags) {
+		std::vector<uint8_t> planar_mt(w * h * 4);
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar_mt.data() + p * w * h;
+		}
+		p2p_unpack_frame(&param, f);
+		EXPECT_EQ(planar, planar_mt);
+
+		std::vector<uint8_t> packed_mt(w * h * 4);
+		param.src[0] = planar_mt.data();
+		param.dst[0] = packed_mt.data();
+		std::swap(param.src_stride, param.dst_stride);
+		for (unsigned p = 1; p < 4; ++p) {
+			param.src[p] = planar_mt.data() + p * w * h;
+			param.dst[p] = nullptr;
+		}
+		p2p_pack_frame(&param, f);
+		EXPECT_EQ(packed, packed_mt);
+
+		param.src[0] = packed.data();
+		for (unsigned p = 1; p < 4; ++p) {
+			param.src[p] = nullptr;
+		}
+		std::swap(param.src_stride, param.dst_stride);
+	}
+}
+
+GTEST_TEST(APITest, test_streaming_stores)
+{
+	unsigned w = 100;
+	unsigned h = 64;
+
+	// Contiguous and padded layouts.
+	for (unsigned pad : { 0U, 28U }) {
+		unsigned stride = w + pad;
+
+		std::vector<uint8_t> packed(stride * 4 * h);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>(i * 11 + 5);
+		}
+
+		std::vector<uint8_t> planar(stride * h * 4);
+		std::vector<uint8_t> planar_nt(stride * h * 4);
+		p2p_buffer_param param{};
+		param.src[0] = packed.data();
+		param.src_stride[0] = stride * 4;
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst_stride[p] = stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = p2p_argb32_be;
+
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar.data() + p * stride * h;
+		}
+		p2p_unpack_frame(&param, 0);
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar_nt.data() + p * stride * h;
+		}
+		p2p_unpack_frame(&param, P2P_STREAMING_STORES);
+		EXPECT_EQ(planar, planar_nt);
+
+		std::vector<uint8_t> repacked(packed.size());
+		std::vector<uint8_t> repacked_nt(packed.size());
+		p2p_buffer_param pack_param{};
+		for (unsigned p = 0; p < 4; ++p) {
+			pack_param.src[p] = planar.data() + p * stride * h;
+			pack_param.src_stride[p] = stride;
+		}
+		pack_param.dst_stride[0] = stride * 4;
+		pack_param.width = w;
+		pack_param.height = h;
+		pack_param.packing = p2p_argb32_be;
+
+		pack_param.dst[0] = repacked.data();
+		p2p_pack_frame(&pack_param, 0);
+		pack_param.dst[0] = repacked_nt.data();
+		p2p_pack_frame(&pack_param, P2P_STREAMING_STORES);
+		EXPECT_EQ(repacked, repacked_nt);
+	}
+}
+
+GTEST_TEST(APITest, test_padded_buffers)
+{
+	// Width that is neither a multiple of the vector nor of the v210 group.
+	unsigned w = 101;
+	unsigned h = 4;
+	const p2p_packing packings[] = { p2p_argb32_be, p2p_rgb24_le, p2p_y210_le, p2p_v210_le };
+
+	for (p2p_packing packing : packings) {
+		SCOPED_TRACE(packing);
+
+		unsigned packed_stride = w * 8 + 64;
+		unsigned planar_stride = w * 2 + 64;
+
+		std::vector<uint8_t> packed(packed_stride * h);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>(i * 13 + 7);
+		}
+
+		std::vector<uint8_t> planar(planar_stride * h * 4);
+		std::vector<uint8_t> planar_padded(planar_stride * h * 4);
+		p2p_buffer_param param{};
+		param.src[0] = packed.data();
+		param.src_stride[0] = packed_stride;
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst_stride[p] = planar_stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = packing;
+
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar.data() + p * planar_stride * h;
+		}
+		p2p_unpack_frame(&param, 0);
+		for (unsigned p = 0; p < 4; ++p) {
+			param.dst[p] = planar_padded.data() + p * planar_stride * h;
+		}
+		p2p_unpack_frame(&param, P2P_PADDED_BUFFERS);
+
+		// Compare the row contents, but not the padding. Formats wider than
+		// 8 bits use 2 bytes per sample.
+		unsigned bytes = packing == p2p_argb32_be || packing == p2p_rgb24_le ? 1 : 2;
+		for (unsigned p = 0; p < 4 * h; ++p) {
+			unsigned n = (packing == p2p_y210_le || packing == p2p_v210_le) && (p / h == 1 || p / h == 2) ? w / 2 : w;
+			ASSERT_TRUE(std::equal(&planar[p * planar_stride], &planar[p * planar_stride] + n * bytes, &planar_padded[p * planar_stride])) << p;
+		}
+
+		std::vector<uint8_t> repacked(packed.size());
+		std::vector<uint8_t> repacked_padded(packed.size());
+		p2p_buffer_param pack_param{};
+		for (unsigned p = 0; p < 4; ++p) {
+			pack_param.src[p] = planar.data() + p * planar_stride * h;
+			pack_param.src_stride[p] = planar_stride;
+		}
+		pack_param.dst_stride[0] = packed_stride;
+		pack_param.width = w;
+		pack_param.height = h;
+		pack_param.packing = packing;
+
+		pack_param.dst[0] = repacked.data();
+		p2p_pack_frame(&pack_param, 0);
+		pack_param.dst[0] = repacked_padded.data();
+		p2p_pack_frame(&pack_param, P2P_PADDED_BUFFERS);
+
+		// Bytes of whole packs covering the row.
+		unsigned linesize = packing == p2p_argb32_be ? w * 4 : packing == p2p_rgb24_le ? w * 3 : packing == p2p_y210_le ? (w + 1) / 2 * 8 : (w + 5) / 6 * 16;
+		for (unsigned i = 0; i < h; ++i) {
+			ASSERT_TRUE(std::equal(&repacked[i * packed_stride], &repacked[i * packed_stride] + linesize, &repacked_padded[i * packed_stride])) << i;
+		}
+	}
+
+	// Wider planar samples must not be written past the padding either.
+	const unsigned long planar_flags[] = { 0, P2P_PLANAR_16BIT, P2P_PLANAR_FLOAT, P2P_PLANAR_HALF };
+	const unsigned widths[] = { 1, 101 };
+
+	for (p2p_packing packing : packings) {
+		for (unsigned long flags : planar_flags) {
+			for (unsigned width : widths) {
+				SCOPED_TRACE(packing);
+				SCOPED_TRACE(flags);
+				SCOPED_TRACE(width);
+
+				unsigned sample_bytes = flags & P2P_PLANAR_FLOAT ? 4 : flags || (packing != p2p_argb32_be && packing != p2p_rgb24_le) ? 2 : 1;
+				unsigned planar_row = width * sample_bytes + 64;
+				unsigned planar_stride = planar_row + 64;
+				unsigned packed_row = (width + 5) / 6 * 16 * 2 + 64;
+				unsigned packed_stride = packed_row + 64;
+
+				std::vector<uint8_t> packed(packed_stride * h, 0xCD);
+				std::vector<uint8_t> planar(planar_stride * h * 4, 0xCD);
+				for (unsigned i = 0; i < h; ++i) {
+					std::fill_n(&packed[i * packed_stride], packed_row, 0);
+				}
+
+				p2p_buffer_param param{};
+				param.src[0] = packed.data();
+				param.src_stride[0] = packed_stride;
+				for (unsigned p = 0; p < 4; ++p) {
+					param.dst[p] = planar.data() + p * planar_stride * h;
+					param.dst_stride[p] = planar_stride;
+				}
+				param.width = width;
+				param.height = h;
+				param.packing = packing;
+				p2p_unpack_frame(&param, flags | P2P_PADDED_BUFFERS);
+
+				for (unsigned i = 0; i < 4 * h; ++i) {
+					const uint8_t *guard = &planar[i * planar_stride + planar_row];
+					ASSERT_TRUE(std::all_of(guard, guard + planar_stride - planar_row, [](uint8_t x) { return x == 0xCD; })) << i;
+				}
+
+				for (unsigned p = 0; p < 4; ++p) {
+					param.src[p] = param.dst[p];
+					param.src_stride[p] = planar_stride;
+					param.dst[p] = nullptr;
+				}
+				param.dst[0] = packed.data();
+				param.dst_stride[0] = packed_stride;
+				p2p_pack_frame(&param, flags | P2P_PADDED_BUFFERS);
+
+				for (unsigned i = 0; i < h; ++i) {
+					const uint8_t *guard = &packed[i * packed_stride + packed_row];
+					ASSERT_TRUE(std::all_of(guard, guard + packed_stride - packed_row, [](uint8_t x) { return x == 0xCD; })) << i;
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_convert_frame)
+{
+	struct test_case {
+		p2p_packing src;
+		p2p_packing dst;
+		bool src_alpha;
+		bool nv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, p2p_uyvy, false, false },
+		{ p2p_argb32_be, p2p_rgba32_le, true, false },
+		{ p2p_rgb24_le, p2p_argb32_be, false, false },
+		{ p2p_y210_le, p2p_y210_be, false, false },
+		{ p2p_y210_le, p2p_v210_le, false, false },
+		{ p2p_v210_le, p2p_y210_le, false, false },
+		{ p2p_nv12_le, p2p_nv12_be, false, true },
+		{ p2p_p010_le, p2p_p010_be, false, true },
+		{ p2p_p010_le, p2p_p016_le, false, true },
+		{ p2p_nv16_le, p2p_yuy2, false, true },
+		{ p2p_yuy2, p2p_nv16_le, false, false },
+	};
+
+	// Odd height for the NV 4:2:0 tail row.
+	unsigned w = 622;
+	unsigned h = 181;
+	unsigned packed_stride = w * 8 + 32;
+	unsigned planar_stride = w * 2 + 32;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.src);
+		SCOPED_TRACE(c.dst);
+
+		std::vector<uint8_t> packed(packed_stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 2; ++p) {
+			param.src[p] = packed.data() + p * packed_stride * h;
+			param.src_stride[p] = packed_stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = c.src;
+
+		// Reference through a planar frame.
+		std::vector<uint8_t> planar(planar_stride * h * 4);
+		std::vector<uint8_t> expected(packed.size());
+		{
+			p2p_buffer_param unpack_param = param;
+			for (unsigned p = 0; p < 4; ++p) {
+				unpack_param.dst[p] = planar.data() + p * planar_stride * h;
+				unpack_param.dst_stride[p] = planar_stride;
+			}
+			p2p_unpack_frame(&unpack_param, 0);
+
+			p2p_buffer_param pack_param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				pack_param.src[p] = p < 3 || c.src_alpha ? planar.data() + p * planar_stride * h : nullptr;
+				pack_param.src_stride[p] = planar_stride;
+			}
+			for (unsigned p = 0; p < 2; ++p) {
+				pack_param.dst[p] = expected.data() + p * packed_stride * h;
+				pack_param.dst_stride[p] = packed_stride;
+			}
+			pack_param.width = w;
+			pack_param.height = h;
+			pack_param.packing = c.dst;
+			p2p_pack_frame(&pack_param, P2P_ALPHA_SET_ONE);
+		}
+
+		for (unsigned long flags : { 0UL, P2P_USE_THREADS }) {
+			std::vector<uint8_t> converted(packed.size());
+			for (unsigned p = 0; p < 2; ++p) {
+				param.dst[p] = converted.data() + p * packed_stride * h;
+				param.dst_stride[p] = packed_stride;
+			}
+
+			ASSERT_EQ(0, p2p_convert_frame(&param, c.dst, flags | P2P_ALPHA_SET_ONE));
+			EXPECT_EQ(expected, converted);
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_convert_frame_incompatible)
+{
+	uint8_t src[64] = {};
+	uint8_t dst[64] = {};
+
+	p2p_buffer_param param{};
+	param.src[0] = src;
+	param.dst[0] = dst;
+	param.src_stride[0] = sizeof(src);
+	param.dst_stride[0] = sizeof(dst);
+	param.width = 2;
+	param.height = 1;
+	param.packing = p2p_argb32_be;
+
+	EXPECT_EQ(-1, p2p_convert_frame(&param, p2p_argb64_be, 0));
+	EXPECT_EQ(-1, p2p_convert_frame(&param, p2p_yuy2, 0));
+	param.packing = p2p_yuy2;
+	EXPECT_EQ(-1, p2p_convert_frame(&param, p2p_nv12_le, 0));
+}
+
+GTEST_TEST(APITest, test_convert_frame_inplace)
+{
+	struct test_case {
+		p2p_packing src;
+		p2p_packing dst;
+	};
+	const test_case cases[] = {
+		{ p2p_argb32_be, p2p_argb32_le },
+		{ p2p_rgba32_le, p2p_argb32_be },
+		{ p2p_y210_be, p2p_y210_le },
+		{ p2p_nv12_le, p2p_nv12_be },
+		{ p2p_p010_le, p2p_p016_le },
+		{ p2p_p016_le, p2p_p010_be },
+		{ p2p_rgb30_le, p2p_y410_le },
+	};
+
+	unsigned w = 333;
+	unsigned h = 67;
+	unsigned stride = w * 4 + 16;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.src);
+		SCOPED_TRACE(c.dst);
+
+		std::vector<uint8_t> frame(stride * h * 2);
+		for (size_t i = 0; i < frame.size(); ++i) {
+			frame[i] = static_cast<uint8_t>((i * 2654435761U) >> 11);
+		}
+
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 2; ++p) {
+			param.src_stride[p] = stride;
+			param.dst_stride[p] = stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = c.src;
+
+		// Bytes outside of the rows are left as they were.
+		std::vector<uint8_t> expected = frame;
+		for (unsigned p = 0; p < 2; ++p) {
+			param.src[p] = frame.data() + p * stride * h;
+			param.dst[p] = expected.data() + p * stride * h;
+		}
+		ASSERT_EQ(0, p2p_convert_frame(&param, c.dst, 0));
+
+		for (unsigned long flags : { 0UL, P2P_USE_THREADS }) {
+			std::vector<uint8_t> buf = frame;
+			for (unsigned p = 0; p < 2; ++p) {
+				param.src[p] = nullptr;
+				param.dst[p] = buf.data() + p * stride * h;
+			}
+			ASSERT_EQ(0, p2p_convert_frame_inplace(&param, c.dst, flags));
+			EXPECT_EQ(expected, buf);
+		}
+	}
+
+	// Rows would change length.
+	uint8_t buf[64] = {};
+	p2p_buffer_param param{};
+	param.dst[0] = buf;
+	param.dst_stride[0] = sizeof(buf);
+	param.width = 6;
+	param.height = 1;
+	param.packing = p2p_y210_le;
+	EXPECT_EQ(-1, p2p_convert_frame_inplace(&param, p2p_v210_le, 0));
+}
+
+GTEST_TEST(APITest, test_planar_16bit)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		bool nv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 8, 1, false },
+		{ p2p_argb32_le, 8, 1, false },
+		{ p2p_rgb24_be, 8, 1, false },
+		{ p2p_rgb30_le, 10, 2, false },
+		{ p2p_y210_be, 10, 2, false },
+		{ p2p_v210_le, 10, 2, false },
+		{ p2p_y416_le, 16, 2, false },
+		{ p2p_nv12_le, 8, 1, true },
+		{ p2p_p010_be, 10, 2, true },
+	};
+
+	// Odd height for the NV 4:2:0 tail row.
+	unsigned w = 622;
+	unsigned h = 181;
+	unsigned packed_stride = w * 8 + 32;
+	unsigned planar_stride = w * 2 + 32;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.packing);
+
+		std::vector<uint8_t> random(packed_stride * h * 2);
+		for (size_t i = 0; i < random.size(); ++i) {
+			random[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		// Canonicalize the packed frame through native planes, without alpha.
+		std::vector<uint8_t> packed(random.size());
+		std::vector<uint8_t> native(planar_stride * h * 3);
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 3; ++p) {
+			param.dst[p] = native.data() + p * planar_stride * h;
+			param.dst_stride[p] = planar_stride;
+		}
+		for (unsigned p = 0; p < 2; ++p) {
+			param.src[p] = random.data() + p * packed_stride * h;
+			param.src_stride[p] = packed_stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = c.packing;
+		p2p_unpack_frame(&param, 0);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			param.src[p] = param.dst[p];
+			param.src_stride[p] = planar_stride;
+		}
+		for (unsigned p = 0; p < 2; ++p) {
+			param.dst[p] = packed.data() + p * packed_stride * h;
+			param.dst_stride[p] = packed_stride;
+		}
+		param.dst[2] = nullptr;
+		p2p_pack_frame(&param, P2P_ALPHA_SET_ONE);
+
+		for (unsigned long flags : { 0UL, P2P_BIT_REPLICATE, P2P_USE_THREADS }) {
+			SCOPED_TRACE(flags);
+
+			std::vector<uint16_t> wide(planar_stride / 2 * h * 3);
+			p2p_buffer_param unpack_param{};
+			for (unsigned p = 0; p < 2; ++p) {
+				unpack_param.src[p] = packed.data() + p * packed_stride * h;
+				unpack_param.src_stride[p] = packed_stride;
+			}
+			for (unsigned p = 0; p < 3; ++p) {
+				unpack_param.dst[p] = wide.data() + p * planar_stride / 2 * h;
+				unpack_param.dst_stride[p] = planar_stride;
+			}
+			unpack_param.width = w;
+			unpack_param.height = h;
+			unpack_param.packing = c.packing;
+			p2p_unpack_frame(&unpack_param, flags | P2P_PLANAR_16BIT);
+
+			// The MSB of each widened sample hold the native sample.
+			for (unsigned p = 0; p < 3; ++p) {
+				unsigned plane_w = p && (c.nv || c.packing == p2p_yuy2 || c.packing == p2p_y210_be || c.packing == p2p_v210_le) ? w / 2 : w;
+				unsigned plane_h = p && c.nv ? h / 2 : h;
+
+				for (unsigned i = 0; i < plane_h; ++i) {
+					for (unsigned j = 0; j < plane_w; ++j) {
+						const uint8_t *row = native.data() + p * planar_stride * h + i * planar_stride;
+						unsigned x = c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+						unsigned y = wide[p * planar_stride / 2 * h + i * planar_stride / 2 + j];
+						ASSERT_EQ(x, y >> (16 - c.depth)) << p << ' ' << i << ' ' << j;
+					}
+				}
+			}
+
+			std::vector<uint8_t> repacked(packed.size());
+			p2p_buffer_param pack_param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				pack_param.src[p] = unpack_param.dst[p];
+				pack_param.src_stride[p] = planar_stride;
+			}
+			for (unsigned p = 0; p < 2; ++p) {
+				pack_param.dst[p] = repacked.data() + p * packed_stride * h;
+				pack_param.dst_stride[p] = packed_stride;
+			}
+			pack_param.width = w;
+			pack_param.height = h;
+			pack_param.packing = c.packing;
+			p2p_pack_frame(&pack_param, flags | P2P_PLANAR_16BIT | P2P_ALPHA_SET_ONE);
+			EXPECT_EQ(packed, repacked);
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_planar_float)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		bool nv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 8, 1, false },
+		{ p2p_argb32_le, 8, 1, false },
+		{ p2p_rgba32_be, 8, 1, false },
+		{ p2p_rgb24_be, 8, 1, false },
+		{ p2p_rgb30_le, 10, 2, false },
+		{ p2p_v210_le, 10, 2, false },
+		{ p2p_y416_le, 16, 2, false },
+		{ p2p_nv12_le, 8, 1, true },
+		{ p2p_p010_be, 10, 2, true },
+	};
+
+	// Odd height for the NV 4:2:0 tail row.
+	unsigned w = 622;
+	unsigned h = 181;
+	unsigned packed_stride = w * 8 + 32;
+	unsigned planar_stride = w * 4 + 32;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.packing);
+
+		std::vector<uint8_t> random(packed_stride * h * 2);
+		for (size_t i = 0; i < random.size(); ++i) {
+			random[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		// Canonicalize the packed frame through native planes, without alpha.
+		std::vector<uint8_t> packed(random.size());
+		std::vector<uint8_t> native(planar_stride * h * 3);
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 3; ++p) {
+			param.dst[p] = native.data() + p * planar_stride * h;
+			param.dst_stride[p] = planar_stride;
+		}
+		for (unsigned p = 0; p < 2; ++p) {
+			param.src[p] = random.data() + p * packed_stride * h;
+			param.src_stride[p] = packed_stride;
+		}
+		param.width = w;
+		param.height = h;
+		param.packing = c.packing;
+		p2p_unpack_frame(&param, 0);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			param.src[p] = param.dst[p];
+			param.src_stride[p] = planar_stride;
+		}
+		for (unsigned p = 0; p < 2; ++p) {
+			param.dst[p] = packed.data() + p * packed_stride * h;
+			param.dst_stride[p] = packed_stride;
+		}
+		param.dst[2] = nullptr;
+		p2p_pack_frame(&param, P2P_ALPHA_SET_ONE);
+
+		for (unsigned long flags : { P2P_PLANAR_FLOAT, P2P_PLANAR_HALF, P2P_PLANAR_FLOAT | P2P_USE_THREADS }) {
+			SCOPED_TRACE(flags);
+
+			// Half precision only round-trips up to 11 bits.
+			bool is_half = !(flags & P2P_PLANAR_FLOAT);
+			if (is_half && c.depth > 11)
+				continue;
+
+			std::vector<uint8_t> wide(planar_stride * h * 3);
+			p2p_buffer_param unpack_param{};
+			for (unsigned p = 0; p < 2; ++p) {
+				unpack_param.src[p] = packed.data() + p * packed_stride * h;
+				unpack_param.src_stride[p] = packed_stride;
+			}
+			for (unsigned p = 0; p < 3; ++p) {
+				unpack_param.dst[p] = wide.data() + p * planar_stride * h;
+				unpack_param.dst_stride[p] = planar_stride;
+			}
+			unpack_param.width = w;
+			unpack_param.height = h;
+			unpack_param.packing = c.packing;
+			p2p_unpack_frame(&unpack_param, flags);
+
+			// Samples are normalized to the maximum of the packed depth.
+			for (unsigned p = 0; p < 3; ++p) {
+				unsigned plane_w = p && (c.nv || c.packing == p2p_yuy2 || c.packing == p2p_v210_le) ? w / 2 : w;
+				unsigned plane_h = p && c.nv ? h / 2 : h;
+
+				for (unsigned i = 0; i < plane_h; ++i) {
+					for (unsigned j = 0; j < plane_w; ++j) {
+						const uint8_t *row = native.data() + p * planar_stride * h + i * planar_stride;
+						const uint8_t *wide_row = wide.data() + p * planar_stride * h + i * planar_stride;
+						unsigned x = c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+						float y = is_half ? p2p::detail::half_to_float(reinterpret_cast<const uint16_t *>(wide_row)[j]) : reinterpret_cast<const float *>(wide_row)[j];
+						ASSERT_NEAR(x, y * ((1U << c.depth) - 1), 0.25) << p << ' ' << i << ' ' << j;
+					}
+				}
+			}
+
+			std::vector<uint8_t> repacked(packed.size());
+			p2p_buffer_param pack_param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				pack_param.src[p] = unpack_param.dst[p];
+				pack_param.src_stride[p] = planar_stride;
+			}
+			for (unsigned p = 0; p < 2; ++p) {
+				pack_param.dst[p] = repacked.data() + p * packed_stride * h;
+				pack_param.dst_stride[p] = packed_stride;
+			}
+			pack_param.width = w;
+			pack_param.height = h;
+			pack_param.packing = c.packing;
+			p2p_pack_frame(&pack_param, flags | P2P_ALPHA_SET_ONE);
+			EXPECT_EQ(packed, repacked);
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_planar_range)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		unsigned subsample_w;
+		unsigned subsample_h;
+		bool yuv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 8, 1, 1, 0, true },
+		{ p2p_rgb30_le, 10, 2, 0, 0, false },
+		{ p2p_v210_le, 10, 2, 1, 0, true },
+		{ p2p_nv12_le, 8, 1, 1, 1, true },
+		{ p2p_p010_be, 10, 2, 1, 1, true },
+	};
+
+	unsigned w = 96;
+	unsigned h = 6;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.packing);
+
+		std::vector<uint8_t> packed(stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto unpack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				param.src[p] = p < 2 ? src.data() + p * stride * h : nullptr;
+				param.src_stride[p] = stride;
+				param.dst[p] = dst.data() + p * stride * h;
+				param.dst_stride[p] = stride;
+			}
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_unpack_frame(&param, flags);
+		};
+		auto pack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				param.src[p] = src.data() + p * stride * h;
+				param.src_stride[p] = stride;
+				param.dst[p] = p < 2 ? dst.data() + p * stride * h : nullptr;
+				param.dst_stride[p] = stride;
+			}
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_pack_frame(&param, flags);
+		};
+		auto sample = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j)
+		{
+			const uint8_t *row = planes.data() + p * stride * h + i * stride;
+			return c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+		};
+
+		std::vector<uint8_t> native(stride * h * 3);
+		std::vector<uint8_t> full(native.size());
+		std::vector<uint8_t> repacked(packed.size());
+		std::vector<uint8_t> limited(native.size());
+
+		unpack(packed, native, 0);
+		unpack(packed, full, P2P_PLANAR_FULL_RANGE);
+		pack(full, repacked, P2P_PLANAR_FULL_RANGE);
+		unpack(repacked, limited, 0);
+
+		// Out-of-range codes clamp, others round-trip.
+		for (unsigned p = 0; p < 3; ++p) {
+			bool chroma = c.yuv && p;
+			unsigned plane_w = p ? w >> c.subsample_w : w;
+			unsigned plane_h = p ? h >> c.subsample_h : h;
+
+			for (unsigned i = 0; i < plane_h; ++i) {
+				for (unsigned j = 0; j < plane_w; ++j) {
+					uint32_t x = sample(native, p, i, j);
+					uint32_t y = p2p::detail::limited_to_full(x, c.depth, c.depth, chroma);
+					ASSERT_EQ(y, sample(full, p, i, j)) << p << ' ' << i << ' ' << j;
+					ASSERT_EQ(p2p::detail::full_to_limited(y, c.depth, c.depth, chroma), sample(limited, p, i, j)) << p << ' ' << i << ' ' << j;
+				}
+			}
+		}
+
+		// Full range packed into limited range planar, and back.
+		unpack(packed, limited, P2P_PLANAR_LIMITED_RANGE);
+		pack(limited, repacked, P2P_PLANAR_LIMITED_RANGE);
+		unpack(repacked, full, 0);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			bool chroma = c.yuv && p;
+			unsigned plane_w = p ? w >> c.subsample_w : w;
+			unsigned plane_h = p ? h >> c.subsample_h : h;
+
+			for (unsigned i = 0; i < plane_h; ++i) {
+				for (unsigned j = 0; j < plane_w; ++j) {
+					uint32_t y = p2p::detail::full_to_limited(sample(native, p, i, j), c.depth, c.depth, chroma);
+					ASSERT_EQ(y, sample(limited, p, i, j)) << p << ' ' << i << ' ' << j;
+					ASSERT_EQ(p2p::detail::limited_to_full(y, c.depth, c.depth, chroma), sample(full, p, i, j)) << p << ' ' << i << ' ' << j;
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_msb_aligned)
+{
+	unsigned w = 64;
+	unsigned h = 4;
+
+	std::vector<uint16_t> luma(w * h);
+	std::vector<uint16_t> chroma(w * h / 2);
+	for (size_t i = 0; i < luma.size(); ++i) {
+		luma[i] = static_cast<uint16_t>(i * 40503U + 7);
+	}
+	for (size_t i = 0; i < chroma.size(); ++i) {
+		chroma[i] = static_cast<uint16_t>(i * 52711U + 3);
+	}
+
+	std::vector<uint16_t> planar(w * h * 2);
+	p2p_buffer_param param{};
+	param.src[0] = luma.data();
+	param.src[1] = chroma.data();
+	param.src_stride[0] = w * 2;
+	param.src_stride[1] = w * 2;
+	param.dst[0] = planar.data();
+	param.dst[1] = planar.data() + w * h;
+	param.dst[2] = planar.data() + w * h + w * h / 4;
+	param.dst_stride[0] = w * 2;
+	param.dst_stride[1] = w;
+	param.dst_stride[2] = w;
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_p010_le;
+	p2p_unpack_frame(&param, P2P_MSB_ALIGNED);
+
+	// Samples are the packed words, padding included.
+	for (unsigned i = 0; i < h; ++i) {
+		for (unsigned j = 0; j < w; ++j) {
+			ASSERT_EQ(luma[i * w + j], planar[i * w + j]) << i << ' ' << j;
+		}
+	}
+	for (unsigned i = 0; i < h / 2; ++i) {
+		for (unsigned j = 0; j < w / 2; ++j) {
+			ASSERT_EQ(chroma[i * w + j * 2], static_cast<const uint16_t *>(param.dst[1])[i * w / 2 + j]) << i << ' ' << j;
+			ASSERT_EQ(chroma[i * w + j * 2 + 1], static_cast<const uint16_t *>(param.dst[2])[i * w / 2 + j]) << i << ' ' << j;
+		}
+	}
+
+	std::vector<uint16_t> luma_out(luma.size());
+	std::vector<uint16_t> chroma_out(chroma.size());
+	p2p_buffer_param pack_param{};
+	std::copy_n(param.dst, 4, pack_param.src);
+	std::copy_n(param.dst_stride, 4, pack_param.src_stride);
+	pack_param.dst[0] = luma_out.data();
+	pack_param.dst[1] = chroma_out.data();
+	pack_param.dst_stride[0] = w * 2;
+	pack_param.dst_stride[1] = w * 2;
+	pack_param.width = w;
+	pack_param.height = h;
+	pack_param.packing = p2p_p010_le;
+	p2p_pack_frame(&pack_param, P2P_MSB_ALIGNED);
+	EXPECT_EQ(luma, luma_out);
+	EXPECT_EQ(chroma, chroma_out);
+}
+
+GTEST_TEST(APITest, test_convert_frame_rescale)
+{
+	unsigned w = 64;
+	unsigned h = 3;
+
+	std::vector<uint8_t> yuy2(w * 2 * h);
+	for (size_t i = 0; i < yuy2.size(); ++i) {
+		yuy2[i] = static_cast<uint8_t>(i * 37 + 5);
+	}
+	std::vector<uint16_t> y210(w * 2 * h);
+
+	p2p_buffer_param param{};
+	param.src[0] = yuy2.data();
+	param.src_stride[0] = w * 2;
+	param.dst[0] = y210.data();
+	param.dst_stride[0] = w * 4;
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_yuy2;
+
+	EXPECT_EQ(-1, p2p_convert_frame(&param, p2p_y210, 0));
+	ASSERT_EQ(0, p2p_convert_frame(&param, p2p_y210, P2P_PLANAR_16BIT));
+
+	// 8-bit samples move to the top of the 10-bit field.
+	for (size_t i = 0; i < yuy2.size(); ++i) {
+		ASSERT_EQ(yuy2[i] << 8, y210[i]) << i;
+	}
+}
+
+GTEST_TEST(APITest, test_chroma_420)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned bytes_per_sample;
+		unsigned packed_linesize;
+		unsigned packed_depth;
+		unsigned planar_depth;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 0, 1, 96 * 2, 8, 8 },
+		{ p2p_uyvy, P2P_PLANAR_16BIT, 2, 96 * 2, 8, 16 },
+		{ p2p_y210_le, 0, 2, 96 * 4, 10, 10 },
+		{ p2p_v210_le, 0, 2, 96 / 6 * 16, 10, 10 },
+	};
+	const unsigned long modes[] = { 0, P2P_CHROMA_LINEAR, P2P_CHROMA_INTERLACED, P2P_CHROMA_LINEAR | P2P_CHROMA_INTERLACED };
+	const unsigned heights[] = { 8, 7, 12 };
+
+	unsigned w = 96;
+	unsigned stride = w * 2;
+
+	for (const test_case &c : cases) {
+		for (unsigned long mode : modes) {
+			for (unsigned h : heights) {
+				bool interlaced = !!(mode & P2P_CHROMA_INTERLACED);
+				bool linear = !!(mode & P2P_CHROMA_LINEAR);
+				unsigned long flags = c.flags | P2P_CHROMA_420 | mode;
+				if (interlaced && h % 4)
+					continue;
+
+				SCOPED_TRACE(testing::Message() << c.packing << ' ' << mode << ' ' << h);
+
+				std::vector<uint8_t> packed(c.packed_linesize * h);
+				for (size_t i = 0; i < packed.size(); ++i) {
+					packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+				}
+
+				auto convert = [&](const void *src, void * const planes[3], unsigned long f, bool is_pack)
+				{
+					p2p_buffer_param param{};
+					param.width = w;
+					param.height = h;
+					param.packing = c.packing;
+
+					if (is_pack) {
+						std::copy_n(planes, 3, param.src);
+						std::fill_n(param.src_stride, 3, stride);
+						param.dst[0] = const_cast<void *>(src);
+						param.dst_stride[0] = c.packed_linesize;
+						p2p_pack_frame(&param, f);
+					} else {
+						std::copy_n(planes, 3, param.dst);
+						std::fill_n(param.dst_stride, 3, stride);
+						param.src[0] = src;
+						param.src_stride[0] = c.packed_linesize;
+						p2p_unpack_frame(&param, f);
+					}
+				};
+				auto sample = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> int
+				{
+					const uint8_t *row = planes.data() + (p * h + i) * stride;
+					return c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+				};
+				auto planes = [&](std::vector<uint8_t> &v) -> std::array<void *, 3>
+				{
+					return { { v.data(), v.data() + h * stride, v.data() + 2 * h * stride } };
+				};
+
+				// Reference rows of a field, or of the frame if progressive.
+				unsigned fields = interlaced ? 2 : 1;
+				auto frame_row = [&](unsigned field, unsigned i) { return i * fields + field; };
+				auto clamp = [](int i, int n) { return std::min(std::max(i, 0), n - 1); };
+
+				std::vector<uint8_t> full(3 * h * stride);
+				std::vector<uint8_t> sub(full.size());
+				convert(packed.data(), planes(full).data(), c.flags, false);
+				convert(packed.data(), planes(sub).data(), flags, false);
+
+				for (unsigned i = 0; i < h; ++i) {
+					for (unsigned j = 0; j < w; ++j) {
+						ASSERT_EQ(sample(full, 0, i, j), sample(sub, 0, i, j)) << i << ' ' << j;
+					}
+				}
+
+				// Each chroma row filters the packed rows of its field.
+				for (unsigned field = 0; field < fields; ++field) {
+					int n = (h - field + fields - 1) / fields;
+
+					for (int i = 0; i < n / 2; ++i) {
+						for (unsigned p = 1; p < 3; ++p) {
+							for (unsigned j = 0; j < w / 2; ++j) {
+								auto x = [&](int k) { return sample(full, p, frame_row(field, clamp(k, n)), j); };
+								int expected = linear ? (x(2 * i - 1) + 3 * (x(2 * i) + x(2 * i + 1)) + x(2 * i + 2) + 4) >> 3 : (x(2 * i) + x(2 * i + 1) + 1) >> 1;
+								ASSERT_EQ(expected, sample(sub, p, frame_row(field, i), j)) << p << ' ' << i << ' ' << j;
+							}
+						}
+					}
+				}
+
+				// Packing interpolates from the nearest chroma rows of the field,
+				// then rounds to the packed depth.
+				auto round_trip = [&](int x)
+				{
+					uint32_t y = p2p::detail::rescale_depth<false>(x, c.planar_depth, c.packed_depth);
+					return static_cast<int>(p2p::detail::rescale_depth<false>(y, c.packed_depth, c.planar_depth));
+				};
+				std::vector<uint8_t> repacked(packed.size());
+				std::vector<uint8_t> unpacked(full.size());
+				convert(repacked.data(), planes(sub).data(), flags, true);
+				convert(repacked.data(), planes(unpacked).data(), c.flags, false);
+
+				for (unsigned field = 0; field < fields; ++field) {
+					int n = (h - field + fields - 1) / fields;
+					int m = h / 2 / fields;
+
+					for (int i = 0; i < n; ++i) {
+						int nearest = std::min(i / 2, m - 1);
+						int next = clamp(i == 2 * m ? nearest - 1 : nearest + (i % 2 ? 1 : -1), m);
+
+						for (unsigned j = 0; j < w; ++j) {
+							ASSERT_EQ(sample(sub, 0, frame_row(field, i), j), sample(unpacked, 0, frame_row(field, i), j)) << i << ' ' << j;
+						}
+						for (unsigned p = 1; p < 3; ++p) {
+							for (unsigned j = 0; j < w / 2; ++j) {
+								int a = sample(sub, p, frame_row(field, nearest), j);
+								int b = sample(sub, p, frame_row(field, next), j);
+								ASSERT_EQ(round_trip(linear ? (3 * a + b + 2) >> 2 : a), sample(unpacked, p, frame_row(field, i), j)) << p << ' ' << i << ' ' << j;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_chroma_420_threaded)
+{
+	unsigned w = 1920;
+	unsigned h = 540;
+
+	std::vector<uint8_t> packed(w * 2 * h);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>(i * 7 + 3);
+	}
+
+	p2p_buffer_param param{};
+	param.src[0] = packed.data();
+	param.src_stride[0] = w * 2;
+	param.dst_stride[0] = w;
+	param.dst_stride[1] = w / 2;
+	param.dst_stride[2] = w / 2;
+	param.width = w;
+	param.height = h;
+	param.packing = p2p_yuy2;
+
+	const unsigned long modes[] = { P2P_CHROMA_420, P2P_CHROMA_420 | P2P_CHROMA_LINEAR | P2P_CHROMA_INTERLACED };
+
+	for (unsigned long mode : modes) {
+		std::vector<uint8_t> planar(w * h * 3 / 2);
+		std::vector<uint8_t> planar_mt(planar.size());
+		std::vector<uint8_t> packed_st(packed.size());
+		std::vector<uint8_t> packed_mt(packed.size());
+
+		auto unpack = [&](std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			param.dst[0] = dst.data();
+			param.dst[1] = dst.data() + w * h;
+			param.dst[2] = dst.data() + w * h + w * h / 4;
+			p2p_unpack_frame(&param, flags);
+		};
+		auto pack = [&](std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			p2p_buffer_param pack_param{};
+			std::copy_n(param.dst, 4, pack_param.src);
+			std::copy_n(param.dst_stride, 4, pack_param.src_stride);
+			pack_param.dst[0] = dst.data();
+			pack_param.dst_stride[0] = w * 2;
+			pack_param.width = w;
+			pack_param.height = h;
+			pack_param.packing = p2p_yuy2;
+			p2p_pack_frame(&pack_param, flags);
+		};
+
+		unpack(planar_mt, mode | P2P_USE_THREADS);
+		pack(packed_mt, mode | P2P_USE_THREADS);
+		unpack(planar, mode);
+		pack(packed_st, mode);
+		EXPECT_EQ(planar, planar_mt);
+		EXPECT_EQ(packed_st, packed_mt);
+	}
+}
+
+GTEST_TEST(APITest, test_resampled_single_row)
+{
+	// A single row has no 4:2:0 chroma row, but its luma is still converted.
+	unsigned w = 8;
+	unsigned stride = 16;
+
+	std::vector<uint16_t> luma(stride);
+	for (unsigned j = 0; j < w; ++j) {
+		luma[j] = static_cast<uint16_t>(((j * 37 + 5) & 0x3FF) << 6);
+	}
+
+	std::vector<uint16_t> planar(stride * 3);
+	p2p_buffer_param param{};
+	param.src[0] = luma.data();
+	for (unsigned p = 0; p < 3; ++p) {
+		param.dst[p] = planar.data() + stride * p;
+		param.dst_stride[p] = stride * sizeof(uint16_t);
+	}
+	param.src_stride[0] = stride * sizeof(uint16_t);
+	param.width = w;
+	param.height = 1;
+	param.packing = p2p_p010_le;
+
+	p2p_unpack_frame(&param, P2P_CHROMA_444);
+	for (unsigned j = 0; j < w; ++j) {
+		ASSERT_EQ(luma[j] >> 6, planar[j]) << j;
+	}
+
+	std::vector<uint16_t> luma_tmp(luma.size());
+	p2p_buffer_param pack_param{};
+	std::copy_n(param.dst, 4, pack_param.src);
+	std::copy_n(param.dst_stride, 4, pack_param.src_stride);
+	pack_param.dst[0] = luma_tmp.data();
+	pack_param.dst_stride[0] = stride * sizeof(uint16_t);
+	pack_param.width = w;
+	pack_param.height = 1;
+	pack_param.packing = p2p_p010_le;
+
+	p2p_pack_frame(&pack_param, P2P_CHROMA_444);
+	ASSERT_EQ(luma, luma_tmp);
+
+	// Luma of a 4:2:2 row unpacked to 4:2:0, and the row left as it is when
+	// packed from 4:2:0 chroma that is not there.
+	std::vector<uint8_t> yuy2(w * 2);
+	for (unsigned j = 0; j < w * 2; ++j) {
+		yuy2[j] = static_cast<uint8_t>(j * 29 + 3);
+	}
+
+	std::vector<uint8_t> planar_422(stride * 3);
+	std::vector<uint8_t> planar_420(stride * 3);
+	p2p_buffer_param yuy2_param{};
+	yuy2_param.src[0] = yuy2.data();
+	yuy2_param.src_stride[0] = w * 2;
+	for (unsigned p = 0; p < 3; ++p) {
+		yuy2_param.dst[p] = planar_422.data() + stride * p;
+		yuy2_param.dst_stride[p] = stride;
+	}
+	yuy2_param.width = w;
+	yuy2_param.height = 1;
+	yuy2_param.packing = p2p_yuy2;
+
+	p2p_unpack_frame(&yuy2_param, 0);
+	for (unsigned p = 0; p < 3; ++p) {
+		yuy2_param.dst[p] = planar_420.data() + stride * p;
+	}
+	p2p_unpack_frame(&yuy2_param, P2P_CHROMA_420);
+	ASSERT_TRUE(std::equal(planar_422.begin(), planar_422.begin() + w, planar_420.begin()));
+
+	std::vector<uint8_t> yuy2_tmp(yuy2.size(), 0xAA);
+	p2p_buffer_param yuy2_pack{};
+	std::copy_n(yuy2_param.dst, 4, yuy2_pack.src);
+	std::copy_n(yuy2_param.dst_stride, 4, yuy2_pack.src_stride);
+	yuy2_pack.dst[0] = yuy2_tmp.data();
+	yuy2_pack.dst_stride[0] = w * 2;
+	yuy2_pack.width = w;
+	yuy2_pack.height = 1;
+	yuy2_pack.packing = p2p_yuy2;
+
+	p2p_pack_frame(&yuy2_pack, P2P_CHROMA_420);
+	ASSERT_TRUE(std::all_of(yuy2_tmp.begin(), yuy2_tmp.end(), [](uint8_t x) { return x == 0xAA; }));
+}
+
+GTEST_TEST(APITest, test_chroma_444_pack)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		unsigned subsample_h;
+		bool is_nv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 8, 1, 0, false },
+		{ p2p_y210_le, 10, 2, 0, false },
+		{ p2p_v210_le, 10, 2, 0, false },
+		{ p2p_nv12_le, 8, 1, 1, true },
+		{ p2p_p210_be, 10, 2, 0, true },
+	};
+	const unsigned long modes[] = { 0, P2P_CHROMA_LINEAR, P2P_CHROMA_CENTERED, P2P_CHROMA_CENTERED | P2P_CHROMA_LINEAR };
+
+	unsigned w = 96;
+	unsigned h = 6;
+	unsigned stride = w * 4;
+
+	for (const test_case &c : cases) {
+		for (unsigned long mode : modes) {
+			SCOPED_TRACE(testing::Message() << c.packing << ' ' << mode);
+
+			bool linear = !!(mode & P2P_CHROMA_LINEAR);
+			bool centered = !!(mode & P2P_CHROMA_CENTERED);
+
+			// Full resolution planes within the packed depth.
+			std::vector<uint8_t> planar(3 * h * stride);
+			for (unsigned p = 0; p < 3; ++p) {
+				for (unsigned i = 0; i < h; ++i) {
+					for (unsigned j = 0; j < w; ++j) {
+						uint32_t x = (((p * h + i) * w + j) * 2654435761U >> 11) & ((1U << c.depth) - 1);
+						uint8_t *row = planar.data() + (p * h + i) * stride;
+						if (c.bytes_per_sample == 1)
+							row[j] = static_cast<uint8_t>(x);
+						else
+							reinterpret_cast<uint16_t *>(row)[j] = static_cast<uint16_t>(x);
+					}
+				}
+			}
+			auto sample = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> int
+			{
+				const uint8_t *row = planes.data() + (p * h + i) * stride;
+				return c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+			};
+
+			std::vector<uint8_t> packed(2 * h * stride);
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				param.src[p] = planar.data() + p * h * stride;
+				param.src_stride[p] = stride;
+			}
+			param.dst[0] = packed.data();
+			param.dst[1] = c.is_nv ? packed.data() + h * stride : nullptr;
+			param.dst_stride[0] = stride;
+			param.dst_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_pack_frame(&param, P2P_CHROMA_444 | mode);
+
+			std::vector<uint8_t> unpacked(planar.size());
+			p2p_buffer_param unpack_param{};
+			std::copy_n(param.dst, 4, unpack_param.src);
+			std::copy_n(param.dst_stride, 4, unpack_param.src_stride);
+			for (unsigned p = 0; p < 3; ++p) {
+				unpack_param.dst[p] = unpacked.data() + p * h * stride;
+				unpack_param.dst_stride[p] = stride;
+			}
+			unpack_param.width = w;
+			unpack_param.height = h;
+			unpack_param.packing = c.packing;
+			p2p_unpack_frame(&unpack_param, 0);
+
+			for (unsigned i = 0; i < h; ++i) {
+				for (unsigned j = 0; j < w; ++j) {
+					ASSERT_EQ(sample(planar, 0, i, j), sample(unpacked, 0, i, j)) << i << ' ' << j;
+				}
+			}
+
+			// Vertical then horizontal decimation, repeating edge samples.
+			auto clamp = [](int i, int n) { return std::min(std::max(i, 0), n - 1); };
+			auto column = [&](unsigned p, int ci, int j) -> int
+			{
+				auto x = [&](int i) { return sample(planar, p, clamp(i, h), clamp(j, w)); };
+				if (!c.subsample_h)
+					return x(ci);
+				return linear ? (x(2 * ci - 1) + 3 * (x(2 * ci) + x(2 * ci + 1)) + x(2 * ci + 2) + 4) >> 3 : (x(2 * ci) + x(2 * ci + 1) + 1) >> 1;
+			};
+
+			for (unsigned p = 1; p < 3; ++p) {
+				for (unsigned i = 0; i < h >> c.subsample_h; ++i) {
+					for (unsigned k = 0; k < w / 2; ++k) {
+						auto x = [&](int j) { return column(p, i, j); };
+						int j = 2 * k;
+						int expected;
+						if (centered)
+							expected = linear ? (x(j - 1) + 3 * (x(j) + x(j + 1)) + x(j + 2) + 4) >> 3 : (x(j) + x(j + 1) + 1) >> 1;
+						else
+							expected = linear ? (x(j - 1) + 2 * x(j) + x(j + 1) + 2) >> 2 : x(j);
+						ASSERT_EQ(expected, sample(unpacked, p, i, k)) << p << ' ' << i << ' ' << k;
+					}
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_chroma_444_unpack)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		unsigned subsample_h;
+		bool is_nv;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 8, 1, 0, false },
+		{ p2p_uyvy, 8, 1, 0, false },
+		{ p2p_y210_le, 10, 2, 0, false },
+		{ p2p_v216_le, 16, 2, 0, false },
+		{ p2p_v210_le, 10, 2, 0, false },
+		{ p2p_nv12_le, 8, 1, 1, true },
+		{ p2p_p210_be, 10, 2, 0, true },
+	};
+	const unsigned long modes[] = { 0, P2P_CHROMA_LINEAR, P2P_CHROMA_CENTERED, P2P_CHROMA_CENTERED | P2P_CHROMA_LINEAR };
+
+	unsigned w = 96;
+	unsigned h = 6;
+	unsigned stride = w * 4;
+
+	for (const test_case &c : cases) {
+		for (unsigned long mode : modes) {
+			SCOPED_TRACE(testing::Message() << c.packing << ' ' << mode);
+
+			bool linear = !!(mode & P2P_CHROMA_LINEAR);
+			bool centered = !!(mode & P2P_CHROMA_CENTERED);
+			unsigned chroma_h = h >> c.subsample_h;
+
+			// Subsampled planes within the packed depth.
+			std::vector<uint8_t> planar(3 * h * stride);
+			for (unsigned p = 0; p < 3; ++p) {
+				for (unsigned i = 0; i < (p ? chroma_h : h); ++i) {
+					for (unsigned j = 0; j < (p ? w / 2 : w); ++j) {
+						uint32_t x = (((p * h + i) * w + j) * 2654435761U >> 11) & ((1U << c.depth) - 1);
+						uint8_t *row = planar.data() + (p * h + i) * stride;
+						if (c.bytes_per_sample == 1)
+							row[j] = static_cast<uint8_t>(x);
+						else
+							reinterpret_cast<uint16_t *>(row)[j] = static_cast<uint16_t>(x);
+					}
+				}
+			}
+			auto sample = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> int
+			{
+				const uint8_t *row = planes.data() + (p * h + i) * stride;
+				return c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+			};
+
+			std::vector<uint8_t> packed(2 * h * stride);
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 3; ++p) {
+				param.src[p] = planar.data() + p * h * stride;
+				param.src_stride[p] = stride;
+			}
+			param.dst[0] = packed.data();
+			param.dst[1] = c.is_nv ? packed.data() + h * stride : nullptr;
+			param.dst_stride[0] = stride;
+			param.dst_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_pack_frame(&param, 0);
+
+			std::vector<uint8_t> unpacked(planar.size());
+			p2p_buffer_param unpack_param{};
+			std::copy_n(param.dst, 4, unpack_param.src);
+			std::copy_n(param.dst_stride, 4, unpack_param.src_stride);
+			for (unsigned p = 0; p < 3; ++p) {
+				unpack_param.dst[p] = unpacked.data() + p * h * stride;
+				unpack_param.dst_stride[p] = stride;
+			}
+			unpack_param.width = w;
+			unpack_param.height = h;
+			unpack_param.packing = c.packing;
+			p2p_unpack_frame(&unpack_param, P2P_CHROMA_444 | mode);
+
+			for (unsigned i = 0; i < h; ++i) {
+				for (unsigned j = 0; j < w; ++j) {
+					ASSERT_EQ(sample(planar, 0, i, j), sample(unpacked, 0, i, j)) << i << ' ' << j;
+				}
+			}
+
+			// Vertical then horizontal upsampling, repeating edge samples.
+			auto clamp = [](int i, int n) { return std::min(std::max(i, 0), n - 1); };
+			auto column = [&](unsigned p, int i, int k) -> int
+			{
+				auto x = [&](int ci) { return sample(planar, p, clamp(ci, chroma_h), clamp(k, w / 2)); };
+				if (!c.subsample_h)
+					return x(i);
+				int ci = i / 2;
+				return linear ? (3 * x(ci) + x(i % 2 ? ci + 1 : ci - 1) + 2) >> 2 : x(ci);
+			};
+
+			for (unsigned p = 1; p < 3; ++p) {
+				for (unsigned i = 0; i < h; ++i) {
+					for (unsigned j = 0; j < w; ++j) {
+						auto x = [&](int k) { return column(p, i, k); };
+						int k = j / 2;
+						int expected;
+						if (!linear)
+							expected = x(k);
+						else if (centered)
+							expected = (3 * x(k) + x(j % 2 ? k + 1 : k - 1) + 2) >> 2;
+						else
+							expected = j % 2 ? (x(k) + x(k + 1) + 1) >> 1 : x(k);
+						ASSERT_EQ(expected, sample(unpacked, p, i, j)) << p << ' ' << i << ' ' << j;
+					}
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_alpha_premultiplied)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned depth;
+		unsigned alpha_depth;
+		unsigned bytes_per_sample;
+		bool yuv;
+	};
+	const test_case cases[] = {
+		{ p2p_argb32_be, 0, 8, 8, 1, false },
+		{ p2p_rgba32_le, P2P_PLANAR_16BIT, 16, 16, 2, false },
+		{ p2p_rgba64_le, 0, 16, 16, 2, false },
+		{ p2p_ayuv_be, 0, 8, 8, 1, true },
+		{ p2p_rgb30_be, 0, 10, 2, 2, false },
+		{ p2p_y410_le, 0, 10, 2, 2, true },
+		{ p2p_y416_le, 0, 16, 16, 2, true },
+	};
+
+	unsigned w = 100;
+	unsigned h = 4;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.packing);
+
+		std::vector<uint8_t> packed(stride * h);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto unpack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, bool alpha, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.dst[p] = p < 3 || alpha ? dst.data() + p * stride * h : nullptr;
+				param.dst_stride[p] = stride;
+			}
+			param.src[0] = src.data();
+			param.src_stride[0] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_unpack_frame(&param, c.flags | flags);
+		};
+		auto pack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, bool alpha, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.src[p] = p < 3 || alpha ? src.data() + p * stride * h : nullptr;
+				param.src_stride[p] = stride;
+			}
+			param.dst[0] = dst.data();
+			param.dst_stride[0] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_pack_frame(&param, c.flags | flags);
+		};
+		auto sample = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> int64_t
+		{
+			const uint8_t *row = planes.data() + p * stride * h + i * stride;
+			return c.bytes_per_sample == 1 ? row[j] : reinterpret_cast<const uint16_t *>(row)[j];
+		};
+
+		// Magnitudes about the midpoint of chroma, rounded half up.
+		int64_t max = (INT64_C(1) << c.depth) - 1;
+		int64_t alpha_max = (INT64_C(1) << c.alpha_depth) - 1;
+		auto convert = [&](int64_t x, int64_t a, unsigned p, bool premultiply)
+		{
+			int64_t mid = c.yuv && p ? INT64_C(1) << (c.depth - 1) : 0;
+			int64_t m = x - mid;
+			int64_t r;
+			if (premultiply)
+				r = (2 * std::abs(m) * a + alpha_max) / (2 * alpha_max);
+			else
+				r = a ? std::min((2 * std::abs(m) * alpha_max + a) / (2 * a), m < 0 ? mid : max - mid) : 0;
+			return m < 0 ? mid - r : mid + r;
+		};
+
+		// Wide planar samples are narrowed to the packed depth.
+		auto round_trip = [&](int64_t x) -> int64_t
+		{
+			if (!(c.flags & P2P_PLANAR_16BIT))
+				return x;
+			return p2p::detail::rescale_depth<false>(p2p::detail::rescale_depth<false>(static_cast<uint32_t>(x), 16, 8), 8, 16);
+		};
+
+		std::vector<uint8_t> straight(stride * h * 4);
+		std::vector<uint8_t> premultiplied(straight.size());
+		std::vector<uint8_t> color_only(straight.size());
+		std::vector<uint8_t> repacked(packed.size());
+		std::vector<uint8_t> unpacked(straight.size());
+
+		unpack(packed, straight, true, 0);
+		unpack(packed, premultiplied, true, P2P_ALPHA_PREMULTIPLIED);
+		unpack(packed, color_only, false, P2P_ALPHA_PREMULTIPLIED);
+		pack(premultiplied, repacked, true, P2P_ALPHA_PREMULTIPLIED);
+		unpack(repacked, unpacked, true, 0);
+
+		for (unsigned i = 0; i < h; ++i) {
+			for (unsigned j = 0; j < w; ++j) {
+				int64_t a = sample(straight, 3, i, j);
+				ASSERT_EQ(a, sample(premultiplied, 3, i, j)) << i << ' ' << j;
+				ASSERT_EQ(a, sample(unpacked, 3, i, j)) << i << ' ' << j;
+
+				for (unsigned p = 0; p < 3; ++p) {
+					int64_t x = convert(sample(straight, p, i, j), a, p, true);
+					ASSERT_EQ(x, sample(premultiplied, p, i, j)) << p << ' ' << i << ' ' << j;
+					ASSERT_EQ(x, sample(color_only, p, i, j)) << p << ' ' << i << ' ' << j;
+					ASSERT_EQ(round_trip(convert(x, a, p, false)), sample(unpacked, p, i, j)) << p << ' ' << i << ' ' << j;
+				}
+			}
+		}
+
+		// Opaque fill leaves color as given.
+		std::vector<uint8_t> expected(packed.size());
+		pack(straight, expected, false, P2P_ALPHA_SET_ONE);
+		pack(straight, repacked, false, P2P_ALPHA_SET_ONE | P2P_ALPHA_PREMULTIPLIED);
+		ASSERT_EQ(expected, repacked);
+	}
+}
+
+GTEST_TEST(APITest, test_color_matrix)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned depth;
+		unsigned bytes_per_sample;
+		bool yuv;
+		bool subsampled;
+	};
+	const test_case cases[] = {
+		{ p2p_argb32_be, P2P_MATRIX_BT601, 8, 1, false, false },
+		{ p2p_rgba64_le, P2P_MATRIX_BT2020 | P2P_MATRIX_FULL_RANGE, 16, 2, false, false },
+		{ p2p_ayuv_be, P2P_MATRIX_BT709, 8, 1, true, false },
+		{ p2p_y416_le, P2P_MATRIX_BT2020, 16, 2, true, false },
+		{ p2p_yuy2, P2P_MATRIX_BT709 | P2P_MATRIX_FULL_RANGE, 8, 1, true, true },
+		{ p2p_nv12_le, P2P_MATRIX_BT601, 8, 1, true, true },
+		{ p2p_v210_le, P2P_MATRIX_BT709, 10, 2, true, true },
+	};
+
+	unsigned w = 96;
+	unsigned h = 5;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(c.packing);
+
+		std::vector<uint8_t> packed(stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		unsigned long chroma = c.subsampled ? P2P_CHROMA_444 : 0;
+		auto unpack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.dst[p] = dst.data() + p * stride * h;
+				param.dst_stride[p] = stride;
+			}
+			param.src[0] = src.data();
+			param.src[1] = src.data() + stride * h;
+			param.src_stride[0] = stride;
+			param.src_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_unpack_frame(&param, flags);
+		};
+		auto pack = [&](const std::vector<uint8_t> &src, std::vector<uint8_t> &dst, unsigned long flags)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.src[p] = src.data() + p * stride * h;
+				param.src_stride[p] = stride;
+			}
+			param.dst[0] = dst.data();
+			param.dst[1] = dst.data() + stride * h;
+			param.dst_stride[0] = stride;
+			param.dst_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			p2p_pack_frame(&param, flags);
+		};
+		auto sample = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> uint8_t *
+		{
+			return planes.data() + p * stride * h + i * stride + j * c.bytes_per_sample;
+		};
+		auto get = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> int64_t
+		{
+			uint8_t *ptr = sample(planes, p, i, j);
+			return c.bytes_per_sample == 1 ? *ptr : *reinterpret_cast<uint16_t *>(ptr);
+		};
+		auto set = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j, int64_t x)
+		{
+			uint8_t *ptr = sample(planes, p, i, j);
+			if (c.bytes_per_sample == 1)
+				*ptr = static_cast<uint8_t>(x);
+			else
+				*reinterpret_cast<uint16_t *>(ptr) = static_cast<uint16_t>(x);
+		};
+
+		// Reference conversion in double precision.
+		double kr = 0.2627, kb = 0.0593;
+		if ((c.flags & P2P_MATRIX_MASK) == P2P_MATRIX_BT601) {
+			kr = 0.299;
+			kb = 0.114;
+		} else if ((c.flags & P2P_MATRIX_MASK) == P2P_MATRIX_BT709) {
+			kr = 0.2126;
+			kb = 0.0722;
+		}
+		double kg = 1 - kr - kb;
+		bool full = !!(c.flags & P2P_MATRIX_FULL_RANGE);
+		double max = std::ldexp(1.0, c.depth) - 1;
+		double k = std::ldexp(1.0, c.depth - 8);
+		double scale[3] = { full ? max : 219 * k, full ? max : 224 * k, full ? max : 224 * k };
+		double offset[3] = { full ? 0 : 16 * k, 128 * k, 128 * k };
+
+		auto convert = [&](const int64_t x[3], int64_t y[3], bool to_yuv)
+		{
+			double v[3];
+			if (to_yuv) {
+				double r = x[0] / max, g = x[1] / max, b = x[2] / max;
+				double luma = kr * r + kg * g + kb * b;
+				v[0] = luma * scale[0] + offset[0];
+				v[1] = (b - luma) / (2 * (1 - kb)) * scale[1] + offset[1];
+				v[2] = (r - luma) / (2 * (1 - kr)) * scale[2] + offset[2];
+			} else {
+				double luma = (x[0] - offset[0]) / scale[0];
+				double pb = (x[1] - offset[1]) / scale[1];
+				double pr = (x[2] - offset[2]) / scale[2];
+				double r = luma + 2 * (1 - kr) * pr;
+				double b = luma + 2 * (1 - kb) * pb;
+				v[0] = r * max;
+				v[1] = (luma - kr * r - kb * b) / kg * max;
+				v[2] = b * max;
+			}
+			for (unsigned p = 0; p < 3; ++p) {
+				y[p] = static_cast<int64_t>(std::lround(std::min(std::max(v[p], 0.0), max)));
+			}
+		};
+
+		// Rounding of three coefficients to 13 fractional bits, over full scale.
+		int64_t tolerance = 1 + (INT64_C(3) << c.depth) / (1 << 14);
+
+		std::vector<uint8_t> native(stride * h * 4);
+		std::vector<uint8_t> converted(native.size());
+		std::vector<uint8_t> expected(native.size());
+		std::vector<uint8_t> repacked(packed.size());
+		std::vector<uint8_t> reference(packed.size());
+
+		unpack(packed, native, chroma);
+		unpack(packed, converted, c.flags);
+
+		for (unsigned i = 0; i < h; ++i) {
+			for (unsigned j = 0; j < w; ++j) {
+				int64_t x[3] = { get(native, 0, i, j), get(native, 1, i, j), get(native, 2, i, j) };
+				int64_t y[3];
+				convert(x, y, !c.yuv);
+
+				for (unsigned p = 0; p < 3; ++p) {
+					ASSERT_LE(std::abs(y[p] - get(converted, p, i, j)), tolerance) << p << ' ' << i << ' ' << j;
+				}
+			}
+		}
+
+		// Packing through the matrix matches packing the reference conversion.
+		for (unsigned i = 0; i < h; ++i) {
+			for (unsigned j = 0; j < w; ++j) {
+				int64_t x[3] = { get(converted, 0, i, j), get(converted, 1, i, j), get(converted, 2, i, j) };
+				int64_t y[3];
+				convert(x, y, c.yuv);
+
+				for (unsigned p = 0; p < 3; ++p) {
+					set(expected, p, i, j, y[p]);
+				}
+				set(expected, 3, i, j, get(converted, 3, i, j));
+			}
+		}
+		pack(converted, repacked, c.flags);
+		pack(expected, reference, chroma);
+
+		unpack(repacked, converted, chroma);
+		unpack(reference, expected, chroma);
+		for (unsigned p = 0; p < 4; ++p) {
+			for (unsigned i = 0; i < h; ++i) {
+				for (unsigned j = 0; j < w; ++j) {
+					ASSERT_LE(std::abs(get(expected, p, i, j) - get(converted, p, i, j)), tolerance) << p << ' ' << i << ' ' << j;
+				}
+			}
+		}
+	}
+}
+
+GTEST_TEST(APITest, test_color_matrix_skipped_luma)
+{
+	unsigned w = 96;
+	unsigned h = 6;
+	unsigned stride = w * 2;
+
+	std::vector<uint8_t> packed(stride * h * 2);
+	for (size_t i = 0; i < packed.size(); ++i) {
+		packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+	}
+
+	auto unpack = [&](std::vector<uint8_t> &dst, bool src_luma, bool dst_luma, unsigned long flags)
+	{
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 3; ++p) {
+			param.dst[p] = dst.data() + p * stride * h;
+			param.dst_stride[p] = stride;
+		}
+		param.src[0] = src_luma ? packed.data() : nullptr;
+		param.src[1] = packed.data() + stride * h;
+		param.src_stride[0] = stride;
+		param.src_stride[1] = stride;
+		if (!dst_luma)
+			param.dst[0] = nullptr;
+		param.width = w;
+		param.height = h;
+		param.packing = p2p_nv12_le;
+		p2p_unpack_frame(&param, flags | P2P_MATRIX_BT709);
+	};
+
+	std::vector<uint8_t> expected(stride * h * 3);
+	unpack(expected, true, true, 0);
+
+	// Green and blue still depend on the luma that is not written.
+	std::vector<uint8_t> planar(expected.size(), 0xAA);
+	unpack(planar, true, false, 0);
+	for (unsigned i = h; i < 3 * h; ++i) {
+		ASSERT_TRUE(std::equal(&planar[i * stride], &planar[i * stride] + w, &expected[i * stride])) << i;
+	}
+
+	// Skipped luma leaves the first plane as is.
+	std::fill(planar.begin(), planar.end(), 0xAA);
+	unpack(planar, true, true, P2P_SKIP_UNPACKED_PLANES);
+	EXPECT_TRUE(std::all_of(planar.begin(), planar.begin() + stride * h, [](uint8_t x) { return x == 0xAA; }));
+
+	std::fill(planar.begin(), planar.end(), 0xAA);
+	unpack(planar, false, true, 0);
+	EXPECT_TRUE(std::all_of(planar.begin(), planar.begin() + stride * h, [](uint8_t x) { return x == 0xAA; }));
+}
+
+GTEST_TEST(APITest, test_lut)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned depth;
+		unsigned alpha_depth;
+		unsigned bytes_per_sample;
+		unsigned subsample_w;
+		unsigned subsample_h;
+	};
+	const test_case cases[] = {
+		{ p2p_argb32_le, 0, 8, 8, 1, 0, 0 },
+		{ p2p_argb32_be, P2P_PLANAR_16BIT, 16, 16, 2, 0, 0 },
+		{ p2p_rgba64_be, 0, 16, 16, 2, 0, 0 },
+		{ p2p_rgb30_le, 0, 10, 2, 2, 0, 0 },
+		{ p2p_y410_le, 0, 10, 2, 2, 0, 0 },
+		{ p2p_yuy2, 0, 8, 0, 1, 1, 0 },
+		{ p2p_yuy2, P2P_CHROMA_420, 8, 0, 1, 1, 1 },
+		{ p2p_v210_le, 0, 10, 0, 2, 1, 0 },
+		{ p2p_v210_le, P2P_CHROMA_444, 10, 0, 2, 0, 0 },
+		{ p2p_nv12_le, 0, 8, 0, 1, 1, 1 },
+		{ p2p_p010_le, 0, 10, 0, 2, 1, 1 },
+		{ p2p_p010_le, P2P_CHROMA_444, 10, 0, 2, 0, 0 },
+		{ p2p_ayuv_be, P2P_MATRIX_BT709, 8, 8, 1, 0, 0 },
+	};
+
+	unsigned w = 102;
+	unsigned h = 6;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(testing::Message() << c.packing << ' ' << c.flags);
+
+		// Tables that scramble every bit of the index.
+		std::vector<uint16_t> tables[4];
+		std::vector<uint8_t> tables8[4];
+		const void *lut[4] = {};
+		for (unsigned p = 0; p < 4; ++p) {
+			unsigned depth = p < 3 ? c.depth : c.alpha_depth;
+			if (!depth)
+				continue;
+
+			uint32_t mask = (UINT32_C(1) << depth) - 1;
+			for (uint32_t i = 0; i <= mask; ++i) {
+				tables[p].push_back(static_cast<uint16_t>(((i ^ (p + 1)) * 2654435761U >> 7) & mask));
+			}
+			tables8[p].assign(tables[p].begin(), tables[p].end());
+			lut[p] = c.bytes_per_sample == 1 ? static_cast<const void *>(tables8[p].data()) : tables[p].data();
+		}
+
+		std::vector<uint8_t> packed(stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto params = [&](const std::vector<uint8_t> &planar, const std::vector<uint8_t> &packed_buf, bool is_pack)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				uint8_t *planar_p = const_cast<uint8_t *>(planar.data()) + p * stride * h;
+				uint8_t *packed_p = const_cast<uint8_t *>(packed_buf.data()) + p * stride * h;
+				if (is_pack) {
+					param.src[p] = planar_p;
+					param.dst[p] = p < 2 ? packed_p : nullptr;
+				} else {
+					param.src[p] = p < 2 ? packed_p : nullptr;
+					param.dst[p] = planar_p;
+				}
+				param.src_stride[p] = stride;
+				param.dst_stride[p] = stride;
+			}
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			return param;
+		};
+		auto lookup = [&](std::vector<uint8_t> &planar, unsigned p, unsigned width, unsigned height)
+		{
+			for (unsigned i = 0; i < height; ++i) {
+				uint8_t *row = planar.data() + p * stride * h + i * stride;
+				for (unsigned j = 0; j < width; ++j) {
+					if (c.bytes_per_sample == 1)
+						row[j] = tables8[p][row[j] & (tables8[p].size() - 1)];
+					else
+						reinterpret_cast<uint16_t *>(row)[j] = tables[p][reinterpret_cast<uint16_t *>(row)[j] & (tables[p].size() - 1)];
+				}
+			}
+		};
+
+		std::vector<uint8_t> planar(stride * h * 4);
+		std::vector<uint8_t> looked_up(planar.size());
+		std::vector<uint8_t> expected(packed.size());
+		std::vector<uint8_t> repacked(packed.size());
+
+		p2p_buffer_param param = params(planar, packed, false);
+		p2p_unpack_frame(&param, c.flags);
+		param = params(looked_up, packed, false);
+		p2p_unpack_frame_lut(&param, lut, c.flags);
+
+		// Unpacking looks up the samples unpacked without tables.
+		std::vector<uint8_t> reference = planar;
+		for (unsigned p = 0; p < 4; ++p) {
+			if (lut[p])
+				lookup(reference, p, p == 1 || p == 2 ? (w + c.subsample_w) >> c.subsample_w : w, p == 1 || p == 2 ? h >> c.subsample_h : h);
+		}
+		ASSERT_EQ(reference, looked_up);
+
+		// Packing looks up the samples before packing them as usual.
+		std::vector<uint8_t> source = planar;
+		for (unsigned p = 0; p < 4; ++p) {
+			if (lut[p])
+				lookup(source, p, w, h);
+		}
+		param = params(source, expected, true);
+		p2p_pack_frame(&param, c.flags);
+		param = params(planar, repacked, true);
+		p2p_pack_frame_lut(&param, lut, c.flags);
+		ASSERT_EQ(expected, repacked);
+
+		// Plans take the same tables.
+		std::fill(repacked.begin(), repacked.end(), 0);
+		param = params(planar, repacked, true);
+		p2p_plan *plan = p2p_create_pack_plan_lut(&param, lut, c.flags | P2P_USE_THREADS);
+		ASSERT_TRUE(plan);
+		p2p_execute_plan(plan, param.src, param.dst);
+		p2p_destroy_plan(plan);
+		ASSERT_EQ(expected, repacked);
+	}
+}
+
+GTEST_TEST(APITest, test_dither)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned depth;
+		unsigned subsample_w; // Of the packed chroma, resampled from 4:4:4 planes if set.
+		unsigned subsample_h;
+	};
+	const test_case cases[] = {
+		{ p2p_argb32_le, P2P_PLANAR_16BIT | P2P_DITHER_ORDERED, 8, 0, 0 },
+		{ p2p_argb32_le, P2P_PLANAR_16BIT | P2P_DITHER_ERROR_DIFFUSION, 8, 0, 0 },
+		{ p2p_argb32_be, P2P_PLANAR_16BIT | P2P_BIT_REPLICATE | P2P_DITHER_ERROR_DIFFUSION, 8, 0, 0 },
+		{ p2p_rgb30_le, P2P_PLANAR_16BIT | P2P_DITHER_ORDERED, 10, 0, 0 },
+		{ p2p_rgba64_le, P2P_PLANAR_FLOAT | P2P_DITHER_ORDERED, 16, 0, 0 },
+		{ p2p_yuy2, P2P_PLANAR_FLOAT | P2P_DITHER_ERROR_DIFFUSION, 8, 0, 0 },
+		{ p2p_v210_le, P2P_PLANAR_16BIT | P2P_DITHER_ORDERED, 10, 0, 0 },
+		{ p2p_v210_le, P2P_PLANAR_16BIT | P2P_CHROMA_444 | P2P_DITHER_ORDERED, 10, 1, 0 },
+		{ p2p_nv12_le, P2P_PLANAR_16BIT | P2P_DITHER_ORDERED, 8, 0, 0 },
+		{ p2p_p010_le, P2P_PLANAR_FLOAT | P2P_DITHER_ERROR_DIFFUSION, 10, 0, 0 },
+		{ p2p_p010_le, P2P_PLANAR_16BIT | P2P_CHROMA_444 | P2P_DITHER_ORDERED, 10, 1, 1 },
+	};
+	const unsigned bayer[8][8] = {
+		{ 0, 32, 8, 40, 2, 34, 10, 42 },
+		{ 48, 16, 56, 24, 50, 18, 58, 26 },
+		{ 12, 44, 4, 36, 14, 46, 6, 38 },
+		{ 60, 28, 52, 20, 62, 30, 54, 22 },
+		{ 3, 35, 11, 43, 1, 33, 9, 41 },
+		{ 51, 19, 59, 27, 49, 17, 57, 25 },
+		{ 15, 47, 7, 39, 13, 45, 5, 37 },
+		{ 63, 31, 55, 23, 61, 29, 53, 21 },
+	};
+
+	unsigned w = 102;
+	unsigned h = 10;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(testing::Message() << c.packing << ' ' << c.flags);
+
+		bool fp = !!(c.flags & P2P_PLANAR_FLOAT);
+		bool replicate = !!(c.flags & P2P_BIT_REPLICATE);
+		unsigned long plain_flags = c.flags & ~(P2P_DITHER_MASK | P2P_CHROMA_444);
+		float max = static_cast<float>((1U << c.depth) - 1);
+
+		auto params = [&](const std::vector<uint8_t> &planar, std::vector<uint8_t> &packed)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.src[p] = planar.data() + p * stride * h;
+				param.src_stride[p] = stride;
+			}
+			param.dst[0] = packed.data();
+			param.dst[1] = packed.data() + stride * h;
+			param.dst_stride[0] = stride;
+			param.dst_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			return param;
+		};
+		auto sample = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> uint8_t *
+		{
+			return planes.data() + p * stride * h + i * stride + j * (fp ? 4 : 2);
+		};
+		auto get = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j)
+		{
+			float x;
+			uint16_t y;
+			if (fp)
+				std::memcpy(&x, sample(planes, p, i, j), 4);
+			else
+				std::memcpy(&y, sample(planes, p, i, j), 2);
+			return fp ? x : static_cast<float>(y);
+		};
+		auto set = [&](std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j, float x)
+		{
+			uint16_t y = static_cast<uint16_t>(x);
+			if (fp)
+				std::memcpy(sample(planes, p, i, j), &x, 4);
+			else
+				std::memcpy(sample(planes, p, i, j), &y, 2);
+		};
+
+		// Samples off the packed grid, with float samples slightly out of range.
+		// Resampled chroma repeats over the samples that are averaged or dropped.
+		std::vector<uint8_t> planar(stride * h * 4);
+		for (unsigned p = 0; p < 4; ++p) {
+			for (unsigned i = 0; i < h; ++i) {
+				for (unsigned j = 0; j < w; ++j) {
+					unsigned row = p == 1 || p == 2 ? i >> c.subsample_h : i;
+					uint32_t hash = static_cast<uint32_t>(((p * h + row) * w + j + 1) * 2654435761U);
+					set(planar, p, i, j, fp ? hash * (1.1f / 4294967296.0f) - 0.05f : static_cast<float>(hash >> 16));
+				}
+			}
+		}
+
+		// Reference dithering of the samples at packed resolution.
+		std::vector<uint8_t> dithered = planar;
+		for (unsigned p = 0; p < 3; ++p) {
+			bool chroma = p == 1 || p == 2;
+			unsigned height = chroma ? h >> c.subsample_h : h;
+			unsigned width = chroma ? (w + c.subsample_w) >> c.subsample_w : w;
+
+			for (unsigned i = 0; i < height; ++i) {
+				float error = 0.0f;
+				for (unsigned j = 0; j < width; ++j) {
+					float x = chroma ? get(planar, p, i << c.subsample_h, j << c.subsample_w) : get(planar, p, i, j);
+					float t = fp ? x * max : replicate ? x * (max / 65535.0f) : x * ((max + 1.0f) / 65536.0f);
+					float q;
+
+					if (c.flags & P2P_DITHER_ORDERED) {
+						q = std::floor(t + (2 * bayer[i % 8][j % 8] + 1) * (1.0f / 128));
+					} else {
+						t += error;
+						q = std::floor(t + 0.5f);
+					}
+					q = std::min(std::max(q, 0.0f), max);
+					error = std::min(std::max(t, 0.0f), max) - q;
+
+					uint32_t code = static_cast<uint32_t>(q) << (16 - c.depth);
+					if (replicate)
+						code |= code >> c.depth;
+					set(dithered, p, i, j, fp ? q / max : static_cast<float>(code));
+				}
+			}
+		}
+
+		std::vector<uint8_t> expected(stride * h * 2);
+		std::vector<uint8_t> packed(expected.size());
+
+		p2p_buffer_param param = params(dithered, expected);
+		p2p_pack_frame(&param, plain_flags);
+		param = params(planar, packed);
+		p2p_pack_frame(&param, c.flags);
+		ASSERT_EQ(expected, packed);
+
+		// Threaded plans dither by frame row, not band row.
+		std::fill(packed.begin(), packed.end(), 0);
+		p2p_plan *plan = p2p_create_pack_plan(&param, c.flags | P2P_USE_THREADS);
+		ASSERT_TRUE(plan);
+		p2p_execute_plan(plan, param.src, param.dst);
+		p2p_destroy_plan(plan);
+		ASSERT_EQ(expected, packed);
+	}
+
+	// Ordered dithering of a flat field keeps its mean to within a threshold step.
+	std::vector<uint16_t> flat(16 * 8 * 4);
+	std::vector<uint8_t> packed(16 * 8 * 4);
+	for (uint16_t x : { 0x0000, 0x1234, 0x80FF, 0xFEC0, 0xFFFF }) {
+		std::fill(flat.begin(), flat.end(), x);
+
+		p2p_buffer_param param{};
+		for (unsigned p = 0; p < 4; ++p) {
+			param.src[p] = flat.data() + p * 16 * 8;
+			param.src_stride[p] = 16 * 2;
+		}
+		param.dst[0] = packed.data();
+		param.dst_stride[0] = 16 * 4;
+		param.width = 16;
+		param.height = 8;
+		param.packing = p2p_argb32_le;
+		p2p_pack_frame(&param, P2P_PLANAR_16BIT | P2P_DITHER_ORDERED);
+
+		unsigned sum = 0;
+		for (size_t i = 0; i < packed.size(); i += 4) {
+			sum += packed[i + 1];
+		}
+		EXPECT_LE(std::abs(sum / 128.0 - std::min(x / 256.0, 255.0)), 1.0 / 64) << x;
+	}
+}
+
+GTEST_TEST(APITest, test_preview)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned bytes_per_sample;
+		unsigned subsample_w; // Of the planar chroma.
+		unsigned subsample_h;
+		bool has_alpha;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 0, 1, 1, 0, false },
+		{ p2p_yuy2, P2P_CHROMA_420, 1, 1, 1, false },
+		{ p2p_v210_le, 0, 2, 1, 0, false },
+		{ p2p_v210_le, P2P_PLANAR_FLOAT, 4, 1, 0, false },
+		{ p2p_nv12_le, 0, 1, 1, 1, false },
+		{ p2p_p010_le, 0, 2, 1, 1, false },
+		{ p2p_p010_le, P2P_CHROMA_444, 2, 0, 0, false },
+		{ p2p_argb32_le, 0, 1, 0, 0, true },
+		{ p2p_rgba32_be, P2P_PLANAR_16BIT, 2, 0, 0, true },
+		{ p2p_rgba64_le, 0, 2, 0, 0, true },
+	};
+
+	// Odd sizes for partial boxes, and enough rows for several bands.
+	unsigned w = 333;
+	unsigned h = 151;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(testing::Message() << c.packing << ' ' << c.flags);
+
+		std::vector<uint8_t> packed(stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto params = [&](std::vector<uint8_t> &planar)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.dst[p] = planar.data() + p * stride * h;
+				param.dst_stride[p] = stride;
+			}
+			param.src[0] = packed.data();
+			param.src[1] = packed.data() + stride * h;
+			param.src_stride[0] = stride;
+			param.src_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			return param;
+		};
+		auto get = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j)
+		{
+			const uint8_t *ptr = planes.data() + p * stride * h + i * stride + j * c.bytes_per_sample;
+			uint16_t x16;
+			float x32;
+			std::memcpy(&x16, ptr, 2);
+			std::memcpy(&x32, ptr, 4);
+			return c.bytes_per_sample == 1 ? *ptr : c.bytes_per_sample == 2 ? x16 : x32;
+		};
+
+		std::vector<uint8_t> planar(stride * h * 4);
+		p2p_buffer_param param = params(planar);
+		p2p_unpack_frame(&param, c.flags);
+
+		for (unsigned long threads : { 0UL, P2P_USE_THREADS }) {
+			SCOPED_TRACE(threads);
+
+			std::vector<uint8_t> unpacked(planar.size());
+			std::vector<uint8_t> previews[2] = { std::vector<uint8_t>(planar.size()), std::vector<uint8_t>(planar.size()) };
+			p2p_preview_param preview_params[2] = {};
+			for (unsigned k = 0; k < 2; ++k) {
+				preview_params[k].scale = 2 << k;
+				for (unsigned p = 0; p < 4; ++p) {
+					preview_params[k].dst[p] = previews[k].data() + p * stride * h;
+					preview_params[k].dst_stride[p] = stride;
+				}
+			}
+
+			param = params(unpacked);
+			ASSERT_EQ(0, p2p_unpack_frame_preview(&param, preview_params, 2, c.flags | threads));
+			ASSERT_EQ(planar, unpacked);
+
+			for (unsigned k = 0; k < 2; ++k) {
+				unsigned scale = 2 << k;
+				for (unsigned p = 0; p < 4; ++p) {
+					if (p == 3 && !c.has_alpha)
+						continue;
+
+					bool chroma = p == 1 || p == 2;
+					unsigned width = chroma ? (w + c.subsample_w) >> c.subsample_w : w;
+					unsigned height = chroma ? h >> c.subsample_h : h;
+
+					for (unsigned i = 0; i < (height + scale - 1) / scale; ++i) {
+						for (unsigned j = 0; j < (width + scale - 1) / scale; ++j) {
+							unsigned rows = std::min(scale, height - i * scale);
+							unsigned cols = std::min(scale, width - j * scale);
+							uint32_t sum = 0;
+							float sum_f = 0.0f;
+
+							for (unsigned r = 0; r < rows; ++r) {
+								for (unsigned s = 0; s < cols; ++s) {
+									sum += static_cast<uint32_t>(get(planar, p, i * scale + r, j * scale + s));
+									sum_f += get(planar, p, i * scale + r, j * scale + s);
+								}
+							}
+
+							unsigned count = rows * cols;
+							float expected = c.bytes_per_sample == 4 ? sum_f / count : static_cast<float>((sum + count / 2) / count);
+							ASSERT_EQ(expected, get(previews[k], p, i, j)) << k << ' ' << p << ' ' << i << ' ' << j;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	p2p_buffer_param param{};
+	p2p_preview_param preview{};
+	preview.scale = 3;
+	EXPECT_EQ(-1, p2p_unpack_frame_preview(&param, &preview, 1, 0));
+}
+
+GTEST_TEST(APITest, test_stats)
+{
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		unsigned bytes_per_sample;
+		unsigned depth;
+		unsigned alpha_depth;
+		unsigned subsample_w; // Of the planar chroma.
+		unsigned subsample_h;
+	};
+	const test_case cases[] = {
+		{ p2p_yuy2, 0, 1, 8, 0, 1, 0 },
+		{ p2p_yuy2, P2P_CHROMA_420, 1, 8, 0, 1, 1 },
+		{ p2p_v210_le, 0, 2, 10, 0, 1, 0 },
+		{ p2p_v210_le, P2P_PLANAR_HALF, 2, 0, 0, 1, 0 },
+		{ p2p_nv12_le, 0, 1, 8, 0, 1, 1 },
+		{ p2p_p010_le, P2P_CHROMA_444, 2, 10, 0, 0, 0 },
+		{ p2p_argb32_le, 0, 1, 8, 8, 0, 0 },
+		{ p2p_rgb30_le, P2P_PLANAR_16BIT, 2, 16, 16, 0, 0 },
+		{ p2p_rgba64_le, P2P_PLANAR_FLOAT, 4, 0, 0, 0, 0 },
+	};
+
+	unsigned w = 333;
+	unsigned h = 151;
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(testing::Message() << c.packing << ' ' << c.flags);
+
+		bool fp = !c.depth;
+		bool has_alpha = c.alpha_depth || (fp && c.packing == p2p_rgba64_le);
+
+		std::vector<uint8_t> packed(stride * h * 2);
+		for (size_t i = 0; i < packed.size(); ++i) {
+			packed[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto params = [&](std::vector<uint8_t> &planar)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.dst[p] = planar.data() + p * stride * h;
+				param.dst_stride[p] = stride;
+			}
+			param.src[0] = packed.data();
+			param.src[1] = packed.data() + stride * h;
+			param.src_stride[0] = stride;
+			param.src_stride[1] = stride;
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			return param;
+		};
+		auto get = [&](const std::vector<uint8_t> &planes, unsigned p, unsigned i, unsigned j) -> double
+		{
+			const uint8_t *ptr = planes.data() + p * stride * h + i * stride + j * c.bytes_per_sample;
+			uint16_t x16;
+			float x32;
+			std::memcpy(&x16, ptr, 2);
+			std::memcpy(&x32, ptr, 4);
+			if (c.flags & P2P_PLANAR_HALF)
+				return p2p::detail::half_to_float(x16);
+			return c.bytes_per_sample == 1 ? *ptr : c.bytes_per_sample == 2 ? x16 : x32;
+		};
+
+		std::vector<uint8_t> planar(stride * h * 4);
+		p2p_buffer_param param = params(planar);
+		p2p_unpack_frame(&param, c.flags);
+
+		// Reference statistics of the unpacked planes.
+		p2p_plane_stats expected[4] = {};
+		std::vector<unsigned long long> expected_histograms[4];
+		for (unsigned p = 0; p < 4; ++p) {
+			if (p == 3 && !has_alpha)
+				continue;
+
+			bool chroma = p == 1 || p == 2;
+			unsigned width = chroma ? (w + c.subsample_w) >> c.subsample_w : w;
+			unsigned height = chroma ? h >> c.subsample_h : h;
+			unsigned depth = p < 3 ? c.depth : c.alpha_depth;
+			expected_histograms[p].resize(fp ? 0 : size_t(1) << depth);
+
+			expected[p].min = INFINITY;
+			expected[p].max = -INFINITY;
+			for (unsigned i = 0; i < height; ++i) {
+				for (unsigned j = 0; j < width; ++j) {
+					double x = get(planar, p, i, j);
+					expected[p].min = std::min(expected[p].min, x);
+					expected[p].max = std::max(expected[p].max, x);
+					expected[p].sum += x;
+					if (!fp)
+						++expected_histograms[p][static_cast<size_t>(x)];
+				}
+			}
+			expected[p].count = static_cast<unsigned long long>(width) * height;
+		}
+
+		auto check = [&](const p2p_plane_stats stats[4], const std::vector<unsigned long long> histograms[4])
+		{
+			for (unsigned p = 0; p < 4; ++p) {
+				SCOPED_TRACE(p);
+				ASSERT_EQ(expected[p].count, stats[p].count);
+				if (!expected[p].count)
+					continue;
+				EXPECT_EQ(expected[p].min, stats[p].min);
+				EXPECT_EQ(expected[p].max, stats[p].max);
+				if (fp)
+					EXPECT_NEAR(expected[p].sum, stats[p].sum, 1e-9 * expected[p].count);
+				else
+					EXPECT_EQ(expected[p].sum, stats[p].sum);
+				EXPECT_EQ(expected_histograms[p], histograms[p]);
+			}
+		};
+
+		for (unsigned long threads : { 0UL, P2P_USE_THREADS }) {
+			SCOPED_TRACE(threads);
+
+			std::vector<uint8_t> unpacked(planar.size());
+			std::vector<unsigned long long> histograms[4];
+			p2p_plane_stats stats[4] = {};
+			for (unsigned p = 0; p < 4; ++p) {
+				histograms[p].resize(expected_histograms[p].size());
+				stats[p].histogram = histograms[p].empty() ? nullptr : histograms[p].data();
+			}
+
+			param = params(unpacked);
+			p2p_unpack_frame_stats(&param, stats, c.flags | threads);
+			ASSERT_EQ(planar, unpacked);
+			check(stats, histograms);
+		}
+
+		// Band statistics of a plan, merged by the caller.
+		std::vector<uint8_t> unpacked(planar.size());
+		std::vector<unsigned long long> histograms[4];
+		p2p_plane_stats stats[4] = {};
+		for (unsigned p = 0; p < 4; ++p) {
+			histograms[p].resize(expected_histograms[p].size());
+			stats[p].histogram = histograms[p].empty() ? nullptr : histograms[p].data();
+		}
+
+		param = params(unpacked);
+		p2p_plan *plan = p2p_create_unpack_plan(&param, c.flags | P2P_USE_THREADS);
+		ASSERT_TRUE(plan);
+		for (unsigned band = p2p_plan_num_bands(plan); band-- > 0;) {
+			p2p_execute_plan_band_stats(plan, band, param.src, param.dst, stats);
+		}
+		p2p_destroy_plan(plan);
+		ASSERT_EQ(planar, unpacked);
+		check(stats, histograms);
+
+		// NV luma without its packed plane is not unpacked, and not counted.
+		if (c.packing == p2p_nv12_le) {
+			p2p_plane_stats luma_stats[4] = {};
+			param = params(unpacked);
+			param.src[0] = nullptr;
+			p2p_unpack_frame_stats(&param, luma_stats, c.flags);
+			EXPECT_EQ(0U, luma_stats[0].count);
+			EXPECT_EQ(expected[1].count, luma_stats[1].count);
+		}
+	}
+}
+
+
+uint32_t crc32c_ref(const std::vector<uint8_t> &data)
+{
+	uint32_t crc = ~UINT32_C(0);
+	for (uint8_t x : data) {
+		crc ^= x;
+		for (unsigned bit = 0; bit < 8; ++bit) {
+			crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+		}
+	}
+	return ~crc;
+}
+
+// One-shot XXH64 with seed 0, from the specification.
+uint64_t xxh64_ref(const std::vector<uint8_t> &data)
+{
+	const uint64_t p1 = 0x9E3779B185EBCA87ULL, p2 = 0xC2B2AE3D27D4EB4FULL, p3 = 0x165667B19E3779F9ULL;
+	const uint64_t p4 = 0x85EBCA77C2B2AE63ULL, p5 = 0x27D4EB2F165667C5ULL;
+	auto rotl = [](uint64_t x, unsigned r) { return (x << r) | (x >> (64 - r)); };
+	auto round = [&](uint64_t acc, uint64_t x) { return rotl(acc + x * p2, 31) * p1; };
+	auto read = [&](size_t i, unsigned n)
+	{
+		uint64_t x = 0;
+		for (unsigned k = 0; k < n; ++k) {
+			x |= static_cast<uint64_t>(data[i + k]) << (8 * k);
+		}
+		return x;
+	};
+
+	size_t n = data.size();
+	size_t i = 0;
+	uint64_t h = p5;
+	if (n >= 32) {
+		uint64_t v[4] = { p1 + p2, p2, 0, 0 - p1 };
+		for (; i + 32 <= n; i += 32) {
+			for (unsigned k = 0; k < 4; ++k) {
+				v[k] = round(v[k], read(i + 8 * k, 8));
+			}
+		}
+		h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+		for (unsigned k = 0; k < 4; ++k) {
+			h = (h ^ round(0, v[k])) * p1 + p4;
+		}
+	}
+	h += n;
+	for (; i + 8 <= n; i += 8) {
+		h = rotl(h ^ round(0, read(i, 8)), 27) * p1 + p4;
+	}
+	if (i + 4 <= n) {
+		h = rotl(h ^ (read(i, 4) * p1), 23) * p2 + p3;
+		i += 4;
+	}
+	for (; i < n; ++i) {
+		h = rotl(h ^ (data[i] * p5), 11) * p1;
+	}
+	h = (h ^ (h >> 33)) * p2;
+	h = (h ^ (h >> 29)) * p3;
+	return h ^ (h >> 32);
+}
+
+GTEST_TEST(APITest, test_hash)
+{
+	// Test vectors of the reference implementations.
+	const std::vector<uint8_t> digits = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+	std::vector<uint8_t> bytes(100);
+	for (size_t i = 0; i < bytes.size(); ++i) {
+		bytes[i] = static_cast<uint8_t>(i);
+	}
+	EXPECT_EQ(0xE3069283U, crc32c_ref(digits));
+	EXPECT_EQ(0xEF46DB3751D8E999ULL, xxh64_ref({}));
+	EXPECT_EQ(0x44BC2CF5AD770999ULL, xxh64_ref({ 'a', 'b', 'c' }));
+	EXPECT_EQ(0x6AC1E58032166597ULL, xxh64_ref(bytes));
+
+	struct test_case {
+		p2p_packing packing;
+		unsigned long flags;
+		bool is_pack;
+		unsigned row_bytes[4]; // Of each destination plane.
+		unsigned rows[4];
+	};
+	const unsigned w = 333;
+	const unsigned h = 151;
+	const test_case cases[] = {
+		{ p2p_yuy2, 0, false, { w, 167, 167, 0 }, { h, h, h, 0 } },
+		{ p2p_yuy2, P2P_CHROMA_420, false, { w, 167, 167, 0 }, { h, h / 2, h / 2, 0 } },
+		{ p2p_nv12_le, 0, false, { w, 167, 167, 0 }, { h, h / 2, h / 2, 0 } },
+		{ p2p_argb32_le, P2P_PLANAR_16BIT, false, { 2 * w, 2 * w, 2 * w, 2 * w }, { h, h, h, h } },
+		{ p2p_v210_le, 0, false, { 2 * w, 334, 334, 0 }, { h, h, h, 0 } },
+		{ p2p_yuy2, 0, true, { 668, 0, 0, 0 }, { h, 0, 0, 0 } },
+		{ p2p_yuy2, P2P_CHROMA_420, true, { 668, 0, 0, 0 }, { h, 0, 0, 0 } },
+		{ p2p_nv12_le, 0, true, { w, 334, 0, 0 }, { h, h / 2, 0, 0 } },
+		{ p2p_argb32_le, 0, true, { 4 * w, 0, 0, 0 }, { h, 0, 0, 0 } },
+		{ p2p_v210_le, 0, true, { 896, 0, 0, 0 }, { h, 0, 0, 0 } },
+	};
+
+	unsigned stride = w * 8;
+
+	for (const test_case &c : cases) {
+		SCOPED_TRACE(testing::Message() << c.packing << ' ' << c.flags << ' ' << c.is_pack);
+
+		std::vector<uint8_t> src(stride * h * 4);
+		for (size_t i = 0; i < src.size(); ++i) {
+			src[i] = static_cast<uint8_t>((i * 2654435761U) >> 13);
+		}
+
+		auto params = [&](std::vector<uint8_t> &dst)
+		{
+			p2p_buffer_param param{};
+			for (unsigned p = 0; p < 4; ++p) {
+				param.src[p] = src.data() + p * stride * h;
+				param.dst[p] = dst.data() + p * stride * h;
+				param.src_stride[p] = stride;
+				param.dst_stride[p] = stride;
+			}
+			param.width = w;
+			param.height = h;
+			param.packing = c.packing;
+			return param;
+		};
+
+		std::vector<uint8_t> expected(stride * h * 4);
+		p2p_buffer_param param = params(expected);
+		if (c.is_pack)
+			p2p_pack_frame(&param, c.flags);
+		else
+			p2p_unpack_frame(&param, c.flags);
+
+		// Reference checksums of the rows of each plane, without padding.
+		std::vector<uint8_t> planes[4];
+		std::vector<uint8_t> frame[2];
+		unsigned long long expected_hash[2][4] = {};
+		for (unsigned p = 0; p < 4; ++p) {
+			for (unsigned i = 0; i < c.rows[p]; ++i) {
+				const uint8_t *row = expected.data() + p * stride * h + i * stride;
+				planes[p].insert(planes[p].end(), row, row + c.row_bytes[p]);
+			}
+			if (!c.rows[p])
+				continue;
+
+			expected_hash[p2p_hash_crc32c][p] = crc32c_ref(planes[p]);
+			expected_hash[p2p_hash_xxh64][p] = xxh64_ref(planes[p]);
+			for (unsigned type = 0; type < 2; ++type) {
+				for (unsigned k = 0; k < 8; ++k) {
+					frame[type].push_back(static_cast<uint8_t>(expected_hash[type][p] >> (8 * k)));
+				}
+			}
+		}
+
+		for (p2p_hash type : { p2p_hash_crc32c, p2p_hash_xxh64 }) {
+			for (unsigned long threads : { 0UL, P2P_USE_THREADS }) {
+				SCOPED_TRACE(testing::Message() << type << ' ' << threads);
+
+				std::vector<uint8_t> dst(expected.size());
+				param = params(dst);
+
+				p2p_frame_hash hash;
+				if (c.is_pack)
+					p2p_pack_frame_hash(&param, type, &hash, c.flags | threads);
+				else
+					p2p_unpack_frame_hash(&param, type, &hash, c.flags | threads);
+
+				ASSERT_EQ(expected, dst);
+				for (unsigned p = 0; p < 4; ++p) {
+					EXPECT_EQ(expected_hash[type][p], hash.plane[p]) << p;
+				}
+				EXPECT_EQ(type == p2p_hash_crc32c ? crc32c_ref(frame[type]) : xxh64_ref(frame[type]), hash.frame);
+			}
+		}
+
+		// NV luma without its packed plane is not unpacked, and not hashed.
+		if (c.packing == p2p_nv12_le && !c.is_pack) {
+			std::vector<uint8_t> dst(expected.size());
+			param = params(dst);
+			param.src[0] = nullptr;
+
+			p2p_frame_hash hash;
+			p2p_unpack_frame_hash(&param, p2p_hash_crc32c, &hash, c.flags);
+			EXPECT_EQ(0U, hash.plane[0]);
+			EXPECT_EQ(expected_hash[p2p_hash_crc32c][1], hash.plane[1]);
+		}
+	}
+}
+
 } // namespace
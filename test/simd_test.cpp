@@ -1,7 +1,12 @@
+#include <algorithm>
 #include <array>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <random>
+#include <vector>
 #include "p2p.h"
+#include "simd/cpuinfo_x86.h"
 #include "simd/p2p_simd.h"
 
 #include "gtest/gtest.h"
@@ -30,9 +35,35 @@ struct closest_type<p2p_scalar::uint48> {
 	typedef uint64_t type;
 };
 
+template <>
+struct closest_type<p2p_scalar::half> {
+	typedef uint16_t type;
+};
+
 template <class T>
 using closest_type_t = typename closest_type<T>::type;
 
+// Random planar sample. Floating point covers [-0.25, 1.25) and NaN, so that
+// clamping is exercised.
+template <class T>
+closest_type_t<T> random_sample(std::mt19937_64 &mt)
+{
+	return static_cast<T>(mt());
+}
+
+template <>
+float random_sample<float>(std::mt19937_64 &mt)
+{
+	uint64_t x = mt();
+	return x % 64 ? static_cast<float>(x % 6144) / 4096.0f - 0.25f : std::numeric_limits<float>::quiet_NaN();
+}
+
+template <>
+uint16_t random_sample<p2p_scalar::half>(std::mt19937_64 &mt)
+{
+	return p2p_scalar::detail::float_to_half(random_sample<float>(mt));
+}
+
 
 template <class Traits, uint64_t PackedMask = typename Traits::packed_type(~0ULL)>
 void unpack_test(p2p::detail::unpack_func func)
@@ -176,10 +207,88 @@ void pack_test(p2p::detail::pack_func func)
 }
 
 
+template <class Traits, bool Aligned = false>
+void unpack_2d_test(p2p::detail::unpack_2d_func func)
+{
+	using planar_type = typename Traits::planar_type;
+	using packed_type = typename Traits::packed_type;
+
+	// Odd strides to cover misaligned rows, unless testing aligned stores.
+	constexpr unsigned w = 48;
+	constexpr unsigned h = 3;
+	constexpr unsigned src_pitch = (w >> Traits::subsampling) + 3;
+	constexpr unsigned dst_pitch = Aligned ? w + 16 : w + 5;
+
+	std::array<packed_type, src_pitch * h> packed = {};
+
+	std::mt19937_64 mt;
+	std::generate(packed.begin(), packed.end(), [&]()
+	{
+		return static_cast<packed_type>(static_cast<closest_type_t<packed_type>>(mt()));
+	});
+
+	std::array<std::array<closest_type_t<planar_type>, dst_pitch * h>, 4> planar_scalar = {};
+	alignas(16) std::array<std::array<closest_type_t<planar_type>, dst_pitch * h>, 4> planar_vector = {};
+	const ptrdiff_t dst_stride[4] = {
+		dst_pitch * sizeof(planar_type), dst_pitch * sizeof(planar_type), dst_pitch * sizeof(planar_type), dst_pitch * sizeof(planar_type)
+	};
+
+	{
+		void *planar_ptrs[4] = { planar_scalar[0].data(), planar_scalar[1].data(), planar_scalar[2].data(), planar_scalar[3].data() };
+		p2p_scalar::packed_to_planar<Traits>::unpack_2d(packed.data(), src_pitch * sizeof(packed_type), planar_ptrs, dst_stride, 1, 47, h);
+	}
+	{
+		void *planar_ptrs[4] = { planar_vector[0].data(), planar_vector[1].data(), planar_vector[2].data(), planar_vector[3].data() };
+		func(packed.data(), src_pitch * sizeof(packed_type), planar_ptrs, dst_stride, 1, 47, h);
+	}
+
+	EXPECT_EQ(planar_scalar, planar_vector);
+}
+
+template <class Traits, bool AlphaOneFill, bool Aligned = false>
+void pack_2d_test(p2p::detail::pack_2d_func func)
+{
+	using planar_type = typename Traits::planar_type;
+	using packed_type = typename Traits::packed_type;
+
+	constexpr unsigned w = 48;
+	constexpr unsigned h = 3;
+	constexpr unsigned src_pitch = w + 5;
+	constexpr unsigned dst_pitch = Aligned ? (w >> Traits::subsampling) + 4 : (w >> Traits::subsampling) + 3;
+
+	std::array<std::array<closest_type_t<planar_type>, src_pitch * h>, 4> planar = {};
+
+	std::mt19937_64 mt;
+	for (auto &plane : planar) {
+		std::generate(plane.begin(), plane.end(), [&]() { return random_sample<planar_type>(mt); });
+	}
+
+	std::array<packed_type, dst_pitch * h> packed_scalar = {};
+	alignas(16) std::array<packed_type, dst_pitch * h> packed_vector = {};
+	const ptrdiff_t src_stride[4] = {
+		src_pitch * sizeof(planar_type), src_pitch * sizeof(planar_type), src_pitch * sizeof(planar_type), src_pitch * sizeof(planar_type)
+	};
+
+	void *planar_ptrs[4] = { planar[0].data(), planar[1].data(), planar[2].data(), nullptr };
+	p2p_scalar::planar_to_packed<Traits, AlphaOneFill>::pack_2d(planar_ptrs, src_stride, packed_scalar.data(), dst_pitch * sizeof(packed_type), 1, 47, h);
+	func(planar_ptrs, src_stride, packed_vector.data(), dst_pitch * sizeof(packed_type), 1, 47, h);
+	EXPECT_EQ(packed_scalar, packed_vector);
+
+	planar_ptrs[3] = planar[3].data();
+	p2p_scalar::planar_to_packed<Traits, AlphaOneFill>::pack_2d(planar_ptrs, src_stride, packed_scalar.data(), dst_pitch * sizeof(packed_type), 1, 47, h);
+	func(planar_ptrs, src_stride, packed_vector.data(), dst_pitch * sizeof(packed_type), 1, 47, h);
+	EXPECT_EQ(packed_scalar, packed_vector);
+}
+
+
 #define UNPACK_TEST(format, cpu) \
   GTEST_TEST(SIMDTest, test_unpack_##format##_##cpu) \
   { \
     unpack_test<p2p_scalar::packed_##format>(p2p::simd::unpack_##format##_##cpu); \
+  } \
+  GTEST_TEST(SIMDTest, test_unpack_##format##_2d_##cpu) \
+  { \
+    unpack_2d_test<p2p_scalar::packed_##format>(p2p::simd::unpack_##format##_2d_##cpu); \
   }
 
 #define PACK_TEST(format, cpu) \
@@ -193,6 +302,64 @@ void pack_test(p2p::detail::pack_func func)
       SCOPED_TRACE("AlphaOneFill"); \
       pack_test<p2p_scalar::packed_##format, 1>(p2p::simd::pack_##format##_1_##cpu); \
     } \
+  } \
+  GTEST_TEST(SIMDTest, test_pack_##format##_2d_##cpu) \
+  { \
+    { \
+      SCOPED_TRACE("AlphaZeroFill"); \
+      pack_2d_test<p2p_scalar::packed_##format, 0>(p2p::simd::pack_##format##_0_2d_##cpu); \
+    } \
+    { \
+      SCOPED_TRACE("AlphaOneFill"); \
+      pack_2d_test<p2p_scalar::packed_##format, 1>(p2p::simd::pack_##format##_1_2d_##cpu); \
+    } \
+  }
+
+#define UNPACK_NT_TEST(format, cpu) \
+  GTEST_TEST(SIMDTest, test_unpack_##format##_2d_nt_##cpu) \
+  { \
+    unpack_2d_test<p2p_scalar::packed_##format>(p2p::simd::unpack_##format##_2d_nt_##cpu); \
+    unpack_2d_test<p2p_scalar::packed_##format, true>(p2p::simd::unpack_##format##_2d_nt_##cpu); \
+  }
+
+#define PACK_NT_TEST(format, cpu) \
+  GTEST_TEST(SIMDTest, test_pack_##format##_2d_nt_##cpu) \
+  { \
+    pack_2d_test<p2p_scalar::packed_##format, 0>(p2p::simd::pack_##format##_0_2d_nt_##cpu); \
+    pack_2d_test<p2p_scalar::packed_##format, 0, true>(p2p::simd::pack_##format##_0_2d_nt_##cpu); \
+    pack_2d_test<p2p_scalar::packed_##format, 1>(p2p::simd::pack_##format##_1_2d_nt_##cpu); \
+    pack_2d_test<p2p_scalar::packed_##format, 1, true>(p2p::simd::pack_##format##_1_2d_nt_##cpu); \
+  }
+
+#define W16_TEST(format, cpu) \
+  GTEST_TEST(SIMDTest, test_unpack_##format##_w16_##cpu) \
+  { \
+    unpack_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t>>(p2p::simd::unpack_##format##_w16_##cpu); \
+    unpack_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t, 16, true>>(p2p::simd::unpack_##format##_w16r_##cpu); \
+    unpack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t>>(p2p::simd::unpack_##format##_w16_2d_##cpu); \
+    unpack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t, 16, true>>(p2p::simd::unpack_##format##_w16r_2d_##cpu); \
+  } \
+  GTEST_TEST(SIMDTest, test_pack_##format##_w16_##cpu) \
+  { \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t>, 0>(p2p::simd::pack_##format##_w16_0_2d_##cpu); \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t>, 1>(p2p::simd::pack_##format##_w16_1_2d_##cpu); \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t, 16, true>, 0>(p2p::simd::pack_##format##_w16r_0_2d_##cpu); \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, uint16_t, 16, true>, 1>(p2p::simd::pack_##format##_w16r_1_2d_##cpu); \
+  }
+
+#define FP_TEST(format, planar, suffix, cpu) \
+  GTEST_TEST(SIMDTest, test_unpack_##format##_##suffix##_##cpu) \
+  { \
+    if (!p2p::simd::query_x86_capabilities().cpu) \
+      return; \
+    unpack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, planar>>(p2p::simd::unpack_##format##_##suffix##_2d_##cpu); \
+  } \
+  GTEST_TEST(SIMDTest, test_pack_##format##_##suffix##_##cpu) \
+  { \
+    if (!p2p::simd::query_x86_capabilities().cpu) \
+      return; \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, planar>, 0>(p2p::simd::pack_##format##_##suffix##_0_2d_##cpu); \
+    pack_2d_test<p2p_scalar::rescale_traits<p2p_scalar::packed_##format, planar>, 1>(p2p::simd::pack_##format##_##suffix##_1_2d_##cpu); \
   }
 
 #if defined(__x86_64__) || defined(__i386__) || defined(_M_IX86) || defined(_M_X64)
@@ -205,6 +372,489 @@ PACK_TEST(argb32_be, sse41)
 PACK_TEST(argb32_le, sse41)
 PACK_TEST(rgba32_be, sse41)
 PACK_TEST(rgba32_le, sse41)
+
+UNPACK_NT_TEST(argb32_be, sse41)
+UNPACK_NT_TEST(argb32_le, sse41)
+UNPACK_NT_TEST(rgba32_be, sse41)
+UNPACK_NT_TEST(rgba32_le, sse41)
+
+PACK_NT_TEST(argb32_be, sse41)
+PACK_NT_TEST(argb32_le, sse41)
+PACK_NT_TEST(rgba32_be, sse41)
+PACK_NT_TEST(rgba32_le, sse41)
+
+W16_TEST(argb32_be, sse41)
+W16_TEST(argb32_le, sse41)
+W16_TEST(rgba32_be, sse41)
+W16_TEST(rgba32_le, sse41)
+
+FP_TEST(argb32_be, float, f32, sse41)
+FP_TEST(argb32_le, float, f32, sse41)
+FP_TEST(rgba32_be, float, f32, sse41)
+FP_TEST(rgba32_le, float, f32, sse41)
+
+FP_TEST(argb32_be, p2p_scalar::half, f16, f16c)
+FP_TEST(argb32_le, p2p_scalar::half, f16, f16c)
+FP_TEST(rgba32_be, p2p_scalar::half, f16, f16c)
+FP_TEST(rgba32_le, p2p_scalar::half, f16, f16c)
+
+GTEST_TEST(SIMDTest, test_transform_bytes_sse41)
+{
+	// Odd word count to cover the partial vector.
+	std::array<uint8_t, 70> src;
+	std::mt19937 mt;
+	std::generate(src.begin(), src.end(), [&]() { return static_cast<uint8_t>(mt()); });
+
+	p2p::detail::byte_transform t;
+	std::fill_n(t.mask, 16, 0xFF);
+	for (unsigned i = 0; i < 16; ++i) {
+		t.shuffle[i] = static_cast<uint8_t>(i);
+		t.shuffle_out[i] = static_cast<uint8_t>(i ^ 1);
+	}
+	t.shift_right = 6;
+	t.shift_left = 0;
+
+	// Little-endian P010 to big-endian P016 samples.
+	std::array<uint8_t, 70> expected;
+	for (size_t i = 0; i < src.size(); i += 2) {
+		uint16_t w = (src[i] | (src[i + 1] << 8)) >> 6;
+		expected[i] = static_cast<uint8_t>(w >> 8);
+		expected[i + 1] = static_cast<uint8_t>(w);
+	}
+
+	std::array<uint8_t, 70> dst{};
+	p2p::simd::transform_bytes_sse41(src.data(), dst.data(), dst.size(), t);
+	EXPECT_EQ(expected, dst);
+
+	// In place.
+	p2p::simd::transform_bytes_sse41(src.data(), src.data(), src.size(), t);
+	EXPECT_EQ(expected, src);
+}
+
+GTEST_TEST(SIMDTest, test_transform_bytes_mask_sse41)
+{
+	// 16-bit byte swap with the low 6 bits of each word cleared, as for Y210.
+	std::array<uint8_t, 64> src;
+	std::mt19937 mt;
+	std::generate(src.begin(), src.end(), [&]() { return static_cast<uint8_t>(mt()); });
+
+	p2p::detail::byte_transform t;
+	for (unsigned i = 0; i < 16; ++i) {
+		t.shuffle[i] = static_cast<uint8_t>(i ^ 1);
+		t.shuffle_out[i] = static_cast<uint8_t>(i);
+		t.mask[i] = i % 2 ? 0xC0 : 0xFF;
+	}
+	t.shift_right = 0;
+	t.shift_left = 0;
+
+	std::array<uint8_t, 64> expected;
+	for (size_t i = 0; i < src.size(); ++i) {
+		expected[i] = src[i ^ 1] & t.mask[i % 16];
+	}
+
+	std::array<uint8_t, 64> dst{};
+	p2p::simd::transform_bytes_sse41(src.data(), dst.data(), dst.size(), t);
+	EXPECT_EQ(expected, dst);
+}
+
+GTEST_TEST(SIMDTest, test_row_filter_sse41)
+{
+	// Odd sample count to cover the scalar tail, and full-scale rows for
+	// overflow.
+	const unsigned n = 37;
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		uint32_t max = bytes == 1 ? 0xFF : 0xFFFF;
+		std::array<std::vector<uint16_t>, 4> rows;
+		for (unsigned k = 0; k < 4; ++k) {
+			rows[k].resize(n);
+			std::generate(rows[k].begin(), rows[k].end(), [&]() { return static_cast<uint16_t>(k == 1 ? max : mt() & max); });
+		}
+
+		std::array<std::vector<uint8_t>, 4> rows8;
+		const void *src[4];
+		for (unsigned k = 0; k < 4; ++k) {
+			rows8[k].assign(rows[k].begin(), rows[k].end());
+			src[k] = bytes == 1 ? static_cast<const void *>(rows8[k].data()) : rows[k].data();
+		}
+
+		for (p2p::detail::row_filter filter : { p2p::detail::row_average, p2p::detail::row_interpolate, p2p::detail::row_smooth }) {
+			SCOPED_TRACE(testing::Message() << bytes << ' ' << filter);
+
+			std::vector<uint16_t> dst(n);
+			std::vector<uint8_t> dst8(n);
+			p2p::simd::select_row_filter_sse41(filter, bytes)(src, bytes == 1 ? static_cast<void *>(dst8.data()) : dst.data(), n);
+			if (bytes == 1)
+				dst.assign(dst8.begin(), dst8.end());
+
+			for (unsigned i = 0; i < n; ++i) {
+				uint32_t a = rows[0][i], b = rows[1][i], c = rows[2][i], d = rows[3][i];
+				uint32_t expected = filter == p2p::detail::row_average ? (a + b + 1) >> 1 :
+					filter == p2p::detail::row_interpolate ? (3 * a + b + 2) >> 2 : (a + 3 * (b + c) + d + 4) >> 3;
+				ASSERT_EQ(expected, dst[i]) << i;
+			}
+		}
+	}
+}
+
+GTEST_TEST(SIMDTest, test_chroma_resample_sse41)
+{
+	// Odd widths for the edge samples, and enough samples for the vector loop.
+	const unsigned src_width = 75;
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		uint32_t max = bytes == 1 ? 0xFF : 0xFFFF;
+		std::vector<uint16_t> src(src_width);
+		std::generate(src.begin(), src.end(), [&]() { return static_cast<uint16_t>(mt() % 4 ? mt() & max : max); });
+		std::vector<uint8_t> src8(src.begin(), src.end());
+
+		auto x = [&](int i) -> uint32_t { return src[std::min(std::max(i, 0), static_cast<int>(src_width) - 1)]; };
+
+		for (p2p::detail::chroma_resample resample : {
+			p2p::detail::chroma_drop, p2p::detail::chroma_average, p2p::detail::chroma_triangle, p2p::detail::chroma_smooth,
+			p2p::detail::chroma_repeat, p2p::detail::chroma_linear_cosited, p2p::detail::chroma_linear_centered })
+		{
+			SCOPED_TRACE(testing::Message() << bytes << ' ' << resample);
+
+			unsigned dst_width = resample >= p2p::detail::chroma_repeat ? src_width * 2 - 1 : (src_width + 1) / 2;
+
+			std::vector<uint16_t> dst(dst_width);
+			std::vector<uint8_t> dst8(dst_width);
+			auto func = p2p::simd::select_chroma_resample_sse41(resample, bytes);
+			if (bytes == 1) {
+				func(src8.data(), dst8.data(), src_width, dst_width);
+				dst.assign(dst8.begin(), dst8.end());
+			} else {
+				func(src.data(), dst.data(), src_width, dst_width);
+			}
+
+			for (unsigned k = 0; k < dst_width; ++k) {
+				int j = 2 * k;
+				int h = k / 2;
+				uint32_t expected;
+				switch (resample) {
+				case p2p::detail::chroma_drop:
+					expected = x(j);
+					break;
+				case p2p::detail::chroma_average:
+					expected = (x(j) + x(j + 1) + 1) >> 1;
+					break;
+				case p2p::detail::chroma_triangle:
+					expected = (x(j - 1) + 2 * x(j) + x(j + 1) + 2) >> 2;
+					break;
+				case p2p::detail::chroma_smooth:
+					expected = (x(j - 1) + 3 * (x(j) + x(j + 1)) + x(j + 2) + 4) >> 3;
+					break;
+				case p2p::detail::chroma_repeat:
+					expected = x(h);
+					break;
+				case p2p::detail::chroma_linear_cosited:
+					expected = k % 2 ? (x(h) + x(h + 1) + 1) >> 1 : x(h);
+					break;
+				default:
+					expected = (3 * x(h) + x(k % 2 ? h + 1 : h - 1) + 2) >> 2;
+					break;
+				}
+				ASSERT_EQ(expected, dst[k]) << k;
+			}
+		}
+	}
+}
+
+GTEST_TEST(SIMDTest, test_alpha_sse41)
+{
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		int64_t max = bytes == 1 ? 0xFF : 0xFFFF;
+
+		// Every 8-bit pair, and random 16-bit pairs salted with edge values,
+		// with an odd count for the scalar tail.
+		unsigned n = bytes == 1 ? 0x10000 + 5 : 4099;
+		std::vector<uint16_t> x(n);
+		std::vector<uint16_t> a(n);
+		for (unsigned i = 0; i < n; ++i) {
+			const uint16_t edges[] = { 0, 1, 0x7FFF, 0x8000, 0xFFFF };
+			if (bytes == 1) {
+				x[i] = static_cast<uint16_t>(i & 0xFF);
+				a[i] = static_cast<uint16_t>((i >> 8) & 0xFF);
+			} else {
+				x[i] = static_cast<uint16_t>(mt() % 4 ? mt() : edges[mt() % 5]);
+				a[i] = static_cast<uint16_t>(mt() % 4 ? mt() : edges[mt() % 5]);
+			}
+		}
+		std::vector<uint8_t> x8(x.begin(), x.end());
+		std::vector<uint8_t> a8(a.begin(), a.end());
+
+		for (p2p::detail::alpha_op op : { p2p::detail::alpha_premultiply, p2p::detail::alpha_unpremultiply }) {
+			for (bool centered : { false, true }) {
+				SCOPED_TRACE(testing::Message() << bytes << ' ' << op << ' ' << centered);
+
+				p2p::detail::alpha_scale scale = { static_cast<unsigned char>(bytes * 8), static_cast<unsigned char>(bytes * 8), centered };
+				std::vector<uint16_t> dst(n);
+				std::vector<uint8_t> dst8(n);
+				auto func = p2p::simd::select_alpha_sse41(op, bytes);
+				if (bytes == 1) {
+					func(x8.data(), a8.data(), dst8.data(), n, scale);
+					dst.assign(dst8.begin(), dst8.end());
+				} else {
+					func(x.data(), a.data(), dst.data(), n, scale);
+				}
+
+				int64_t mid = centered ? (max + 1) / 2 : 0;
+				for (unsigned i = 0; i < n; ++i) {
+					int64_t m = x[i] - mid;
+					int64_t r;
+					if (op == p2p::detail::alpha_premultiply)
+						r = (2 * std::abs(m) * a[i] + max) / (2 * max);
+					else
+						r = a[i] ? std::min((2 * std::abs(m) * max + a[i]) / (2 * a[i]), m < 0 ? mid : max - mid) : 0;
+					ASSERT_EQ(m < 0 ? mid - r : mid + r, dst[i]) << i << ' ' << x[i] << ' ' << a[i];
+				}
+			}
+		}
+	}
+}
+GTEST_TEST(SIMDTest, test_matrix_sse41)
+{
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		SCOPED_TRACE(bytes);
+
+		// Limited range BT.709 to RGB, which overshoots on both sides.
+		int32_t k = bytes == 1 ? 1 : 256;
+		p2p::detail::color_matrix m{};
+		const int32_t c[3][3] = { { 9539, 0, 14686 }, { 9539, -1747, -4366 }, { 9539, 17304, 0 } };
+		std::copy_n(&c[0][0], 9, &m.c[0][0]);
+		m.in[0] = 16 * k;
+		m.in[1] = 128 * k;
+		m.in[2] = 128 * k;
+		m.max = bytes == 1 ? 0xFF : 0xFFFF;
+
+		// Odd count for the scalar tail.
+		unsigned n = 1001;
+		std::vector<uint16_t> x[3];
+		std::vector<uint8_t> x8[3];
+		for (unsigned p = 0; p < 3; ++p) {
+			for (unsigned i = 0; i < n; ++i) {
+				x[p].push_back(static_cast<uint16_t>(mt() & m.max));
+			}
+			x8[p].assign(x[p].begin(), x[p].end());
+		}
+
+		std::vector<uint16_t> dst[3];
+		std::vector<uint8_t> dst8[3];
+		const void *src_p[3];
+		void *dst_p[3];
+		for (unsigned p = 0; p < 3; ++p) {
+			dst[p].resize(n);
+			dst8[p].resize(n);
+			src_p[p] = bytes == 1 ? static_cast<const void *>(x8[p].data()) : x[p].data();
+			dst_p[p] = bytes == 1 ? static_cast<void *>(dst8[p].data()) : dst[p].data();
+		}
+		p2p::simd::select_matrix_sse41(bytes)(src_p, dst_p, n, m);
+
+		for (unsigned p = 0; p < 3; ++p) {
+			if (bytes == 1)
+				dst[p].assign(dst8[p].begin(), dst8[p].end());
+
+			for (unsigned i = 0; i < n; ++i) {
+				int32_t y = (c[p][0] * (x[0][i] - m.in[0]) + c[p][1] * (x[1][i] - m.in[1]) + c[p][2] * (x[2][i] - m.in[2]) + 4096) >> 13;
+				ASSERT_EQ(std::min(std::max(y, 0), m.max), dst[p][i]) << p << ' ' << i;
+			}
+		}
+	}
+}
+
+GTEST_TEST(SIMDTest, test_dither_sse41)
+{
+	std::mt19937 mt;
+
+	for (unsigned depth : { 8U, 10U, 12U }) {
+		for (unsigned row : { 0U, 5U }) {
+			SCOPED_TRACE(testing::Message() << depth << ' ' << row);
+
+			// Odd count for the scalar tail, with samples that saturate the threshold.
+			unsigned n = 1001;
+			std::vector<uint16_t> x(n);
+			for (unsigned i = 0; i < n; ++i) {
+				x[i] = static_cast<uint16_t>(i % 7 ? mt() : 0xFFFF - i % 64);
+			}
+
+			std::vector<uint16_t> dst(n);
+			p2p::simd::select_dither_sse41(p2p::detail::dither_ordered)(x.data(), dst.data(), n, row, depth);
+
+			unsigned shift = 16 - depth;
+			for (unsigned i = 0; i < n; ++i) {
+				uint32_t t = ((2 * p2p::detail::bayer_threshold(i, row) + 1) << shift) >> 7;
+				uint32_t y = std::min(x[i] + t, UINT32_C(0xFFFF)) >> shift << shift;
+				ASSERT_EQ(y, dst[i]) << i << ' ' << x[i];
+			}
+		}
+	}
+	EXPECT_FALSE(p2p::simd::select_dither_sse41(p2p::detail::dither_error_diffusion));
+}
+
+GTEST_TEST(SIMDTest, test_box_filter_sse41)
+{
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		for (unsigned scale : { 2U, 4U }) {
+			SCOPED_TRACE(testing::Message() << bytes << ' ' << scale);
+
+			// Full scale samples, and a partial box in the scalar tail.
+			unsigned width = 1003;
+			uint32_t max = bytes == 1 ? 0xFF : 0xFFFF;
+			std::vector<uint16_t> x[4];
+			std::vector<uint8_t> x8[4];
+			const void *src[4];
+			for (unsigned r = 0; r < scale; ++r) {
+				for (unsigned i = 0; i < width; ++i) {
+					x[r].push_back(static_cast<uint16_t>(i % 97 < 8 ? max : mt() & max));
+				}
+				x8[r].assign(x[r].begin(), x[r].end());
+				src[r] = bytes == 1 ? static_cast<const void *>(x8[r].data()) : x[r].data();
+			}
+
+			unsigned n = (width + scale - 1) / scale;
+			std::vector<uint16_t> dst(n);
+			std::vector<uint8_t> dst8(n);
+			p2p::simd::select_box_filter_sse41(scale, bytes)(src, bytes == 1 ? static_cast<void *>(dst8.data()) : dst.data(), width);
+			if (bytes == 1)
+				dst.assign(dst8.begin(), dst8.end());
+
+			for (unsigned k = 0; k < n; ++k) {
+				unsigned end = std::min((k + 1) * scale, width);
+				uint32_t count = scale * (end - k * scale);
+				uint32_t sum = 0;
+				for (unsigned r = 0; r < scale; ++r) {
+					for (unsigned i = k * scale; i < end; ++i) {
+						sum += x[r][i];
+					}
+				}
+				ASSERT_EQ((sum + count / 2) / count, dst[k]) << k;
+			}
+		}
+	}
+}
+
+GTEST_TEST(SIMDTest, test_stats_sse41)
+{
+	std::mt19937 mt;
+
+	for (unsigned bytes : { 1U, 2U }) {
+		SCOPED_TRACE(bytes);
+
+		// Extremes inside the vectors and in the scalar tail, on top of running values.
+		unsigned n = 1003;
+		uint32_t max = bytes == 1 ? 0xFF : 0xFFFF;
+		std::vector<uint16_t> x(n);
+		for (unsigned i = 0; i < n; ++i) {
+			x[i] = static_cast<uint16_t>((mt() & max) / 4 + max / 4);
+		}
+		x[517] = static_cast<uint16_t>(max);
+		x[n - 1] = 3;
+		std::vector<uint8_t> x8(x.begin(), x.end());
+
+		p2p::detail::sample_stats stats = { 100, 7, 1000 };
+		p2p::simd::select_stats_sse41(bytes)(bytes == 1 ? static_cast<const void *>(x8.data()) : x.data(), n, stats);
+
+		uint64_t sum = 1000;
+		for (uint16_t v : x) {
+			sum += v;
+		}
+		EXPECT_EQ(3U, stats.min);
+		EXPECT_EQ(max, stats.max);
+		EXPECT_EQ(sum, stats.sum);
+	}
+}
+
+GTEST_TEST(SIMDTest, test_crc32c_sse42)
+{
+	if (!p2p::simd::query_x86_capabilities().sse42)
+		return;
+
+	auto crc32c_ref = [](uint32_t crc, const uint8_t *data, size_t n)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < n; ++i) {
+			crc ^= data[i];
+			for (unsigned bit = 0; bit < 8; ++bit) {
+				crc = crc & 1 ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+			}
+		}
+		return ~crc;
+	};
+
+	p2p::detail::crc32c_func crc32c = p2p::simd::select_crc32c_sse42();
+	EXPECT_EQ(0xE3069283U, crc32c(0, "123456789", 9));
+
+	std::mt19937 mt;
+	std::vector<uint8_t> x(1031);
+	for (uint8_t &v : x) {
+		v = static_cast<uint8_t>(mt());
+	}
+
+	// Every alignment, with the word loop, the dword step and the byte tail.
+	for (unsigned offset = 0; offset < 8; ++offset) {
+		for (size_t n : { 0U, 1U, 3U, 4U, 7U, 12U, 13U, 1023U }) {
+			SCOPED_TRACE(testing::Message() << offset << ' ' << n);
+			EXPECT_EQ(crc32c_ref(0x12345678, x.data() + offset, n), crc32c(0x12345678, x.data() + offset, n));
+		}
+	}
+}
+
+GTEST_TEST(SIMDTest, test_lut_avx2)
+{
+	if (!p2p::simd::query_x86_capabilities().avx2)
+		return;
+
+	std::mt19937 mt;
+
+	// Table sizes of 8-, 10- and 16-bit samples, and of 2-bit alpha.
+	for (unsigned bytes : { 1U, 2U }) {
+		for (unsigned depth : { 2U, 8U, 10U, 16U }) {
+			if (bytes == 1 && depth != 8)
+				continue;
+			SCOPED_TRACE(testing::Message() << bytes << ' ' << depth);
+
+			uint32_t mask = (UINT32_C(1) << depth) - 1;
+			std::vector<uint16_t> table(mask + 1);
+			for (uint16_t &x : table) {
+				x = static_cast<uint16_t>(mt() & mask);
+			}
+			std::vector<uint8_t> table8(table.begin(), table.end());
+
+			// Every index, unmasked bits above the depth, and an odd tail.
+			unsigned n = std::max(mask + 1, 1024U) + 7;
+			std::vector<uint16_t> x(n);
+			for (unsigned i = 0; i < n; ++i) {
+				x[i] = static_cast<uint16_t>(i <= mask ? i : mt());
+				x[i] = bytes == 1 ? x[i] & 0xFF : x[i];
+			}
+			std::vector<uint8_t> x8(x.begin(), x.end());
+
+			p2p::detail::lut_table t = { bytes == 1 ? static_cast<const void *>(table8.data()) : table.data(), mask };
+			std::vector<uint16_t> dst(n);
+			std::vector<uint8_t> dst8(n);
+			if (bytes == 1) {
+				p2p::simd::select_lut_avx2(bytes)(x8.data(), dst8.data(), n, t);
+				dst.assign(dst8.begin(), dst8.end());
+			} else {
+				p2p::simd::select_lut_avx2(bytes)(x.data(), dst.data(), n, t);
+			}
+
+			for (unsigned i = 0; i < n; ++i) {
+				ASSERT_EQ(table[x[i] & mask], dst[i]) << i << ' ' << x[i];
+			}
+		}
+	}
+}
+
 #endif
 
 } // namespace
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+#include "p2p_thread.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+GTEST_TEST(ThreadTest, test_parallel_for)
+{
+	p2p::thread_pool pool{ 4 };
+	std::vector<std::atomic<unsigned>> counts(1000);
+
+	pool.parallel_for(static_cast<unsigned>(counts.size()), [&](unsigned i) { ++counts[i]; });
+
+	for (const auto &x : counts) {
+		ASSERT_EQ(1U, x.load());
+	}
+}
+
+GTEST_TEST(ThreadTest, test_concurrent_submit)
+{
+	p2p::thread_pool pool{ 3 };
+	std::atomic<unsigned> total{};
+	std::vector<std::thread> threads;
+
+	for (unsigned n = 0; n < 4; ++n) {
+		threads.emplace_back([&]()
+		{
+			for (unsigned k = 0; k < 50; ++k) {
+				pool.parallel_for(16, [&](unsigned) { ++total; });
+			}
+		});
+	}
+	for (std::thread &th : threads) {
+		th.join();
+	}
+
+	ASSERT_EQ(4U * 50U * 16U, total.load());
+}
+
+GTEST_TEST(ThreadTest, test_submit_cancel)
+{
+	p2p::thread_pool pool{ 2 };
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::atomic<unsigned> calls{};
+	int status = -1;
+
+	// Occupy the only worker.
+	auto blocker = pool.submit(1, [=](unsigned) { released.wait(); });
+	auto t = pool.submit(4, [&](unsigned) { ++calls; }, [&](bool cancelled) { status = cancelled; });
+
+	ASSERT_TRUE(pool.cancel(t));
+	release.set_value();
+
+	ASSERT_TRUE(pool.wait(t));
+	ASSERT_FALSE(pool.wait(blocker));
+	ASSERT_EQ(0U, calls.load());
+	ASSERT_EQ(1, status);
+	ASSERT_FALSE(pool.cancel(t));
+}
+
+GTEST_TEST(ThreadTest, test_priority)
+{
+	p2p::thread_pool pool{ 2 };
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+	std::vector<int> order;
+
+	// Occupy the only worker while the tasks are queued.
+	auto blocker = pool.submit(1, [=](unsigned) { released.wait(); });
+	auto bg = pool.submit(1, [&](unsigned) { order.push_back(p2p::thread_pool::background); }, nullptr, p2p::thread_pool::background);
+	auto nm = pool.submit(1, [&](unsigned) { order.push_back(p2p::thread_pool::normal); }, nullptr, p2p::thread_pool::normal);
+	auto rt = pool.submit(1, [&](unsigned) { order.push_back(p2p::thread_pool::realtime); }, nullptr, p2p::thread_pool::realtime);
+	release.set_value();
+
+	pool.wait(bg);
+	pool.wait(nm);
+	pool.wait(rt);
+
+	std::vector<int> expected{ p2p::thread_pool::realtime, p2p::thread_pool::normal, p2p::thread_pool::background };
+	ASSERT_EQ(expected, order);
+}
+
+GTEST_TEST(ThreadTest, test_concurrency_limit)
+{
+	p2p::thread_pool pool{ 2 };
+	std::atomic<unsigned> running{};
+	std::atomic<unsigned> peak{};
+	std::vector<std::thread> threads;
+
+	for (unsigned n = 0; n < 6; ++n) {
+		threads.emplace_back([&]()
+		{
+			for (unsigned k = 0; k < 20; ++k) {
+				pool.parallel_for(8, [&](unsigned)
+				{
+					unsigned cur = ++running;
+					unsigned prev = peak.load();
+					while (cur > prev && !peak.compare_exchange_weak(prev, cur)) {}
+					std::this_thread::yield();
+					--running;
+				});
+			}
+		});
+	}
+	for (std::thread &th : threads) {
+		th.join();
+	}
+
+	ASSERT_LE(peak.load(), pool.num_threads());
+}
+
+GTEST_TEST(ThreadTest, test_node_pool)
+{
+	std::vector<unsigned char> buf(1 << 16, 1);
+	std::atomic<unsigned> total{};
+
+	p2p::thread_pool &global = p2p::thread_pool::global();
+	ASSERT_EQ(-1, global.node_of(nullptr));
+
+	int node = global.node_of(buf.data());
+	ASSERT_LE(global.num_threads(node), global.num_threads());
+	global.parallel_for(64, [&](unsigned i) { total += buf[i]; }, p2p::thread_pool::normal, node);
+	ASSERT_EQ(64U, total.load());
+
+	// Two nodes of two CPUs, with the submitter in place of a worker of node 0.
+	std::vector<std::vector<unsigned>> nodes{ { 0, 0 }, { 0, 0 } };
+	p2p::thread_pool pool{ nodes };
+	ASSERT_EQ(4U, pool.num_threads());
+	ASSERT_EQ(2U, pool.num_threads(0));
+	ASSERT_EQ(3U, pool.num_threads(1));
+
+	std::atomic<unsigned> running{};
+	std::atomic<unsigned> peak{};
+	auto func = [&](unsigned)
+	{
+		unsigned cur = ++running;
+		unsigned prev = peak.load();
+		while (cur > prev && !peak.compare_exchange_weak(prev, cur)) {}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		--running;
+	};
+
+	// Only the worker of node 0 runs a task bound to it.
+	pool.wait(pool.submit(16, func, nullptr, p2p::thread_pool::normal, 0));
+	ASSERT_EQ(1U, peak.load());
+}
+
+GTEST_TEST(ThreadTest, test_pinned_pool)
+{
+	p2p::thread_pool pool{ 3, { 0 } };
+	std::atomic<unsigned> total{};
+
+	pool.parallel_for(100, [&](unsigned) { ++total; });
+	ASSERT_EQ(100U, total.load());
+}
+
+} // namespace
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <cstring>
@@ -74,4 +75,67 @@ GTEST_TEST(V210Test, test_v210_le)
 	ASSERT_EQ(packed, packed_tmp);
 }
 
+GTEST_TEST(V210Test, test_v210_2d)
+{
+	const std::array<uint16_t, 12> planar = {
+		0x0101, 0x0102, 0x0103, 0x0104, 0x0105, 0x0106,
+		0x0201, 0x0202, 0x0203,
+		0x0301, 0x0302, 0x0303,
+	};
+	const std::array<uint32_t, 4> packed = {
+		be(0b00'1100000001'0100000001'1000000001),
+		be(0b00'0100000011'1000000010'0100000010),
+		be(0b00'1000000011'0100000100'1100000010),
+		be(0b00'0100000110'1100000011'0100000101),
+	};
+
+	// Second row is a copy of the first.
+	std::array<uint32_t, 8> packed_2d;
+	std::memcpy(&packed_2d[0], &packed, sizeof(packed));
+	std::memcpy(&packed_2d[4], &packed, sizeof(packed));
+
+	std::array<uint16_t, 24> planar_tmp{};
+	void *planar_tmp_ptrs[4] = { &planar_tmp[0], &planar_tmp[12], &planar_tmp[18], nullptr };
+	const ptrdiff_t planar_stride[4] = { 6 * sizeof(uint16_t), 3 * sizeof(uint16_t), 3 * sizeof(uint16_t), 0 };
+
+	SCOPED_TRACE("packed_to_planar");
+	p2p::packed_to_planar<p2p::packed_v210_be>::unpack_2d(&packed_2d, sizeof(packed), planar_tmp_ptrs, planar_stride, 0, 6, 2);
+	for (unsigned i = 0; i < 2; ++i) {
+		ASSERT_TRUE(std::equal(&planar[0], &planar[6], &planar_tmp[i * 6]));
+		ASSERT_TRUE(std::equal(&planar[6], &planar[9], &planar_tmp[12 + i * 3]));
+		ASSERT_TRUE(std::equal(&planar[9], &planar[12], &planar_tmp[18 + i * 3]));
+	}
+
+	SCOPED_TRACE("planar_to_packed");
+	std::array<uint32_t, 8> packed_tmp{};
+	p2p::planar_to_packed<p2p::packed_v210_be>::pack_2d(planar_tmp_ptrs, planar_stride, &packed_tmp, sizeof(packed), 0, 6, 2);
+	ASSERT_EQ(packed_2d, packed_tmp);
+}
+
+GTEST_TEST(V210Test, test_v210_convert)
+{
+	const std::array<uint32_t, 4> packed_be = {
+		be(0b00'1100000001'0100000001'1000000001),
+		be(0b00'0100000011'1000000010'0100000010),
+		be(0b00'1000000011'0100000100'1100000010),
+		be(0b00'0100000110'1100000011'0100000101),
+	};
+	const std::array<uint32_t, 4> packed_le = {
+		be(0b00000001'00000110'00010100'00110000),
+		be(0b00000010'00001001'00111000'00010000),
+		be(0b00000010'00010011'00110100'00100000),
+		be(0b00000101'00001101'01101100'00010000),
+	};
+
+	std::array<uint32_t, 8> src;
+	std::memcpy(&src[0], &packed_be, sizeof(packed_be));
+	std::memcpy(&src[4], &packed_be, sizeof(packed_be));
+
+	std::array<uint32_t, 8> dst{};
+	p2p::packed_to_packed<p2p::packed_v210_be, p2p::packed_v210_le>::convert_2d(&src, sizeof(packed_be), &dst, sizeof(packed_le), 0, 6, 2);
+	for (unsigned i = 0; i < 2; ++i) {
+		ASSERT_TRUE(std::equal(packed_le.begin(), packed_le.end(), &dst[i * 4]));
+	}
+}
+
 } // namespace
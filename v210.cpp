@@ -150,6 +150,36 @@ void pack_v210(const void * const src[4], void *dst, unsigned left, unsigned rig
 	}
 }
 
+template <class Endian>
+void unpack_v210_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+{
+	void *dst_p[4] = { dst[0], dst[1], dst[2], dst[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		unpack_v210<Endian>(src, dst_p, left, right);
+
+		src = detail::increment_ptr(src, src_stride);
+		for (unsigned p = 0; p < 4; ++p) {
+			dst_p[p] = detail::increment_ptr(dst_p[p], dst_stride[p]);
+		}
+	}
+}
+
+template <class Endian>
+void pack_v210_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	const void *src_p[4] = { src[0], src[1], src[2], src[3] };
+
+	for (unsigned i = 0; i < height; ++i) {
+		pack_v210<Endian>(src_p, dst, left, right);
+
+		for (unsigned p = 0; p < 4; ++p) {
+			src_p[p] = detail::increment_ptr(src_p[p], src_stride[p]);
+		}
+		dst = detail::increment_ptr(dst, dst_stride);
+	}
+}
+
 } // namespace
 
 
@@ -183,4 +213,34 @@ void planar_to_packed<packed_v210_le, true>::pack(const void * const src[4], voi
 	pack_v210<little_endian_t>(src, dst, left, right);
 }
 
+void packed_to_planar<packed_v210_be>::unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+{
+	unpack_v210_2d<big_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
+void packed_to_planar<packed_v210_le>::unpack_2d(const void *src, ptrdiff_t src_stride, void * const dst[4], const ptrdiff_t dst_stride[4], unsigned left, unsigned right, unsigned height)
+{
+	unpack_v210_2d<little_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
+void planar_to_packed<packed_v210_be, false>::pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	pack_v210_2d<big_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
+void planar_to_packed<packed_v210_be, true>::pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	pack_v210_2d<big_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
+void planar_to_packed<packed_v210_le, false>::pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	pack_v210_2d<little_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
+void planar_to_packed<packed_v210_le, true>::pack_2d(const void * const src[4], const ptrdiff_t src_stride[4], void *dst, ptrdiff_t dst_stride, unsigned left, unsigned right, unsigned height)
+{
+	pack_v210_2d<little_endian_t>(src, src_stride, dst, dst_stride, left, right, height);
+}
+
 } // namespace p2p